@@ -0,0 +1,151 @@
+//==============================================================================
+// bench_bufferedreader.cpp - Line Reading Throughput
+//==============================================================================
+// Generates a large text file of short lines, then measures how fast it can
+// be split into lines three ways:
+//   1. BufferedReader::forEachLine (no per-line allocation)
+//   2. BufferedReader::readLine (one String per line)
+//   3. File::readToBuffer in 64 KB chunks with a manual newline scan
+//
+// Usage:
+//   bench_bufferedreader [-s <megabytes>] [-f <path>] [-k]
+//
+// The default is a 1024 MB file in the current directory, deleted afterwards
+// unless -k is given. An existing file of the right size is reused.
+//==============================================================================
+
+#include "attoboy/attoboy.h"
+
+using namespace attoboy;
+
+static const int CHUNK_SIZE = 1024 * 1024;
+
+static bool CountLine(const char *line, int length, void *arg) {
+  long long *bytes = (long long *)arg;
+  *bytes += length;
+  return true;
+}
+
+static Buffer MakeChunk() {
+  // Lines of varying length (20-99 characters), cut at a line boundary so
+  // every chunk ends with "\n".
+  Buffer chunk(CHUNK_SIZE);
+  String letters("abcdefghijklmnopqrstuvwxyz0123456789");
+  int lineNo = 0;
+  while (true) {
+    int len = 20 + (lineNo * 37) % 80;
+    if (chunk.length() + len + 1 > CHUNK_SIZE)
+      break;
+    String line;
+    for (int i = 0; i < len; i++)
+      line = line + letters.at((lineNo + i) % 36);
+    chunk.append(line + "\n");
+    lineNo++;
+  }
+  return chunk;
+}
+
+static bool Generate(const Path &path, int megabytes) {
+  long long wanted = (long long)megabytes * CHUNK_SIZE;
+  if (path.exists() && path.getSize() >= wanted - CHUNK_SIZE &&
+      path.getSize() <= wanted)
+    return true;
+
+  path.deleteFile();
+  Buffer chunk = MakeChunk();
+  File file(path);
+  if (!file.isValid())
+    return false;
+  for (int i = 0; i < megabytes; i++) {
+    if (file.write(chunk) != chunk.length())
+      return false;
+  }
+  return true;
+}
+
+static void Report(const String &name, long long bytes, long long lines,
+                   long long ms) {
+  if (ms <= 0)
+    ms = 1;
+  long long mbps = Math::Div64(Math::Div64(bytes, CHUNK_SIZE) * 1000, ms);
+  Log(name, ": ", lines, " lines, ", bytes, " bytes in ", ms, " ms (", mbps,
+      " MB/s)");
+}
+
+extern "C" void atto_main() {
+  Arguments args;
+  args.addParameter("s", "File size in megabytes", "1024", "size")
+      .addParameter("f", "Path of the generated file", "bench_lines.txt",
+                    "file")
+      .addFlag("k", "Keep the generated file", false, "keep")
+      .setHelp("bench_bufferedreader - Line Reading Throughput\n\n"
+               "Usage: bench_bufferedreader [-s <MB>] [-f <path>] [-k]");
+
+  Map parsed = args.parseArguments();
+  if (parsed.isEmpty()) {
+    Exit(1);
+    return;
+  }
+
+  int megabytes = parsed.get<String, String>("s").toInteger();
+  if (megabytes <= 0)
+    megabytes = 1024;
+  Path path(parsed.get<String, String>("f"));
+
+  Log("Generating ", megabytes, " MB at ", path.toString(), "...");
+  if (!Generate(path, megabytes)) {
+    LogError("Could not write ", path.toString());
+    Exit(1);
+    return;
+  }
+
+  // 1. forEachLine
+  {
+    File file(path);
+    BufferedReader reader(file);
+    long long bytes = 0;
+    DateTime start;
+    long long lines = reader.forEachLine(CountLine, &bytes);
+    Report("forEachLine", bytes + lines, lines, DateTime().diff(start));
+  }
+
+  // 2. readLine
+  {
+    File file(path);
+    BufferedReader reader(file);
+    long long bytes = 0;
+    long long lines = 0;
+    DateTime start;
+    while (!reader.isAtEnd()) {
+      String line = reader.readLine();
+      bytes += line.byteLength() + 1;
+      lines++;
+    }
+    Report("readLine", bytes, lines, DateTime().diff(start));
+  }
+
+  // 3. Raw 64 KB chunks with a byte-by-byte newline scan
+  {
+    File file(path);
+    long long bytes = 0;
+    long long lines = 0;
+    DateTime start;
+    while (true) {
+      Buffer chunk = file.readToBuffer(65536);
+      int len = 0;
+      const unsigned char *data = chunk.c_ptr(&len);
+      if (len == 0)
+        break;
+      for (int i = 0; i < len; i++) {
+        if (data[i] == '\n')
+          lines++;
+      }
+      bytes += len;
+    }
+    Report("readToBuffer", bytes, lines, DateTime().diff(start));
+  }
+
+  if (!parsed.get<String, String>("k", "false").toBool())
+    path.deleteFile();
+  Exit(0);
+}
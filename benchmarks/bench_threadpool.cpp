@@ -0,0 +1,152 @@
+//==============================================================================
+// bench_threadpool.cpp - Task Throughput and Fan-Out Latency
+//==============================================================================
+// Measures the cost of scheduling work four ways:
+//   1. Empty tasks submitted from the main thread (tasks/sec)
+//   2. Empty tasks submitted from inside a task, so they land on the
+//      worker's own queue and are stolen by the others (tasks/sec)
+//   3. Fan-out/fan-in: submit a batch of tasks and await them all, repeated
+//      (microseconds per round)
+//   4. The same fan-out with one Thread per task
+//
+// Usage:
+//   bench_threadpool [-t <tasks>] [-f <fan-out>] [-r <rounds>] [-w <workers>]
+//
+// The default is 1000000 empty tasks and 1000 rounds of 64 tasks on one
+// worker per logical processor. The fan-out is capped at 4096.
+//==============================================================================
+
+#include "attoboy/attoboy.h"
+#include <new>
+
+using namespace attoboy;
+
+// Largest fan-out; the handles of one round live in fixed storage.
+static const int MAX_FAN_OUT = 4096;
+alignas(Future) static unsigned char g_futureSlots[MAX_FAN_OUT *
+                                                   sizeof(Future)];
+alignas(Thread) static unsigned char g_threadSlots[MAX_FAN_OUT *
+                                                   sizeof(Thread)];
+
+static void *EmptyTask(void *arg, const CancelToken &token) { return arg; }
+
+static void *EmptyThread(void *arg) { return arg; }
+
+struct Spawner {
+  ThreadPool *pool;
+  int tasks;
+};
+
+// Submits every task from a worker and waits for them there.
+static void *SpawnTasks(void *arg, const CancelToken &token) {
+  Spawner *spawner = (Spawner *)arg;
+  Future last = spawner->pool->submit(EmptyTask);
+  for (int i = 1; i < spawner->tasks; i++)
+    last = spawner->pool->submit(EmptyTask);
+  last.await();
+  return nullptr;
+}
+
+static void ReportRate(const String &name, int tasks, long long ms) {
+  if (ms <= 0)
+    ms = 1;
+  Log(name, ": ", tasks, " tasks in ", ms, " ms (",
+      Math::Div64((long long)tasks * 1000, ms), " tasks/s)");
+}
+
+static void ReportLatency(const String &name, int rounds, int fanOut,
+                          long long ms) {
+  if (ms <= 0)
+    ms = 1;
+  Log(name, ": ", rounds, " rounds of ", fanOut, " tasks in ", ms, " ms (",
+      Math::Div64(ms * 1000, rounds), " us per round)");
+}
+
+extern "C" void atto_main() {
+  Arguments args;
+  args.addParameter("t", "Number of empty tasks", "1000000", "tasks")
+      .addParameter("f", "Tasks per fan-out round", "64", "fanout")
+      .addParameter("r", "Fan-out rounds", "1000", "rounds")
+      .addParameter("w", "Worker threads (0 = one per processor)", "0",
+                    "workers")
+      .setHelp("bench_threadpool - Task Throughput and Fan-Out Latency\n\n"
+               "Usage: bench_threadpool [-t <tasks>] [-f <fan-out>] "
+               "[-r <rounds>] [-w <workers>]");
+
+  Map parsed = args.parseArguments();
+  if (parsed.isEmpty()) {
+    Exit(1);
+    return;
+  }
+
+  int tasks = parsed.get<String, String>("t").toInteger();
+  if (tasks <= 0)
+    tasks = 1000000;
+  int fanOut = parsed.get<String, String>("f").toInteger();
+  if (fanOut <= 0)
+    fanOut = 64;
+  if (fanOut > MAX_FAN_OUT)
+    fanOut = MAX_FAN_OUT;
+  int rounds = parsed.get<String, String>("r").toInteger();
+  if (rounds <= 0)
+    rounds = 1000;
+
+  ThreadPool pool(parsed.get<String, String>("w").toInteger());
+  Log("Workers: ", pool.getWorkerCount());
+
+  // 1. Empty tasks from the main thread
+  {
+    DateTime start;
+    for (int i = 0; i < tasks; i++)
+      pool.submit(EmptyTask);
+    pool.waitIdle();
+    ReportRate("ThreadPool, external submit", tasks, DateTime().diff(start));
+  }
+
+  // 2. Empty tasks from a worker
+  {
+    Spawner spawner = {&pool, tasks};
+    long long steals = pool.getStealCount();
+    DateTime start;
+    pool.submit(SpawnTasks, &spawner).await();
+    pool.waitIdle();
+    ReportRate("ThreadPool, worker submit", tasks, DateTime().diff(start));
+    Log("  stolen: ", pool.getStealCount() - steals);
+  }
+
+  Future *futures = (Future *)g_futureSlots;
+  Thread *threads = (Thread *)g_threadSlots;
+
+  // 3. Fan-out/fan-in on the pool
+  {
+    DateTime start;
+    for (int r = 0; r < rounds; r++) {
+      for (int i = 0; i < fanOut; i++)
+        new (&futures[i]) Future(pool.submit(EmptyTask));
+      for (int i = 0; i < fanOut; i++) {
+        futures[i].await();
+        futures[i].~Future();
+      }
+    }
+    ReportLatency("ThreadPool fan-out", rounds, fanOut,
+                  DateTime().diff(start));
+  }
+
+  // 4. Fan-out/fan-in with a thread per task
+  {
+    int threadRounds = rounds / 10 > 0 ? rounds / 10 : 1;
+    DateTime start;
+    for (int r = 0; r < threadRounds; r++) {
+      for (int i = 0; i < fanOut; i++)
+        new (&threads[i]) Thread(EmptyThread);
+      for (int i = 0; i < fanOut; i++) {
+        threads[i].await();
+        threads[i].~Thread();
+      }
+    }
+    ReportLatency("Thread per task fan-out", threadRounds, fanOut,
+                  DateTime().diff(start));
+  }
+
+  Exit(0);
+}
@@ -0,0 +1,176 @@
+//==============================================================================
+// bench_webserver.cpp - WebServer Request Throughput and Latency
+//==============================================================================
+// Starts a WebServer with one small route, then drives it from client threads
+// over keep-alive loopback connections. Each client sends its requests in
+// batches of the pipeline depth and waits for the whole batch to be answered.
+//
+// Usage:
+//   bench_webserver [-c <connections>] [-n <requests>] [-p <depth>]
+//                   [-P <port>]
+//
+// The defaults are 64 connections, 200000 requests in total, no pipelining
+// (depth 1) and any free port. Reports requests per second and the median,
+// p99 and maximum batch latency.
+//==============================================================================
+
+#include "attoboy/attoboy.h"
+#include <windows.h>
+
+using namespace attoboy;
+
+// Latency histogram in 10 microsecond buckets, up to one second.
+static const int BUCKET_US = 10;
+static const int BUCKET_COUNT = 100000;
+
+static volatile LONG g_histogram[BUCKET_COUNT];
+static LARGE_INTEGER g_frequency;
+static int g_port = 0;
+static int g_requests = 0;
+static int g_depth = 1;
+static int g_responseLength = 0;
+
+static const char REQUEST[] = "GET /bench HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+static void Hello(const WebServerRequest &request, WebServerResponse &response,
+                  void *arg) {
+  response.write(String("Hello, world!"));
+}
+
+static void Record(long long ticks) {
+  long long us = Math::Div64(ticks * 1000000, g_frequency.QuadPart);
+  long long bucket = Math::Div64(us, BUCKET_US);
+  if (bucket >= BUCKET_COUNT)
+    bucket = BUCKET_COUNT - 1;
+  InterlockedIncrement(&g_histogram[bucket]);
+}
+
+// Reads exactly count bytes. Returns false if the server closed early.
+static bool ReadResponses(File &client, int count) {
+  while (count > 0) {
+    Buffer chunk = client.readToBuffer(count < 65536 ? count : 65536);
+    if (chunk.isEmpty())
+      return false;
+    count -= chunk.length();
+  }
+  return true;
+}
+
+static void *Client(void *arg) {
+  File client(String("127.0.0.1"), g_port);
+  if (!client.isValid())
+    return (void *)0;
+
+  String batch;
+  for (int i = 0; i < g_depth; i++)
+    batch = batch + REQUEST;
+
+  long long done = 0;
+  while (done < g_requests) {
+    LARGE_INTEGER start;
+    LARGE_INTEGER end;
+    QueryPerformanceCounter(&start);
+    client.write(batch);
+    if (!ReadResponses(client, g_responseLength * g_depth))
+      break;
+    QueryPerformanceCounter(&end);
+    Record(end.QuadPart - start.QuadPart);
+    done += g_depth;
+  }
+  return (void *)done;
+}
+
+static long long Percentile(long long total, int percent) {
+  long long wanted = Math::Div64(total * percent + 99, 100);
+  long long seen = 0;
+  for (int i = 0; i < BUCKET_COUNT; i++) {
+    seen += g_histogram[i];
+    if (seen >= wanted)
+      return (long long)(i + 1) * BUCKET_US;
+  }
+  return (long long)BUCKET_COUNT * BUCKET_US;
+}
+
+extern "C" void atto_main() {
+  Arguments args;
+  args.addParameter("c", "Concurrent connections", "64", "connections")
+      .addParameter("n", "Total requests", "200000", "requests")
+      .addParameter("p", "Pipelined requests per batch", "1", "depth")
+      .addParameter("P", "Server port (0 = any free port)", "0", "port")
+      .setHelp("bench_webserver - WebServer Request Throughput and Latency\n\n"
+               "Usage: bench_webserver [-c <connections>] [-n <requests>] "
+               "[-p <depth>] [-P <port>]");
+
+  Map parsed = args.parseArguments();
+  if (parsed.isEmpty()) {
+    Exit(1);
+    return;
+  }
+
+  int connections = parsed.get<String, String>("c").toInteger();
+  int total = parsed.get<String, String>("n").toInteger();
+  g_depth = parsed.get<String, String>("p").toInteger();
+  if (connections <= 0)
+    connections = 64;
+  if (total <= 0)
+    total = 200000;
+  if (g_depth <= 0)
+    g_depth = 1;
+  // Each client sends whole batches, so round its share up to the depth.
+  g_requests = (total + connections - 1) / connections;
+  g_requests = (g_requests + g_depth - 1) / g_depth * g_depth;
+  QueryPerformanceFrequency(&g_frequency);
+
+  WebServer server(parsed.get<String, String>("P").toInteger());
+  server.addRoute("GET", "/bench", Hello);
+  if (!server.start()) {
+    LogError("Could not start the server");
+    Exit(1);
+    return;
+  }
+  g_port = server.getPort();
+
+  // Every response is identical, so one sample gives the length to read.
+  {
+    File probe(String("127.0.0.1"), g_port);
+    probe.write(String(REQUEST));
+    Sleep(100);
+    g_responseLength = probe.readToBuffer(65536).length();
+    if (g_responseLength <= 0) {
+      LogError("No response from the server");
+      Exit(1);
+      return;
+    }
+  }
+
+  Log("Serving on port ", g_port, ": ", connections, " connections, ",
+      g_requests * connections, " requests, pipeline depth ", g_depth);
+
+  Thread **threads = (Thread **)Alloc(connections * (int)sizeof(Thread *));
+  DateTime start;
+  for (int i = 0; i < connections; i++)
+    threads[i] = new Thread(Client);
+  long long completed = 0;
+  for (int i = 0; i < connections; i++) {
+    completed += (long long)threads[i]->await();
+    delete threads[i];
+  }
+  long long ms = DateTime().diff(start);
+  Free(threads);
+  server.stop();
+
+  if (ms <= 0)
+    ms = 1;
+  long long batches = 0;
+  long long maxUs = 0;
+  for (int i = 0; i < BUCKET_COUNT; i++) {
+    batches += g_histogram[i];
+    if (g_histogram[i])
+      maxUs = (long long)(i + 1) * BUCKET_US;
+  }
+  Log(completed, " requests in ", ms, " ms (",
+      Math::Div64(completed * 1000, ms), " req/s)");
+  Log("Batch latency: p50 ", Percentile(batches, 50), " us, p99 ",
+      Percentile(batches, 99), " us, max ", maxUs, " us");
+  Exit(completed == (long long)g_requests * connections ? 0 : 1);
+}
@@ -1,13 +1,13 @@
 //==============================================================================
 // Attoboy HTTP File Server
-// A simple single-threaded HTTP server demonstrating attoboy's networking
+// A multi-threaded HTTP server demonstrating attoboy's WebServer
 //==============================================================================
 //
 // Usage:
-//   example_web_server                     # Serve current directory on port
-//   8123 example_web_server -p 8080             # Serve current directory on
-//   port 8080 example_web_server C:\www              # Serve C:\www on port
-//   8123 example_web_server -p 80 C:\www        # Serve C:\www on port 80
+//   example_web_server                   # Serve current directory on port 8123
+//   example_web_server -p 8080           # Serve current directory on port 8080
+//   example_web_server C:\www            # Serve C:\www on port 8123
+//   example_web_server -p 80 C:\www      # Serve C:\www on port 80
 //
 //==============================================================================
 
@@ -23,144 +23,31 @@ using namespace attoboy;
 //------------------------------------------------------------------------------
 
 static volatile bool g_serverRunning = true;
-static int g_serverPort = 8123;
-
-static void *UnblockAcceptThread(void *arg) {
-  File client("127.0.0.1", g_serverPort);
-  if (client.isValid()) {
-    client.write("GET / HTTP/1.0\r\n\r\n");
-    Sleep(100); // Give time for the request to be processed
-    client.close();
-  }
-  return nullptr;
-}
 
 static BOOL WINAPI ConsoleCtrlHandler(DWORD ctrlType) {
   if (ctrlType == CTRL_C_EVENT || ctrlType == CTRL_BREAK_EVENT) {
     g_serverRunning = false;
     Log("\nShutting down server...");
-
-    // Start thread to unblock accept()
-    Thread unblockThread(UnblockAcceptThread, nullptr);
-
     return TRUE;
   }
   return FALSE;
 }
 
-//------------------------------------------------------------------------------
-// Content-Type Mapping
-//------------------------------------------------------------------------------
-
-static String GetContentType(const String &extension) {
-  String ext = extension.lower();
-
-  // Text formats
-  if (ext == "html" || ext == "htm")
-    return "text/html; charset=utf-8";
-  if (ext == "css")
-    return "text/css; charset=utf-8";
-  if (ext == "js")
-    return "text/javascript; charset=utf-8";
-  if (ext == "json")
-    return "application/json; charset=utf-8";
-  if (ext == "xml")
-    return "application/xml; charset=utf-8";
-  if (ext == "txt")
-    return "text/plain; charset=utf-8";
-  if (ext == "csv")
-    return "text/csv; charset=utf-8";
-  if (ext == "md")
-    return "text/markdown; charset=utf-8";
-
-  // Images
-  if (ext == "png")
-    return "image/png";
-  if (ext == "jpg" || ext == "jpeg")
-    return "image/jpeg";
-  if (ext == "gif")
-    return "image/gif";
-  if (ext == "ico")
-    return "image/x-icon";
-  if (ext == "svg")
-    return "image/svg+xml";
-  if (ext == "webp")
-    return "image/webp";
-  if (ext == "bmp")
-    return "image/bmp";
-
-  // Fonts
-  if (ext == "woff")
-    return "font/woff";
-  if (ext == "woff2")
-    return "font/woff2";
-  if (ext == "ttf")
-    return "font/ttf";
-  if (ext == "otf")
-    return "font/otf";
-  if (ext == "eot")
-    return "application/vnd.ms-fontobject";
-
-  // Documents
-  if (ext == "pdf")
-    return "application/pdf";
-  if (ext == "zip")
-    return "application/zip";
-  if (ext == "gz" || ext == "gzip")
-    return "application/gzip";
-  if (ext == "tar")
-    return "application/x-tar";
-
-  // Audio/Video
-  if (ext == "mp3")
-    return "audio/mpeg";
-  if (ext == "wav")
-    return "audio/wav";
-  if (ext == "ogg")
-    return "audio/ogg";
-  if (ext == "mp4")
-    return "video/mp4";
-  if (ext == "webm")
-    return "video/webm";
-
-  // Default binary
-  return "application/octet-stream";
-}
-
 //------------------------------------------------------------------------------
 // HTTP Response Helpers
 //------------------------------------------------------------------------------
 
 static String GetStatusText(int code) {
-  if (code == 200)
-    return "OK";
-  if (code == 400)
-    return "Bad Request";
   if (code == 403)
     return "Forbidden";
   if (code == 404)
     return "Not Found";
   if (code == 405)
     return "Method Not Allowed";
-  if (code == 500)
-    return "Internal Server Error";
-  return "Unknown";
+  return "Error";
 }
 
-static String BuildResponseHeaders(int statusCode, const String &contentType,
-                                   long long contentLength) {
-  String response =
-      String("HTTP/1.1 ", statusCode, " ", GetStatusText(statusCode), "\r\n");
-  response = response + "Content-Type: " + contentType + "\r\n";
-  response =
-      response + "Content-Length: " + String((int)contentLength) + "\r\n";
-  response = response + "Connection: close\r\n";
-  response = response + "Server: attoboy-httpd/1.0\r\n";
-  response = response + "\r\n";
-  return response;
-}
-
-static void SendErrorResponse(File &client, int statusCode) {
+static void SendErrorResponse(WebServerResponse &response, int statusCode) {
   String body =
       String("<!DOCTYPE html>\n"
              "<html><head><title>",
@@ -175,10 +62,9 @@ static void SendErrorResponse(File &client, int statusCode) {
              "<p>The requested resource could not be served.</p>\n"
              "<hr><p><em>attoboy-httpd</em></p></body></html>\n");
 
-  String headers = BuildResponseHeaders(statusCode, "text/html; charset=utf-8",
-                                        body.byteLength());
-  client.write(headers);
-  client.write(body);
+  response.setStatus(statusCode);
+  response.setHeader("Content-Type", "text/html; charset=utf-8");
+  response.write(body);
 }
 
 //------------------------------------------------------------------------------
@@ -186,52 +72,15 @@ static void SendErrorResponse(File &client, int statusCode) {
 //------------------------------------------------------------------------------
 
 static String NormalizePath(const String &path) {
-  // Decode URL-encoded characters (basic: %20, %2F, etc.)
-  String decoded;
-  int len = path.byteLength();
-  const char *p = path.c_str();
-
-  for (int i = 0; i < len; ++i) {
-    if (p[i] == '%' && i + 2 < len) {
-      char hex[3] = {p[i + 1], p[i + 2], 0};
-      int val = 0;
-      for (int j = 0; j < 2; ++j) {
-        char c = hex[j];
-        val *= 16;
-        if (c >= '0' && c <= '9')
-          val += c - '0';
-        else if (c >= 'a' && c <= 'f')
-          val += 10 + c - 'a';
-        else if (c >= 'A' && c <= 'F')
-          val += 10 + c - 'A';
-      }
-      if (val > 0 && val < 256) {
-        char ch = (char)val;
-        decoded = decoded + String::FromCStr(&ch, 1);
-      }
-      i += 2;
-    } else if (p[i] == '+') {
-      decoded = decoded + " ";
-    } else {
-      decoded = decoded + String::FromCStr(&p[i], 1);
-    }
-  }
-
-  // Normalize slashes to forward slash
-  decoded = decoded.replace("\\", "/");
-
-  // Remove query string if present
-  int queryPos = decoded.getPositionOf("?");
-  if (queryPos >= 0) {
-    decoded = decoded.substring(0, queryPos);
-  }
+  // The server has already URL-decoded the path and removed the query.
+  String normalized = path.replace("\\", "/");
 
   // Collapse multiple slashes
-  while (decoded.contains("//")) {
-    decoded = decoded.replace("//", "/");
+  while (normalized.contains("//")) {
+    normalized = normalized.replace("//", "/");
   }
 
-  return decoded;
+  return normalized;
 }
 
 static bool IsPathSafe(const String &requestPath) {
@@ -377,91 +226,31 @@ static String GenerateDirectoryListing(const Path &dir, const String &urlPath) {
   return html;
 }
 
-//------------------------------------------------------------------------------
-// Request Parsing
-//------------------------------------------------------------------------------
-
-struct HttpRequest {
-  String method;
-  String path;
-  bool valid;
-};
-
-static HttpRequest ParseRequest(const String &raw) {
-  HttpRequest req;
-  req.valid = false;
-
-  // Find the first line
-  int lineEnd = raw.getPositionOf("\r\n");
-  if (lineEnd < 0) {
-    lineEnd = raw.getPositionOf("\n");
-  }
-  if (lineEnd < 0)
-    return req;
-
-  String requestLine = raw.substring(0, lineEnd);
-  List parts = requestLine.split(" ", 3);
-
-  if (parts.length() < 2)
-    return req;
-
-  req.method = parts.at<String>(0).upper();
-  req.path = parts.at<String>(1);
-  req.valid = true;
-
-  return req;
-}
-
 //------------------------------------------------------------------------------
 // Request Handler
 //------------------------------------------------------------------------------
 
-static void HandleClient(File &client, const Path &rootDir) {
-  // Read the request (simple approach: read what's available)
-  String request;
-
-  // Wait briefly for data
-  Sleep(10);
-
-  // Read available data
-  if (client.hasAvailable()) {
-    request = client.readToString(8192);
-  }
-
-  if (request.isEmpty()) {
-    client.flush();
-    client.close();
-    return;
-  }
-
-  // Parse the request
-  HttpRequest req = ParseRequest(request);
-
-  if (!req.valid) {
-    Log(req.path, " -> 400");
-    SendErrorResponse(client, 400);
-    client.flush();
-    client.close();
-    return;
-  }
-
-  // Only allow GET
-  if (req.method != "GET") {
-    Log(req.path, " -> 405");
-    SendErrorResponse(client, 405);
-    client.flush();
-    client.close();
+// Runs on the server's I/O worker threads, so several requests may be served
+// at once. arg is the root directory.
+static void HandleRequest(const WebServerRequest &request,
+                          WebServerResponse &response, void *arg) {
+  const Path &rootDir = *(const Path *)arg;
+
+  // Only GET and HEAD are served.
+  String method = request.getMethod();
+  if (method != "GET" && method != "HEAD") {
+    Log(request.getPath(), " -> 405");
+    response.setHeader("Allow", "GET, HEAD");
+    SendErrorResponse(response, 405);
     return;
   }
 
   // Normalize and validate path
-  String urlPath = NormalizePath(req.path);
+  String urlPath = NormalizePath(request.getPath());
 
   if (!IsPathSafe(urlPath)) {
     Log(urlPath, " -> 403");
-    SendErrorResponse(client, 403);
-    client.flush();
-    client.close();
+    SendErrorResponse(response, 403);
     return;
   }
 
@@ -483,18 +272,14 @@ static void HandleClient(File &client, const Path &rootDir) {
   // Check if path exists
   if (!targetPath.exists()) {
     Log(urlPath, " -> 404");
-    SendErrorResponse(client, 404);
-    client.flush();
-    client.close();
+    SendErrorResponse(response, 404);
     return;
   }
 
   // Security: verify the resolved path is within root
   if (!targetPath.isWithin(rootDir) && !targetPath.equals(rootDir)) {
     Log(urlPath, " -> 403");
-    SendErrorResponse(client, 403);
-    client.flush();
-    client.close();
+    SendErrorResponse(response, 403);
     return;
   }
 
@@ -506,52 +291,21 @@ static void HandleClient(File &client, const Path &rootDir) {
       targetPath = indexPath;
     } else {
       // Generate directory listing
-      String listing = GenerateDirectoryListing(targetPath, urlPath);
-      String headers = BuildResponseHeaders(200, "text/html; charset=utf-8",
-                                            listing.byteLength());
-      client.write(headers);
-      client.write(listing);
+      response.setHeader("Content-Type", "text/html; charset=utf-8");
+      response.write(GenerateDirectoryListing(targetPath, urlPath));
       Log(urlPath, " -> 200 (directory)");
-      client.flush();
-      client.close();
       return;
     }
   }
 
-  // Serve file
-  if (!targetPath.isRegularFile()) {
+  // Serve file, with the Content-Type taken from its extension
+  if (!response.sendFile(targetPath)) {
     Log(urlPath, " -> 404");
-    SendErrorResponse(client, 404);
-    client.flush();
-    client.close();
+    SendErrorResponse(response, 404);
     return;
   }
 
-  // Read file content
-  Buffer content = targetPath.readToBuffer();
-  String contentType = GetContentType(targetPath.getExtension());
-
-  // Send response
-  String headers = BuildResponseHeaders(200, contentType, content.length());
-  client.write(headers);
-
-  // Write content in chunks for large files
-  int len = 0;
-  const unsigned char *data = content.c_ptr(&len);
-  int written = 0;
-  while (written < len) {
-    int chunk = len - written;
-    if (chunk > 65536)
-      chunk = 65536;
-    int n = client.writeUpTo(Buffer(data + written, chunk));
-    if (n <= 0)
-      break;
-    written += n;
-  }
-
   Log(urlPath, " -> 200");
-  client.flush();
-  client.close();
 }
 
 //------------------------------------------------------------------------------
@@ -566,7 +320,7 @@ extern "C" void atto_main() {
       "path", "Directory to serve (default: current directory)");
   args.setHelp(
       "Attoboy HTTP File Server\n\n"
-      "A simple single-threaded HTTP server for serving static files.\n\n"
+      "A multi-threaded HTTP server for serving static files.\n\n"
       "Usage: example_web_server [options] [path]\n\n"
       "Examples:\n"
       "  example_web_server                    Serve current directory on port "
@@ -587,7 +341,6 @@ extern "C" void atto_main() {
     LogError("Invalid port number. Must be between 1 and 65535.");
     Exit(1);
   }
-  g_serverPort = port;
 
   // Get root directory
   String rootPath = parsed.get<String, String>("path", ".");
@@ -610,10 +363,11 @@ extern "C" void atto_main() {
   // Set up CTRL-C handler
   SetConsoleCtrlHandler(ConsoleCtrlHandler, TRUE);
 
-  // Create server socket
-  File server(port);
+  // Every path goes to the one handler, for any method.
+  WebServer server(port);
+  server.addRoute("", "/", HandleRequest, &rootDir);
 
-  if (!server.isValid()) {
+  if (!server.start()) {
     LogError("Failed to create server socket on port ", port);
     LogError("The port may be in use or require administrator privileges.");
     Exit(1);
@@ -628,14 +382,12 @@ extern "C" void atto_main() {
   Log("Press Ctrl+C to stop the server.");
   Log("");
 
-  // Main server loop
+  // Requests are served on the server's worker threads; this thread only
+  // waits for Ctrl+C.
   while (g_serverRunning) {
-    File client = server.accept();
-
-    if (client.isValid()) {
-      HandleClient(client, rootDir);
-    }
+    Sleep(250);
   }
 
-  Log("Server stopped.");
+  server.stop();
+  Log("Server stopped. ", (int)server.getRequestCount(), " requests served.");
 }
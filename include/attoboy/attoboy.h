@@ -42,8 +42,16 @@ class BufferImpl;
 class ArgumentsImpl;
 class ThreadImpl;
 class MutexImpl;
+class ThreadPoolImpl;
+class FutureImpl;
+class CancelTokenImpl;
 class PathImpl;
+class DirectoryWalkerImpl;
+class DirectoryWatcherImpl;
+class FileCopierImpl;
+class SearchImpl;
 class FileImpl;
+class DatagramImpl;
 class SubprocessImpl;
 class RegistryImpl;
 class WebRequestImpl;
@@ -52,6 +60,18 @@ class AIImpl;
 class EmbeddingImpl;
 class ConversationImpl;
 class ConsoleImpl;
+class HasherImpl;
+class DigestImpl;
+class BufferViewImpl;
+class BufferChainImpl;
+class MappedFileImpl;
+class BufferedReaderImpl;
+class BufferedWriterImpl;
+class AsyncResultImpl;
+class PollerImpl;
+class WebServerImpl;
+class WebServerRequestImpl;
+class WebServerResponseImpl;
 
 class List;
 class Map;
@@ -60,6 +80,11 @@ class WebResponse;
 class AI;
 class Embedding;
 class Conversation;
+class File;
+class Datagram;
+class MappedFile;
+class Subprocess;
+class AsyncResult;
 struct ListValueView;
 struct MapValueView;
 struct DefaultValue;
@@ -216,6 +241,10 @@ public:
   String operator+(const String &other) const;
   /// Returns a hash code for this string.
   int hash() const;
+  /// Returns a 64-bit xxHash64 of the string's UTF-8 bytes.
+  long long hash64() const;
+  /// Returns the CRC-32C checksum of the string's UTF-8 bytes.
+  int crc32c() const;
 
   /// Splits this string by newlines into a list.
   List lines() const;
@@ -232,6 +261,7 @@ public:
   String format(const Map &map) const;
 
 private:
+  friend class Buffer;
   StringImpl *impl;
 };
 
@@ -790,8 +820,21 @@ private:
   DateTimeImpl *impl;
 };
 
+/// Formats for Buffer::compress() and Buffer::decompress().
+enum CompressionFormat {
+  /// attoboy's own LZ4 container: fastest, only readable by attoboy.
+  COMPRESSION_LZ4 = 0,
+  /// gzip (RFC 1952), as in Content-Encoding: gzip.
+  COMPRESSION_GZIP,
+  /// zlib-wrapped deflate (RFC 1950/1951), as in Content-Encoding: deflate.
+  /// Decompression also accepts raw deflate.
+  COMPRESSION_DEFLATE
+};
+
 /// Mutable byte buffer for binary data.
-/// Supports compression (LZ4) and encryption (ChaCha20).
+/// Supports compression (LZ4, gzip, deflate) and encryption (ChaCha20).
+/// Copies and slices share bytes with the original until one of them is
+/// modified.
 class Buffer {
 public:
   /// Creates an empty buffer.
@@ -802,7 +845,7 @@ public:
   Buffer(const String &str);
   /// Creates a buffer by copying bytes from a pointer.
   Buffer(const unsigned char *ptr, int size);
-  /// Creates a copy of another buffer.
+  /// Creates a copy of another buffer (shares bytes until either changes).
   Buffer(const Buffer &other);
   /// Destroys the buffer and frees memory.
   ~Buffer();
@@ -840,16 +883,19 @@ public:
   Buffer &remove(int start, int end = -1);
   /// Reverses byte order in place. Returns this buffer for chaining.
   Buffer &reverse();
-  /// Shrinks capacity to match length. Returns this buffer for chaining.
+  /// Shrinks capacity to match length and stops sharing storage with other
+  /// buffers. Returns this buffer for chaining.
   Buffer &trim();
 
-  /// Returns a new buffer with bytes from start to end.
+  /// Returns a buffer with bytes from start to end. The bytes are shared, not
+  /// copied; call trim() on a small slice to let a large parent be freed.
   Buffer slice(int start, int end = -1) const;
 
-  /// Returns an LZ4-compressed version of this buffer.
-  Buffer compress() const;
-  /// Returns a decompressed version of this buffer.
-  Buffer decompress() const;
+  /// Returns a compressed version of this buffer (LZ4 by default).
+  Buffer compress(CompressionFormat format = COMPRESSION_LZ4) const;
+  /// Returns a decompressed version of this buffer, or an empty buffer if it
+  /// is not valid data in the given format.
+  Buffer decompress(CompressionFormat format = COMPRESSION_LZ4) const;
 
   /// Encrypts/decrypts using ChaCha20 (symmetric). Key ≥32 bytes, nonce ≥12
   /// bytes.
@@ -864,9 +910,11 @@ public:
   /// bytes.
   Buffer crypt(const Buffer &key, const Buffer &nonce) const;
 
-  /// Converts the buffer to a Base64-encoded string.
-  String toBase64() const;
-  /// Creates a buffer from a Base64-encoded string.
+  /// Converts the buffer to a Base64-encoded string. urlSafe selects the
+  /// "-_" alphabet (RFC 4648 section 5); pad controls trailing '=' characters.
+  String toBase64(bool urlSafe = false, bool pad = true) const;
+  /// Creates a buffer from a Base64-encoded string. Accepts the standard and
+  /// URL-safe alphabets, with or without padding. Whitespace is ignored.
   static Buffer fromBase64(const String &base64);
   /// Converts the buffer's bytes to a String, based on the specified
   /// sourceEncoding. sourceEncoding defaults to "utf-8".
@@ -876,6 +924,14 @@ public:
   bool compare(const Buffer &other) const;
   /// Returns a hash code for this buffer.
   int hash() const;
+  /// Returns a 64-bit xxHash64 of the buffer's bytes.
+  long long hash64() const;
+  /// Returns the CRC-32C checksum of the buffer's bytes.
+  int crc32c() const;
+  /// Returns the 32-byte SHA-256 digest of the buffer's bytes.
+  Buffer sha256() const;
+  /// Returns the 32-byte BLAKE2s-256 digest of the buffer's bytes.
+  Buffer blake2s() const;
   /// Returns true if this buffer equals the other.
   bool operator==(const Buffer &other) const;
   /// Returns true if this buffer does not equal the other.
@@ -886,9 +942,204 @@ public:
   Buffer operator+(const Buffer &other) const;
 
 private:
+  friend class BufferView;
+  friend class BufferChain;
+  friend class File;
+  friend class Datagram;
+  friend class MappedFile;
+  friend class BufferedReader;
+  friend class Path;
   BufferImpl *impl;
 };
 
+/// Read cursor for parsing binary data out of a buffer. The view keeps its
+/// own reference to the bytes, so later changes to the buffer do not affect
+/// it. Reads past the end return 0 and set the failed flag.
+class BufferView {
+public:
+  /// Creates a view over the buffer's current bytes, positioned at 0.
+  BufferView(const Buffer &buf);
+  /// Creates a copy with the same bytes and position.
+  BufferView(const BufferView &other);
+  /// Destroys the view and releases its reference to the bytes.
+  ~BufferView();
+  /// Assigns another view's bytes and position.
+  BufferView &operator=(const BufferView &other);
+
+  /// Returns the total number of bytes in the view.
+  int length() const;
+  /// Returns the current read position.
+  int getPosition() const;
+  /// Moves the read position. Returns false if pos is out of range.
+  bool setPosition(int pos);
+  /// Returns the number of bytes left to read.
+  int remaining() const;
+  /// Returns true if every byte has been read.
+  bool isAtEnd() const;
+  /// Returns true if any read or skip ran past the end.
+  bool failed() const;
+  /// Advances the position by count bytes. Returns false if too few remain.
+  bool skip(int count);
+
+  /// Reads an unsigned 8-bit integer.
+  int readU8();
+  /// Reads an unsigned 16-bit little-endian integer.
+  int readU16LE();
+  /// Reads an unsigned 16-bit big-endian integer.
+  int readU16BE();
+  /// Reads a 32-bit little-endian integer.
+  unsigned int readU32LE();
+  /// Reads a 32-bit big-endian integer.
+  unsigned int readU32BE();
+  /// Reads a 64-bit little-endian integer.
+  long long readU64LE();
+  /// Reads a 64-bit big-endian integer.
+  long long readU64BE();
+  /// Reads a 32-bit little-endian IEEE float.
+  float readF32LE();
+  /// Reads count bytes as a buffer that shares the view's bytes.
+  Buffer readBytes(int count);
+  /// Reads count bytes as a UTF-8 string.
+  String readString(int count);
+
+private:
+  BufferViewImpl *impl;
+};
+
+/// Byte sequence stored as a chain of shared segments. Appending, prepending
+/// or inserting a Buffer only records a reference to its bytes, so building a
+/// message around a large body never copies the body. The bytes are joined
+/// into one block only when c_ptr() or toBuffer() needs them contiguous.
+class BufferChain {
+public:
+  /// Creates an empty chain.
+  BufferChain();
+  /// Creates a chain holding the buffer's bytes as its first segment.
+  BufferChain(const Buffer &buf);
+  /// Creates a chain sharing the other chain's segments.
+  BufferChain(const BufferChain &other);
+  /// Destroys the chain and releases its segments.
+  ~BufferChain();
+  /// Assigns another chain's segments.
+  BufferChain &operator=(const BufferChain &other);
+
+  /// Adds the buffer's bytes at the end without copying them.
+  BufferChain &append(const Buffer &buf);
+  /// Adds a copy of the string's UTF-8 bytes at the end.
+  BufferChain &append(const String &str);
+  /// Adds every segment of another chain at the end.
+  BufferChain &append(const BufferChain &other);
+  /// Adds the buffer's bytes at the start without copying them.
+  BufferChain &prepend(const Buffer &buf);
+  /// Adds a copy of the string's UTF-8 bytes at the start.
+  BufferChain &prepend(const String &str);
+  /// Inserts the buffer's bytes at byte index, splitting a segment if needed.
+  BufferChain &insert(int index, const Buffer &buf);
+  /// Inserts a copy of the string's UTF-8 bytes at byte index.
+  BufferChain &insert(int index, const String &str);
+  /// Removes all segments.
+  BufferChain &clear();
+
+  /// Returns the total number of bytes.
+  int length() const;
+  /// Returns true if the chain holds no bytes.
+  bool isEmpty() const;
+  /// Returns the number of segments.
+  int segmentCount() const;
+  /// Returns a copy of the segment at index, sharing its bytes.
+  Buffer segmentAt(int index) const;
+
+  /// Joins the segments into one block and returns a pointer to it.
+  /// len receives the length. Valid until the chain is next modified.
+  const unsigned char *c_ptr(int *len) const;
+  /// Returns the bytes as one buffer, joining the segments if needed.
+  Buffer toBuffer() const;
+
+private:
+  friend class File;
+  friend class Datagram;
+  BufferChainImpl *impl;
+};
+
+/// Incremental xxHash64 and CRC-32C over data fed in pieces.
+class Hasher {
+public:
+  /// Creates a hasher. seed only affects the xxHash64 result.
+  Hasher(long long seed = 0);
+  /// Creates a copy of the other hasher's current state.
+  Hasher(const Hasher &other);
+  /// Destroys the hasher and frees resources.
+  ~Hasher();
+  /// Assigns another hasher's current state.
+  Hasher &operator=(const Hasher &other);
+
+  /// Adds the buffer's bytes. Returns this hasher.
+  Hasher &update(const Buffer &buf);
+  /// Adds the string's UTF-8 bytes. Returns this hasher.
+  Hasher &update(const String &str);
+  /// Adds size bytes from ptr. Returns this hasher.
+  Hasher &update(const unsigned char *ptr, int size);
+  /// Reads the file or socket from its current position until no more data
+  /// arrives, adding the bytes in fixed-size chunks. Returns this hasher.
+  Hasher &update(File &file);
+  /// Clears all data added so far, keeping the seed.
+  void reset();
+
+  /// Returns the xxHash64 of all data added so far.
+  long long hash64() const;
+  /// Returns the CRC-32C of all data added so far.
+  int crc32c() const;
+  /// Returns the total number of bytes added.
+  long long length() const;
+
+private:
+  HasherImpl *impl;
+};
+
+/// Cryptographic digest algorithms.
+enum DigestAlgorithm {
+  /// SHA-256 (32-byte digest).
+  DIGEST_SHA256 = 0,
+  /// BLAKE2s-256 (32-byte digest).
+  DIGEST_BLAKE2S
+};
+
+/// Incremental SHA-256 or BLAKE2s digest over data fed in pieces.
+class Digest {
+public:
+  /// Creates a digest using the given algorithm.
+  Digest(DigestAlgorithm algorithm = DIGEST_SHA256);
+  /// Creates a copy of the other digest's current state.
+  Digest(const Digest &other);
+  /// Destroys the digest and frees resources.
+  ~Digest();
+  /// Assigns another digest's algorithm and current state.
+  Digest &operator=(const Digest &other);
+
+  /// Adds the buffer's bytes. Returns this digest.
+  Digest &update(const Buffer &buf);
+  /// Adds the string's UTF-8 bytes. Returns this digest.
+  Digest &update(const String &str);
+  /// Adds size bytes from ptr. Returns this digest.
+  Digest &update(const unsigned char *ptr, int size);
+  /// Reads the file or socket from its current position until no more data
+  /// arrives, adding the bytes in large chunks. Returns this digest.
+  Digest &update(File &file);
+  /// Clears all data added so far.
+  void reset();
+
+  /// Returns the digest of all data added so far. More data may still be
+  /// added afterwards.
+  Buffer digest() const;
+  /// Returns the digest as a lowercase hexadecimal string.
+  String hexDigest() const;
+  /// Returns the algorithm in use.
+  DigestAlgorithm algorithm() const;
+
+private:
+  DigestImpl *impl;
+};
+
 //------------------------------------------------------------------------------
 // Command-Line Parsing
 //------------------------------------------------------------------------------
@@ -946,6 +1197,7 @@ private:
 /// Immutable filesystem path with metadata and convenience operations.
 class Path {
   friend class File;
+  friend class MappedFile;
   friend SubprocessImpl *CreateSubprocessImpl(const Path &, const List &, bool,
                                               bool);
 
@@ -1034,6 +1286,11 @@ public:
   String readToString() const;
   /// Reads the entire file as a buffer.
   Buffer readToBuffer() const;
+  /// Streams the file through the given digest algorithm without loading it
+  /// into memory. Returns the digest, or an empty buffer on error.
+  Buffer digest(DigestAlgorithm algorithm = DIGEST_SHA256) const;
+  /// Maps the file into memory instead of reading it (see MappedFile).
+  MappedFile map(bool writable = false) const;
   /// Writes a string to the file. Returns true on success.
   bool writeFromString(const String &str) const;
   /// Writes a buffer to the file. Returns true on success.
@@ -1069,14 +1326,258 @@ private:
   PathImpl *impl;
 };
 
+/// Recursive directory traversal that reports each entry with the size,
+/// times and attributes from the directory listing, so no further calls
+/// per file are needed. Paths longer than MAX_PATH are supported. With
+/// more than one thread, subdirectories are listed in parallel and entries
+/// arrive in no particular order. Symbolic links and junctions are reported
+/// but not followed. Copies share the same walk.
+class DirectoryWalker {
+public:
+  /// Creates a walker over root's contents. maxDepth limits how far below
+  /// root to go (0 = root's children only, -1 = no limit). threads sets how
+  /// many directories are listed at once (0 = one per processor).
+  DirectoryWalker(const Path &root, int maxDepth = -1, int threads = 1);
+  /// Creates a copy (shares the underlying walk).
+  DirectoryWalker(const DirectoryWalker &other);
+  /// Destroys the handle. The last copy stops the walk.
+  ~DirectoryWalker();
+  /// Assigns another walker (shares the underlying walk).
+  DirectoryWalker &operator=(const DirectoryWalker &other);
+
+  /// Only reports entries whose name matches pattern (* and ?, ignoring
+  /// case). Directories are still descended. Set before the first next().
+  DirectoryWalker &setFilter(const String &pattern);
+  /// Neither reports nor descends into directories whose name matches
+  /// pattern (e.g., ".git"). May be called more than once. Set before the
+  /// first next().
+  DirectoryWalker &skipDirectories(const String &pattern);
+  /// Sets whether directories are reported as well as files (default
+  /// true). Set before the first next().
+  DirectoryWalker &setIncludeDirectories(bool include);
+
+  /// Moves to the next entry. Returns false when the walk is finished.
+  bool next();
+  /// Returns the current entry's path (root joined with the relative path).
+  String getPath() const;
+  /// Returns the current entry's name.
+  String getName() const;
+  /// Returns how deep the current entry is (0 = directly in root).
+  int getDepth() const;
+  /// Returns true if the current entry is a directory.
+  bool isDirectory() const;
+  /// Returns true if the current entry is a symbolic link or junction.
+  bool isSymbolicLink() const;
+  /// Returns the current entry's FILE_ATTRIBUTE_* flags.
+  int getAttributes() const;
+  /// Returns the current entry's size in bytes (0 for directories).
+  long long getSize() const;
+  /// Returns the current entry's creation time.
+  DateTime getCreatedOn() const;
+  /// Returns the current entry's last modification time.
+  DateTime getModifiedOn() const;
+  /// Returns the current entry's last access time.
+  DateTime getAccessedOn() const;
+  /// Returns how many directories could not be listed so far.
+  int getErrorCount() const;
+
+private:
+  DirectoryWalkerImpl *impl;
+};
+
+/// Kinds of change reported by DirectoryWatcher.
+enum DirectoryChange {
+  /// A file or directory was created (or moved in from outside the tree).
+  CHANGE_CREATED = 1,
+  /// A file's contents, size or times changed.
+  CHANGE_MODIFIED = 2,
+  /// A file or directory was deleted (or moved out of the tree).
+  CHANGE_DELETED = 3,
+  /// A file or directory was renamed within the tree; oldPath is set.
+  CHANGE_RENAMED = 4,
+  /// Too many changes arrived at once and some were lost. Re-scan the
+  /// reported path (the watched root).
+  CHANGE_OVERFLOW = 5
+};
+
+/// Called on the watcher's thread for each coalesced change. oldPath is
+/// empty unless change is CHANGE_RENAMED.
+typedef void (*DirectoryChangeCallback)(DirectoryChange change,
+                                        const String &path,
+                                        const String &oldPath, void *arg);
+
+/// Watches a directory tree for changes (ReadDirectoryChangesW), so work
+/// scales with the number of changes rather than the size of the tree.
+/// Changes to the same path are coalesced until it has been quiet for the
+/// debounce window: a file created then written is one CHANGE_CREATED, a
+/// file created then deleted is not reported, and a delete followed by a
+/// create (an atomic save) is one CHANGE_MODIFIED. Watching starts when the
+/// watcher is created. Copies share the same watch.
+class DirectoryWatcher {
+public:
+  /// Starts watching root (and everything below it if recursive). Changes
+  /// are reported once a path has been quiet for debounceMs milliseconds.
+  DirectoryWatcher(const Path &root, bool recursive = true,
+                   int debounceMs = 100);
+  /// Creates a copy (shares the underlying watch).
+  DirectoryWatcher(const DirectoryWatcher &other);
+  /// Destroys the handle. The last copy stops watching.
+  ~DirectoryWatcher();
+  /// Assigns another watcher (shares the underlying watch).
+  DirectoryWatcher &operator=(const DirectoryWatcher &other);
+
+  /// Returns true while the watch is running. It ends when stopped or when
+  /// the root can no longer be watched (e.g., it was deleted).
+  bool isValid() const;
+  /// Delivers changes to callback instead of queuing them for poll(). Pass
+  /// nullptr to queue them again.
+  void setCallback(DirectoryChangeCallback callback, void *arg = nullptr);
+  /// Returns and clears the queued changes, waiting up to timeoutMs for at
+  /// least one (-1 = no limit). Each is a Map with "type" ("created",
+  /// "modified", "deleted", "renamed" or "overflow"), "path" and, for
+  /// renames, "oldPath".
+  List poll(int timeoutMs = 0);
+  /// Stops watching. Changes still waiting out the debounce window are
+  /// delivered first.
+  void stop();
+
+private:
+  DirectoryWatcherImpl *impl;
+};
+
+/// Called by FileCopier as data is copied, one call at a time. Return
+/// false to cancel the rest of the operation.
+typedef bool (*CopyProgressCallback)(long long copiedBytes,
+                                     long long totalBytes, int copiedFiles,
+                                     int totalFiles, void *arg);
+
+/// Copies or moves a file or a whole directory tree with CopyFileEx.
+/// Several files are copied at once, large files bypass the system cache,
+/// and an incremental mode skips files that are already up to date. Links
+/// to directories are not followed. Copies share the same settings and
+/// results.
+class FileCopier {
+public:
+  /// Creates a copier from source to destination. For a directory,
+  /// destination is the directory that receives source's contents.
+  FileCopier(const Path &source, const Path &destination);
+  /// Creates a copy (shares the underlying copier).
+  FileCopier(const FileCopier &other);
+  /// Destroys the handle.
+  ~FileCopier();
+  /// Assigns another copier (shares the underlying copier).
+  FileCopier &operator=(const FileCopier &other);
+
+  /// Sets how many files are copied at once (default 4, 0 = one per
+  /// processor).
+  FileCopier &setThreads(int threads);
+  /// Sets whether files whose destination already has the same size and
+  /// modification time are skipped (default false).
+  FileCopier &setIncremental(bool incremental);
+  /// Files of at least this many bytes are copied unbuffered, which is
+  /// faster for large files and keeps them out of the cache (default
+  /// 64 MB, -1 = never).
+  FileCopier &setUnbufferedThreshold(long long bytes);
+  /// Sets a callback for progress and cancellation.
+  FileCopier &setProgressCallback(CopyProgressCallback callback,
+                                  void *arg = nullptr);
+
+  /// Copies source to destination, creating directories as needed.
+  /// Returns true if every file was copied or skipped.
+  bool copy();
+  /// Moves source to destination. On the same volume this is a single
+  /// rename; otherwise files are copied and each source file is deleted
+  /// once copied. Returns true if everything was moved.
+  bool move();
+
+  /// Returns the bytes copied by the last copy() or move().
+  long long getCopiedBytes() const;
+  /// Returns how many files were copied.
+  int getCopiedFileCount() const;
+  /// Returns how many files were skipped as up to date.
+  int getSkippedFileCount() const;
+  /// Returns how many files (or directories) could not be copied.
+  int getFailedFileCount() const;
+  /// Returns how long the last copy() or move() took, in milliseconds.
+  long long getElapsedMilliseconds() const;
+  /// Returns the average throughput of the last copy() or move().
+  long long getBytesPerSecond() const;
+
+private:
+  FileCopierImpl *impl;
+};
+
+/// Called by Search for each match, one call at a time. line and column are
+/// 1-based (column counts bytes), text is the matching line without its
+/// line ending, and pattern is the index of the pattern that matched.
+/// Return false to stop the search.
+typedef bool (*SearchCallback)(const String &path, int line, int column,
+                               const String &text, int pattern, void *arg);
+
+/// Finds literal strings in a file or a directory tree, like grep. Files
+/// are memory-mapped and searched in parallel; binary files (a NUL byte in
+/// the first 8 KB) are skipped. One pattern is found with a SIMD substring
+/// scan, several at once with an Aho-Corasick automaton. Every occurrence
+/// is reported, including overlapping ones. Copies share the same settings.
+class Search {
+public:
+  /// Creates a search for one string.
+  Search(const String &pattern);
+  /// Creates a search for any of the strings in patterns. Empty strings
+  /// never match but keep their index.
+  Search(const List &patterns);
+  /// Creates a copy (shares the underlying search).
+  Search(const Search &other);
+  /// Destroys the handle.
+  ~Search();
+  /// Assigns another search (shares the underlying search).
+  Search &operator=(const Search &other);
+
+  /// Sets whether ASCII letters match regardless of case (default false).
+  Search &setIgnoreCase(bool ignoreCase);
+  /// Sets how many files are searched at once (default 0 = one per
+  /// processor).
+  Search &setThreads(int threads);
+  /// Only searches files whose name matches pattern (* and ?, ignoring
+  /// case).
+  Search &setFilter(const String &pattern);
+  /// Skips directories whose name matches pattern (e.g., ".git"). May be
+  /// called more than once.
+  Search &skipDirectories(const String &pattern);
+
+  /// Searches path, a file or a directory tree, calling callback for each
+  /// match. Matches within a file arrive in order. Returns the number of
+  /// matches, or -1 if path does not exist.
+  int run(const Path &path, SearchCallback callback, void *arg = nullptr);
+  /// Searches path and returns up to maxMatches matches (-1 = all) as Maps
+  /// with "path", "line", "column", "text" and "pattern".
+  List findAll(const Path &path, int maxMatches = -1);
+
+  /// Returns how many files the last run searched.
+  int getFileCount() const;
+  /// Returns how many files the last run skipped as binary.
+  int getBinaryFileCount() const;
+
+private:
+  SearchImpl *impl;
+};
+
+/// Called on an I/O worker thread when an asynchronous File operation
+/// completes. result is already done; arg is the value passed when starting.
+typedef void (*AsyncCallback)(AsyncResult &result, void *arg);
+
 /// Stream-based I/O for files, named pipes, and TCP sockets.
 class File {
 public:
   /// Opens a file at the given path for reading and writing.
   File(const Path &path);
-  /// Opens a TCP socket connection to host:port.
-  File(const String &host, int port);
-  /// Creates a listening server socket on the given port.
+  /// Opens a TCP socket connection to host:port. The host's IPv6 and IPv4
+  /// addresses are tried in turns, a new attempt starting every 250 ms
+  /// while earlier ones are pending; the first to connect is kept. Gives up
+  /// after connectTimeoutMs (-1 = once every address has failed).
+  File(const String &host, int port, int connectTimeoutMs = -1);
+  /// Creates a listening server socket on the given port (0 = any free
+  /// port; getPort() returns the one chosen), accepting IPv6 and IPv4.
   File(int port);
   /// Creates a copy (shares the underlying handle).
   File(const File &other);
@@ -1107,6 +1608,12 @@ public:
   String readAllToString();
   /// Reads up to count bytes into a string.
   String readToString(int count);
+  /// Reads until the end of the file or pipe, or until the peer closes the
+  /// socket, into a geometrically growing buffer. Returns what was read.
+  Buffer readUntilClosed();
+  /// Reads exactly count bytes, waiting as needed. Returns fewer only if the
+  /// stream ends, times out or fails first.
+  Buffer readExact(int count);
   /// Returns true if data is available to read.
   bool hasAvailable() const;
   /// Returns the number of bytes available to read.
@@ -1122,6 +1629,17 @@ public:
   /// Writes up to count bytes from a string. Returns bytes written, or -1 on
   /// error.
   int writeUpTo(const String &str, int count = -1);
+  /// Writes every segment of a chain in order without joining them (one
+  /// gather send on sockets). Returns bytes written, or -1 on error.
+  int write(const BufferChain &chain);
+  /// Sends length bytes of a file from offset (-1 = to the end). On sockets
+  /// the kernel sends straight from the file cache (TransmitFile), without
+  /// reading the file into memory. Returns bytes sent, or -1 on error.
+  long long sendFile(const Path &path, long long offset = 0,
+                     long long length = -1);
+  /// Writes a buffer as Base64 text, encoding in chunks without building the
+  /// whole string in memory. Returns characters written, or -1 on error.
+  int writeBase64(const Buffer &buf, bool urlSafe = false, bool pad = true);
   /// Flushes buffered data. Returns true on success.
   bool flush();
 
@@ -1143,9 +1661,54 @@ public:
   /// Returns true if this is a named pipe.
   bool isNamedPipe() const;
 
+  /// Switches a socket or pipe between blocking and non-blocking mode. In
+  /// non-blocking mode reads return empty results and writes return 0 when
+  /// they would wait; use a Poller to learn when to retry. Returns true on
+  /// success.
+  bool setNonBlocking(bool enabled);
+  /// Returns true if the socket or pipe is in non-blocking mode.
+  bool isNonBlocking() const;
+
+  /// Turns off Nagle's algorithm so small writes are sent at once instead of
+  /// being held back to coalesce (sockets only). Returns true on success.
+  bool setNoDelay(bool enabled);
+  /// Sets the kernel receive and send buffer sizes in bytes (-1 = leave
+  /// unchanged; sockets only). Returns true on success.
+  bool setBufferSizes(int receiveBytes, int sendBytes = -1);
+  /// Turns TCP keep-alive probes on or off. idleMs is the silence before the
+  /// first probe and intervalMs the gap between probes (0 = system default).
+  /// Returns true on success.
+  bool setKeepAlive(bool enabled, int idleMs = 0, int intervalMs = 0);
+  /// Sets how long blocking socket reads and writes wait, in milliseconds
+  /// (0 = forever). A read that times out returns what arrived so far.
+  /// Returns true on success.
+  bool setTimeouts(int readMs, int writeMs);
+
   /// Accepts a client connection on a server socket.
   File accept();
 
+  /// Starts reading up to count bytes without blocking. Sockets use
+  /// overlapped I/O on a shared completion port; files and pipes are read on
+  /// a thread of their own. callback, if given, runs on a worker when done.
+  AsyncResult readAsync(int count, AsyncCallback callback = nullptr,
+                        void *arg = nullptr);
+  /// Starts writing a buffer without blocking. The buffer is shared, not
+  /// copied. callback, if given, runs on a worker when done.
+  AsyncResult writeAsync(const Buffer &buf, AsyncCallback callback = nullptr,
+                         void *arg = nullptr);
+  /// Starts accepting a connection on a server socket without blocking.
+  /// callback, if given, runs on a worker when done.
+  AsyncResult acceptAsync(AsyncCallback callback = nullptr,
+                          void *arg = nullptr);
+  /// Starts sending length bytes of a file from offset (-1 = to the end) on
+  /// a socket without blocking, straight from the file cache (TransmitFile).
+  /// At most 1 GB is sent per call; getCount() tells how much went.
+  /// callback, if given, runs on a worker when done.
+  AsyncResult sendFileAsync(const Path &path, long long offset = 0,
+                            long long length = -1,
+                            AsyncCallback callback = nullptr,
+                            void *arg = nullptr);
+
   /// Returns true if this file equals the other.
   bool equals(const File &other) const;
   /// Returns true if this file equals the other.
@@ -1153,10 +1716,341 @@ public:
   /// Returns true if this file does not equal the other.
   bool operator!=(const File &other) const;
 
+  /// Keeps the addresses host names resolve to for ttlMs (default 60000)
+  /// and reuses them for later connections. 0 turns caching off and
+  /// empties the cache.
+  static void SetResolverCache(int ttlMs = 60000);
+  /// Forgets every cached host name.
+  static void ClearResolverCache();
+  /// Returns how many host names were not cached and had to be looked up.
+  static long long GetResolverLookupCount();
+
 private:
+  friend class Hasher;
+  friend class Digest;
+  friend class BufferedReader;
+  friend class BufferedWriter;
+  friend class Poller;
   FileImpl *impl;
 };
 
+/// Handle to an asynchronous File operation. Copies share the same
+/// operation. The getters wait for the operation to finish.
+class AsyncResult {
+public:
+  /// Creates a copy (shares the underlying operation).
+  AsyncResult(const AsyncResult &other);
+  /// Destroys the handle. The operation keeps running.
+  ~AsyncResult();
+  /// Assigns another result (shares the underlying operation).
+  AsyncResult &operator=(const AsyncResult &other);
+
+  /// Returns true if the operation has finished.
+  bool isDone() const;
+  /// Waits up to timeoutMs (-1 = forever). Returns true if finished.
+  bool wait(int timeoutMs = -1);
+  /// Returns true if the operation succeeded. A read at the end of the
+  /// stream succeeds with zero bytes.
+  bool succeeded();
+  /// Returns the number of bytes read or written.
+  int getCount();
+  /// Returns the bytes read by readAsync(), or an empty buffer.
+  Buffer getBuffer();
+  /// Returns the connection accepted by acceptAsync(), or an invalid File.
+  File getFile();
+
+private:
+  friend class File;
+  friend void CompleteAsyncOp(AsyncResultImpl *impl, bool ok, int bytes);
+  AsyncResult(AsyncResultImpl *adopted);
+  AsyncResultImpl *impl;
+};
+
+/// UDP socket for sending and receiving single datagrams (IPv4). Copies
+/// share the same socket.
+class Datagram {
+public:
+  /// Creates a UDP socket bound to port on all interfaces (0 = any free
+  /// port; getPort() returns the one chosen).
+  Datagram(int port = 0);
+  /// Creates a UDP socket bound to port on the local address (e.g.,
+  /// "127.0.0.1").
+  Datagram(const String &address, int port);
+  /// Creates a copy (shares the underlying socket).
+  Datagram(const Datagram &other);
+  /// Closes the socket when the last copy is gone.
+  ~Datagram();
+  /// Assigns another datagram socket (shares the underlying socket).
+  Datagram &operator=(const Datagram &other);
+
+  /// Returns true if the socket was created and bound.
+  bool isValid() const;
+  /// Returns the local port, or -1 if invalid.
+  int getPort() const;
+  /// Closes the socket.
+  void close();
+
+  /// Sends data as one datagram to host:port. The last host resolved is
+  /// remembered, so repeated sends skip the lookup. Returns bytes sent, 0 if
+  /// a non-blocking socket would block, or -1 on error.
+  int sendTo(const String &host, int port, const Buffer &data);
+  /// Sends a string as one datagram to host:port. Returns bytes sent, 0 if a
+  /// non-blocking socket would block, or -1 on error.
+  int sendTo(const String &host, int port, const String &data);
+  /// Sends every segment of packets to host:port as its own datagram.
+  /// Returns the number of datagrams sent (fewer if a non-blocking socket
+  /// runs out of room), or -1 on error before any was sent.
+  int sendBatch(const String &host, int port, const BufferChain &packets);
+
+  /// Waits up to timeoutMs (-1 = forever) for one datagram and returns it.
+  /// host and port, if given, receive the sender. Returns an empty buffer
+  /// on timeout or error.
+  Buffer receiveFrom(String *host = nullptr, int *port = nullptr,
+                     int timeoutMs = -1);
+
+  /// Sets the receive ring used by receiveBatch(): count slots of slotSize
+  /// bytes (default 64 of 2048). Longer datagrams are cut to slotSize.
+  /// Returns false if out of memory.
+  bool setReceiveRing(int count, int slotSize);
+  /// Waits up to timeoutMs (-1 = forever) for a datagram, then takes every
+  /// datagram already queued, up to maxCount (-1 = ring size), into the
+  /// ring without allocating. Returns the number received, 0 on timeout, or
+  /// -1 on error. Packets stay readable until the ring wraps onto them.
+  int receiveBatch(int maxCount = -1, int timeoutMs = -1);
+  /// Returns the index-th datagram of the last receiveBatch() in place;
+  /// length receives its size. Returns nullptr if index is out of range.
+  const unsigned char *packetData(int index, int *length) const;
+  /// Returns a copy of the index-th datagram of the last receiveBatch().
+  Buffer packet(int index) const;
+  /// Returns the sender address of the index-th datagram.
+  String packetHost(int index) const;
+  /// Returns the sender port of the index-th datagram, or -1.
+  int packetPort(int index) const;
+
+  /// Switches between blocking and non-blocking mode. In non-blocking mode
+  /// receives return nothing and sends return 0 instead of waiting; use a
+  /// Poller to learn when to retry. Returns true on success.
+  bool setNonBlocking(bool enabled);
+  /// Returns true if the socket is in non-blocking mode.
+  bool isNonBlocking() const;
+  /// Allows sending to broadcast addresses. Returns true on success.
+  bool setBroadcast(bool enabled);
+  /// Sets the kernel receive and send buffer sizes in bytes (-1 = leave
+  /// unchanged). Returns true on success.
+  bool setBufferSizes(int receiveBytes, int sendBytes = -1);
+  /// Joins the multicast group (e.g., "239.1.2.3") on the interface with
+  /// the given local address (empty = default). Returns true on success.
+  bool joinGroup(const String &group,
+                 const String &interfaceAddress = String());
+  /// Leaves a multicast group joined with joinGroup(). Returns true on
+  /// success.
+  bool leaveGroup(const String &group,
+                  const String &interfaceAddress = String());
+  /// Sets the time-to-live of outgoing multicast datagrams and whether
+  /// this host receives its own. Returns true on success.
+  bool setMulticastOptions(int ttl, bool loopback = true);
+
+private:
+  friend class Poller;
+  DatagramImpl *impl;
+};
+
+/// Readiness events for Poller (combine with |).
+enum PollEvent {
+  /// Data is waiting to be read, or a server socket has a connection.
+  POLL_READABLE = 1,
+  /// A write would not block.
+  POLL_WRITABLE = 2,
+  /// The other end closed the connection or pipe.
+  POLL_CLOSED = 4,
+  /// The socket or pipe reported an error.
+  POLL_ERROR = 8
+};
+
+/// Waits on many sockets and pipes at once, so one thread can serve many
+/// connections. Copies share the same registrations.
+class Poller {
+public:
+  /// Creates an empty poller.
+  Poller();
+  /// Creates a copy (shares the underlying poller).
+  Poller(const Poller &other);
+  /// Destroys the poller handle.
+  ~Poller();
+  /// Assigns another poller (shares the underlying poller).
+  Poller &operator=(const Poller &other);
+
+  /// Registers a socket, server socket or named pipe for the given events
+  /// (POLL_READABLE and/or POLL_WRITABLE), or updates its events if already
+  /// registered. Returns false for regular files and closed files.
+  bool add(const File &file, int events = POLL_READABLE);
+  /// Unregisters a file. Returns true if it was registered.
+  bool remove(const File &file);
+  /// Registers a datagram socket for the given events, or updates them.
+  /// Returns false if the socket is closed.
+  bool add(const Datagram &datagram, int events = POLL_READABLE);
+  /// Unregisters a datagram socket. Returns true if it was registered.
+  bool remove(const Datagram &datagram);
+  /// Returns the number of registered files.
+  int count() const;
+
+  /// Waits up to timeoutMs (-1 = forever, 0 = just check) for registered
+  /// files to become ready. Returns the number ready, 0 on timeout, or -1 on
+  /// error. POLL_CLOSED and POLL_ERROR are always reported. Other threads
+  /// may add and remove files during a wait; additions are watched from the
+  /// next wait() and removed files are not reported.
+  int wait(int timeoutMs = -1);
+  /// Returns the index-th ready file from the last wait(), or an invalid
+  /// File if that entry is a datagram socket.
+  File readyFile(int index) const;
+  /// Returns the index-th ready datagram socket from the last wait(), or an
+  /// invalid Datagram if that entry is a File.
+  Datagram readyDatagram(int index) const;
+  /// Returns the PollEvent flags of the index-th ready file.
+  int readyEvents(int index) const;
+
+private:
+  PollerImpl *impl;
+};
+
+/// Memory-mapped view of an existing file. Bytes are paged in on demand, so
+/// multi-gigabyte files can be scanned without reading them into memory.
+/// Only a window of the file is mapped at a time: the whole file (up to 2 GB)
+/// on 64-bit builds, 64 MB on 32-bit. Use setWindow() to slide it.
+/// Copies share the same mapping and window.
+class MappedFile {
+public:
+  /// Maps the file at path, read-only unless writable is true. A writable
+  /// mapping can change bytes but not the file's size.
+  MappedFile(const Path &path, bool writable = false);
+  /// Creates a copy (shares the underlying mapping).
+  MappedFile(const MappedFile &other);
+  /// Destroys the handle. The mapping closes when the last copy is gone.
+  ~MappedFile();
+  /// Assigns another mapped file (shares the underlying mapping).
+  MappedFile &operator=(const MappedFile &other);
+
+  /// Returns true if the file was opened and mapped.
+  bool isValid() const;
+  /// Returns true if the mapping allows writes.
+  bool isWritable() const;
+  /// Returns the file size in bytes.
+  long long getSize() const;
+
+  /// Maps length bytes starting at offset, replacing the current window.
+  /// length -1 uses the default window size; both are clamped to the end of
+  /// the file. Returns true on success.
+  bool setWindow(long long offset, int length = -1);
+  /// Returns the file offset of the current window.
+  long long getWindowOffset() const;
+  /// Returns the length of the current window in bytes.
+  int getWindowLength() const;
+
+  /// Returns a pointer to the window's bytes. len receives the length.
+  /// Valid until the window moves or the file is closed.
+  const unsigned char *c_ptr(int *len) const;
+  /// Returns a writable pointer to the window's bytes, or nullptr if the
+  /// mapping is read-only. len receives the length.
+  unsigned char *writablePtr(int *len);
+  /// Returns the window as a buffer without copying. The buffer keeps the
+  /// bytes mapped after the window moves; writing to it makes a private copy.
+  Buffer toBuffer() const;
+
+  /// Writes changed bytes in the window back to disk. Returns true on
+  /// success.
+  bool flush();
+  /// Unmaps the window and closes the file.
+  void close();
+
+private:
+  MappedFileImpl *impl;
+};
+
+/// Buffered reader over a File or a Subprocess's output. Reads the source in
+/// large blocks and splits lines, delimited records or fixed-size chunks out
+/// of its buffer. Every read blocks until enough data arrives or the source
+/// ends. Copies share the same buffer and position.
+class BufferedReader {
+public:
+  /// Creates a reader over a file, pipe or connected socket.
+  BufferedReader(const File &file, int bufferSize = 65536);
+  /// Creates a reader over a subprocess's captured output.
+  BufferedReader(const Subprocess &process, int bufferSize = 65536);
+  /// Creates a copy (shares the underlying reader).
+  BufferedReader(const BufferedReader &other);
+  /// Destroys the handle. The source stays open.
+  ~BufferedReader();
+  /// Assigns another reader (shares the underlying reader).
+  BufferedReader &operator=(const BufferedReader &other);
+
+  /// Reads the next line, without its "\n" or "\r\n" ending. The last line
+  /// may lack an ending. Returns an empty string at the end of the source.
+  String readLine();
+  /// Reads up to the next occurrence of delimiter and skips past it.
+  /// Returns the rest of the source if the delimiter never appears.
+  String readUntil(const String &delimiter);
+  /// Reads exactly count bytes. Returns fewer only if the source ends first.
+  Buffer readExact(int count);
+  /// Calls callback for each remaining line with a pointer into the reader's
+  /// buffer and the line's length (ending removed). No memory is allocated
+  /// per line; the pointer is only valid during the call. Return false from
+  /// the callback to stop. Returns the number of lines passed to callback.
+  int forEachLine(bool (*callback)(const char *line, int length, void *arg),
+                  void *arg = nullptr);
+
+  /// Returns true if every byte of the source has been consumed. May block
+  /// until data arrives.
+  bool isAtEnd();
+  /// Returns the number of bytes already read from the source but not yet
+  /// returned.
+  int bufferedCount() const;
+
+private:
+  BufferedReaderImpl *impl;
+};
+
+/// Write-coalescing writer over a File. Small writes collect in a buffer that
+/// is written out when it fills, on flush() and when the last copy is
+/// destroyed. In background mode a worker thread writes one buffer while
+/// callers fill the other. Copies share the same buffer.
+class BufferedWriter {
+public:
+  /// Creates a writer over a file, pipe or connected socket. If background is
+  /// true, full buffers are written by a worker thread and callers only block
+  /// when both buffers are full.
+  BufferedWriter(const File &file, int bufferSize = 65536,
+                 bool background = false);
+  /// Creates a copy (shares the underlying writer).
+  BufferedWriter(const BufferedWriter &other);
+  /// Destroys the handle, flushing if it is the last copy. The file stays
+  /// open.
+  ~BufferedWriter();
+  /// Assigns another writer (shares the underlying writer).
+  BufferedWriter &operator=(const BufferedWriter &other);
+
+  /// Buffers a buffer. Returns bytes accepted, or -1 after a write error.
+  int write(const Buffer &buf);
+  /// Buffers a string. Returns bytes accepted, or -1 after a write error.
+  int write(const String &str);
+  /// Buffers size bytes from ptr. Returns bytes accepted, or -1 after a write
+  /// error.
+  int write(const unsigned char *ptr, int size);
+  /// Writes out everything buffered, waits for it to complete and flushes
+  /// the file to disk. Returns false if any write has failed.
+  bool flush();
+
+  /// Returns the number of bytes accepted but not yet written.
+  int bufferedCount() const;
+  /// Returns true if a worker thread performs the writes.
+  bool isBackground() const;
+  /// Returns true if a write to the file has failed. Later writes are
+  /// rejected.
+  bool failed() const;
+
+private:
+  BufferedWriterImpl *impl;
+};
+
 //------------------------------------------------------------------------------
 // Concurrency
 //------------------------------------------------------------------------------
@@ -1214,6 +2108,109 @@ private:
   MutexImpl *impl;
 };
 
+/// Cooperative cancellation flag for pool tasks. Copies share the flag.
+class CancelToken {
+public:
+  /// Creates a token that is not cancelled.
+  CancelToken();
+  /// Creates a copy (shares the underlying flag).
+  CancelToken(const CancelToken &other);
+  /// Destroys the handle.
+  ~CancelToken();
+  /// Assigns another token (shares the underlying flag).
+  CancelToken &operator=(const CancelToken &other);
+
+  /// Requests cancellation. Tasks holding the token that have not started
+  /// are skipped; running tasks see isCancelled() and may stop early.
+  void cancel();
+  /// Returns true once cancel() has been called.
+  bool isCancelled() const;
+
+private:
+  friend class ThreadPool;
+  friend class Future;
+  friend void RunFutureTask(FutureImpl *impl);
+  CancelToken(CancelTokenImpl *shared);
+  CancelTokenImpl *impl;
+};
+
+/// A pool task. token reports whether the task has been cancelled.
+typedef void *(*TaskFunction)(void *arg, const CancelToken &token);
+/// A continuation; result is the finished task's return value.
+typedef void *(*ContinuationFunction)(void *result, void *arg);
+
+/// The result of a task submitted to a ThreadPool. Copies share the task.
+class Future {
+public:
+  /// Creates a copy (shares the underlying task).
+  Future(const Future &other);
+  /// Destroys the handle. The task keeps running.
+  ~Future();
+  /// Assigns another future (shares the underlying task).
+  Future &operator=(const Future &other);
+
+  /// Returns true once the task has finished or was cancelled before it
+  /// ran.
+  bool isReady() const;
+  /// Waits for the task and returns its result (nullptr if it was
+  /// cancelled before it ran). On one of the pool's workers, other tasks
+  /// are run while waiting.
+  void *await();
+  /// Waits up to timeoutMs (-1 = forever). Returns true if ready.
+  bool wait(int timeoutMs = -1);
+  /// Cancels the task's token (and so every task sharing it).
+  void cancel();
+  /// Returns true if the task was skipped because it was cancelled, or
+  /// could not be queued.
+  bool isCancelled() const;
+  /// Runs func(result, arg) on the pool once this task finishes and returns
+  /// its future, which shares this task's token. If the task has already
+  /// finished, func runs now on the calling thread. If the task is skipped,
+  /// so is the continuation.
+  Future then(ContinuationFunction func, void *arg = nullptr);
+
+private:
+  friend class ThreadPool;
+  Future(FutureImpl *adopted);
+  FutureImpl *impl;
+};
+
+/// Fixed set of worker threads running submitted tasks. Each worker keeps
+/// its own queue; tasks submitted from a worker go to its queue, and idle
+/// workers steal from the others. Copies share the pool.
+class ThreadPool {
+public:
+  /// Starts workerCount threads (0 = one per logical processor).
+  ThreadPool(int workerCount = 0);
+  /// Creates a copy (shares the underlying pool).
+  ThreadPool(const ThreadPool &other);
+  /// Destroys the handle. The last one waits for every queued task to
+  /// finish (unless it is destroyed inside a task), then stops the workers.
+  ~ThreadPool();
+  /// Assigns another pool (shares the underlying pool).
+  ThreadPool &operator=(const ThreadPool &other);
+
+  /// Queues func(arg, token) with a new cancellation token.
+  Future submit(TaskFunction func, void *arg = nullptr);
+  /// Queues func(arg, token) with the given token, so a group of tasks can
+  /// be cancelled together.
+  Future submit(TaskFunction func, void *arg, const CancelToken &token);
+
+  /// Returns the number of worker threads, or 0 if none could be started.
+  int getWorkerCount() const;
+  /// Returns the number of tasks queued, running or waiting on another
+  /// task's result.
+  int getPendingCount() const;
+  /// Returns how many tasks were taken from another worker's queue.
+  long long getStealCount() const;
+  /// Waits until no task is queued or running. Returns false at once if
+  /// called from one of the pool's own tasks.
+  bool waitIdle();
+
+private:
+  ThreadPoolImpl *impl;
+};
+
 //------------------------------------------------------------------------------
 // Process Management
 //------------------------------------------------------------------------------
@@ -1274,6 +2271,7 @@ public:
   int write(const String &str);
 
 private:
+  friend class BufferedReader;
   SubprocessImpl *impl;
   Subprocess(const Path &executable, const List &arguments);
   static void Start_impl(const Path &executable, const List &arguments);
@@ -1369,6 +2367,16 @@ private:
   WebResponse();
 };
 
+/// Called by WebRequest::DoAll() with a request's position in the batch and
+/// its response.
+typedef void (*WebResponseCallback)(int index, const WebResponse &response,
+                                    void *arg);
+
+/// Receives the next chunk of a streamed response body; arg is the value
+/// passed to WebRequest::doGet(). Return false to stop the transfer.
+typedef bool (*WebChunkCallback)(const unsigned char *data, int length,
+                                 void *arg);
+
 /// HTTP client using WinHTTP.
 class WebRequest {
 public:
@@ -1385,6 +2393,12 @@ public:
 
   /// Performs an HTTP GET request. timeout in ms (-1 = infinite).
   WebResponse doGet(int timeout = -1);
+  /// Performs an HTTP GET, passing a 2xx body to callback in chunks as it
+  /// arrives instead of keeping it in the response.
+  WebResponse doGet(WebChunkCallback callback, void *arg, int timeout = -1);
+  /// Performs an HTTP GET, writing a 2xx body to destination as it arrives
+  /// instead of keeping it in the response.
+  WebResponse doGet(File &destination, int timeout = -1);
   /// Performs an HTTP POST request with no body.
   WebResponse doPost(int timeout = -1);
   /// Performs an HTTP POST with JSON body (Map).
@@ -1408,15 +2422,166 @@ public:
   /// Returns true if a request has been completed (can only be done once).
   bool hasCompleted() const;
 
-  /// Downloads a file from URL to disk. Returns true on success.
+  /// Downloads a file from URL to disk, streaming the body to the file.
+  /// Returns true on success.
   static bool Download(const String &url, const String &savePath,
                        const Map &params = Map(), const Map &headers = Map(),
                        bool overwrite = true, int timeout = -1);
+  /// Downloads a file from URL to disk, requesting only the bytes after
+  /// those already in savePath and keeping a partial file on failure so a
+  /// later call can continue it. Returns true once the file is complete.
+  static bool ResumeDownload(const String &url, const String &savePath,
+                             const Map &params = Map(),
+                             const Map &headers = Map(), int timeout = -1);
+
+  /// Runs a batch of requests with at most concurrency in flight. Each item
+  /// is a URL String (GET) or a Map with "url" and optional "method",
+  /// "body" (String, or Map/List sent as JSON), "params", "headers" and
+  /// "timeout". callback runs on the calling thread as responses finish, or
+  /// in list order if ordered. Responses with no status, 429 or 5xx are
+  /// retried up to retries times, waiting about backoffMs and doubling each
+  /// time. Returns the number of successful responses.
+  static int DoAll(const List &requests, WebResponseCallback callback,
+                   void *arg = nullptr, int concurrency = 8, int timeout = -1,
+                   int retries = 2, int backoffMs = 500, bool ordered = false);
+
+  /// Limits the connections kept per host (default 16) and closes a host's
+  /// pooled connections after idleTimeoutMs without use (default 60000;
+  /// 0 closes idle hosts now). A background thread closes them while the
+  /// pool holds idle hosts.
+  static void SetConnectionPool(int maxConnectionsPerHost = 16,
+                                int idleTimeoutMs = 60000);
+  /// Returns how many requests opened a new connection.
+  static long long GetNewConnectionCount();
+  /// Returns how many requests reused a pooled keep-alive connection.
+  static long long GetReusedConnectionCount();
+
+  /// Turns on the on-disk cache for doGet() responses, kept under
+  /// GetLocalAppDirectory() and trimmed to maxBytes by evicting the least
+  /// recently used entries. Entries are keyed by URL plus the request
+  /// headers named in varyHeaders. Fresh entries (Cache-Control max-age)
+  /// are served without a request; stale ones are revalidated with
+  /// If-None-Match/If-Modified-Since. Returns true on success.
+  static bool EnableCache(long long maxBytes = 64 * 1024 * 1024,
+                          const List &varyHeaders = List());
+  /// Turns the response cache off. Cached entries stay on disk.
+  static void DisableCache();
+  /// Deletes all cached responses.
+  static void ClearCache();
+  /// Returns how many doGet() calls were answered from the cache.
+  static long long GetCacheHitCount();
+  /// Returns how many cacheable doGet() calls had to fetch the body.
+  static long long GetCacheMissCount();
+  /// Returns how many cache hits were confirmed with a 304 response.
+  static long long GetCacheRevalidationCount();
 
 private:
   WebRequestImpl *impl;
 };
 
+/// HTTP request received by a WebServer. Only valid during the handler
+/// call; copy out anything needed later.
+class WebServerRequest {
+public:
+  /// Returns the request method (e.g., "GET").
+  String getMethod() const;
+  /// Returns the URL-decoded path, without the query string.
+  String getPath() const;
+  /// Returns the raw query string (after '?'), or empty string.
+  String getQuery() const;
+  /// Returns the first header with the given name (case-insensitive), or
+  /// empty string.
+  String getHeader(const String &name) const;
+  /// Returns a map of request headers.
+  Map getHeaders() const;
+  /// Returns the request body. The bytes are shared with the connection's
+  /// receive buffer, not copied.
+  Buffer getBody() const;
+
+private:
+  friend void DispatchWebRequest(WebServerImpl *server,
+                                 WebServerRequestImpl *request,
+                                 WebServerResponseImpl *response);
+  WebServerRequest(WebServerRequestImpl *impl);
+  WebServerRequest(const WebServerRequest &other);
+  WebServerRequest &operator=(const WebServerRequest &other);
+  WebServerRequestImpl *impl;
+};
+
+/// HTTP response built by a WebServer handler. Sent when the handler
+/// returns. Content-Length and Connection are set by the server.
+class WebServerResponse {
+public:
+  /// Sets the status code (default 200).
+  void setStatus(int statusCode);
+  /// Adds a response header.
+  void setHeader(const String &name, const String &value);
+  /// Appends a string to the body.
+  void write(const String &str);
+  /// Appends a buffer to the body without copying it.
+  void write(const Buffer &buf);
+  /// Sends a file as the body (replacing anything written), with a
+  /// Content-Type from its extension unless one was set. The file is streamed
+  /// with File::sendFileAsync(), and a single-range Range request is answered
+  /// with 206 or 416. Returns false if the path is not a regular file.
+  bool sendFile(const Path &path);
+
+private:
+  friend void DispatchWebRequest(WebServerImpl *server,
+                                 WebServerRequestImpl *request,
+                                 WebServerResponseImpl *response);
+  WebServerResponse(WebServerResponseImpl *impl);
+  WebServerResponse(const WebServerResponse &other);
+  WebServerResponse &operator=(const WebServerResponse &other);
+  WebServerResponseImpl *impl;
+};
+
+/// Handles one request. Runs on the system thread pool, not on the I/O
+/// workers, so it may block; arg is the value passed to addRoute().
+typedef void (*WebHandler)(const WebServerRequest &request,
+                           WebServerResponse &response, void *arg);
+
+/// Multi-threaded HTTP/1.1 server. Connections are read and written with
+/// overlapped I/O on the shared completion port used by File::readAsync(),
+/// with keep-alive and pipelined requests. Copies share the same server; it
+/// stops when the last is gone.
+class WebServer {
+public:
+  /// Creates a server for the given port (0 = any free port). Nothing
+  /// listens until start().
+  WebServer(int port);
+  /// Creates a copy (shares the underlying server).
+  WebServer(const WebServer &other);
+  /// Destroys the handle. The last handle stops the server.
+  ~WebServer();
+  /// Assigns another server (shares the underlying server).
+  WebServer &operator=(const WebServer &other);
+
+  /// Routes requests whose path is pathPrefix or lies below it to handler.
+  /// An empty method matches any method; "GET" also matches HEAD. The
+  /// longest matching prefix wins. Returns true on success.
+  bool addRoute(const String &method, const String &pathPrefix,
+                WebHandler handler, void *arg = nullptr);
+
+  /// Starts listening and serving. Returns true on success.
+  bool start();
+  /// Stops accepting, closes idle connections and waits up to timeoutMs for
+  /// busy ones, which close once their current response is sent.
+  void stop(int timeoutMs = 5000);
+  /// Returns true if the server is running.
+  bool isRunning() const;
+
+  /// Returns the listening port (the actual port once started).
+  int getPort() const;
+  /// Returns the number of open connections.
+  int getConnectionCount() const;
+  /// Returns the number of requests handled since creation.
+  long long getRequestCount() const;
+
+private:
+  WebServerImpl *impl;
+};
+
 //------------------------------------------------------------------------------
 // AI Integration
 //------------------------------------------------------------------------------
@@ -1900,10 +3065,16 @@ int GetProcessId();
 // Logging
 //------------------------------------------------------------------------------
 
-/// Enables logging to a file. Mutually exclusive with console logging.
-void EnableLoggingToFile(const String &path, bool truncate = false);
+/// Enables logging to a file. Mutually exclusive with console logging. If
+/// buffered is true, log lines are collected in memory and written by a
+/// background thread at least once a second; call FlushLog() to force them
+/// out. Exit() flushes automatically.
+void EnableLoggingToFile(const String &path, bool truncate = false,
+                         bool buffered = false);
 /// Enables logging to console (default). Mutually exclusive with file logging.
 void EnableLoggingToConsole();
+/// Writes any buffered log output to the log file.
+void FlushLog();
 
 // Log level selection (define ONE before including this header):
 //   ATTOBOY_LOG_DEBUG_ENABLE   - Debug, Info, Warning, Error
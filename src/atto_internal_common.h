@@ -50,11 +50,69 @@ inline char *WideToUtf8(const WCHAR *wide, int *outLen = nullptr) {
   return utf8;
 }
 
+/// Returns a * b (mod 2^64). 32-bit MSVC lowers 64-bit multiplies to
+/// _allmul, which is not available without the CRT, so there the product is
+/// built from two 32x32->64 multiplies.
+inline unsigned long long MulU64By32(unsigned long long a, unsigned int b) {
+#if defined(_MSC_VER) && defined(_M_IX86)
+  return __emulu((unsigned int)a, b) +
+         ((unsigned long long)(unsigned int)__emulu((unsigned int)(a >> 32), b)
+          << 32);
+#else
+  return a * b;
+#endif
+}
+
 inline void FreeConvertedString(void *str) {
   if (str)
     HeapFree(GetProcessHeap(), 0, str);
 }
 
+inline bool IsPathSeparator(WCHAR c) { return c == L'\\' || c == L'/'; }
+
+/// Returns the length of the root of path including its separator, such as
+/// "C:\", "\\server\share\", "\\?\C:\" or "\\?\UNC\server\share\"; 1 for
+/// "\"; 0 for a relative path.
+inline int GetPathRootLength(const WCHAR *path) {
+  int at = 0;
+  int components = 0;
+  if (IsPathSeparator(path[0]) && IsPathSeparator(path[1])) {
+    at = 2;
+    components = 2;
+    if ((path[2] == L'?' || path[2] == L'.') && IsPathSeparator(path[3])) {
+      at = 4;
+      components = 1;
+      if ((path[4] | 0x20) == L'u' && (path[5] | 0x20) == L'n' &&
+          (path[6] | 0x20) == L'c' && IsPathSeparator(path[7])) {
+        at = 8;
+        components = 2;
+      }
+    }
+  }
+  WCHAR drive = (WCHAR)(path[at] | 0x20);
+  if (components < 2 && drive >= L'a' && drive <= L'z' && path[at + 1] == L':')
+    return at + 2 + (IsPathSeparator(path[at + 2]) ? 1 : 0);
+  if (at == 0)
+    return IsPathSeparator(path[0]) ? 1 : 0;
+  // A server and share, or a device name after \\?\ or \\.\.
+  for (int i = 0; i < components && path[at]; i++) {
+    while (path[at] && !IsPathSeparator(path[at]))
+      at++;
+    if (path[at])
+      at++;
+  }
+  return at;
+}
+
+/// Removes trailing separators from path without shortening its root, so
+/// "C:\" and "\\server\share\" keep theirs.
+inline void TrimPathSeparators(WCHAR *path) {
+  int root = GetPathRootLength(path);
+  int len = lstrlenW(path);
+  while (len > root && IsPathSeparator(path[len - 1]))
+    path[--len] = 0;
+}
+
 inline int countUTF8Characters(const char *str, int byteLen) {
   if (!str || byteLen <= 0)
     return 0;
@@ -0,0 +1,44 @@
+#pragma once
+#include <windows.h>
+
+// SIMD support is only compiled for x86/x64 targets. Every function that uses
+// vector intrinsics must be tagged with ATTO_TARGET so GCC emits the right
+// instructions without raising the baseline of the whole library; callers
+// pick a code path at runtime through GetCpuFeatures().
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) ||               \
+    defined(__x86_64__)
+#define ATTO_X86 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#define ATTO_TARGET(isa)
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#define ATTO_TARGET(isa) __attribute__((target(isa)))
+#endif
+#else
+#define ATTO_X86 0
+#define ATTO_TARGET(isa)
+#endif
+
+namespace attoboy {
+
+enum CpuFeature {
+  CPU_SSE2 = 1 << 0,
+  CPU_SSSE3 = 1 << 1,
+  CPU_SSE41 = 1 << 2,
+  CPU_SSE42 = 1 << 3,
+  CPU_AVX2 = 1 << 4,
+  CPU_SHA = 1 << 5
+};
+
+/// Returns a bitmask of CpuFeature flags supported by the CPU and OS.
+/// The result is computed once and cached.
+int GetCpuFeatures();
+
+static inline bool HasCpuFeature(int feature) {
+  return (GetCpuFeatures() & feature) != 0;
+}
+
+} // namespace attoboy
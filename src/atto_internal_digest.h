@@ -0,0 +1,43 @@
+#pragma once
+#include <windows.h>
+
+// Cryptographic digest primitives shared by Buffer, Digest and Path. Each
+// *Final function works on a copy of the state, so a running digest can be
+// read without disturbing it.
+
+namespace attoboy {
+
+static const int SHA256_DIGEST_SIZE = 32;
+static const int BLAKE2S_DIGEST_SIZE = 32;
+
+/// Streaming SHA-256 state. Initialize with Sha256Init before use.
+struct Sha256State {
+  unsigned int h[8];
+  unsigned long long total;
+  unsigned char buf[64];
+  int bufLen;
+};
+
+/// Streaming BLAKE2s-256 state. Initialize with Blake2sInit before use.
+struct Blake2sState {
+  unsigned int h[8];
+  unsigned int t[2];
+  unsigned char buf[64];
+  int bufLen;
+};
+
+/// Resets the state to hash a new message.
+void Sha256Init(Sha256State *state);
+/// Feeds len bytes into the running hash.
+void Sha256Update(Sha256State *state, const unsigned char *data, int len);
+/// Writes the 32-byte digest of everything fed so far to out.
+void Sha256Final(const Sha256State *state, unsigned char *out);
+
+/// Resets the state to hash a new message (unkeyed, 32-byte output).
+void Blake2sInit(Blake2sState *state);
+/// Feeds len bytes into the running hash.
+void Blake2sUpdate(Blake2sState *state, const unsigned char *data, int len);
+/// Writes the 32-byte digest of everything fed so far to out.
+void Blake2sFinal(const Blake2sState *state, unsigned char *out);
+
+} // namespace attoboy
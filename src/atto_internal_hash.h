@@ -0,0 +1,45 @@
+#pragma once
+#include <windows.h>
+
+// Shared non-cryptographic hash primitives. Buffer, String, Hasher and any
+// container or codec that needs a fast checksum should call these instead of
+// rolling their own loops.
+
+namespace attoboy {
+
+/// Streaming xxHash64 state. Initialize with XXH64Init before use.
+struct XXH64State {
+  unsigned long long v[4];
+  unsigned long long total;
+  unsigned long long seed;
+  unsigned char mem[32];
+  int memSize;
+};
+
+/// Resets the state to hash a new stream with the given seed.
+void XXH64Init(XXH64State *state, unsigned long long seed);
+/// Feeds len bytes into the running hash.
+void XXH64Update(XXH64State *state, const unsigned char *data, int len);
+/// Returns the hash of everything fed so far. Does not modify the state.
+unsigned long long XXH64Digest(const XXH64State *state);
+/// One-shot xxHash64 of a byte range.
+unsigned long long XXH64(const unsigned char *data, int len,
+                         unsigned long long seed);
+
+/// Continues a CRC-32C (Castagnoli) over len bytes. Pass 0 to start a new
+/// checksum; the returned value is final and can be passed back in to chain.
+/// Uses the SSE4.2 crc32 instruction when available.
+unsigned int Crc32cUpdate(unsigned int crc, const unsigned char *data,
+                          int len);
+
+/// Continues a CRC-32 (IEEE, as used by gzip) over len bytes. Pass 0 to
+/// start a new checksum.
+unsigned int Crc32Update(unsigned int crc, const unsigned char *data,
+                         int len);
+
+/// Continues an Adler-32 (as used by zlib) over len bytes. Pass 1 to start a
+/// new checksum.
+unsigned int Adler32Update(unsigned int adler, const unsigned char *data,
+                           int len);
+
+} // namespace attoboy
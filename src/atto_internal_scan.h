@@ -0,0 +1,16 @@
+#pragma once
+#include <windows.h>
+
+// Byte-search primitives shared by the readers and search code.
+
+namespace attoboy {
+
+/// Returns the index of the first occurrence of value in data[0, len), or -1.
+int FindByte(const unsigned char *data, int len, unsigned char value);
+
+/// Returns the index of the first occurrence of the needleLen-byte needle in
+/// data[0, len), or -1. An empty needle matches at 0.
+int FindBytes(const unsigned char *data, int len, const unsigned char *needle,
+              int needleLen);
+
+} // namespace attoboy
@@ -0,0 +1,299 @@
+#include "attoasyncresult_internal.h"
+
+namespace attoboy {
+
+static SRWLOCK g_asyncInitLock = SRWLOCK_INIT;
+static HANDLE g_asyncPort = nullptr;
+
+// Performs a read or write on a handle without overlapped support. Runs on
+// its own thread so a read that waits on a pipe or console cannot hold up
+// the completion port's workers. The call uses a duplicate of the handle,
+// so the file's lock is only held while duplicating it and close() is not
+// blocked behind it.
+static DWORD WINAPI BlockingAsyncOpProc(LPVOID param) {
+  AsyncResultImpl *impl = (AsyncResultImpl *)param;
+  FileImpl *file = impl->fileImpl;
+  HANDLE handle = nullptr;
+  {
+    ReadLockGuard guard(&file->lock);
+    if (file->isOpen && file->isValid &&
+        !DuplicateHandle(GetCurrentProcess(), file->handle, GetCurrentProcess(),
+                         &handle, 0, FALSE, DUPLICATE_SAME_ACCESS))
+      handle = nullptr;
+  }
+
+  bool ok = false;
+  int bytes = 0;
+  if (handle) {
+    if (impl->type == ASYNC_OP_READ) {
+      DWORD bytesRead = 0;
+      ok = ReadFile(handle, impl->data, (DWORD)impl->requested, &bytesRead,
+                    nullptr) != FALSE;
+      bytes = ok ? (int)bytesRead : 0;
+    } else {
+      const unsigned char *data = impl->data;
+      int remaining = impl->requested;
+      ok = true;
+      while (ok && remaining > 0) {
+        DWORD bytesWritten = 0;
+        ok = WriteFile(handle, data, (DWORD)remaining, &bytesWritten,
+                       nullptr) &&
+             bytesWritten > 0;
+        data += bytesWritten;
+        remaining -= (int)bytesWritten;
+      }
+      bytes = ok ? impl->requested : 0;
+    }
+    CloseHandle(handle);
+  }
+
+  // Hand the result to the pool so callbacks run on a worker as usual.
+  HANDLE port = GetAsyncPort();
+  if (!port ||
+      !PostQueuedCompletionStatus(port, (DWORD)bytes,
+                                  ok ? ASYNC_KEY_IO : ASYNC_KEY_FAILED,
+                                  &impl->overlapped))
+    CompleteAsyncOp(impl, ok, bytes);
+  return 0;
+}
+
+static DWORD WINAPI AsyncWorkerProc(LPVOID param) {
+  HANDLE port = (HANDLE)param;
+  for (;;) {
+    DWORD bytes = 0;
+    ULONG_PTR key = 0;
+    OVERLAPPED *overlapped = nullptr;
+    BOOL ok =
+        GetQueuedCompletionStatus(port, &bytes, &key, &overlapped, INFINITE);
+    if (!overlapped) {
+      if (!ok && GetLastError() == ERROR_ABANDONED_WAIT_0)
+        break;
+      continue;
+    }
+
+    AsyncResultImpl *impl = (AsyncResultImpl *)overlapped;
+    if (key == ASYNC_KEY_FAILED)
+      CompleteAsyncOp(impl, false, 0);
+    else
+      CompleteAsyncOp(impl, ok != FALSE, (int)bytes);
+  }
+  return 0;
+}
+
+HANDLE GetAsyncPort() {
+  {
+    ReadLockGuard guard(&g_asyncInitLock);
+    if (g_asyncPort)
+      return g_asyncPort;
+  }
+
+  WriteLockGuard guard(&g_asyncInitLock);
+  if (g_asyncPort)
+    return g_asyncPort;
+
+  HANDLE port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 0);
+  if (!port)
+    return nullptr;
+
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  int threads = (int)info.dwNumberOfProcessors;
+  if (threads < ASYNC_MIN_THREADS)
+    threads = ASYNC_MIN_THREADS;
+  if (threads > ASYNC_MAX_THREADS)
+    threads = ASYNC_MAX_THREADS;
+
+  int started = 0;
+  for (int i = 0; i < threads; i++) {
+    HANDLE thread =
+        CreateThread(nullptr, 0, AsyncWorkerProc, port, 0, nullptr);
+    if (thread) {
+      CloseHandle(thread);
+      started++;
+    }
+  }
+  if (started == 0) {
+    CloseHandle(port);
+    return nullptr;
+  }
+
+  g_asyncPort = port;
+  return g_asyncPort;
+}
+
+AsyncResultImpl *AllocAsyncResultImpl(AsyncOpType type, AsyncCallback callback,
+                                      void *arg) {
+  AsyncResultImpl *impl = (AsyncResultImpl *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(AsyncResultImpl));
+  if (!impl)
+    return nullptr;
+  InitializeSRWLock(&impl->lock);
+  InitializeConditionVariable(&impl->completed);
+  impl->type = type;
+  impl->callback = callback;
+  impl->callbackArg = arg;
+  impl->refCount = 2;
+  return impl;
+}
+
+void ReleaseAsyncResultImpl(AsyncResultImpl *impl) {
+  if (!impl || InterlockedDecrement(&impl->refCount) != 0)
+    return;
+
+  if (impl->file) {
+    impl->file->~File();
+    HeapFree(GetProcessHeap(), 0, impl->file);
+  }
+  if (impl->buffer) {
+    impl->buffer->~Buffer();
+    HeapFree(GetProcessHeap(), 0, impl->buffer);
+  }
+  if (impl->accepted) {
+    impl->accepted->~File();
+    HeapFree(GetProcessHeap(), 0, impl->accepted);
+  }
+  if (impl->sourceFile)
+    CloseHandle(impl->sourceFile);
+  HeapFree(GetProcessHeap(), 0, impl);
+}
+
+void CompleteAsyncOp(AsyncResultImpl *impl, bool ok, int bytes) {
+  {
+    WriteLockGuard guard(&impl->lock);
+    impl->succeeded = ok;
+    impl->transferred = ok ? bytes : 0;
+
+    if (impl->type == ASYNC_OP_READ && impl->bufferImpl) {
+      WriteLockGuard bufferGuard(&impl->bufferImpl->lock);
+      impl->bufferImpl->size = impl->transferred;
+    } else if (impl->type == ASYNC_OP_ACCEPT && impl->acceptedImpl) {
+      FileImpl *client = impl->acceptedImpl;
+      WriteLockGuard clientGuard(&client->lock);
+      if (ok) {
+        SOCKET listener = impl->fileImpl->sock;
+        setsockopt(client->sock, SOL_SOCKET, SO_UPDATE_ACCEPT_CONTEXT,
+                   (const char *)&listener, sizeof(listener));
+        client->isOpen = true;
+        client->isValid = true;
+      } else if (client->sock != INVALID_SOCKET) {
+        closesocket(client->sock);
+        client->sock = INVALID_SOCKET;
+      }
+    }
+
+    impl->done = true;
+    WakeAllConditionVariable(&impl->completed);
+  }
+
+  if (impl->callback) {
+    InterlockedIncrement(&impl->refCount);
+    AsyncResult result(impl);
+    impl->callback(result, impl->callbackArg);
+  }
+  ReleaseAsyncResultImpl(impl);
+}
+
+void QueueBlockingAsyncOp(AsyncResultImpl *impl) {
+  HANDLE thread =
+      CreateThread(nullptr, 0, BlockingAsyncOpProc, impl, 0, nullptr);
+  if (thread)
+    CloseHandle(thread);
+  else
+    FailAsyncOp(impl);
+}
+
+void FailAsyncOp(AsyncResultImpl *impl) {
+  HANDLE port = GetAsyncPort();
+  if (!port ||
+      !PostQueuedCompletionStatus(port, 0, ASYNC_KEY_FAILED, &impl->overlapped))
+    CompleteAsyncOp(impl, false, 0);
+}
+
+AsyncResult::AsyncResult(AsyncResultImpl *adopted) { impl = adopted; }
+
+AsyncResult::AsyncResult(const AsyncResult &other) {
+  impl = other.impl;
+  if (impl)
+    InterlockedIncrement(&impl->refCount);
+}
+
+AsyncResult::~AsyncResult() { ReleaseAsyncResultImpl(impl); }
+
+AsyncResult &AsyncResult::operator=(const AsyncResult &other) {
+  if (this != &other) {
+    ReleaseAsyncResultImpl(impl);
+    impl = other.impl;
+    if (impl)
+      InterlockedIncrement(&impl->refCount);
+  }
+  return *this;
+}
+
+bool AsyncResult::isDone() const {
+  if (!impl)
+    return true;
+
+  ReadLockGuard guard(&impl->lock);
+  return impl->done;
+}
+
+bool AsyncResult::wait(int timeoutMs) {
+  if (!impl)
+    return true;
+
+  ULONGLONG deadline = GetTickCount64() + (timeoutMs > 0 ? timeoutMs : 0);
+  WriteLockGuard guard(&impl->lock);
+  while (!impl->done) {
+    DWORD remaining = INFINITE;
+    if (timeoutMs >= 0) {
+      ULONGLONG now = GetTickCount64();
+      if (now >= deadline)
+        return false;
+      remaining = (DWORD)(deadline - now);
+    }
+    SleepConditionVariableSRW(&impl->completed, &impl->lock, remaining, 0);
+  }
+  return true;
+}
+
+bool AsyncResult::succeeded() {
+  if (!impl)
+    return false;
+
+  wait();
+  ReadLockGuard guard(&impl->lock);
+  return impl->succeeded;
+}
+
+int AsyncResult::getCount() {
+  if (!impl)
+    return 0;
+
+  wait();
+  ReadLockGuard guard(&impl->lock);
+  return impl->transferred;
+}
+
+Buffer AsyncResult::getBuffer() {
+  if (!impl)
+    return Buffer();
+
+  wait();
+  ReadLockGuard guard(&impl->lock);
+  if (impl->type != ASYNC_OP_READ || !impl->buffer)
+    return Buffer();
+  return *impl->buffer;
+}
+
+File AsyncResult::getFile() {
+  if (!impl)
+    return File(Path(""));
+
+  wait();
+  ReadLockGuard guard(&impl->lock);
+  if (impl->type != ASYNC_OP_ACCEPT || !impl->accepted || !impl->succeeded)
+    return File(Path(""));
+  return *impl->accepted;
+}
+
+} // namespace attoboy
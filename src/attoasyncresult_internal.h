@@ -0,0 +1,81 @@
+#pragma once
+#include "attofile_internal.h"
+#include "attobuffer_internal.h"
+#include <mswsock.h>
+#include <new>
+
+namespace attoboy {
+
+enum AsyncOpType {
+  ASYNC_OP_READ = 0,
+  ASYNC_OP_WRITE,
+  ASYNC_OP_ACCEPT,
+  ASYNC_OP_SEND_FILE
+};
+
+// Completion keys. ASYNC_KEY_IO packets are queued by the kernel when
+// overlapped socket I/O finishes; the others are posted by the library.
+static const ULONG_PTR ASYNC_KEY_IO = 1;
+static const ULONG_PTR ASYNC_KEY_FAILED = 2;
+
+static const int ASYNC_MIN_THREADS = 2;
+static const int ASYNC_MAX_THREADS = 16;
+static const int ASYNC_ADDRESS_SIZE = sizeof(SOCKADDR_STORAGE) + 16;
+
+// One outstanding operation. overlapped must stay the first member so the
+// OVERLAPPED* of a completion packet converts back to the operation. The I/O
+// in flight holds one reference and every AsyncResult handle another.
+// file/buffer/accepted are owning copies placed in heap memory, and
+// sourceFile is the open file of a sendFileAsync().
+struct AsyncResultImpl {
+  OVERLAPPED overlapped;
+  AsyncOpType type;
+  File *file;
+  FileImpl *fileImpl;
+  Buffer *buffer;
+  BufferImpl *bufferImpl;
+  unsigned char *data;
+  int requested;
+  int transferred;
+  File *accepted;
+  FileImpl *acceptedImpl;
+  unsigned char acceptAddresses[2 * ASYNC_ADDRESS_SIZE];
+  HANDLE sourceFile;
+  bool succeeded;
+  bool done;
+  AsyncCallback callback;
+  void *callbackArg;
+  CONDITION_VARIABLE completed;
+  SRWLOCK lock;
+  volatile LONG refCount;
+};
+
+/// Returns the process-wide I/O completion port, starting its worker threads
+/// on first use. Returns nullptr if the port cannot be created.
+HANDLE GetAsyncPort();
+/// Allocates an operation holding two references: one for the I/O and one
+/// for the caller's AsyncResult.
+AsyncResultImpl *AllocAsyncResultImpl(AsyncOpType type, AsyncCallback callback,
+                                      void *arg);
+/// Drops one reference, freeing the operation with the last one.
+void ReleaseAsyncResultImpl(AsyncResultImpl *impl);
+/// Records the outcome, wakes waiters, runs the callback and drops the I/O's
+/// reference.
+void CompleteAsyncOp(AsyncResultImpl *impl, bool ok, int bytes);
+/// Starts a thread that performs the read or write synchronously (for file
+/// and pipe handles that were not opened for overlapped I/O), keeping the
+/// blocking call off the completion port's workers.
+void QueueBlockingAsyncOp(AsyncResultImpl *impl);
+/// Gives op its own copy of file, so the File outlives the I/O.
+bool AttachAsyncFile(AsyncResultImpl *op, const File &file,
+                     FileImpl *fileImpl);
+/// Registers a socket with the completion port the first time it is used
+/// asynchronously. The caller must hold the exclusive file lock.
+bool BindAsyncSocket(FileImpl *file);
+/// Returns the TransmitFile extension for a socket, or nullptr.
+LPFN_TRANSMITFILE GetTransmitFile(SOCKET sock);
+/// Completes impl as failed on a worker thread (or inline if no worker can
+/// be started), so callbacks always run on the pool.
+void FailAsyncOp(AsyncResultImpl *impl);
+
+} // namespace attoboy
@@ -0,0 +1,375 @@
+#include "atto_internal_cpu.h"
+#include "attobuffer_internal.h"
+
+namespace attoboy {
+
+static const unsigned char base64_table[65] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const unsigned char base64url_table[65] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// Accepts both the standard ("+/") and URL-safe ("-_") alphabets.
+static const unsigned char base64_decode_table[256] = {
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 62, 64, 62, 64, 63, 52, 53, 54, 55, 56, 57, 58, 59, 60,
+    61, 64, 64, 64, 64, 64, 64, 64, 0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10,
+    11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 64, 64, 64, 64,
+    63, 64, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42,
+    43, 44, 45, 46, 47, 48, 49, 50, 51, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64};
+
+#if ATTO_X86
+
+//------------------------------------------------------------------------------
+// Vectorized codecs (Muła/Lemire). Encoding splits 12 input bytes into 16
+// sextets with one shuffle and two multiplies, then maps sextets to ASCII with
+// a 16-entry offset table. Decoding validates and translates 16 characters
+// using nibble lookups and packs the sextets back with multiply-adds. Any
+// character outside the standard alphabet stops the vector loop and leaves the
+// rest of the input to the scalar code.
+//------------------------------------------------------------------------------
+
+ATTO_TARGET("ssse3")
+static __m128i EncodeReshuffle128(__m128i in) {
+  in = _mm_shuffle_epi8(
+      in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+  const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+  const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+  return _mm_or_si128(t1, t3);
+}
+
+ATTO_TARGET("ssse3")
+static __m128i EncodeTranslate128(__m128i in, __m128i lut) {
+  __m128i indices = _mm_subs_epu8(in, _mm_set1_epi8(51));
+  __m128i mask = _mm_cmpgt_epi8(in, _mm_set1_epi8(25));
+  indices = _mm_sub_epi8(indices, mask);
+  return _mm_add_epi8(in, _mm_shuffle_epi8(lut, indices));
+}
+
+ATTO_TARGET("ssse3")
+static __m128i EncodeLut128(bool urlSafe) {
+  // Offsets added to each sextet: A-Z, a-z, 0-9 (x10), then 62 and 63.
+  return urlSafe ? _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4,
+                                 -4, -17, 32, 0, 0)
+                 : _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4,
+                                 -4, -19, -16, 0, 0);
+}
+
+ATTO_TARGET("ssse3")
+static int EncodeSSSE3(const unsigned char *in, int len, char *out,
+                       bool urlSafe) {
+  const __m128i lut = EncodeLut128(urlSafe);
+  int consumed = 0;
+  while (len - consumed >= 16) {
+    __m128i block = _mm_loadu_si128((const __m128i *)(in + consumed));
+    block = EncodeTranslate128(EncodeReshuffle128(block), lut);
+    _mm_storeu_si128((__m128i *)out, block);
+    out += 16;
+    consumed += 12;
+  }
+  return consumed;
+}
+
+ATTO_TARGET("avx2")
+static int EncodeAVX2(const unsigned char *in, int len, char *out,
+                      bool urlSafe) {
+  const __m128i lut128 = EncodeLut128(urlSafe);
+  const __m256i lut = _mm256_broadcastsi128_si256(lut128);
+  const __m256i shuffle = _mm256_broadcastsi128_si256(
+      _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  int consumed = 0;
+  while (len - consumed >= 32) {
+    // Each 128-bit lane receives 12 consecutive input bytes.
+    __m128i lo = _mm_loadu_si128((const __m128i *)(in + consumed));
+    __m128i hi = _mm_loadu_si128((const __m128i *)(in + consumed + 12));
+    __m256i block =
+        _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+    block = _mm256_shuffle_epi8(block, shuffle);
+    const __m256i t0 = _mm256_and_si256(block, _mm256_set1_epi32(0x0fc0fc00));
+    const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    const __m256i t2 = _mm256_and_si256(block, _mm256_set1_epi32(0x003f03f0));
+    const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    block = _mm256_or_si256(t1, t3);
+
+    __m256i indices = _mm256_subs_epu8(block, _mm256_set1_epi8(51));
+    __m256i mask = _mm256_cmpgt_epi8(block, _mm256_set1_epi8(25));
+    indices = _mm256_sub_epi8(indices, mask);
+    block = _mm256_add_epi8(block, _mm256_shuffle_epi8(lut, indices));
+
+    _mm256_storeu_si256((__m256i *)out, block);
+    out += 32;
+    consumed += 24;
+  }
+  return consumed;
+}
+
+ATTO_TARGET("ssse3")
+static int DecodeSSSE3(const unsigned char *in, int len, unsigned char *out) {
+  const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                      0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b,
+                                      0x1b, 0x1a);
+  const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04,
+                                      0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                      0x10, 0x10);
+  const __m128i lutRoll =
+      _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i mask2F = _mm_set1_epi8(0x2f);
+  const __m128i zero = _mm_setzero_si128();
+
+  int consumed = 0;
+  while (len - consumed >= 16) {
+    __m128i str = _mm_loadu_si128((const __m128i *)(in + consumed));
+    __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask2F);
+    __m128i loNibbles = _mm_and_si128(str, mask2F);
+    __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+    __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+    __m128i invalid = _mm_cmpgt_epi8(_mm_and_si128(lo, hi), zero);
+    if (_mm_movemask_epi8(invalid) != 0)
+      break;
+
+    __m128i eq2F = _mm_cmpeq_epi8(str, mask2F);
+    __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles));
+    str = _mm_add_epi8(str, roll);
+
+    __m128i merged = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+    __m128i packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+    packed = _mm_shuffle_epi8(packed, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+                                                    14, 13, 12, -1, -1, -1,
+                                                    -1));
+    // Writes 16 bytes of which 12 are valid; callers reserve slack.
+    _mm_storeu_si128((__m128i *)out, packed);
+    out += 12;
+    consumed += 16;
+  }
+  return consumed;
+}
+
+ATTO_TARGET("avx2")
+static int DecodeAVX2(const unsigned char *in, int len, unsigned char *out) {
+  const __m256i lutLo = _mm256_broadcastsi128_si256(
+      _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                    0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a));
+  const __m256i lutHi = _mm256_broadcastsi128_si256(
+      _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10,
+                    0x10, 0x10, 0x10, 0x10, 0x10, 0x10));
+  const __m256i lutRoll = _mm256_broadcastsi128_si256(
+      _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0));
+  const __m256i packShuffle = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+  const __m256i mask2F = _mm256_set1_epi8(0x2f);
+
+  int consumed = 0;
+  while (len - consumed >= 32) {
+    __m256i str = _mm256_loadu_si256((const __m256i *)(in + consumed));
+    __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask2F);
+    __m256i loNibbles = _mm256_and_si256(str, mask2F);
+    __m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+    __m256i lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+    if (!_mm256_testz_si256(lo, hi))
+      break;
+
+    __m256i eq2F = _mm256_cmpeq_epi8(str, mask2F);
+    __m256i roll =
+        _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(eq2F, hiNibbles));
+    str = _mm256_add_epi8(str, roll);
+
+    __m256i merged = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+    __m256i packed = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+    packed = _mm256_shuffle_epi8(packed, packShuffle);
+    packed = _mm256_permutevar8x32_epi32(
+        packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+    // Writes 32 bytes of which 24 are valid; callers reserve slack.
+    _mm256_storeu_si256((__m256i *)out, packed);
+    out += 24;
+    consumed += 32;
+  }
+  return consumed;
+}
+
+#endif
+
+int Base64EncodedLength(int len, bool pad) {
+  if (len <= 0)
+    return 0;
+  if (pad)
+    return 4 * ((len + 2) / 3);
+  int rem = len % 3;
+  return 4 * (len / 3) + (rem ? rem + 1 : 0);
+}
+
+int Base64DecodedCapacity(int len) {
+  if (len <= 0)
+    return 0;
+  return (len / 4) * 3 + 3 + BASE64_DECODE_SLACK;
+}
+
+int Base64Encode(const unsigned char *in, int len, char *out, bool urlSafe,
+                 bool pad) {
+  if (!in || len <= 0 || !out)
+    return 0;
+
+  const unsigned char *table = urlSafe ? base64url_table : base64_table;
+  char *pos = out;
+  int done = 0;
+
+#if ATTO_X86
+  int features = GetCpuFeatures();
+  if (features & CPU_AVX2) {
+    int n = EncodeAVX2(in, len, pos, urlSafe);
+    pos += n / 3 * 4;
+    done += n;
+  }
+  if (features & CPU_SSSE3) {
+    int n = EncodeSSSE3(in + done, len - done, pos, urlSafe);
+    pos += n / 3 * 4;
+    done += n;
+  }
+#endif
+
+  const unsigned char *src = in + done;
+  const unsigned char *end = in + len;
+
+  while (end - src >= 3) {
+    *pos++ = table[src[0] >> 2];
+    *pos++ = table[((src[0] & 0x03) << 4) | (src[1] >> 4)];
+    *pos++ = table[((src[1] & 0x0f) << 2) | (src[2] >> 6)];
+    *pos++ = table[src[2] & 0x3f];
+    src += 3;
+  }
+
+  if (end - src) {
+    *pos++ = table[src[0] >> 2];
+    if (end - src == 1) {
+      *pos++ = table[(src[0] & 0x03) << 4];
+      if (pad)
+        *pos++ = '=';
+    } else {
+      *pos++ = table[((src[0] & 0x03) << 4) | (src[1] >> 4)];
+      *pos++ = table[(src[1] & 0x0f) << 2];
+    }
+    if (pad)
+      *pos++ = '=';
+  }
+
+  return (int)(pos - out);
+}
+
+int Base64Decode(const char *in, int len, unsigned char *out) {
+  if (!in || len <= 0 || !out)
+    return 0;
+
+  const unsigned char *src = (const unsigned char *)in;
+  const unsigned char *end = src + len;
+  unsigned char *pos = out;
+  unsigned int tmp = 0;
+  int count = 0;
+
+#if ATTO_X86
+  int features = GetCpuFeatures();
+#endif
+
+  while (src < end) {
+#if ATTO_X86
+    // Re-enter the vector loop at every quantum boundary so that line breaks
+    // in wrapped input only cost a short scalar detour.
+    if (count == 0) {
+      if (features & CPU_AVX2) {
+        int n = DecodeAVX2(src, (int)(end - src), pos);
+        src += n;
+        pos += n / 4 * 3;
+      }
+      if (features & CPU_SSSE3) {
+        int n = DecodeSSSE3(src, (int)(end - src), pos);
+        src += n;
+        pos += n / 4 * 3;
+      }
+      if (src >= end)
+        break;
+    }
+#endif
+
+    unsigned char c = *src++;
+    unsigned char d = base64_decode_table[c];
+
+    if (d == 64) {
+      if (c == '=')
+        break;
+      continue;
+    }
+
+    tmp = (tmp << 6) | d;
+    count++;
+
+    if (count == 4) {
+      *pos++ = (tmp >> 16) & 0xff;
+      *pos++ = (tmp >> 8) & 0xff;
+      *pos++ = tmp & 0xff;
+      tmp = 0;
+      count = 0;
+    }
+  }
+
+  if (count == 3) {
+    *pos++ = (tmp >> 10) & 0xff;
+    *pos++ = (tmp >> 2) & 0xff;
+  } else if (count == 2) {
+    *pos++ = (tmp >> 4) & 0xff;
+  }
+
+  return (int)(pos - out);
+}
+
+String Buffer::toBase64(bool urlSafe, bool pad) const {
+  if (!impl)
+    return String();
+
+  ReadLockGuard guard(&impl->lock);
+
+  int olen = Base64EncodedLength(impl->size, pad);
+  if (olen == 0)
+    return String();
+
+  // Encode straight into the result's storage to avoid a temporary copy.
+  String result;
+  if (!result.impl)
+    return result;
+
+  char *out = AllocString(olen);
+  if (!out)
+    return result;
+
+  Base64Encode(impl->data, impl->size, out, urlSafe, pad);
+  out[olen] = '\0';
+
+  FreeString(result.impl->data);
+  result.impl->data = out;
+  result.impl->len = olen;
+  return result;
+}
+
+Buffer Buffer::fromBase64(const String &base64String) {
+  const char *str = base64String.c_str();
+  int len = base64String.byteLength();
+  if (!str || len <= 0)
+    return Buffer();
+
+  Buffer result(Base64DecodedCapacity(len));
+  if (!result.impl || !result.impl->data)
+    return result;
+
+  result.impl->size = Base64Decode(str, len, result.impl->data);
+  return result;
+}
+
+} // namespace attoboy
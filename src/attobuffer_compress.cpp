@@ -216,20 +216,26 @@ static int LZ4DecompressCore(const unsigned char *src, int srcLen,
   return (int)(op - dst);
 }
 
-Buffer Buffer::compress() const {
+Buffer Buffer::compress(CompressionFormat format) const {
   Buffer result;
 
-  if (!impl || impl->size == 0)
+  if (!impl || (impl->size == 0 && format == COMPRESSION_LZ4))
     return result;
 
   ReadLockGuard lock(&impl->lock);
 
+  if (format != COMPRESSION_LZ4) {
+    if (result.impl)
+      DeflateIntoBuffer(result.impl, impl->data, impl->size, format);
+    return result;
+  }
+
+  // Compress straight into the result's storage, sized for the worst case.
   int maxCompSize = impl->size + (impl->size / 255) + 16 + 12;
-  unsigned char *compData =
-      (unsigned char *)HeapAlloc(GetProcessHeap(), 0, maxCompSize);
-  if (!compData)
+  if (!result.impl || !ResetBufferStorage(result.impl, maxCompSize))
     return result;
 
+  unsigned char *compData = result.impl->data;
   LZ4WriteU32(compData, LZ4_MAGIC);
   LZ4WriteU32(compData + 4, (unsigned int)impl->size);
 
@@ -237,46 +243,32 @@ Buffer Buffer::compress() const {
                                  maxCompSize - 8);
 
   if (compSize < 0) {
-    HeapFree(GetProcessHeap(), 0, compData);
-    return result;
-  }
-
-  result.impl =
-      (BufferImpl *)HeapAlloc(GetProcessHeap(), 0, sizeof(BufferImpl));
-  if (!result.impl) {
-    HeapFree(GetProcessHeap(), 0, compData);
+    ResetBufferStorage(result.impl, 0);
     return result;
   }
 
-  InitializeSRWLock(&result.impl->lock);
-  WriteLockGuard wlock(&result.impl->lock);
-
   result.impl->size = compSize + 8;
-  result.impl->capacity = compSize + 8;
-  result.impl->data = AllocBufferData(result.impl->capacity);
-
-  if (!result.impl->data) {
-    HeapFree(GetProcessHeap(), 0, result.impl);
-    HeapFree(GetProcessHeap(), 0, compData);
-    result.impl = nullptr;
-    return result;
-  }
-
-  for (int i = 0; i < result.impl->size; i++)
-    result.impl->data[i] = compData[i];
-
-  HeapFree(GetProcessHeap(), 0, compData);
   return result;
 }
 
-Buffer Buffer::decompress() const {
+Buffer Buffer::decompress(CompressionFormat format) const {
   Buffer result;
 
-  if (!impl || impl->size < 8)
+  if (!impl || impl->size == 0)
     return result;
 
   ReadLockGuard lock(&impl->lock);
 
+  if (format != COMPRESSION_LZ4) {
+    if (result.impl &&
+        !InflateIntoBuffer(result.impl, impl->data, impl->size, format))
+      ResetBufferStorage(result.impl, 0);
+    return result;
+  }
+
+  if (impl->size < 8)
+    return result;
+
   if (LZ4ReadU32(impl->data) != LZ4_MAGIC)
     return result;
 
@@ -284,44 +276,19 @@ Buffer Buffer::decompress() const {
   if (decompSize == 0 || decompSize > 256 * 1024 * 1024)
     return result;
 
-  unsigned char *decompData =
-      (unsigned char *)HeapAlloc(GetProcessHeap(), 0, decompSize);
-  if (!decompData)
+  // Decompress straight into the result's storage.
+  if (!result.impl || !ResetBufferStorage(result.impl, (int)decompSize))
     return result;
 
   int actualSize = LZ4DecompressCore(impl->data + 8, impl->size - 8,
-                                     decompData, (int)decompSize);
+                                     result.impl->data, (int)decompSize);
 
   if (actualSize < 0 || actualSize != (int)decompSize) {
-    HeapFree(GetProcessHeap(), 0, decompData);
-    return result;
-  }
-
-  result.impl =
-      (BufferImpl *)HeapAlloc(GetProcessHeap(), 0, sizeof(BufferImpl));
-  if (!result.impl) {
-    HeapFree(GetProcessHeap(), 0, decompData);
+    ResetBufferStorage(result.impl, 0);
     return result;
   }
 
-  InitializeSRWLock(&result.impl->lock);
-  WriteLockGuard wlock(&result.impl->lock);
-
   result.impl->size = actualSize;
-  result.impl->capacity = actualSize;
-  result.impl->data = AllocBufferData(result.impl->capacity);
-
-  if (!result.impl->data) {
-    HeapFree(GetProcessHeap(), 0, result.impl);
-    HeapFree(GetProcessHeap(), 0, decompData);
-    result.impl = nullptr;
-    return result;
-  }
-
-  for (int i = 0; i < result.impl->size; i++)
-    result.impl->data[i] = decompData[i];
-
-  HeapFree(GetProcessHeap(), 0, decompData);
   return result;
 }
 
@@ -2,104 +2,74 @@
 
 namespace attoboy {
 
-Buffer::Buffer() {
-  impl = (BufferImpl *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
-                                 sizeof(BufferImpl));
-  InitializeSRWLock(&impl->lock);
-  impl->data = AllocBufferData(512);
-  impl->size = 0;
-  impl->capacity = 512;
+static BufferImpl *AllocBufferImpl() {
+  BufferImpl *impl = (BufferImpl *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                             sizeof(BufferImpl));
+  if (impl)
+    InitializeSRWLock(&impl->lock);
+  return impl;
 }
 
-Buffer::Buffer(int size) {
-  impl = (BufferImpl *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
-                                 sizeof(BufferImpl));
-  InitializeSRWLock(&impl->lock);
+// Empty buffers allocate no storage; the first write gives them 512 bytes.
+Buffer::Buffer() { impl = AllocBufferImpl(); }
 
-  if (size < 0)
-    size = 0;
+Buffer::Buffer(int size) {
+  impl = AllocBufferImpl();
 
-  int capacity = size > 0 ? size : 512;
-  impl->data = AllocBufferData(capacity);
-  impl->size = 0;
-  impl->capacity = capacity;
+  if (size > 0)
+    ResetBufferStorage(impl, size);
 }
 
 Buffer::Buffer(const String &str) {
-  impl = (BufferImpl *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
-                                 sizeof(BufferImpl));
-  InitializeSRWLock(&impl->lock);
+  impl = AllocBufferImpl();
 
   const char *astr = str.c_str();
   int len = str.byteLength();
   int byteSize = len * sizeof(char);
 
-  int capacity = byteSize > 512 ? byteSize : 512;
-  impl->data = AllocBufferData(capacity);
-  impl->capacity = capacity;
+  if (byteSize <= 0)
+    return;
+
+  if (!ResetBufferStorage(impl, byteSize > 512 ? byteSize : 512))
+    return;
   impl->size = byteSize;
 
-  if (impl->data && byteSize > 0) {
-    unsigned char *src = (unsigned char *)astr;
-    for (int i = 0; i < byteSize; i++) {
-      impl->data[i] = src[i];
-    }
+  unsigned char *src = (unsigned char *)astr;
+  for (int i = 0; i < byteSize; i++) {
+    impl->data[i] = src[i];
   }
 }
 
 Buffer::Buffer(const unsigned char *ptr, int size) {
-  impl = (BufferImpl *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
-                                 sizeof(BufferImpl));
-  InitializeSRWLock(&impl->lock);
+  impl = AllocBufferImpl();
 
-  if (!ptr || size <= 0) {
-    impl->data = AllocBufferData(512);
-    impl->size = 0;
-    impl->capacity = 512;
+  if (!ptr || size <= 0)
     return;
-  }
 
-  int capacity = size > 512 ? size : 512;
-  impl->data = AllocBufferData(capacity);
-  impl->capacity = capacity;
+  if (!ResetBufferStorage(impl, size > 512 ? size : 512))
+    return;
   impl->size = size;
 
-  if (impl->data) {
-    const unsigned char *src = (const unsigned char *)ptr;
-    for (int i = 0; i < size; i++) {
-      impl->data[i] = src[i];
-    }
+  for (int i = 0; i < size; i++) {
+    impl->data[i] = ptr[i];
   }
 }
 
 Buffer::Buffer(const Buffer &other) {
-  impl = (BufferImpl *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
-                                 sizeof(BufferImpl));
-  InitializeSRWLock(&impl->lock);
+  impl = AllocBufferImpl();
 
   if (other.impl) {
+    // Copies share storage until one side writes.
     ReadLockGuard guard(&other.impl->lock);
-
-    int capacity = other.impl->capacity > 512 ? other.impl->capacity : 512;
-    impl->data = AllocBufferData(capacity);
-    impl->capacity = capacity;
-    impl->size = other.impl->size;
-
-    if (impl->data && other.impl->data && other.impl->size > 0) {
-      for (int i = 0; i < other.impl->size; i++) {
-        impl->data[i] = other.impl->data[i];
-      }
-    }
-  } else {
-    impl->data = AllocBufferData(512);
-    impl->size = 0;
-    impl->capacity = 512;
+    ShareBufferStorage(impl, other.impl->storage, other.impl->data,
+                       other.impl->size);
+    impl->capacity = other.impl->capacity;
   }
 }
 
 Buffer::~Buffer() {
   if (impl) {
-    FreeBufferData(impl->data);
+    ReleaseBufferStorage(impl->storage);
     HeapFree(GetProcessHeap(), 0, impl);
   }
 }
@@ -113,21 +83,9 @@ Buffer &Buffer::operator=(const Buffer &other) {
 
     if (other.impl) {
       ReadLockGuard otherGuard(&other.impl->lock);
-
-      if (other.impl->size > impl->capacity) {
-        FreeBufferData(impl->data);
-        int capacity = other.impl->capacity > 512 ? other.impl->capacity : 512;
-        impl->data = AllocBufferData(capacity);
-        impl->capacity = capacity;
-      }
-
-      impl->size = other.impl->size;
-
-      if (impl->data && other.impl->data && other.impl->size > 0) {
-        for (int i = 0; i < other.impl->size; i++) {
-          impl->data[i] = other.impl->data[i];
-        }
-      }
+      ShareBufferStorage(impl, other.impl->storage, other.impl->data,
+                         other.impl->size);
+      impl->capacity = other.impl->capacity;
     } else {
       impl->size = 0;
     }
@@ -0,0 +1,1073 @@
+#include "attobuffer_internal.h"
+#include "atto_internal_hash.h"
+
+namespace attoboy {
+
+//------------------------------------------------------------------------------
+// Shared tables (RFC 1951)
+//------------------------------------------------------------------------------
+
+static const unsigned short LENGTH_BASE[29] = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const unsigned char LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                               1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                               4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const unsigned short DIST_BASE[30] = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145,  8193,  12289, 16385, 24577};
+static const unsigned char DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2,  2,  3,  3,
+                                             4, 4, 5, 5, 6, 6, 7,  7,  8,  8,
+                                             9, 9, 10, 10, 11, 11, 12, 12, 13,
+                                             13};
+// Order in which code length code lengths are stored in a dynamic header.
+static const unsigned char CLEN_ORDER[19] = {16, 17, 18, 0, 8,  7, 9,
+                                             6,  10, 5,  11, 4, 12, 3,
+                                             13, 2,  14, 1, 15};
+
+static const int DEFLATE_WINDOW = 32768;
+static const int DEFLATE_MAX_MATCH = 258;
+static const int LITLEN_CODES = 286;
+static const int DIST_CODES = 30;
+
+static void FixedLitLenLengths(unsigned char *lengths) {
+  for (int i = 0; i < 288; i++)
+    lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+}
+
+//------------------------------------------------------------------------------
+// Inflate
+//------------------------------------------------------------------------------
+
+// Codes up to INFLATE_FAST_BITS long decode with one table lookup; longer
+// ones fall back to a canonical walk.
+static const int INFLATE_FAST_BITS = 9;
+// Decoding steps only start with this much input buffered (unless the input
+// has ended), which covers the largest dynamic block header, so no step
+// ever stops halfway.
+static const int INFLATE_LOOKAHEAD = 1024;
+// Decoded bytes are kept for back-references and handed to the sink in
+// chunks of up to INFLATE_FLUSH bytes.
+static const int INFLATE_FLUSH = 65536;
+static const int INFLATE_OUT_SIZE = DEFLATE_WINDOW + INFLATE_FLUSH;
+// Buffer::decompress() refuses to produce more than this.
+static const int INFLATE_MAX_OUTPUT = 1 << 30;
+
+enum InflatePhase {
+  INFLATE_HEADER,
+  INFLATE_BLOCK,
+  INFLATE_STORED,
+  INFLATE_CODES,
+  INFLATE_TRAILER,
+  INFLATE_DONE
+};
+
+struct InflateHuffman {
+  unsigned short fast[1 << INFLATE_FAST_BITS];
+  unsigned short count[16];
+  unsigned short symbol[288];
+};
+
+struct InflateStream {
+  CompressionFormat format;
+  InflateSink sink;
+  void *context;
+  InflatePhase phase;
+  bool wrapped;
+  bool lastBlock;
+  bool overrun;
+  int storedLeft;
+  int members;
+
+  unsigned char *in;
+  int inLen;
+  int inPos;
+  int inCapacity;
+  // Reads take at most 16 bits, so fewer than 24 are ever buffered; a 32-bit
+  // buffer keeps the variable shifts clear of 64-bit CRT helpers.
+  unsigned int bitBuf;
+  int bitCount;
+
+  unsigned char *out;
+  int outPos;
+  int flushed;
+  unsigned int check;
+  unsigned int totalOut;
+
+  InflateHuffman lit;
+  InflateHuffman dist;
+};
+
+// Builds decoding tables from code lengths. Returns false if the lengths
+// over-subscribe the code space.
+static bool BuildInflateHuffman(InflateHuffman *h, const unsigned char *lengths,
+                                int n) {
+  ZeroMemory(h->count, sizeof(h->count));
+  ZeroMemory(h->fast, sizeof(h->fast));
+  for (int i = 0; i < n; i++)
+    h->count[lengths[i]]++;
+  h->count[0] = 0;
+
+  int left = 1;
+  for (int len = 1; len <= 15; len++) {
+    left = (left << 1) - h->count[len];
+    if (left < 0)
+      return false;
+  }
+
+  unsigned short offsets[16];
+  offsets[1] = 0;
+  for (int len = 1; len < 15; len++)
+    offsets[len + 1] = offsets[len] + h->count[len];
+  for (int i = 0; i < n; i++)
+    if (lengths[i])
+      h->symbol[offsets[lengths[i]]++] = (unsigned short)i;
+
+  // Fill the fast table with the bit-reversed canonical codes.
+  int code = 0;
+  int index = 0;
+  for (int len = 1; len <= INFLATE_FAST_BITS; len++) {
+    for (int k = 0; k < h->count[len]; k++, code++, index++) {
+      int reversed = 0;
+      for (int b = 0; b < len; b++)
+        reversed |= ((code >> b) & 1) << (len - 1 - b);
+      for (int fill = reversed; fill < (1 << INFLATE_FAST_BITS);
+           fill += 1 << len)
+        h->fast[fill] = (unsigned short)((h->symbol[index] << 4) | len);
+    }
+    code <<= 1;
+  }
+  return true;
+}
+
+static inline void InflateFill(InflateStream *s, int bits) {
+  while (s->bitCount < bits && s->inPos < s->inLen) {
+    s->bitBuf |= (unsigned int)s->in[s->inPos++] << s->bitCount;
+    s->bitCount += 8;
+  }
+}
+
+static inline unsigned int InflateBits(InflateStream *s, int bits) {
+  InflateFill(s, bits);
+  if (s->bitCount < bits) {
+    s->overrun = true;
+    return 0;
+  }
+  unsigned int value = s->bitBuf & ((1U << bits) - 1);
+  s->bitBuf >>= bits;
+  s->bitCount -= bits;
+  return value;
+}
+
+static int InflateDecode(InflateStream *s, const InflateHuffman *h) {
+  InflateFill(s, 15);
+  unsigned int entry =
+      h->fast[s->bitBuf & ((1 << INFLATE_FAST_BITS) - 1)];
+  if (entry && (int)(entry & 15) <= s->bitCount) {
+    s->bitBuf >>= entry & 15;
+    s->bitCount -= entry & 15;
+    return entry >> 4;
+  }
+
+  int code = 0;
+  int first = 0;
+  int index = 0;
+  for (int len = 1; len <= 15 && len <= s->bitCount; len++) {
+    code |= (int)((s->bitBuf >> (len - 1)) & 1);
+    int count = h->count[len];
+    if (code - count < first) {
+      s->bitBuf >>= len;
+      s->bitCount -= len;
+      return h->symbol[index + (code - first)];
+    }
+    index += count;
+    first = (first + count) << 1;
+    code <<= 1;
+  }
+  s->overrun = true;
+  return -1;
+}
+
+// Moves bytes to a lower address; a forward copy is safe for the overlap.
+// (The library has no memmove when built without the CRT.)
+static void ShiftBytesDown(unsigned char *to, const unsigned char *from,
+                           int count) {
+  for (int i = 0; i < count; i++)
+    to[i] = from[i];
+}
+
+static bool FlushInflate(InflateStream *s) {
+  int pending = s->outPos - s->flushed;
+  if (pending > 0) {
+    const unsigned char *data = s->out + s->flushed;
+    if (s->format == COMPRESSION_GZIP)
+      s->check = Crc32Update(s->check, data, pending);
+    else if (s->wrapped)
+      s->check = Adler32Update(s->check, data, pending);
+    s->totalOut += (unsigned int)pending;
+    s->flushed = s->outPos;
+    if (!s->sink(s->context, data, pending))
+      return false;
+  }
+  // Keep only the window that later back-references may reach.
+  if (s->outPos > DEFLATE_WINDOW) {
+    ShiftBytesDown(s->out, s->out + s->outPos - DEFLATE_WINDOW,
+                   DEFLATE_WINDOW);
+    s->outPos = DEFLATE_WINDOW;
+    s->flushed = DEFLATE_WINDOW;
+  }
+  return true;
+}
+
+static bool ReadDynamicTables(InflateStream *s) {
+  int nlen = (int)InflateBits(s, 5) + 257;
+  int ndist = (int)InflateBits(s, 5) + 1;
+  int ncode = (int)InflateBits(s, 4) + 4;
+  if (nlen > LITLEN_CODES || ndist > DIST_CODES)
+    return false;
+
+  unsigned char lengths[320];
+  ZeroMemory(lengths, sizeof(lengths));
+  for (int i = 0; i < ncode; i++)
+    lengths[CLEN_ORDER[i]] = (unsigned char)InflateBits(s, 3);
+  InflateHuffman *clen = &s->dist;
+  if (!BuildInflateHuffman(clen, lengths, 19))
+    return false;
+
+  int index = 0;
+  while (index < nlen + ndist && !s->overrun) {
+    int symbol = InflateDecode(s, clen);
+    if (symbol < 0)
+      return false;
+    if (symbol < 16) {
+      lengths[index++] = (unsigned char)symbol;
+      continue;
+    }
+    unsigned char repeat = 0;
+    int times;
+    if (symbol == 16) {
+      if (index == 0)
+        return false;
+      repeat = lengths[index - 1];
+      times = 3 + (int)InflateBits(s, 2);
+    } else if (symbol == 17) {
+      times = 3 + (int)InflateBits(s, 3);
+    } else {
+      times = 11 + (int)InflateBits(s, 7);
+    }
+    if (index + times > nlen + ndist)
+      return false;
+    while (times-- > 0)
+      lengths[index++] = repeat;
+  }
+  if (s->overrun || lengths[256] == 0)
+    return false;
+  return BuildInflateHuffman(&s->lit, lengths, nlen) &&
+         BuildInflateHuffman(&s->dist, lengths + nlen, ndist);
+}
+
+// Reads a block header and sets up the block. Returns false on bad data.
+static bool StartInflateBlock(InflateStream *s) {
+  s->lastBlock = InflateBits(s, 1) != 0;
+  unsigned int type = InflateBits(s, 2);
+  if (type == 0) {
+    s->bitBuf >>= s->bitCount & 7;
+    s->bitCount -= s->bitCount & 7;
+    unsigned int len = InflateBits(s, 16);
+    unsigned int nlen = InflateBits(s, 16);
+    if ((len ^ 0xFFFF) != nlen)
+      return false;
+    s->storedLeft = (int)len;
+    s->phase = INFLATE_STORED;
+    return true;
+  }
+  if (type == 1) {
+    unsigned char lengths[320];
+    FixedLitLenLengths(lengths);
+    for (int i = 0; i < 30; i++)
+      lengths[288 + i] = 5;
+    BuildInflateHuffman(&s->lit, lengths, 288);
+    BuildInflateHuffman(&s->dist, lengths + 288, 30);
+    s->phase = INFLATE_CODES;
+    return true;
+  }
+  if (type == 2 && ReadDynamicTables(s)) {
+    s->phase = INFLATE_CODES;
+    return true;
+  }
+  return false;
+}
+
+// Copies stored bytes, from the bit buffer first and then straight from the
+// input. Returns false if the sink stopped.
+static bool CopyStoredBytes(InflateStream *s) {
+  while (s->storedLeft > 0) {
+    if (s->outPos == INFLATE_OUT_SIZE && !FlushInflate(s))
+      return false;
+    if (s->bitCount >= 8) {
+      s->out[s->outPos++] = (unsigned char)s->bitBuf;
+      s->bitBuf >>= 8;
+      s->bitCount -= 8;
+      s->storedLeft--;
+      continue;
+    }
+    int count = s->inLen - s->inPos;
+    if (count == 0)
+      return true;
+    if (count > s->storedLeft)
+      count = s->storedLeft;
+    if (count > INFLATE_OUT_SIZE - s->outPos)
+      count = INFLATE_OUT_SIZE - s->outPos;
+    CopyMemory(s->out + s->outPos, s->in + s->inPos, count);
+    s->outPos += count;
+    s->inPos += count;
+    s->storedLeft -= count;
+  }
+  s->phase = s->lastBlock ? INFLATE_TRAILER : INFLATE_BLOCK;
+  return true;
+}
+
+// Returns 1 at the end of the block, 0 when more input is needed, -1 on bad
+// data or a stopped sink.
+static int InflateCodes(InflateStream *s, bool final) {
+  for (;;) {
+    if (!final && s->inLen - s->inPos < INFLATE_LOOKAHEAD)
+      return 0;
+    if (s->outPos > INFLATE_OUT_SIZE - DEFLATE_MAX_MATCH && !FlushInflate(s))
+      return -1;
+
+    int symbol = InflateDecode(s, &s->lit);
+    if (symbol < 0 || s->overrun)
+      return -1;
+    if (symbol < 256) {
+      s->out[s->outPos++] = (unsigned char)symbol;
+      continue;
+    }
+    if (symbol == 256)
+      return 1;
+
+    symbol -= 257;
+    if (symbol >= 29)
+      return -1;
+    int length =
+        LENGTH_BASE[symbol] + (int)InflateBits(s, LENGTH_EXTRA[symbol]);
+    int distSymbol = InflateDecode(s, &s->dist);
+    if (distSymbol < 0 || distSymbol >= 30)
+      return -1;
+    int distance =
+        DIST_BASE[distSymbol] + (int)InflateBits(s, DIST_EXTRA[distSymbol]);
+    if (s->overrun || distance > s->outPos)
+      return -1;
+
+    unsigned char *to = s->out + s->outPos;
+    const unsigned char *from = to - distance;
+    if (distance >= length) {
+      CopyMemory(to, from, length);
+    } else {
+      for (int i = 0; i < length; i++)
+        to[i] = from[i];
+    }
+    s->outPos += length;
+  }
+}
+
+// Parses a gzip member header or detects a zlib header. Returns 1 when done,
+// 0 when more input is needed, -1 on bad data.
+static int ReadInflateHeader(InflateStream *s, bool final) {
+  const unsigned char *p = s->in + s->inPos;
+  int avail = s->inLen - s->inPos;
+
+  if (s->format == COMPRESSION_DEFLATE) {
+    if (avail < 2 && !final)
+      return 0;
+    if (avail == 0)
+      return -1;
+    // zlib (RFC 1950) if the first two bytes form a valid header, else raw.
+    int cmf = p[0];
+    int flg = avail > 1 ? p[1] : 0;
+    s->wrapped = (cmf & 0x0F) == 8 && (cmf >> 4) <= 7 &&
+                 ((cmf << 8) | flg) % 31 == 0 && !(flg & 0x20);
+    if (s->wrapped) {
+      s->inPos += 2;
+      s->check = 1;
+    }
+    s->phase = INFLATE_BLOCK;
+    return 1;
+  }
+
+  bool truncated = avail < 10;
+  if (truncated && !final)
+    return 0;
+  if (truncated || p[0] != 0x1F || p[1] != 0x8B || p[2] != 8 ||
+      (p[3] & 0xE0)) {
+    if (s->members == 0)
+      return -1;
+    // Trailing bytes after a complete member are ignored, as gzip does.
+    s->inPos = s->inLen;
+    s->phase = INFLATE_DONE;
+    return 1;
+  }
+  int flags = p[3];
+  int at = 10;
+  if (flags & 4) {
+    if (avail < at + 2)
+      return final ? -1 : 0;
+    at += 2 + (p[at] | (p[at + 1] << 8));
+  }
+  for (int field = 8; field <= 16; field <<= 1) {
+    if (!(flags & field))
+      continue;
+    while (at < avail && p[at] != 0)
+      at++;
+    if (at >= avail)
+      return final ? -1 : 0;
+    at++;
+  }
+  if (flags & 2)
+    at += 2;
+  if (at > avail)
+    return final ? -1 : 0;
+
+  s->inPos += at;
+  s->check = 0;
+  s->totalOut = 0;
+  s->phase = INFLATE_BLOCK;
+  return 1;
+}
+
+static bool CheckInflateTrailer(InflateStream *s) {
+  s->bitBuf >>= s->bitCount & 7;
+  s->bitCount -= s->bitCount & 7;
+  if (s->format == COMPRESSION_GZIP) {
+    unsigned int crc = InflateBits(s, 16);
+    crc |= InflateBits(s, 16) << 16;
+    unsigned int size = InflateBits(s, 16);
+    size |= InflateBits(s, 16) << 16;
+    return !s->overrun && crc == s->check && size == s->totalOut;
+  }
+  if (!s->wrapped)
+    return true;
+  unsigned int adler = 0;
+  for (int i = 0; i < 4; i++)
+    adler = (adler << 8) | InflateBits(s, 8);
+  return !s->overrun && adler == s->check;
+}
+
+// Decodes as far as the buffered input allows. Returns 1 once the stream
+// is complete, 0 when more input is needed, -1 on bad data.
+static int PumpInflate(InflateStream *s, bool final) {
+  for (;;) {
+    switch (s->phase) {
+    case INFLATE_HEADER: {
+      int result = ReadInflateHeader(s, final);
+      if (result <= 0)
+        return result;
+      break;
+    }
+    case INFLATE_BLOCK:
+      if (!final && s->inLen - s->inPos < INFLATE_LOOKAHEAD)
+        return 0;
+      if (!StartInflateBlock(s) || s->overrun)
+        return -1;
+      break;
+    case INFLATE_STORED:
+      if (!CopyStoredBytes(s))
+        return -1;
+      if (s->phase == INFLATE_STORED)
+        return final ? -1 : 0;
+      break;
+    case INFLATE_CODES: {
+      int result = InflateCodes(s, final);
+      if (result <= 0)
+        return result;
+      s->phase = s->lastBlock ? INFLATE_TRAILER : INFLATE_BLOCK;
+      break;
+    }
+    case INFLATE_TRAILER:
+      if (!final && s->inLen - s->inPos < 8)
+        return 0;
+      if (!FlushInflate(s) || !CheckInflateTrailer(s))
+        return -1;
+      s->members++;
+      s->phase = INFLATE_DONE;
+      break;
+    case INFLATE_DONE:
+      // Concatenated gzip members decode as one stream.
+      if (s->format == COMPRESSION_GZIP && s->bitCount == 0 &&
+          s->inPos < s->inLen) {
+        s->phase = INFLATE_HEADER;
+        break;
+      }
+      return 1;
+    }
+  }
+}
+
+InflateStream *CreateInflateStream(CompressionFormat format, InflateSink sink,
+                                   void *context) {
+  InflateStream *s = (InflateStream *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(InflateStream));
+  if (!s)
+    return nullptr;
+  s->out = (unsigned char *)HeapAlloc(GetProcessHeap(), 0, INFLATE_OUT_SIZE);
+  if (!s->out) {
+    HeapFree(GetProcessHeap(), 0, s);
+    return nullptr;
+  }
+  s->format = format;
+  s->sink = sink;
+  s->context = context;
+  s->phase = INFLATE_HEADER;
+  return s;
+}
+
+bool InflateStreamWrite(InflateStream *s, const unsigned char *data, int len) {
+  if (s->phase == INFLATE_DONE && s->format != COMPRESSION_GZIP)
+    return true;
+
+  // Drop consumed input, then append the new bytes.
+  if (s->inPos > 0) {
+    ShiftBytesDown(s->in, s->in + s->inPos, s->inLen - s->inPos);
+    s->inLen -= s->inPos;
+    s->inPos = 0;
+  }
+  if (s->inLen + len > s->inCapacity) {
+    int capacity = s->inCapacity ? s->inCapacity : INFLATE_FLUSH;
+    while (capacity < s->inLen + len)
+      capacity *= 2;
+    unsigned char *grown =
+        s->in ? (unsigned char *)HeapReAlloc(GetProcessHeap(), 0, s->in,
+                                             capacity)
+              : (unsigned char *)HeapAlloc(GetProcessHeap(), 0, capacity);
+    if (!grown)
+      return false;
+    s->in = grown;
+    s->inCapacity = capacity;
+  }
+  CopyMemory(s->in + s->inLen, data, len);
+  s->inLen += len;
+  return PumpInflate(s, false) >= 0;
+}
+
+bool InflateStreamFinish(InflateStream *s) {
+  return PumpInflate(s, true) == 1 && FlushInflate(s);
+}
+
+void FreeInflateStream(InflateStream *s) {
+  if (!s)
+    return;
+  if (s->in)
+    HeapFree(GetProcessHeap(), 0, s->in);
+  HeapFree(GetProcessHeap(), 0, s->out);
+  HeapFree(GetProcessHeap(), 0, s);
+}
+
+static bool AppendInflated(void *context, const unsigned char *data,
+                           int length) {
+  BufferImpl *out = (BufferImpl *)context;
+  if (length > INFLATE_MAX_OUTPUT - out->size ||
+      !EnsureBufferCapacity(out, out->size + length))
+    return false;
+  CopyMemory(out->data + out->size, data, length);
+  out->size += length;
+  return true;
+}
+
+bool InflateIntoBuffer(BufferImpl *out, const unsigned char *src, int len,
+                       CompressionFormat format) {
+  InflateStream *s = CreateInflateStream(format, AppendInflated, out);
+  if (!s)
+    return false;
+  // Whole input at once: decode it as final without the lookahead copy.
+  s->in = (unsigned char *)src;
+  s->inLen = len;
+  bool ok = PumpInflate(s, true) == 1 && FlushInflate(s);
+  s->in = nullptr;
+  FreeInflateStream(s);
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Deflate
+//------------------------------------------------------------------------------
+
+static const int DEFLATE_HASH_BITS = 15;
+static const int DEFLATE_MAX_CHAIN = 64;
+// Matches at least this long are taken without checking the next position
+// for a longer one.
+static const int DEFLATE_LAZY_LIMIT = 32;
+static const int DEFLATE_BLOCK_SYMBOLS = 16384;
+static const int STORED_MAX = 65535;
+
+struct DeflateWriter {
+  unsigned char *out;
+  int pos;
+  // At most 7 bits stay buffered between 16-bit writes.
+  unsigned int bitBuf;
+  int bitCount;
+};
+
+static inline void PutBits(DeflateWriter *w, unsigned int value, int bits) {
+  w->bitBuf |= value << w->bitCount;
+  w->bitCount += bits;
+  while (w->bitCount >= 8) {
+    w->out[w->pos++] = (unsigned char)w->bitBuf;
+    w->bitBuf >>= 8;
+    w->bitCount -= 8;
+  }
+}
+
+static inline void AlignBits(DeflateWriter *w) {
+  if (w->bitCount > 0)
+    PutBits(w, 0, 8 - w->bitCount);
+}
+
+// A block's symbols: a literal has distance 0, a match stores its length and
+// distance.
+struct DeflateBlock {
+  unsigned short length[DEFLATE_BLOCK_SYMBOLS];
+  unsigned short distance[DEFLATE_BLOCK_SYMBOLS];
+  int count;
+  unsigned int litFreq[LITLEN_CODES];
+  unsigned int distFreq[DIST_CODES];
+};
+
+static inline int LengthCode(int length) {
+  int code = 0;
+  while (code < 28 && LENGTH_BASE[code + 1] <= length)
+    code++;
+  return code;
+}
+
+static inline int DistanceCode(int distance) {
+  int code = 0;
+  while (code < 29 && DIST_BASE[code + 1] <= distance)
+    code++;
+  return code;
+}
+
+// Builds code lengths no longer than limit. Frequencies are halved until the
+// Huffman tree fits, which costs little ratio and keeps this simple.
+static void BuildCodeLengths(const unsigned int *freq, int n, int limit,
+                             unsigned char *lengths) {
+  unsigned int weight[2 * LITLEN_CODES];
+  int parent[2 * LITLEN_CODES];
+  int leaf[LITLEN_CODES];
+  int leaves = 0;
+  for (int i = 0; i < n; i++) {
+    lengths[i] = 0;
+    if (freq[i])
+      leaf[leaves++] = i;
+  }
+  if (leaves == 1) {
+    lengths[leaf[0]] = 1;
+    return;
+  }
+
+  for (int i = 0; i < leaves; i++)
+    weight[i] = freq[leaf[i]];
+  for (;;) {
+    bool active[2 * LITLEN_CODES];
+    int nodes = leaves;
+    for (int i = 0; i < leaves; i++)
+      active[i] = true;
+    for (int merge = 0; merge < leaves - 1; merge++) {
+      int a = -1;
+      int b = -1;
+      for (int i = 0; i < nodes; i++) {
+        if (!active[i])
+          continue;
+        if (a < 0 || weight[i] < weight[a]) {
+          b = a;
+          a = i;
+        } else if (b < 0 || weight[i] < weight[b]) {
+          b = i;
+        }
+      }
+      active[a] = active[b] = false;
+      weight[nodes] = weight[a] + weight[b];
+      parent[a] = parent[b] = nodes;
+      active[nodes++] = true;
+    }
+
+    int root = nodes - 1;
+    int longest = 0;
+    for (int i = 0; i < leaves; i++) {
+      int depth = 0;
+      for (int node = i; node != root; node = parent[node])
+        depth++;
+      lengths[leaf[i]] = (unsigned char)depth;
+      if (depth > longest)
+        longest = depth;
+    }
+    if (longest <= limit)
+      return;
+    for (int i = 0; i < leaves; i++)
+      weight[i] = (weight[i] >> 1) | 1;
+  }
+}
+
+// Turns code lengths into bit-reversed canonical codes for LSB-first output.
+static void BuildCodes(const unsigned char *lengths, int n,
+                       unsigned short *codes) {
+  int count[16] = {0};
+  int next[16];
+  for (int i = 0; i < n; i++)
+    count[lengths[i]]++;
+  count[0] = 0;
+  int code = 0;
+  for (int len = 1; len <= 15; len++) {
+    code = (code + count[len - 1]) << 1;
+    next[len] = code;
+  }
+  for (int i = 0; i < n; i++) {
+    int len = lengths[i];
+    if (!len)
+      continue;
+    int value = next[len]++;
+    int reversed = 0;
+    for (int b = 0; b < len; b++)
+      reversed |= ((value >> b) & 1) << (len - 1 - b);
+    codes[i] = (unsigned short)reversed;
+  }
+}
+
+// Run-length codes the concatenated code lengths with symbols 16-18. Returns
+// the number of symbols; extra holds each symbol's extra bits.
+static int EncodeCodeLengths(const unsigned char *lengths, int n,
+                             unsigned char *symbols, unsigned char *extra) {
+  int count = 0;
+  for (int i = 0; i < n;) {
+    int run = 1;
+    while (i + run < n && lengths[i + run] == lengths[i])
+      run++;
+    if (lengths[i] == 0 && run >= 3) {
+      if (run > 138)
+        run = 138;
+      symbols[count] = run >= 11 ? 18 : 17;
+      extra[count++] = (unsigned char)(run >= 11 ? run - 11 : run - 3);
+      i += run;
+    } else if (i > 0 && lengths[i] == lengths[i - 1] && run >= 3) {
+      if (run > 6)
+        run = 6;
+      symbols[count] = 16;
+      extra[count++] = (unsigned char)(run - 3);
+      i += run;
+    } else {
+      symbols[count] = lengths[i];
+      extra[count++] = 0;
+      i++;
+    }
+  }
+  return count;
+}
+
+// A block holds at most DEFLATE_BLOCK_SYMBOLS symbols of at most 48 bits
+// each, so the total fits in an int.
+static int SymbolBits(const DeflateBlock *block,
+                      const unsigned char *litLengths,
+                      const unsigned char *distLengths) {
+  int bits = 0;
+  for (int i = 0; i < LITLEN_CODES; i++) {
+    bits += (int)block->litFreq[i] * litLengths[i];
+    if (i > 256)
+      bits += (int)block->litFreq[i] * LENGTH_EXTRA[i - 257];
+  }
+  for (int i = 0; i < DIST_CODES; i++)
+    bits += (int)block->distFreq[i] * (distLengths[i] + DIST_EXTRA[i]);
+  return bits;
+}
+
+static void WriteSymbols(DeflateWriter *w, const DeflateBlock *block,
+                         const unsigned char *litLengths,
+                         const unsigned short *litCodes,
+                         const unsigned char *distLengths,
+                         const unsigned short *distCodes) {
+  for (int i = 0; i < block->count; i++) {
+    int length = block->length[i];
+    int distance = block->distance[i];
+    if (distance == 0) {
+      PutBits(w, litCodes[length], litLengths[length]);
+      continue;
+    }
+    int lc = LengthCode(length);
+    PutBits(w, litCodes[257 + lc], litLengths[257 + lc]);
+    PutBits(w, length - LENGTH_BASE[lc], LENGTH_EXTRA[lc]);
+    int dc = DistanceCode(distance);
+    PutBits(w, distCodes[dc], distLengths[dc]);
+    PutBits(w, distance - DIST_BASE[dc], DIST_EXTRA[dc]);
+  }
+  PutBits(w, litCodes[256], litLengths[256]);
+}
+
+// Gives unused symbols a count until at least two are used, so the Huffman
+// code is complete; decoders such as zlib reject incomplete ones.
+static void UseTwoCodes(unsigned int *freq, int n) {
+  int used = 0;
+  for (int i = 0; i < n; i++)
+    if (freq[i])
+      used++;
+  for (int i = 0; used < 2; i++)
+    if (!freq[i]) {
+      freq[i] = 1;
+      used++;
+    }
+}
+
+// Writes the block as stored, fixed or dynamic Huffman, whichever is
+// smallest. src/len are the input bytes the block covers.
+static void WriteDeflateBlock(DeflateWriter *w, DeflateBlock *block,
+                              const unsigned char *src, int len, bool last) {
+  block->litFreq[256] = 1;
+  UseTwoCodes(block->litFreq, LITLEN_CODES);
+  UseTwoCodes(block->distFreq, DIST_CODES);
+
+  unsigned char litLengths[LITLEN_CODES];
+  unsigned char distLengths[DIST_CODES];
+  BuildCodeLengths(block->litFreq, LITLEN_CODES, 15, litLengths);
+  BuildCodeLengths(block->distFreq, DIST_CODES, 15, distLengths);
+
+  int nlit = LITLEN_CODES;
+  while (nlit > 257 && litLengths[nlit - 1] == 0)
+    nlit--;
+  int ndist = DIST_CODES;
+  while (ndist > 1 && distLengths[ndist - 1] == 0)
+    ndist--;
+  unsigned char all[LITLEN_CODES + DIST_CODES];
+  CopyMemory(all, litLengths, nlit);
+  CopyMemory(all + nlit, distLengths, ndist);
+  unsigned char clSymbols[LITLEN_CODES + DIST_CODES];
+  unsigned char clExtra[LITLEN_CODES + DIST_CODES];
+  int clCount = EncodeCodeLengths(all, nlit + ndist, clSymbols, clExtra);
+  unsigned int clFreq[19] = {0};
+  for (int i = 0; i < clCount; i++)
+    clFreq[clSymbols[i]]++;
+  UseTwoCodes(clFreq, 19);
+  unsigned char clLengths[19];
+  BuildCodeLengths(clFreq, 19, 7, clLengths);
+  int nclen = 19;
+  while (nclen > 4 && clLengths[CLEN_ORDER[nclen - 1]] == 0)
+    nclen--;
+
+  int dynamicBits = 17 + 3 * nclen;
+  for (int i = 0; i < clCount; i++)
+    dynamicBits += clLengths[clSymbols[i]] +
+                   (clSymbols[i] == 16 ? 2 : clSymbols[i] == 17 ? 3
+                                         : clSymbols[i] == 18 ? 7 : 0);
+  dynamicBits += SymbolBits(block, litLengths, distLengths);
+
+  unsigned char fixedLit[288];
+  unsigned char fixedDist[DIST_CODES];
+  FixedLitLenLengths(fixedLit);
+  for (int i = 0; i < DIST_CODES; i++)
+    fixedDist[i] = 5;
+  int fixedBits = 3 + SymbolBits(block, fixedLit, fixedDist);
+  int storedBits = (len + 5 * ((len + STORED_MAX - 1) / STORED_MAX + 1)) * 8;
+
+  if (storedBits <= fixedBits && storedBits <= dynamicBits) {
+    int offset = 0;
+    do {
+      int chunk = len - offset < STORED_MAX ? len - offset : STORED_MAX;
+      bool final = last && offset + chunk == len;
+      PutBits(w, final ? 1 : 0, 1);
+      PutBits(w, 0, 2);
+      AlignBits(w);
+      PutBits(w, chunk, 16);
+      PutBits(w, chunk ^ 0xFFFF, 16);
+      CopyMemory(w->out + w->pos, src + offset, chunk);
+      w->pos += chunk;
+      offset += chunk;
+    } while (offset < len);
+  } else if (fixedBits <= dynamicBits) {
+    unsigned short litCodes[288];
+    unsigned short distCodes[DIST_CODES];
+    BuildCodes(fixedLit, 288, litCodes);
+    BuildCodes(fixedDist, DIST_CODES, distCodes);
+    PutBits(w, last ? 1 : 0, 1);
+    PutBits(w, 1, 2);
+    WriteSymbols(w, block, fixedLit, litCodes, fixedDist, distCodes);
+  } else {
+    unsigned short litCodes[LITLEN_CODES];
+    unsigned short distCodes[DIST_CODES];
+    unsigned short clCodes[19];
+    BuildCodes(litLengths, LITLEN_CODES, litCodes);
+    BuildCodes(distLengths, DIST_CODES, distCodes);
+    BuildCodes(clLengths, 19, clCodes);
+    PutBits(w, last ? 1 : 0, 1);
+    PutBits(w, 2, 2);
+    PutBits(w, nlit - 257, 5);
+    PutBits(w, ndist - 1, 5);
+    PutBits(w, nclen - 4, 4);
+    for (int i = 0; i < nclen; i++)
+      PutBits(w, clLengths[CLEN_ORDER[i]], 3);
+    for (int i = 0; i < clCount; i++) {
+      int symbol = clSymbols[i];
+      PutBits(w, clCodes[symbol], clLengths[symbol]);
+      if (symbol >= 16)
+        PutBits(w, clExtra[i], symbol == 16 ? 2 : symbol == 17 ? 3 : 7);
+    }
+    WriteSymbols(w, block, litLengths, litCodes, distLengths, distCodes);
+  }
+
+  block->count = 0;
+  ZeroMemory(block->litFreq, sizeof(block->litFreq));
+  ZeroMemory(block->distFreq, sizeof(block->distFreq));
+}
+
+static inline unsigned int DeflateHash(const unsigned char *p) {
+  unsigned int v = p[0] | (p[1] << 8) | (p[2] << 16);
+  return (v * 2654435761U) >> (32 - DEFLATE_HASH_BITS);
+}
+
+// Returns the longest earlier match for pos (0 if under 3 bytes) and sets
+// *distance. head/prev hold positions plus one, 0 meaning none.
+static int FindMatch(const unsigned char *src, int len, int pos,
+                     const int *head, const int *prev, int *distance) {
+  int limit = len - pos < DEFLATE_MAX_MATCH ? len - pos : DEFLATE_MAX_MATCH;
+  if (limit < 3)
+    return 0;
+  int best = 2;
+  int candidate = head[DeflateHash(src + pos)];
+  for (int chain = 0; candidate && chain < DEFLATE_MAX_CHAIN; chain++) {
+    int from = candidate - 1;
+    if (pos - from > DEFLATE_WINDOW)
+      break;
+    if (src[from + best] == src[pos + best]) {
+      int n = 0;
+      while (n < limit && src[from + n] == src[pos + n])
+        n++;
+      if (n > best) {
+        best = n;
+        *distance = pos - from;
+        if (n == limit)
+          break;
+      }
+    }
+    candidate = prev[from & (DEFLATE_WINDOW - 1)];
+  }
+  return best >= 3 ? best : 0;
+}
+
+static inline void InsertHash(const unsigned char *src, int len, int pos,
+                              int *head, int *prev) {
+  if (pos + 3 > len)
+    return;
+  unsigned int h = DeflateHash(src + pos);
+  prev[pos & (DEFLATE_WINDOW - 1)] = head[h];
+  head[h] = pos + 1;
+}
+
+static inline void AddSymbol(DeflateBlock *block, int length, int distance) {
+  block->length[block->count] = (unsigned short)length;
+  block->distance[block->count++] = (unsigned short)distance;
+  if (distance == 0) {
+    block->litFreq[length]++;
+  } else {
+    block->litFreq[257 + LengthCode(length)]++;
+    block->distFreq[DistanceCode(distance)]++;
+  }
+}
+
+// Compresses len bytes into w as a raw deflate stream (RFC 1951) using
+// hash-chain matching with one step of lazy evaluation.
+static bool DeflateRaw(DeflateWriter *w, const unsigned char *src, int len) {
+  int *head = (int *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                               sizeof(int) << DEFLATE_HASH_BITS);
+  int *prev = (int *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                               sizeof(int) * DEFLATE_WINDOW);
+  DeflateBlock *block = (DeflateBlock *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(DeflateBlock));
+  bool ok = head && prev && block;
+
+  int blockStart = 0;
+  int pos = 0;
+  while (ok && pos < len) {
+    int distance = 0;
+    int length = FindMatch(src, len, pos, head, prev, &distance);
+    InsertHash(src, len, pos, head, prev);
+    if (length && length < DEFLATE_LAZY_LIMIT) {
+      int nextDistance = 0;
+      int next = FindMatch(src, len, pos + 1, head, prev, &nextDistance);
+      if (next > length) {
+        AddSymbol(block, src[pos], 0);
+        pos++;
+        length = next;
+        distance = nextDistance;
+        InsertHash(src, len, pos, head, prev);
+      }
+    }
+
+    if (length) {
+      AddSymbol(block, length, distance);
+      for (int i = 1; i < length; i++)
+        InsertHash(src, len, pos + i, head, prev);
+      pos += length;
+    } else {
+      AddSymbol(block, src[pos], 0);
+      pos++;
+    }
+
+    if (block->count >= DEFLATE_BLOCK_SYMBOLS - 1) {
+      WriteDeflateBlock(w, block, src + blockStart, pos - blockStart,
+                        pos == len);
+      blockStart = pos;
+    }
+  }
+  if (ok && (block->count > 0 || len == 0))
+    WriteDeflateBlock(w, block, src + blockStart, pos - blockStart, true);
+  AlignBits(w);
+
+  if (head)
+    HeapFree(GetProcessHeap(), 0, head);
+  if (prev)
+    HeapFree(GetProcessHeap(), 0, prev);
+  if (block)
+    HeapFree(GetProcessHeap(), 0, block);
+  return ok;
+}
+
+bool DeflateIntoBuffer(BufferImpl *out, const unsigned char *src, int len,
+                       CompressionFormat format) {
+  // Never larger than stored blocks plus the wrapper.
+  int maxSize = len + len / 1024 + 64;
+  if (!ResetBufferStorage(out, maxSize))
+    return false;
+
+  DeflateWriter w;
+  ZeroMemory(&w, sizeof(w));
+  w.out = out->data;
+  if (format == COMPRESSION_GZIP) {
+    static const unsigned char header[10] = {0x1F, 0x8B, 8, 0, 0,
+                                             0,    0,    0, 0, 0xFF};
+    CopyMemory(w.out, header, sizeof(header));
+    w.pos = sizeof(header);
+  } else {
+    w.out[w.pos++] = 0x78;
+    w.out[w.pos++] = 0x9C;
+  }
+
+  if (!DeflateRaw(&w, src, len)) {
+    ResetBufferStorage(out, 0);
+    return false;
+  }
+
+  unsigned char *p = w.out + w.pos;
+  if (format == COMPRESSION_GZIP) {
+    unsigned int crc = Crc32Update(0, src, len);
+    for (int i = 0; i < 4; i++) {
+      p[i] = (unsigned char)(crc >> (8 * i));
+      p[4 + i] = (unsigned char)((unsigned int)len >> (8 * i));
+    }
+    w.pos += 8;
+  } else {
+    unsigned int adler = Adler32Update(1, src, len);
+    for (int i = 0; i < 4; i++)
+      p[i] = (unsigned char)(adler >> (24 - 8 * i));
+    w.pos += 4;
+  }
+  out->size = w.pos;
+  return true;
+}
+
+} // namespace attoboy
@@ -6,50 +6,160 @@
 
 namespace attoboy {
 
+// Byte storage shared by a buffer, its copies and its slices. Copies and
+// slices only take a reference; the first write to shared storage gives the
+// writer its own copy (see EnsureBufferCapacity). The bytes follow the header,
+// except for external storage (destroy set), whose bytes live elsewhere, such
+// as a mapped file view, and are never written through a Buffer.
+struct BufferStorage {
+  volatile LONG refCount;
+  int capacity;
+  void (*destroy)(BufferStorage *storage);
+};
+
 struct BufferImpl {
   unsigned char *data;
   int size;
   int capacity;
+  BufferStorage *storage;
   mutable SRWLOCK lock;
 };
 
-static inline unsigned char *AllocBufferData(int capacity) {
+static inline unsigned char *BufferStorageBytes(BufferStorage *storage) {
+  return (unsigned char *)(storage + 1);
+}
+
+static inline BufferStorage *AllocBufferStorage(int capacity) {
   if (capacity <= 0)
     return nullptr;
-  return (unsigned char *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
-                                    capacity);
+  BufferStorage *storage = (BufferStorage *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(BufferStorage) + capacity);
+  if (storage) {
+    storage->refCount = 1;
+    storage->capacity = capacity;
+  }
+  return storage;
 }
 
-static inline void FreeBufferData(unsigned char *data) {
-  if (data)
-    HeapFree(GetProcessHeap(), 0, data);
+static inline void RetainBufferStorage(BufferStorage *storage) {
+  if (storage)
+    InterlockedIncrement(&storage->refCount);
 }
 
+static inline void ReleaseBufferStorage(BufferStorage *storage) {
+  if (storage && InterlockedDecrement(&storage->refCount) == 0) {
+    if (storage->destroy)
+      storage->destroy(storage);
+    else
+      HeapFree(GetProcessHeap(), 0, storage);
+  }
+}
+
+static inline bool IsBufferShared(const BufferImpl *impl) {
+  return impl->storage &&
+         (impl->storage->refCount > 1 || impl->storage->destroy);
+}
+
+/// Gives impl fresh, unshared storage of the given capacity and size 0.
+/// A capacity of 0 leaves the buffer without storage.
+static inline bool ResetBufferStorage(BufferImpl *impl, int capacity) {
+  BufferStorage *storage = AllocBufferStorage(capacity);
+  if (capacity > 0 && !storage)
+    return false;
+
+  ReleaseBufferStorage(impl->storage);
+  impl->storage = storage;
+  impl->data = storage ? BufferStorageBytes(storage) : nullptr;
+  impl->size = 0;
+  impl->capacity = storage ? capacity : 0;
+  return true;
+}
+
+/// Makes impl a read-only view of size bytes at data inside storage. The
+/// view's first write copies the bytes out.
+static inline void ShareBufferStorage(BufferImpl *impl, BufferStorage *storage,
+                                      unsigned char *data, int size) {
+  RetainBufferStorage(storage);
+  ReleaseBufferStorage(impl->storage);
+  impl->storage = storage;
+  impl->data = storage ? data : nullptr;
+  impl->size = storage ? size : 0;
+  impl->capacity = impl->size;
+}
+
+/// Makes the buffer writable with room for requiredSize bytes: grows the
+/// storage if needed and copies it out if it is shared with other buffers.
 static inline bool EnsureBufferCapacity(BufferImpl *impl, int requiredSize) {
-  if (!impl || requiredSize <= impl->capacity)
+  if (!impl)
     return true;
 
-  int newCapacity = impl->capacity;
-  if (newCapacity == 0)
-    newCapacity = 512;
+  bool shared = IsBufferShared(impl);
+  if (!shared && requiredSize <= impl->capacity)
+    return true;
 
+  int newCapacity = impl->capacity < 512 ? 512 : impl->capacity;
   while (newCapacity < requiredSize)
     newCapacity *= 2;
 
-  unsigned char *newData = AllocBufferData(newCapacity);
-  if (!newData)
+  BufferStorage *storage = AllocBufferStorage(newCapacity);
+  if (!storage)
     return false;
 
-  if (impl->data && impl->size > 0) {
-    for (int i = 0; i < impl->size; i++) {
-      newData[i] = impl->data[i];
-    }
+  unsigned char *newData = BufferStorageBytes(storage);
+  for (int i = 0; i < impl->size; i++) {
+    newData[i] = impl->data[i];
   }
 
-  FreeBufferData(impl->data);
+  ReleaseBufferStorage(impl->storage);
+  impl->storage = storage;
   impl->data = newData;
   impl->capacity = newCapacity;
   return true;
 }
 
+/// Receives decoded bytes from an InflateStream. Returning false stops
+/// decoding.
+typedef bool (*InflateSink)(void *context, const unsigned char *data,
+                            int length);
+
+struct InflateStream;
+
+/// Starts decoding a gzip stream, or a zlib or raw deflate stream for
+/// COMPRESSION_DEFLATE, passing decoded bytes to sink as they are produced.
+/// Returns nullptr if out of memory.
+InflateStream *CreateInflateStream(CompressionFormat format, InflateSink sink,
+                                   void *context);
+/// Feeds the next len compressed bytes and decodes what it can. Returns
+/// false on corrupt data or if the sink stopped.
+bool InflateStreamWrite(InflateStream *stream, const unsigned char *data,
+                        int len);
+/// Decodes the rest once all input has been fed and checks the trailer.
+/// Returns true if the stream was complete and intact.
+bool InflateStreamFinish(InflateStream *stream);
+/// Frees the stream.
+void FreeInflateStream(InflateStream *stream);
+
+/// Decodes a whole gzip or deflate stream into out. Returns false on
+/// corrupt or truncated data.
+bool InflateIntoBuffer(BufferImpl *out, const unsigned char *src, int len,
+                       CompressionFormat format);
+/// Encodes len bytes as gzip or zlib-wrapped deflate into fresh storage in
+/// out. Returns false if out of memory.
+bool DeflateIntoBuffer(BufferImpl *out, const unsigned char *src, int len,
+                       CompressionFormat format);
+
+// Extra bytes the vectorized Base64 decoder may write past the decoded data.
+static const int BASE64_DECODE_SLACK = 32;
+
+/// Returns the exact encoded length of len bytes.
+int Base64EncodedLength(int len, bool pad);
+/// Returns the output capacity Base64Decode needs for len input characters.
+int Base64DecodedCapacity(int len);
+/// Encodes len bytes into out (no terminator). Returns characters written.
+int Base64Encode(const unsigned char *in, int len, char *out, bool urlSafe,
+                 bool pad);
+/// Decodes up to len characters into out, skipping characters outside the
+/// alphabet and stopping at '='. Returns bytes written.
+int Base64Decode(const char *in, int len, unsigned char *out);
+
 } // namespace attoboy
@@ -25,13 +25,10 @@ Buffer Buffer::slice(int start, int end) const {
     return Buffer();
   }
 
-  Buffer result(sliceSize);
-  result.impl->size = sliceSize;
-
-  for (int i = 0; i < sliceSize; i++) {
-    result.impl->data[i] = impl->data[start + i];
-  }
-
+  // The slice shares this buffer's bytes; whichever side writes first
+  // makes its own copy.
+  Buffer result;
+  ShareBufferStorage(result.impl, impl->storage, impl->data + start, sliceSize);
   return result;
 }
 
@@ -51,6 +48,9 @@ Buffer &Buffer::remove(int start, int end) {
   if (end <= start)
     return *this;
 
+  if (!EnsureBufferCapacity(impl, impl->size))
+    return *this;
+
   int removeSize = end - start;
   int remainingSize = impl->size - end;
 
@@ -72,6 +72,9 @@ Buffer &Buffer::reverse() {
   if (impl->size <= 1)
     return *this;
 
+  if (!EnsureBufferCapacity(impl, impl->size))
+    return *this;
+
   int left = 0;
   int right = impl->size - 1;
 
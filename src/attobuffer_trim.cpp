@@ -8,28 +8,27 @@ Buffer &Buffer::trim() {
 
   WriteLockGuard lock(&impl->lock);
 
-  if (impl->size == impl->capacity)
+  // A slice may be the only thing keeping a much larger parent alive, so
+  // shared storage is always compacted even if size == capacity.
+  if (impl->size == impl->capacity && !IsBufferShared(impl) &&
+      (!impl->storage || impl->data == BufferStorageBytes(impl->storage)))
     return *this;
 
   if (impl->size == 0) {
-    if (impl->data) {
-      FreeBufferData(impl->data);
-      impl->data = nullptr;
-    }
-    impl->capacity = 0;
+    ResetBufferStorage(impl, 0);
     return *this;
   }
 
-  unsigned char *newData = AllocBufferData(impl->size);
-  if (!newData)
+  BufferStorage *storage = AllocBufferStorage(impl->size);
+  if (!storage)
     return *this;
 
+  unsigned char *newData = BufferStorageBytes(storage);
   for (int i = 0; i < impl->size; i++)
     newData[i] = impl->data[i];
 
-  if (impl->data)
-    FreeBufferData(impl->data);
-
+  ReleaseBufferStorage(impl->storage);
+  impl->storage = storage;
   impl->data = newData;
   impl->capacity = impl->size;
 
@@ -1,3 +1,4 @@
+#include "atto_internal_hash.h"
 #include "attobuffer_internal.h"
 #include "attostring_internal.h"
 
@@ -83,4 +84,20 @@ int Buffer::hash() const {
   return hash;
 }
 
+long long Buffer::hash64() const {
+  if (!impl)
+    return (long long)XXH64(nullptr, 0, 0);
+
+  ReadLockGuard guard(&impl->lock);
+  return (long long)XXH64(impl->data, impl->size, 0);
+}
+
+int Buffer::crc32c() const {
+  if (!impl)
+    return 0;
+
+  ReadLockGuard guard(&impl->lock);
+  return (int)Crc32cUpdate(0, impl->data, impl->size);
+}
+
 } // namespace attoboy
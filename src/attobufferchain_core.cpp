@@ -0,0 +1,364 @@
+#include "attobufferchain_internal.h"
+
+namespace attoboy {
+
+static BufferChainImpl *AllocBufferChainImpl() {
+  BufferChainImpl *impl = (BufferChainImpl *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(BufferChainImpl));
+  if (impl)
+    InitializeSRWLock(&impl->lock);
+  return impl;
+}
+
+static void ClearSegments(BufferChainImpl *impl) {
+  for (int i = 0; i < impl->count; i++)
+    ReleaseBufferStorage(impl->segments[impl->start + i].storage);
+  impl->start = impl->capacity / 2;
+  impl->count = 0;
+  impl->size = 0;
+}
+
+static void FreeSegments(BufferChainImpl *impl) {
+  ClearSegments(impl);
+  if (impl->segments)
+    HeapFree(GetProcessHeap(), 0, impl->segments);
+  impl->segments = nullptr;
+  impl->capacity = 0;
+  impl->start = 0;
+}
+
+// Re-centers the segments so both ends have free slots, doubling the array
+// when it is more than half full.
+static bool GrowSegments(BufferChainImpl *impl) {
+  int newCapacity = impl->capacity;
+  if (newCapacity < 8 || impl->count + 1 > newCapacity / 2)
+    newCapacity = newCapacity < 8 ? 8 : newCapacity * 2;
+
+  BufferSegment *segments = (BufferSegment *)HeapAlloc(
+      GetProcessHeap(), 0, newCapacity * sizeof(BufferSegment));
+  if (!segments)
+    return false;
+
+  int newStart = (newCapacity - impl->count) / 2;
+  for (int i = 0; i < impl->count; i++)
+    segments[newStart + i] = impl->segments[impl->start + i];
+
+  if (impl->segments)
+    HeapFree(GetProcessHeap(), 0, impl->segments);
+  impl->segments = segments;
+  impl->capacity = newCapacity;
+  impl->start = newStart;
+  return true;
+}
+
+// Places seg at position index (0..count), taking over its storage
+// reference. Releases the reference if the segment array cannot grow.
+static bool InsertSegment(BufferChainImpl *impl, int index,
+                          const BufferSegment &seg) {
+  bool atFront = index == 0;
+  bool full = atFront ? impl->start == 0
+                      : impl->start + impl->count >= impl->capacity;
+  if (full && !GrowSegments(impl)) {
+    ReleaseBufferStorage(seg.storage);
+    return false;
+  }
+
+  if (atFront) {
+    impl->start--;
+    impl->segments[impl->start] = seg;
+  } else {
+    BufferSegment *base = impl->segments + impl->start;
+    for (int i = impl->count; i > index; i--)
+      base[i] = base[i - 1];
+    base[index] = seg;
+  }
+  impl->count++;
+  impl->size += seg.size;
+  return true;
+}
+
+// Takes a reference to the buffer's bytes. Returns false for an empty buffer.
+static bool SegmentFromBuffer(BufferImpl *bufImpl, BufferSegment *seg) {
+  if (!bufImpl)
+    return false;
+  ReadLockGuard guard(&bufImpl->lock);
+  if (!bufImpl->storage || bufImpl->size <= 0)
+    return false;
+  RetainBufferStorage(bufImpl->storage);
+  seg->storage = bufImpl->storage;
+  seg->data = bufImpl->data;
+  seg->size = bufImpl->size;
+  return true;
+}
+
+// Copies the string's bytes into new storage. Returns false if empty.
+static bool SegmentFromString(const String &str, BufferSegment *seg) {
+  int len = str.byteLength();
+  if (len <= 0)
+    return false;
+  BufferStorage *storage = AllocBufferStorage(len);
+  if (!storage)
+    return false;
+  unsigned char *data = BufferStorageBytes(storage);
+  const char *src = str.c_str();
+  for (int i = 0; i < len; i++)
+    data[i] = (unsigned char)src[i];
+  seg->storage = storage;
+  seg->data = data;
+  seg->size = len;
+  return true;
+}
+
+// Returns the segment position at which byte index begins, splitting the
+// segment that straddles it. Returns -1 if the split fails.
+static int SplitAt(BufferChainImpl *impl, int index) {
+  if (index <= 0)
+    return 0;
+  if (index >= impl->size)
+    return impl->count;
+
+  int offset = 0;
+  for (int i = 0; i < impl->count; i++) {
+    BufferSegment &seg = impl->segments[impl->start + i];
+    if (index == offset)
+      return i;
+    if (index < offset + seg.size) {
+      int head = index - offset;
+      BufferSegment tail;
+      tail.storage = seg.storage;
+      tail.data = seg.data + head;
+      tail.size = seg.size - head;
+      RetainBufferStorage(tail.storage);
+      seg.size = head;
+      impl->size -= tail.size;
+      if (!InsertSegment(impl, i + 1, tail)) {
+        impl->size += tail.size;
+        impl->segments[impl->start + i].size += tail.size;
+        return -1;
+      }
+      return i + 1;
+    }
+    offset += seg.size;
+  }
+  return impl->count;
+}
+
+// Joins all segments into one. Caller holds the write lock.
+static bool FlattenSegments(BufferChainImpl *impl) {
+  if (impl->count <= 1)
+    return true;
+
+  BufferStorage *storage = AllocBufferStorage(impl->size);
+  if (!storage)
+    return false;
+
+  unsigned char *dest = BufferStorageBytes(storage);
+  int total = impl->size;
+  int pos = 0;
+  for (int i = 0; i < impl->count; i++) {
+    const BufferSegment &seg = impl->segments[impl->start + i];
+    for (int j = 0; j < seg.size; j++)
+      dest[pos + j] = seg.data[j];
+    pos += seg.size;
+  }
+
+  ClearSegments(impl);
+  BufferSegment joined;
+  joined.storage = storage;
+  joined.data = dest;
+  joined.size = total;
+  return InsertSegment(impl, 0, joined);
+}
+
+static void CopySegments(BufferChainImpl *impl, const BufferChainImpl *src) {
+  for (int i = 0; i < src->count; i++) {
+    BufferSegment seg = src->segments[src->start + i];
+    RetainBufferStorage(seg.storage);
+    if (!InsertSegment(impl, impl->count, seg))
+      return;
+  }
+}
+
+BufferChain::BufferChain() { impl = AllocBufferChainImpl(); }
+
+BufferChain::BufferChain(const Buffer &buf) {
+  impl = AllocBufferChainImpl();
+  append(buf);
+}
+
+BufferChain::BufferChain(const BufferChain &other) {
+  impl = AllocBufferChainImpl();
+  if (!impl || !other.impl)
+    return;
+
+  ReadLockGuard guard(&other.impl->lock);
+  CopySegments(impl, other.impl);
+}
+
+BufferChain::~BufferChain() {
+  if (impl) {
+    FreeSegments(impl);
+    HeapFree(GetProcessHeap(), 0, impl);
+  }
+}
+
+BufferChain &BufferChain::operator=(const BufferChain &other) {
+  if (this == &other || !impl || !other.impl)
+    return *this;
+
+  WriteLockGuard guard(&impl->lock);
+  ReadLockGuard otherGuard(&other.impl->lock);
+  ClearSegments(impl);
+  CopySegments(impl, other.impl);
+  return *this;
+}
+
+BufferChain &BufferChain::append(const Buffer &buf) {
+  BufferSegment seg;
+  if (!impl || !SegmentFromBuffer(buf.impl, &seg))
+    return *this;
+
+  WriteLockGuard guard(&impl->lock);
+  InsertSegment(impl, impl->count, seg);
+  return *this;
+}
+
+BufferChain &BufferChain::append(const String &str) {
+  BufferSegment seg;
+  if (!impl || !SegmentFromString(str, &seg))
+    return *this;
+
+  WriteLockGuard guard(&impl->lock);
+  InsertSegment(impl, impl->count, seg);
+  return *this;
+}
+
+BufferChain &BufferChain::append(const BufferChain &other) {
+  if (!impl || !other.impl)
+    return *this;
+
+  if (this == &other) {
+    BufferChain copy(other);
+    return append(copy);
+  }
+
+  WriteLockGuard guard(&impl->lock);
+  ReadLockGuard otherGuard(&other.impl->lock);
+  CopySegments(impl, other.impl);
+  return *this;
+}
+
+BufferChain &BufferChain::prepend(const Buffer &buf) {
+  BufferSegment seg;
+  if (!impl || !SegmentFromBuffer(buf.impl, &seg))
+    return *this;
+
+  WriteLockGuard guard(&impl->lock);
+  InsertSegment(impl, 0, seg);
+  return *this;
+}
+
+BufferChain &BufferChain::prepend(const String &str) {
+  BufferSegment seg;
+  if (!impl || !SegmentFromString(str, &seg))
+    return *this;
+
+  WriteLockGuard guard(&impl->lock);
+  InsertSegment(impl, 0, seg);
+  return *this;
+}
+
+BufferChain &BufferChain::insert(int index, const Buffer &buf) {
+  BufferSegment seg;
+  if (!impl || !SegmentFromBuffer(buf.impl, &seg))
+    return *this;
+
+  WriteLockGuard guard(&impl->lock);
+  int pos = SplitAt(impl, index);
+  if (pos < 0)
+    ReleaseBufferStorage(seg.storage);
+  else
+    InsertSegment(impl, pos, seg);
+  return *this;
+}
+
+BufferChain &BufferChain::insert(int index, const String &str) {
+  BufferSegment seg;
+  if (!impl || !SegmentFromString(str, &seg))
+    return *this;
+
+  WriteLockGuard guard(&impl->lock);
+  int pos = SplitAt(impl, index);
+  if (pos < 0)
+    ReleaseBufferStorage(seg.storage);
+  else
+    InsertSegment(impl, pos, seg);
+  return *this;
+}
+
+BufferChain &BufferChain::clear() {
+  if (!impl)
+    return *this;
+
+  WriteLockGuard guard(&impl->lock);
+  ClearSegments(impl);
+  return *this;
+}
+
+int BufferChain::length() const {
+  if (!impl)
+    return 0;
+  ReadLockGuard guard(&impl->lock);
+  return impl->size;
+}
+
+bool BufferChain::isEmpty() const { return length() == 0; }
+
+int BufferChain::segmentCount() const {
+  if (!impl)
+    return 0;
+  ReadLockGuard guard(&impl->lock);
+  return impl->count;
+}
+
+Buffer BufferChain::segmentAt(int index) const {
+  Buffer result;
+  if (!impl || !result.impl)
+    return result;
+
+  ReadLockGuard guard(&impl->lock);
+  if (index < 0 || index >= impl->count)
+    return result;
+  const BufferSegment &seg = impl->segments[impl->start + index];
+  ShareBufferStorage(result.impl, seg.storage, seg.data, seg.size);
+  return result;
+}
+
+const unsigned char *BufferChain::c_ptr(int *len) const {
+  if (len)
+    *len = 0;
+  if (!impl)
+    return nullptr;
+
+  WriteLockGuard guard(&impl->lock);
+  if (impl->count == 0 || !FlattenSegments(impl))
+    return nullptr;
+  if (len)
+    *len = impl->size;
+  return impl->segments[impl->start].data;
+}
+
+Buffer BufferChain::toBuffer() const {
+  Buffer result;
+  if (!impl || !result.impl)
+    return result;
+
+  WriteLockGuard guard(&impl->lock);
+  if (impl->count == 0 || !FlattenSegments(impl))
+    return result;
+  const BufferSegment &seg = impl->segments[impl->start];
+  ShareBufferStorage(result.impl, seg.storage, seg.data, seg.size);
+  return result;
+}
+
+} // namespace attoboy
@@ -0,0 +1,27 @@
+#pragma once
+#include "atto_internal_common.h"
+#include "attobuffer_internal.h"
+#include "attoboy/attoboy.h"
+#include <windows.h>
+
+namespace attoboy {
+
+/// A run of size bytes at data, kept alive by a reference on storage.
+struct BufferSegment {
+  BufferStorage *storage;
+  unsigned char *data;
+  int size;
+};
+
+// Segments live in segments[start, start + count). Free slots are kept on
+// both sides so prepend and append are amortized O(1).
+struct BufferChainImpl {
+  BufferSegment *segments;
+  int start;
+  int count;
+  int capacity;
+  int size;
+  mutable SRWLOCK lock;
+};
+
+} // namespace attoboy
@@ -0,0 +1,330 @@
+#include "attobufferedreader_internal.h"
+#include "atto_internal_scan.h"
+
+namespace attoboy {
+
+static BufferedReaderImpl *AllocBufferedReaderImpl(int bufferSize) {
+  BufferedReaderImpl *impl = (BufferedReaderImpl *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(BufferedReaderImpl));
+  if (!impl)
+    return nullptr;
+  InitializeSRWLock(&impl->lock);
+  impl->refCount = 1;
+
+  if (bufferSize < BUFFERED_READER_MIN_SIZE)
+    bufferSize = BUFFERED_READER_MIN_SIZE;
+  impl->buf = (unsigned char *)HeapAlloc(GetProcessHeap(), 0, bufferSize);
+  if (impl->buf)
+    impl->capacity = bufferSize;
+  else
+    impl->eof = true;
+  return impl;
+}
+
+static void FreeBufferedReaderImpl(BufferedReaderImpl *impl) {
+  if (impl->file) {
+    impl->file->~File();
+    HeapFree(GetProcessHeap(), 0, impl->file);
+  }
+  if (impl->process) {
+    impl->process->~Subprocess();
+    HeapFree(GetProcessHeap(), 0, impl->process);
+  }
+  if (impl->buf)
+    HeapFree(GetProcessHeap(), 0, impl->buf);
+  HeapFree(GetProcessHeap(), 0, impl);
+}
+
+// Reads up to count bytes from the source, waiting for data if a File is in
+// non-blocking mode. Returns bytes read, or 0 at the end of the source or on
+// error.
+static int ReadSource(BufferedReaderImpl *impl, unsigned char *dest,
+                      int count) {
+  if (impl->fileImpl) {
+    FileImpl *file = impl->fileImpl;
+    ReadLockGuard guard(&file->lock);
+    if (!file->isOpen || !file->isValid)
+      return 0;
+    int bytesRead =
+        ReadFileImplWaiting(file, dest, count, GetReadTimeout(file));
+    return bytesRead < 0 ? 0 : bytesRead;
+  }
+
+  if (impl->processImpl) {
+    SubprocessImpl *process = impl->processImpl;
+    ReadLockGuard guard(&process->lock);
+    if (!process->valid || !process->hStdOutRead)
+      return 0;
+    // Fails with ERROR_BROKEN_PIPE once the process exits and the pipe
+    // drains, which is the end of the stream.
+    DWORD bytesRead = 0;
+    if (!ReadFile(process->hStdOutRead, dest, count, &bytesRead, nullptr))
+      return 0;
+    return (int)bytesRead;
+  }
+
+  return 0;
+}
+
+// Reads more of the source into the buffer, first sliding unconsumed bytes
+// to the front or doubling the buffer if it is full. Returns false at the end
+// of the source. Caller holds the write lock.
+static bool FillBuffer(BufferedReaderImpl *impl) {
+  if (impl->eof)
+    return false;
+
+  if (impl->start == impl->end) {
+    impl->start = impl->end = 0;
+  } else if (impl->start > 0 &&
+             impl->capacity - impl->end < impl->capacity / 4) {
+    int pending = impl->end - impl->start;
+    for (int i = 0; i < pending; i++)
+      impl->buf[i] = impl->buf[impl->start + i];
+    impl->start = 0;
+    impl->end = pending;
+  }
+
+  if (impl->end == impl->capacity) {
+    int newCapacity = impl->capacity * 2;
+    unsigned char *newBuf =
+        (unsigned char *)HeapAlloc(GetProcessHeap(), 0, newCapacity);
+    if (!newBuf) {
+      impl->eof = true;
+      return false;
+    }
+    int pending = impl->end - impl->start;
+    for (int i = 0; i < pending; i++)
+      newBuf[i] = impl->buf[impl->start + i];
+    HeapFree(GetProcessHeap(), 0, impl->buf);
+    impl->buf = newBuf;
+    impl->capacity = newCapacity;
+    impl->start = 0;
+    impl->end = pending;
+  }
+
+  int bytesRead =
+      ReadSource(impl, impl->buf + impl->end, impl->capacity - impl->end);
+  if (bytesRead <= 0) {
+    impl->eof = true;
+    return false;
+  }
+  impl->end += bytesRead;
+  return true;
+}
+
+// Finds the next "\n" at or after the read position, reading more as needed.
+// Returns its offset from start, or -1 if the source ends first. Caller holds
+// the write lock.
+static int FindLineEnd(BufferedReaderImpl *impl) {
+  int scanned = 0;
+  for (;;) {
+    int pending = impl->end - impl->start;
+    int hit = FindByte(impl->buf + impl->start + scanned, pending - scanned,
+                       '\n');
+    if (hit >= 0)
+      return scanned + hit;
+    scanned = pending;
+    if (!FillBuffer(impl))
+      return -1;
+  }
+}
+
+// Consumes the next line and sets *line/*length to it without its ending.
+// Returns false if nothing is left. Caller holds the write lock.
+static bool TakeLine(BufferedReaderImpl *impl, const unsigned char **line,
+                     int *length) {
+  int lineEnd = FindLineEnd(impl);
+  int consumed;
+  int len;
+  if (lineEnd >= 0) {
+    len = lineEnd;
+    consumed = lineEnd + 1;
+  } else {
+    len = impl->end - impl->start;
+    consumed = len;
+    if (len == 0)
+      return false;
+  }
+
+  *line = impl->buf + impl->start;
+  if (len > 0 && (*line)[len - 1] == '\r' && lineEnd >= 0)
+    len--;
+  *length = len;
+  impl->start += consumed;
+  return true;
+}
+
+BufferedReader::BufferedReader(const File &file, int bufferSize) {
+  impl = AllocBufferedReaderImpl(bufferSize);
+  if (!impl)
+    return;
+
+  void *mem = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(File));
+  if (!mem)
+    return;
+  impl->file = new (mem) File(file);
+  impl->fileImpl = impl->file->impl;
+}
+
+BufferedReader::BufferedReader(const Subprocess &process, int bufferSize) {
+  impl = AllocBufferedReaderImpl(bufferSize);
+  if (!impl)
+    return;
+
+  void *mem =
+      HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(Subprocess));
+  if (!mem)
+    return;
+  impl->process = new (mem) Subprocess(process);
+  impl->processImpl = impl->process->impl;
+}
+
+BufferedReader::BufferedReader(const BufferedReader &other) {
+  impl = other.impl;
+  if (impl)
+    InterlockedIncrement(&impl->refCount);
+}
+
+BufferedReader::~BufferedReader() {
+  if (impl && InterlockedDecrement(&impl->refCount) == 0)
+    FreeBufferedReaderImpl(impl);
+}
+
+BufferedReader &BufferedReader::operator=(const BufferedReader &other) {
+  if (this != &other) {
+    if (impl && InterlockedDecrement(&impl->refCount) == 0)
+      FreeBufferedReaderImpl(impl);
+    impl = other.impl;
+    if (impl)
+      InterlockedIncrement(&impl->refCount);
+  }
+  return *this;
+}
+
+String BufferedReader::readLine() {
+  if (!impl)
+    return String();
+
+  WriteLockGuard guard(&impl->lock);
+  const unsigned char *line;
+  int length;
+  if (!TakeLine(impl, &line, &length))
+    return String();
+  return String::FromCStr((const char *)line, length);
+}
+
+String BufferedReader::readUntil(const String &delimiter) {
+  if (!impl)
+    return String();
+
+  const unsigned char *needle = (const unsigned char *)delimiter.c_str();
+  int needleLen = delimiter.byteLength();
+
+  WriteLockGuard guard(&impl->lock);
+  int scanned = 0;
+  for (;;) {
+    int pending = impl->end - impl->start;
+    int hit = FindBytes(impl->buf + impl->start + scanned, pending - scanned,
+                        needle, needleLen);
+    if (hit >= 0) {
+      const char *record = (const char *)(impl->buf + impl->start);
+      int length = scanned + hit;
+      impl->start += length + needleLen;
+      return String::FromCStr(record, length);
+    }
+    // The delimiter may straddle what is buffered and what comes next.
+    if (pending - needleLen + 1 > scanned)
+      scanned = pending - needleLen + 1;
+    if (!FillBuffer(impl))
+      break;
+  }
+
+  const char *rest = (const char *)(impl->buf + impl->start);
+  int length = impl->end - impl->start;
+  impl->start = impl->end;
+  return String::FromCStr(rest, length);
+}
+
+Buffer BufferedReader::readExact(int count) {
+  if (!impl || count <= 0)
+    return Buffer();
+
+  Buffer result(count);
+  if (!result.impl || !result.impl->data)
+    return Buffer();
+
+  WriteLockGuard guard(&impl->lock);
+  unsigned char *dest = result.impl->data;
+
+  int fromBuffer = impl->end - impl->start;
+  if (fromBuffer > count)
+    fromBuffer = count;
+  for (int i = 0; i < fromBuffer; i++)
+    dest[i] = impl->buf[impl->start + i];
+  impl->start += fromBuffer;
+
+  // Large remainders go straight into the result instead of through the
+  // buffer.
+  int total = fromBuffer;
+  while (total < count && !impl->eof) {
+    int want = count - total;
+    if (want >= impl->capacity) {
+      int bytesRead = ReadSource(impl, dest + total, want);
+      if (bytesRead <= 0) {
+        impl->eof = true;
+        break;
+      }
+      total += bytesRead;
+    } else {
+      if (!FillBuffer(impl))
+        break;
+      int available = impl->end - impl->start;
+      int take = available < want ? available : want;
+      for (int i = 0; i < take; i++)
+        dest[total + i] = impl->buf[impl->start + i];
+      impl->start += take;
+      total += take;
+    }
+  }
+
+  result.impl->size = total;
+  return result;
+}
+
+int BufferedReader::forEachLine(bool (*callback)(const char *line, int length,
+                                                 void *arg),
+                                void *arg) {
+  if (!impl || !callback)
+    return 0;
+
+  WriteLockGuard guard(&impl->lock);
+  int count = 0;
+  const unsigned char *line;
+  int length;
+  while (TakeLine(impl, &line, &length)) {
+    count++;
+    if (!callback((const char *)line, length, arg))
+      break;
+  }
+  return count;
+}
+
+bool BufferedReader::isAtEnd() {
+  if (!impl)
+    return true;
+
+  WriteLockGuard guard(&impl->lock);
+  if (impl->start < impl->end)
+    return false;
+  return !FillBuffer(impl);
+}
+
+int BufferedReader::bufferedCount() const {
+  if (!impl)
+    return 0;
+
+  ReadLockGuard guard(&impl->lock);
+  return impl->end - impl->start;
+}
+
+} // namespace attoboy
@@ -0,0 +1,27 @@
+#pragma once
+#include "attofile_internal.h"
+#include "attosubprocess_internal.h"
+#include "attobuffer_internal.h"
+#include <new>
+
+namespace attoboy {
+
+static const int BUFFERED_READER_MIN_SIZE = 4096;
+
+// Unconsumed bytes are buf[start, end). The owning File or Subprocess copy
+// keeps the source alive; fileImpl/processImpl point into it.
+struct BufferedReaderImpl {
+  File *file;
+  Subprocess *process;
+  FileImpl *fileImpl;
+  SubprocessImpl *processImpl;
+  unsigned char *buf;
+  int capacity;
+  int start;
+  int end;
+  bool eof;
+  SRWLOCK lock;
+  volatile LONG refCount;
+};
+
+} // namespace attoboy
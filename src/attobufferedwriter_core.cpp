@@ -0,0 +1,278 @@
+#include "attobufferedwriter_internal.h"
+
+namespace attoboy {
+
+// Hands the active buffer to the destination: written inline in foreground
+// mode, queued for the worker (after it finishes the previous one) in
+// background mode. Caller holds the exclusive lock.
+static bool SubmitActiveBuffer(BufferedWriterImpl *impl) {
+  if (impl->used == 0)
+    return !impl->failed;
+
+  if (!impl->background) {
+    if (!impl->sink(impl->sinkContext, impl->buffers[impl->active],
+                    impl->used))
+      impl->failed = true;
+    impl->used = 0;
+    return !impl->failed;
+  }
+
+  while (impl->pendingLen > 0 && !impl->failed)
+    SleepConditionVariableSRW(&impl->changed, &impl->lock, INFINITE, 0);
+  if (impl->failed)
+    return false;
+
+  impl->pending = impl->buffers[impl->active];
+  impl->pendingLen = impl->used;
+  impl->active ^= 1;
+  impl->used = 0;
+  WakeAllConditionVariable(&impl->changed);
+  return true;
+}
+
+static DWORD WINAPI WriterThreadProc(LPVOID param) {
+  BufferedWriterImpl *impl = (BufferedWriterImpl *)param;
+  AcquireSRWLockExclusive(&impl->lock);
+  for (;;) {
+    if (impl->pendingLen > 0) {
+      const unsigned char *data = impl->pending;
+      int len = impl->pendingLen;
+
+      // Write without the lock so callers can keep filling the other buffer.
+      ReleaseSRWLockExclusive(&impl->lock);
+      bool ok = impl->sink(impl->sinkContext, data, len);
+      AcquireSRWLockExclusive(&impl->lock);
+
+      if (!ok)
+        impl->failed = true;
+      impl->pending = nullptr;
+      impl->pendingLen = 0;
+      WakeAllConditionVariable(&impl->changed);
+      continue;
+    }
+    if (impl->stopping)
+      break;
+
+    DWORD timeout =
+        impl->flushIntervalMs > 0 ? (DWORD)impl->flushIntervalMs : INFINITE;
+    if (!SleepConditionVariableSRW(&impl->changed, &impl->lock, timeout, 0) &&
+        impl->used > 0 && !impl->stopping) {
+      // Idle for a full interval with data waiting: write it out.
+      impl->pending = impl->buffers[impl->active];
+      impl->pendingLen = impl->used;
+      impl->active ^= 1;
+      impl->used = 0;
+    }
+  }
+  ReleaseSRWLockExclusive(&impl->lock);
+  return 0;
+}
+
+BufferedWriterImpl *AllocBufferedWriterImpl(WriterSink sink, void *context,
+                                            int bufferSize, bool background,
+                                            int flushIntervalMs) {
+  BufferedWriterImpl *impl = (BufferedWriterImpl *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(BufferedWriterImpl));
+  if (!impl)
+    return nullptr;
+  InitializeSRWLock(&impl->lock);
+  InitializeConditionVariable(&impl->changed);
+  impl->refCount = 1;
+  impl->sink = sink;
+  impl->sinkContext = context;
+  impl->flushIntervalMs = flushIntervalMs;
+
+  if (bufferSize < BUFFERED_WRITER_MIN_SIZE)
+    bufferSize = BUFFERED_WRITER_MIN_SIZE;
+  impl->capacity = bufferSize;
+  int bufferCount = background ? 2 : 1;
+  for (int i = 0; i < bufferCount; i++) {
+    impl->buffers[i] =
+        (unsigned char *)HeapAlloc(GetProcessHeap(), 0, bufferSize);
+    if (!impl->buffers[i]) {
+      FreeBufferedWriterImpl(impl);
+      return nullptr;
+    }
+  }
+
+  if (background) {
+    impl->background = true;
+    impl->thread = CreateThread(nullptr, 0, WriterThreadProc, impl, 0, nullptr);
+    if (!impl->thread)
+      impl->background = false;
+  }
+  return impl;
+}
+
+bool BufferedWriterAppend(BufferedWriterImpl *impl, const unsigned char *data,
+                          int len) {
+  WriteLockGuard guard(&impl->lock);
+  if (impl->failed)
+    return false;
+
+  // A large write with nothing buffered skips the copy in foreground mode.
+  if (!impl->background && impl->used == 0 && len >= impl->capacity) {
+    if (!impl->sink(impl->sinkContext, data, len))
+      impl->failed = true;
+    return !impl->failed;
+  }
+
+  while (len > 0) {
+    int room = impl->capacity - impl->used;
+    int n = len < room ? len : room;
+    CopyMemory(impl->buffers[impl->active] + impl->used, data, n);
+    impl->used += n;
+    data += n;
+    len -= n;
+    if (impl->used == impl->capacity && !SubmitActiveBuffer(impl))
+      return false;
+  }
+  return true;
+}
+
+bool BufferedWriterFlush(BufferedWriterImpl *impl) {
+  WriteLockGuard guard(&impl->lock);
+  if (!SubmitActiveBuffer(impl))
+    return false;
+  while (impl->pendingLen > 0)
+    SleepConditionVariableSRW(&impl->changed, &impl->lock, INFINITE, 0);
+  return !impl->failed;
+}
+
+void FreeBufferedWriterImpl(BufferedWriterImpl *impl) {
+  if (impl->buffers[0])
+    BufferedWriterFlush(impl);
+
+  if (impl->thread) {
+    {
+      WriteLockGuard guard(&impl->lock);
+      impl->stopping = true;
+      WakeAllConditionVariable(&impl->changed);
+    }
+    WaitForSingleObject(impl->thread, INFINITE);
+    CloseHandle(impl->thread);
+  }
+
+  for (int i = 0; i < 2; i++) {
+    if (impl->buffers[i])
+      HeapFree(GetProcessHeap(), 0, impl->buffers[i]);
+  }
+  HeapFree(GetProcessHeap(), 0, impl);
+}
+
+static bool FileSink(void *context, const unsigned char *data, int len) {
+  FileImpl *file = (FileImpl *)context;
+  if (!file)
+    return false;
+  WriteLockGuard guard(&file->lock);
+  if (!file->isOpen || !file->isValid)
+    return false;
+  return WriteFileImplAll(file, data, len);
+}
+
+static void ReleaseBufferedWriter(BufferedWriterImpl *impl) {
+  File *file = impl->file;
+  FreeBufferedWriterImpl(impl);
+  if (file) {
+    file->~File();
+    HeapFree(GetProcessHeap(), 0, file);
+  }
+}
+
+BufferedWriter::BufferedWriter(const File &file, int bufferSize,
+                               bool background) {
+  impl = nullptr;
+  void *mem = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(File));
+  if (!mem)
+    return;
+  File *copy = new (mem) File(file);
+
+  impl = AllocBufferedWriterImpl(FileSink, copy->impl, bufferSize, background,
+                                 0);
+  if (!impl) {
+    copy->~File();
+    HeapFree(GetProcessHeap(), 0, mem);
+    return;
+  }
+  impl->file = copy;
+  impl->fileImpl = copy->impl;
+}
+
+BufferedWriter::BufferedWriter(const BufferedWriter &other) {
+  impl = other.impl;
+  if (impl)
+    InterlockedIncrement(&impl->refCount);
+}
+
+BufferedWriter::~BufferedWriter() {
+  if (impl && InterlockedDecrement(&impl->refCount) == 0)
+    ReleaseBufferedWriter(impl);
+}
+
+BufferedWriter &BufferedWriter::operator=(const BufferedWriter &other) {
+  if (this != &other) {
+    if (impl && InterlockedDecrement(&impl->refCount) == 0)
+      ReleaseBufferedWriter(impl);
+    impl = other.impl;
+    if (impl)
+      InterlockedIncrement(&impl->refCount);
+  }
+  return *this;
+}
+
+int BufferedWriter::write(const Buffer &buf) {
+  int len = 0;
+  const unsigned char *data = buf.c_ptr(&len);
+  return write(data, len);
+}
+
+int BufferedWriter::write(const String &str) {
+  return write((const unsigned char *)str.c_str(), str.byteLength());
+}
+
+int BufferedWriter::write(const unsigned char *ptr, int size) {
+  if (!impl)
+    return -1;
+  if (!ptr || size <= 0)
+    return 0;
+  return BufferedWriterAppend(impl, ptr, size) ? size : -1;
+}
+
+bool BufferedWriter::flush() {
+  if (!impl || !BufferedWriterFlush(impl))
+    return false;
+
+  FileImpl *file = impl->fileImpl;
+  if (file) {
+    WriteLockGuard guard(&file->lock);
+    if (file->type == FILE_TYPE_REGULAR)
+      FlushFileBuffers(file->handle);
+  }
+  return true;
+}
+
+int BufferedWriter::bufferedCount() const {
+  if (!impl)
+    return 0;
+
+  ReadLockGuard guard(&impl->lock);
+  return impl->used + impl->pendingLen;
+}
+
+bool BufferedWriter::isBackground() const {
+  if (!impl)
+    return false;
+
+  ReadLockGuard guard(&impl->lock);
+  return impl->background;
+}
+
+bool BufferedWriter::failed() const {
+  if (!impl)
+    return true;
+
+  ReadLockGuard guard(&impl->lock);
+  return impl->failed;
+}
+
+} // namespace attoboy
@@ -0,0 +1,55 @@
+#pragma once
+#include "attofile_internal.h"
+#include <new>
+
+namespace attoboy {
+
+static const int BUFFERED_WRITER_MIN_SIZE = 4096;
+
+/// Writes all len bytes to the writer's destination. Returns false on error.
+typedef bool (*WriterSink)(void *context, const unsigned char *data, int len);
+
+// Callers append to buffers[active]. In background mode a full buffer is
+// handed to the worker thread as pending while callers switch to the other
+// buffer; `changed` is signalled whenever pending, used or stopping change.
+// BufferedWriter sets file/fileImpl; the logger uses the engine without a
+// File.
+struct BufferedWriterImpl {
+  WriterSink sink;
+  void *sinkContext;
+  File *file;
+  FileImpl *fileImpl;
+  unsigned char *buffers[2];
+  int capacity;
+  int active;
+  int used;
+  const unsigned char *pending;
+  int pendingLen;
+  bool background;
+  bool stopping;
+  bool failed;
+  int flushIntervalMs;
+  HANDLE thread;
+  CONDITION_VARIABLE changed;
+  SRWLOCK lock;
+  volatile LONG refCount;
+};
+
+/// Creates a writer engine. In background mode a worker thread writes full
+/// buffers; if flushIntervalMs > 0 it also writes partial buffers that have
+/// sat idle that long. Returns nullptr on allocation failure.
+BufferedWriterImpl *AllocBufferedWriterImpl(WriterSink sink, void *context,
+                                            int bufferSize, bool background,
+                                            int flushIntervalMs);
+/// Appends len bytes, writing out buffers as they fill. Returns false if a
+/// write has failed.
+bool BufferedWriterAppend(BufferedWriterImpl *impl, const unsigned char *data,
+                          int len);
+/// Writes out everything appended so far and waits for it to complete.
+/// Returns false if a write has failed.
+bool BufferedWriterFlush(BufferedWriterImpl *impl);
+/// Flushes, stops the worker thread and frees the engine. Does not touch
+/// impl->file.
+void FreeBufferedWriterImpl(BufferedWriterImpl *impl);
+
+} // namespace attoboy
@@ -0,0 +1,232 @@
+#include "attobufferview_internal.h"
+
+namespace attoboy {
+
+static BufferViewImpl *AllocBufferViewImpl() {
+  BufferViewImpl *impl = (BufferViewImpl *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(BufferViewImpl));
+  if (impl)
+    InitializeSRWLock(&impl->lock);
+  return impl;
+}
+
+static void AssignBufferView(BufferViewImpl *impl, const BufferViewImpl *src) {
+  RetainBufferStorage(src->storage);
+  ReleaseBufferStorage(impl->storage);
+  impl->storage = src->storage;
+  impl->data = src->data;
+  impl->size = src->size;
+  impl->pos = src->pos;
+  impl->failed = src->failed;
+}
+
+// Returns a pointer to the next count bytes and advances past them, or
+// nullptr (setting the failed flag) if fewer remain. Caller holds the lock.
+static const unsigned char *TakeBytes(BufferViewImpl *impl, int count) {
+  if (count < 0 || impl->size - impl->pos < count) {
+    impl->failed = true;
+    return nullptr;
+  }
+  const unsigned char *p = impl->data + impl->pos;
+  impl->pos += count;
+  return p;
+}
+
+BufferView::BufferView(const Buffer &buf) {
+  impl = AllocBufferViewImpl();
+  if (!impl || !buf.impl)
+    return;
+
+  ReadLockGuard guard(&buf.impl->lock);
+  RetainBufferStorage(buf.impl->storage);
+  impl->storage = buf.impl->storage;
+  impl->data = buf.impl->storage ? buf.impl->data : nullptr;
+  impl->size = buf.impl->storage ? buf.impl->size : 0;
+}
+
+BufferView::BufferView(const BufferView &other) {
+  impl = AllocBufferViewImpl();
+  if (!impl || !other.impl)
+    return;
+
+  ReadLockGuard guard(&other.impl->lock);
+  AssignBufferView(impl, other.impl);
+}
+
+BufferView::~BufferView() {
+  if (impl) {
+    ReleaseBufferStorage(impl->storage);
+    HeapFree(GetProcessHeap(), 0, impl);
+  }
+}
+
+BufferView &BufferView::operator=(const BufferView &other) {
+  if (this == &other || !impl || !other.impl)
+    return *this;
+
+  WriteLockGuard guard(&impl->lock);
+  ReadLockGuard otherGuard(&other.impl->lock);
+  AssignBufferView(impl, other.impl);
+  return *this;
+}
+
+int BufferView::length() const {
+  if (!impl)
+    return 0;
+  ReadLockGuard guard(&impl->lock);
+  return impl->size;
+}
+
+int BufferView::getPosition() const {
+  if (!impl)
+    return 0;
+  ReadLockGuard guard(&impl->lock);
+  return impl->pos;
+}
+
+bool BufferView::setPosition(int pos) {
+  if (!impl)
+    return false;
+  WriteLockGuard guard(&impl->lock);
+  if (pos < 0 || pos > impl->size)
+    return false;
+  impl->pos = pos;
+  return true;
+}
+
+int BufferView::remaining() const {
+  if (!impl)
+    return 0;
+  ReadLockGuard guard(&impl->lock);
+  return impl->size - impl->pos;
+}
+
+bool BufferView::isAtEnd() const {
+  if (!impl)
+    return true;
+  ReadLockGuard guard(&impl->lock);
+  return impl->pos >= impl->size;
+}
+
+bool BufferView::failed() const {
+  if (!impl)
+    return true;
+  ReadLockGuard guard(&impl->lock);
+  return impl->failed;
+}
+
+bool BufferView::skip(int count) {
+  if (!impl)
+    return false;
+  WriteLockGuard guard(&impl->lock);
+  return TakeBytes(impl, count) != nullptr;
+}
+
+int BufferView::readU8() {
+  if (!impl)
+    return 0;
+  WriteLockGuard guard(&impl->lock);
+  const unsigned char *p = TakeBytes(impl, 1);
+  return p ? p[0] : 0;
+}
+
+int BufferView::readU16LE() {
+  if (!impl)
+    return 0;
+  WriteLockGuard guard(&impl->lock);
+  const unsigned char *p = TakeBytes(impl, 2);
+  return p ? (p[0] | (p[1] << 8)) : 0;
+}
+
+int BufferView::readU16BE() {
+  if (!impl)
+    return 0;
+  WriteLockGuard guard(&impl->lock);
+  const unsigned char *p = TakeBytes(impl, 2);
+  return p ? ((p[0] << 8) | p[1]) : 0;
+}
+
+unsigned int BufferView::readU32LE() {
+  if (!impl)
+    return 0;
+  WriteLockGuard guard(&impl->lock);
+  const unsigned char *p = TakeBytes(impl, 4);
+  if (!p)
+    return 0;
+  return (unsigned int)p[0] | ((unsigned int)p[1] << 8) |
+         ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+unsigned int BufferView::readU32BE() {
+  if (!impl)
+    return 0;
+  WriteLockGuard guard(&impl->lock);
+  const unsigned char *p = TakeBytes(impl, 4);
+  if (!p)
+    return 0;
+  return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) |
+         ((unsigned int)p[2] << 8) | (unsigned int)p[3];
+}
+
+long long BufferView::readU64LE() {
+  if (!impl)
+    return 0;
+  WriteLockGuard guard(&impl->lock);
+  const unsigned char *p = TakeBytes(impl, 8);
+  if (!p)
+    return 0;
+  unsigned int lo = (unsigned int)p[0] | ((unsigned int)p[1] << 8) |
+                    ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+  unsigned int hi = (unsigned int)p[4] | ((unsigned int)p[5] << 8) |
+                    ((unsigned int)p[6] << 16) | ((unsigned int)p[7] << 24);
+  return (long long)(((unsigned long long)hi << 32) | lo);
+}
+
+long long BufferView::readU64BE() {
+  if (!impl)
+    return 0;
+  WriteLockGuard guard(&impl->lock);
+  const unsigned char *p = TakeBytes(impl, 8);
+  if (!p)
+    return 0;
+  unsigned int hi = ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) |
+                    ((unsigned int)p[2] << 8) | (unsigned int)p[3];
+  unsigned int lo = ((unsigned int)p[4] << 24) | ((unsigned int)p[5] << 16) |
+                    ((unsigned int)p[6] << 8) | (unsigned int)p[7];
+  return (long long)(((unsigned long long)hi << 32) | lo);
+}
+
+float BufferView::readF32LE() {
+  unsigned int bits = readU32LE();
+  float result;
+  const char *src = reinterpret_cast<const char *>(&bits);
+  char *dst = reinterpret_cast<char *>(&result);
+  for (int i = 0; i < 4; i++)
+    dst[i] = src[i];
+  return result;
+}
+
+Buffer BufferView::readBytes(int count) {
+  Buffer result;
+  if (!impl || !result.impl)
+    return result;
+
+  WriteLockGuard guard(&impl->lock);
+  unsigned char *p = (unsigned char *)TakeBytes(impl, count);
+  if (p && count > 0)
+    ShareBufferStorage(result.impl, impl->storage, p, count);
+  return result;
+}
+
+String BufferView::readString(int count) {
+  if (!impl)
+    return String();
+
+  WriteLockGuard guard(&impl->lock);
+  const unsigned char *p = TakeBytes(impl, count);
+  if (!p || count == 0)
+    return String();
+  return String::FromCStr((const char *)p, count);
+}
+
+} // namespace attoboy
@@ -0,0 +1,18 @@
+#pragma once
+#include "atto_internal_common.h"
+#include "attobuffer_internal.h"
+#include "attoboy/attoboy.h"
+#include <windows.h>
+
+namespace attoboy {
+
+struct BufferViewImpl {
+  BufferStorage *storage;
+  unsigned char *data;
+  int size;
+  int pos;
+  bool failed;
+  mutable SRWLOCK lock;
+};
+
+} // namespace attoboy
@@ -0,0 +1,158 @@
+#include "attodatagram_internal.h"
+
+namespace attoboy {
+
+// Replaces the ring with count slots of slotSize bytes. The caller must hold
+// impl->lock.
+static bool AllocDatagramRing(DatagramImpl *impl, int count, int slotSize) {
+  unsigned char *ring = (unsigned char *)HeapAlloc(
+      GetProcessHeap(), 0, (SIZE_T)count * (SIZE_T)slotSize);
+  DatagramSlot *slots = (DatagramSlot *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, count * sizeof(DatagramSlot));
+  if (!ring || !slots) {
+    if (ring)
+      HeapFree(GetProcessHeap(), 0, ring);
+    if (slots)
+      HeapFree(GetProcessHeap(), 0, slots);
+    return false;
+  }
+
+  if (impl->ring)
+    HeapFree(GetProcessHeap(), 0, impl->ring);
+  if (impl->slots)
+    HeapFree(GetProcessHeap(), 0, impl->slots);
+  impl->ring = ring;
+  impl->slots = slots;
+  impl->slotCount = count;
+  impl->slotSize = slotSize;
+  impl->batchStart = 0;
+  impl->batchCount = 0;
+  impl->ringNext = 0;
+  return true;
+}
+
+// Takes queued datagrams into the ring, from ringNext on, until none is
+// waiting or limit are taken. Returns the number taken, or -1 if the first
+// receive failed. The caller must hold impl->lock.
+static int DrainDatagrams(DatagramImpl *impl, int limit) {
+  impl->batchStart = impl->ringNext;
+  impl->batchCount = 0;
+  while (impl->batchCount < limit) {
+    int slot = (impl->batchStart + impl->batchCount) % impl->slotCount;
+    int length = ReceiveDatagram(
+        impl->sock, impl->ring + (SIZE_T)slot * impl->slotSize,
+        impl->slotSize, &impl->slots[slot].from);
+    if (length == DATAGRAM_NONE_WAITING)
+      break;
+    if (length == DATAGRAM_FAILED) {
+      if (impl->batchCount == 0)
+        return -1;
+      break;
+    }
+    impl->slots[slot].length = length;
+    impl->batchCount++;
+  }
+  impl->ringNext = (impl->batchStart + impl->batchCount) % impl->slotCount;
+  return impl->batchCount;
+}
+
+// Returns the ring slot of the index-th packet of the last batch, or -1.
+// The caller must hold impl->lock.
+static int BatchSlot(const DatagramImpl *impl, int index) {
+  if (index < 0 || index >= impl->batchCount)
+    return -1;
+  return (impl->batchStart + index) % impl->slotCount;
+}
+
+bool Datagram::setReceiveRing(int count, int slotSize) {
+  if (!impl || count <= 0 || slotSize <= 0)
+    return false;
+  if (slotSize > DATAGRAM_MAX_PAYLOAD)
+    slotSize = DATAGRAM_MAX_PAYLOAD;
+  WriteLockGuard lock(&impl->lock);
+  return AllocDatagramRing(impl, count, slotSize);
+}
+
+int Datagram::receiveBatch(int maxCount, int timeoutMs) {
+  if (!impl)
+    return -1;
+  if (maxCount == 0)
+    return 0;
+
+  // Drain first: under load datagrams are already queued and no wait is
+  // needed. The wait itself happens without the lock so sends on other
+  // threads are not held up.
+  bool waited = false;
+  while (true) {
+    SOCKET sock;
+    {
+      WriteLockGuard lock(&impl->lock);
+      if (impl->sock == INVALID_SOCKET)
+        return -1;
+      if (!impl->ring &&
+          !AllocDatagramRing(impl, DATAGRAM_DEFAULT_SLOTS,
+                             DATAGRAM_DEFAULT_SLOT_SIZE))
+        return -1;
+      int limit = maxCount < 0 || maxCount > impl->slotCount ? impl->slotCount
+                                                             : maxCount;
+      int received = DrainDatagrams(impl, limit);
+      if (received != 0)
+        return received;
+      if (impl->nonBlocking || timeoutMs == 0 || (waited && timeoutMs > 0))
+        return 0;
+      sock = impl->sock;
+    }
+
+    int ready = WaitDatagramReady(sock, timeoutMs);
+    if (ready <= 0)
+      return ready;
+    waited = true;
+  }
+}
+
+const unsigned char *Datagram::packetData(int index, int *length) const {
+  if (length)
+    *length = 0;
+  if (!impl)
+    return nullptr;
+  ReadLockGuard lock(&impl->lock);
+  int slot = BatchSlot(impl, index);
+  if (slot < 0)
+    return nullptr;
+  if (length)
+    *length = impl->slots[slot].length;
+  return impl->ring + (SIZE_T)slot * impl->slotSize;
+}
+
+Buffer Datagram::packet(int index) const {
+  if (!impl)
+    return Buffer();
+  ReadLockGuard lock(&impl->lock);
+  int slot = BatchSlot(impl, index);
+  if (slot < 0 || impl->slots[slot].length == 0)
+    return Buffer();
+  return Buffer(impl->ring + (SIZE_T)slot * impl->slotSize,
+                impl->slots[slot].length);
+}
+
+String Datagram::packetHost(int index) const {
+  if (!impl)
+    return String();
+  ReadLockGuard lock(&impl->lock);
+  int slot = BatchSlot(impl, index);
+  if (slot < 0)
+    return String();
+  return DatagramAddressString(&impl->slots[slot].from);
+}
+
+int Datagram::packetPort(int index) const {
+  if (!impl)
+    return -1;
+  ReadLockGuard lock(&impl->lock);
+  int slot = BatchSlot(impl, index);
+  if (slot < 0)
+    return -1;
+  return ntohs(impl->slots[slot].from.sin_port);
+}
+
+} // namespace attoboy
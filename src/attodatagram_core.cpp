@@ -0,0 +1,389 @@
+#include "attodatagram_internal.h"
+#include "attobufferchain_internal.h"
+#include <mstcpip.h>
+
+#ifndef SIO_UDP_CONNRESET
+#define SIO_UDP_CONNRESET _WSAIOW(IOC_VENDOR, 12)
+#endif
+
+namespace attoboy {
+
+static bool ParseIPv4(const char *text, struct in_addr *addr) {
+  return text && inet_pton(AF_INET, text, addr) == 1;
+}
+
+static void FreeDatagramImpl(DatagramImpl *impl) {
+  if (!impl)
+    return;
+  if (impl->sock != INVALID_SOCKET)
+    closesocket(impl->sock);
+  if (impl->ring)
+    HeapFree(GetProcessHeap(), 0, impl->ring);
+  if (impl->slots)
+    HeapFree(GetProcessHeap(), 0, impl->slots);
+  FreeFileStr(impl->lastHost);
+  HeapFree(GetProcessHeap(), 0, impl);
+}
+
+// Creates the socket and binds it to address:port (nullptr = any address).
+// Leaves impl->sock INVALID_SOCKET on failure.
+static void OpenDatagramSocket(DatagramImpl *impl, const char *address,
+                               int port) {
+  if (port < 0 || port > 65535 || !InitWinsock())
+    return;
+
+  struct sockaddr_in addr;
+  ZeroMemory(&addr, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons((u_short)port);
+  addr.sin_addr.s_addr = INADDR_ANY;
+  if (address && !ParseIPv4(address, &addr.sin_addr))
+    return;
+
+  SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock == INVALID_SOCKET)
+    return;
+
+  // Without this, an ICMP "port unreachable" for an earlier send fails the
+  // next receive with WSAECONNRESET.
+  BOOL reportReset = FALSE;
+  DWORD bytes = 0;
+  WSAIoctl(sock, SIO_UDP_CONNRESET, &reportReset, sizeof(reportReset),
+           nullptr, 0, &bytes, nullptr, nullptr);
+
+  u_long nonBlocking = 1;
+  if (ioctlsocket(sock, FIONBIO, &nonBlocking) == SOCKET_ERROR ||
+      bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR) {
+    closesocket(sock);
+    return;
+  }
+
+  struct sockaddr_in bound;
+  int boundLen = sizeof(bound);
+  impl->port = port;
+  if (getsockname(sock, (struct sockaddr *)&bound, &boundLen) == 0)
+    impl->port = ntohs(bound.sin_port);
+  impl->sock = sock;
+}
+
+static DatagramImpl *NewDatagramImpl(const char *address, int port) {
+  DatagramImpl *impl = (DatagramImpl *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(DatagramImpl));
+  if (!impl)
+    return nullptr;
+  InitializeSRWLock(&impl->lock);
+  impl->sock = INVALID_SOCKET;
+  impl->port = -1;
+  impl->lastPort = -1;
+  impl->refCount = 1;
+  OpenDatagramSocket(impl, address, port);
+  return impl;
+}
+
+Datagram::Datagram(int port) { impl = NewDatagramImpl(nullptr, port); }
+
+Datagram::Datagram(const String &address, int port) {
+  impl = NewDatagramImpl(address.c_str(), port);
+}
+
+Datagram::Datagram(const Datagram &other) {
+  impl = other.impl;
+  if (impl)
+    InterlockedIncrement(&impl->refCount);
+}
+
+Datagram::~Datagram() {
+  if (impl && InterlockedDecrement(&impl->refCount) == 0)
+    FreeDatagramImpl(impl);
+}
+
+Datagram &Datagram::operator=(const Datagram &other) {
+  if (this != &other) {
+    if (impl && InterlockedDecrement(&impl->refCount) == 0)
+      FreeDatagramImpl(impl);
+    impl = other.impl;
+    if (impl)
+      InterlockedIncrement(&impl->refCount);
+  }
+  return *this;
+}
+
+bool Datagram::isValid() const {
+  if (!impl)
+    return false;
+  ReadLockGuard lock(&impl->lock);
+  return impl->sock != INVALID_SOCKET;
+}
+
+int Datagram::getPort() const {
+  if (!impl)
+    return -1;
+  ReadLockGuard lock(&impl->lock);
+  return impl->sock != INVALID_SOCKET ? impl->port : -1;
+}
+
+void Datagram::close() {
+  if (!impl)
+    return;
+  WriteLockGuard lock(&impl->lock);
+  if (impl->sock != INVALID_SOCKET) {
+    closesocket(impl->sock);
+    impl->sock = INVALID_SOCKET;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Sending
+//------------------------------------------------------------------------------
+
+// Resolves host:port into dest, reusing the previous lookup when the
+// destination has not changed. Returns the socket, or INVALID_SOCKET if the
+// socket is closed or host does not resolve.
+static SOCKET ResolveDatagramTarget(DatagramImpl *impl, const String &host,
+                                    int port, struct sockaddr_in *dest,
+                                    bool *nonBlocking) {
+  const char *hostCStr = host.c_str();
+  if (!hostCStr || port < 0 || port > 65535)
+    return INVALID_SOCKET;
+
+  WriteLockGuard lock(&impl->lock);
+  if (impl->sock == INVALID_SOCKET)
+    return INVALID_SOCKET;
+  *nonBlocking = impl->nonBlocking;
+
+  if (impl->lastHost && impl->lastPort == port &&
+      lstrcmpA(impl->lastHost, hostCStr) == 0) {
+    *dest = impl->lastAddr;
+    return impl->sock;
+  }
+
+  ZeroMemory(dest, sizeof(*dest));
+  dest->sin_family = AF_INET;
+  dest->sin_port = htons((u_short)port);
+  if (!ParseIPv4(hostCStr, &dest->sin_addr)) {
+    struct addrinfo hints, *result = nullptr;
+    ZeroMemory(&hints, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_protocol = IPPROTO_UDP;
+    if (getaddrinfo(hostCStr, nullptr, &hints, &result) != 0 || !result)
+      return INVALID_SOCKET;
+    dest->sin_addr = ((struct sockaddr_in *)result->ai_addr)->sin_addr;
+    freeaddrinfo(result);
+  }
+
+  ATTO_LPSTR copy = AllocFileStr(ATTO_LSTRLEN(hostCStr));
+  if (copy) {
+    ATTO_LSTRCPY(copy, hostCStr);
+    FreeFileStr(impl->lastHost);
+    impl->lastHost = copy;
+    impl->lastPort = port;
+    impl->lastAddr = *dest;
+  }
+  return impl->sock;
+}
+
+// Sends one datagram, waiting for room unless nonBlocking. Returns bytes
+// sent, 0 if a non-blocking socket would block, or -1 on error.
+static int SendDatagram(SOCKET sock, const struct sockaddr_in *dest,
+                        const unsigned char *data, int len, bool nonBlocking) {
+  while (true) {
+    int sent = sendto(sock, (const char *)data, len, 0,
+                      (const struct sockaddr *)dest, sizeof(*dest));
+    if (sent != SOCKET_ERROR)
+      return sent;
+    if (WSAGetLastError() != WSAEWOULDBLOCK)
+      return -1;
+    if (nonBlocking)
+      return 0;
+    if (WaitDatagramReady(sock, -1, true) < 0)
+      return -1;
+  }
+}
+
+int Datagram::sendTo(const String &host, int port, const Buffer &data) {
+  if (!impl)
+    return -1;
+  struct sockaddr_in dest;
+  bool nonBlocking = false;
+  SOCKET sock = ResolveDatagramTarget(impl, host, port, &dest, &nonBlocking);
+  if (sock == INVALID_SOCKET)
+    return -1;
+  int len = 0;
+  const unsigned char *bytes = data.c_ptr(&len);
+  return SendDatagram(sock, &dest, bytes, len, nonBlocking);
+}
+
+int Datagram::sendTo(const String &host, int port, const String &data) {
+  if (!impl)
+    return -1;
+  struct sockaddr_in dest;
+  bool nonBlocking = false;
+  SOCKET sock = ResolveDatagramTarget(impl, host, port, &dest, &nonBlocking);
+  if (sock == INVALID_SOCKET)
+    return -1;
+  return SendDatagram(sock, &dest, (const unsigned char *)data.c_str(),
+                      data.byteLength(), nonBlocking);
+}
+
+int Datagram::sendBatch(const String &host, int port,
+                        const BufferChain &packets) {
+  if (!impl)
+    return -1;
+  struct sockaddr_in dest;
+  bool nonBlocking = false;
+  SOCKET sock = ResolveDatagramTarget(impl, host, port, &dest, &nonBlocking);
+  if (sock == INVALID_SOCKET)
+    return -1;
+  if (!packets.impl)
+    return 0;
+
+  BufferChainImpl *chainImpl = packets.impl;
+  ReadLockGuard chainLock(&chainImpl->lock);
+  const BufferSegment *segments = chainImpl->segments + chainImpl->start;
+  int sentCount = 0;
+  for (int i = 0; i < chainImpl->count; i++) {
+    int sent = SendDatagram(sock, &dest, segments[i].data, segments[i].size,
+                            nonBlocking);
+    if (sent < 0)
+      return sentCount > 0 ? sentCount : -1;
+    // A non-blocking socket ran out of room.
+    if (sent == 0 && segments[i].size > 0)
+      break;
+    sentCount++;
+  }
+  return sentCount;
+}
+
+//------------------------------------------------------------------------------
+// Receiving one datagram
+//------------------------------------------------------------------------------
+
+Buffer Datagram::receiveFrom(String *host, int *port, int timeoutMs) {
+  if (!impl)
+    return Buffer();
+
+  SOCKET sock;
+  bool nonBlocking;
+  {
+    ReadLockGuard lock(&impl->lock);
+    sock = impl->sock;
+    nonBlocking = impl->nonBlocking;
+  }
+  if (sock == INVALID_SOCKET)
+    return Buffer();
+
+  Buffer result(DATAGRAM_MAX_PAYLOAD);
+  if (!result.impl || !result.impl->data)
+    return Buffer();
+
+  struct sockaddr_in from;
+  int length = ReceiveDatagram(sock, result.impl->data, DATAGRAM_MAX_PAYLOAD,
+                               &from);
+  while (length == DATAGRAM_NONE_WAITING && !nonBlocking) {
+    if (WaitDatagramReady(sock, timeoutMs) <= 0)
+      return Buffer();
+    length = ReceiveDatagram(sock, result.impl->data, DATAGRAM_MAX_PAYLOAD,
+                             &from);
+    if (timeoutMs >= 0)
+      break;
+  }
+  if (length < 0)
+    return Buffer();
+
+  if (host)
+    *host = DatagramAddressString(&from);
+  if (port)
+    *port = ntohs(from.sin_port);
+  result.impl->size = length;
+  // Don't pin a 64 KB allocation behind a small datagram.
+  result.trim();
+  return result;
+}
+
+//------------------------------------------------------------------------------
+// Options
+//------------------------------------------------------------------------------
+
+static bool SetDatagramOption(DatagramImpl *impl, int level, int name,
+                              const void *value, int len) {
+  if (!impl)
+    return false;
+  WriteLockGuard lock(&impl->lock);
+  if (impl->sock == INVALID_SOCKET)
+    return false;
+  return setsockopt(impl->sock, level, name, (const char *)value, len) !=
+         SOCKET_ERROR;
+}
+
+bool Datagram::setNonBlocking(bool enabled) {
+  if (!impl)
+    return false;
+  WriteLockGuard lock(&impl->lock);
+  if (impl->sock == INVALID_SOCKET)
+    return false;
+  impl->nonBlocking = enabled;
+  return true;
+}
+
+bool Datagram::isNonBlocking() const {
+  if (!impl)
+    return false;
+  ReadLockGuard lock(&impl->lock);
+  return impl->nonBlocking;
+}
+
+bool Datagram::setBroadcast(bool enabled) {
+  DWORD value = enabled ? 1 : 0;
+  return SetDatagramOption(impl, SOL_SOCKET, SO_BROADCAST, &value,
+                           sizeof(value));
+}
+
+bool Datagram::setBufferSizes(int receiveBytes, int sendBytes) {
+  bool ok = isValid();
+  if (ok && receiveBytes >= 0) {
+    DWORD value = (DWORD)receiveBytes;
+    ok = SetDatagramOption(impl, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value));
+  }
+  if (ok && sendBytes >= 0) {
+    DWORD value = (DWORD)sendBytes;
+    ok = SetDatagramOption(impl, SOL_SOCKET, SO_SNDBUF, &value, sizeof(value));
+  }
+  return ok;
+}
+
+static bool ChangeMembership(DatagramImpl *impl, const String &group,
+                             const String &interfaceAddress, int option) {
+  struct ip_mreq request;
+  ZeroMemory(&request, sizeof(request));
+  if (!ParseIPv4(group.c_str(), &request.imr_multiaddr))
+    return false;
+  request.imr_interface.s_addr = INADDR_ANY;
+  if (!interfaceAddress.isEmpty() &&
+      !ParseIPv4(interfaceAddress.c_str(), &request.imr_interface))
+    return false;
+  return SetDatagramOption(impl, IPPROTO_IP, option, &request,
+                           sizeof(request));
+}
+
+bool Datagram::joinGroup(const String &group, const String &interfaceAddress) {
+  return ChangeMembership(impl, group, interfaceAddress, IP_ADD_MEMBERSHIP);
+}
+
+bool Datagram::leaveGroup(const String &group,
+                          const String &interfaceAddress) {
+  return ChangeMembership(impl, group, interfaceAddress, IP_DROP_MEMBERSHIP);
+}
+
+bool Datagram::setMulticastOptions(int ttl, bool loopback) {
+  if (ttl < 0 || ttl > 255)
+    return false;
+  DWORD ttlValue = (DWORD)ttl;
+  DWORD loopValue = loopback ? 1 : 0;
+  return SetDatagramOption(impl, IPPROTO_IP, IP_MULTICAST_TTL, &ttlValue,
+                           sizeof(ttlValue)) &&
+         SetDatagramOption(impl, IPPROTO_IP, IP_MULTICAST_LOOP, &loopValue,
+                           sizeof(loopValue));
+}
+
+} // namespace attoboy
@@ -0,0 +1,90 @@
+#pragma once
+#include "attofile_internal.h"
+
+namespace attoboy {
+
+// Default receive ring for receiveBatch: enough slots to drain a burst in
+// one call, each large enough for a typical LAN datagram.
+static const int DATAGRAM_DEFAULT_SLOTS = 64;
+static const int DATAGRAM_DEFAULT_SLOT_SIZE = 2048;
+// Largest UDP payload over IPv4.
+static const int DATAGRAM_MAX_PAYLOAD = 65507;
+
+// One received datagram in the ring. length is the number of bytes kept,
+// which is less than the datagram if it did not fit the slot.
+struct DatagramSlot {
+  int length;
+  struct sockaddr_in from;
+};
+
+// The socket itself is always non-blocking, so a batch can drain the queue
+// without an extra readiness check per datagram; nonBlocking only decides
+// whether calls wait (with WSAPoll) when nothing is ready.
+// ring holds slotCount slots of slotSize bytes. The last receiveBatch()
+// filled batchCount slots starting at batchStart; the next one starts at
+// ringNext, so earlier packets stay readable until the ring wraps.
+// sendTo() keeps the last destination it resolved in lastHost/lastAddr.
+struct DatagramImpl {
+  SOCKET sock;
+  int port;
+  bool nonBlocking;
+
+  unsigned char *ring;
+  DatagramSlot *slots;
+  int slotCount;
+  int slotSize;
+  int batchStart;
+  int batchCount;
+  int ringNext;
+
+  ATTO_LPSTR lastHost;
+  int lastPort;
+  struct sockaddr_in lastAddr;
+
+  SRWLOCK lock;
+  volatile LONG refCount;
+};
+
+/// Waits up to timeoutMs (-1 = forever) for the socket to become readable
+/// (or writable). Returns 1 if ready, 0 on timeout, or -1 on error.
+static inline int WaitDatagramReady(SOCKET sock, int timeoutMs,
+                                    bool writable = false) {
+  WSAPOLLFD fd;
+  fd.fd = sock;
+  fd.events = writable ? POLLWRNORM : POLLRDNORM;
+  fd.revents = 0;
+  int result = WSAPoll(&fd, 1, timeoutMs);
+  if (result == SOCKET_ERROR)
+    return -1;
+  return result > 0 ? 1 : 0;
+}
+
+// ReceiveDatagram results other than a length (datagrams may be empty).
+static const int DATAGRAM_NONE_WAITING = -1;
+static const int DATAGRAM_FAILED = -2;
+
+/// Receives one datagram into dest, storing the sender in from. Returns the
+/// bytes kept (a longer datagram is cut to count), DATAGRAM_NONE_WAITING or
+/// DATAGRAM_FAILED.
+static inline int ReceiveDatagram(SOCKET sock, unsigned char *dest, int count,
+                                  struct sockaddr_in *from) {
+  int fromLen = sizeof(*from);
+  int received = recvfrom(sock, (char *)dest, count, 0,
+                          (struct sockaddr *)from, &fromLen);
+  if (received != SOCKET_ERROR)
+    return received;
+  int error = WSAGetLastError();
+  if (error == WSAEMSGSIZE)
+    return count;
+  return error == WSAEWOULDBLOCK ? DATAGRAM_NONE_WAITING : DATAGRAM_FAILED;
+}
+
+/// Returns the dotted IPv4 address of addr.
+static inline String DatagramAddressString(const struct sockaddr_in *addr) {
+  char text[INET_ADDRSTRLEN];
+  if (!inet_ntop(AF_INET, (void *)&addr->sin_addr, text, sizeof(text)))
+    return String();
+  return String(text);
+}
+
+} // namespace attoboy
@@ -0,0 +1,142 @@
+#include "attofile_internal.h"
+#include "attodigest_internal.h"
+
+namespace attoboy {
+
+static DigestImpl *AllocDigestImpl(DigestAlgorithm algorithm) {
+  DigestImpl *impl = (DigestImpl *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(DigestImpl));
+  if (impl) {
+    InitializeSRWLock(&impl->lock);
+    impl->algorithm =
+        algorithm == DIGEST_BLAKE2S ? DIGEST_BLAKE2S : DIGEST_SHA256;
+    DigestStateInit(impl);
+  }
+  return impl;
+}
+
+static void CopyDigestState(DigestImpl *dest, const DigestImpl *src) {
+  dest->algorithm = src->algorithm;
+  if (src->algorithm == DIGEST_BLAKE2S)
+    dest->blake2s = src->blake2s;
+  else
+    dest->sha256 = src->sha256;
+}
+
+Digest::Digest(DigestAlgorithm algorithm) {
+  impl = AllocDigestImpl(algorithm);
+}
+
+Digest::Digest(const Digest &other) {
+  impl = AllocDigestImpl(DIGEST_SHA256);
+  if (impl && other.impl) {
+    ReadLockGuard guard(&other.impl->lock);
+    CopyDigestState(impl, other.impl);
+  }
+}
+
+Digest::~Digest() {
+  if (impl)
+    HeapFree(GetProcessHeap(), 0, impl);
+}
+
+Digest &Digest::operator=(const Digest &other) {
+  if (this == &other || !impl || !other.impl)
+    return *this;
+
+  WriteLockGuard guard(&impl->lock);
+  ReadLockGuard otherGuard(&other.impl->lock);
+  CopyDigestState(impl, other.impl);
+  return *this;
+}
+
+Digest &Digest::update(const Buffer &buf) {
+  int len = 0;
+  const unsigned char *data = buf.c_ptr(&len);
+  return update(data, len);
+}
+
+Digest &Digest::update(const String &str) {
+  return update((const unsigned char *)str.c_str(), str.byteLength());
+}
+
+Digest &Digest::update(const unsigned char *ptr, int size) {
+  if (!impl || !ptr || size <= 0)
+    return *this;
+
+  WriteLockGuard guard(&impl->lock);
+  DigestStateUpdate(impl, ptr, size);
+  return *this;
+}
+
+Digest &Digest::update(File &file) {
+  FileImpl *fileImpl = file.impl;
+  if (!impl || !fileImpl || !fileImpl->isOpen || !fileImpl->isValid)
+    return *this;
+
+  unsigned char *chunk =
+      (unsigned char *)HeapAlloc(GetProcessHeap(), 0, DIGEST_FILE_CHUNK);
+  if (!chunk)
+    return *this;
+
+  ReadLockGuard fileGuard(&fileImpl->lock);
+  WriteLockGuard guard(&impl->lock);
+
+  int bytesRead;
+  while ((bytesRead = ReadFileImplChunk(fileImpl, chunk, DIGEST_FILE_CHUNK)) >
+         0)
+    DigestStateUpdate(impl, chunk, bytesRead);
+
+  HeapFree(GetProcessHeap(), 0, chunk);
+  return *this;
+}
+
+void Digest::reset() {
+  if (!impl)
+    return;
+
+  WriteLockGuard guard(&impl->lock);
+  DigestStateInit(impl);
+}
+
+Buffer Digest::digest() const {
+  if (!impl)
+    return Buffer();
+
+  unsigned char out[SHA256_DIGEST_SIZE];
+  {
+    ReadLockGuard guard(&impl->lock);
+    DigestStateFinal(impl, out);
+  }
+  return Buffer(out, SHA256_DIGEST_SIZE);
+}
+
+String Digest::hexDigest() const {
+  if (!impl)
+    return String();
+
+  static const char hexChars[] = "0123456789abcdef";
+  unsigned char out[SHA256_DIGEST_SIZE];
+  {
+    ReadLockGuard guard(&impl->lock);
+    DigestStateFinal(impl, out);
+  }
+
+  char hex[SHA256_DIGEST_SIZE * 2 + 1];
+  for (int i = 0; i < SHA256_DIGEST_SIZE; i++) {
+    hex[i * 2] = hexChars[out[i] >> 4];
+    hex[i * 2 + 1] = hexChars[out[i] & 0x0F];
+  }
+  hex[SHA256_DIGEST_SIZE * 2] = '\0';
+  return String(hex);
+}
+
+DigestAlgorithm Digest::algorithm() const {
+  if (!impl)
+    return DIGEST_SHA256;
+
+  ReadLockGuard guard(&impl->lock);
+  return impl->algorithm;
+}
+
+} // namespace attoboy
@@ -0,0 +1,46 @@
+#pragma once
+#include "atto_internal_common.h"
+#include "atto_internal_digest.h"
+#include "attoboy/attoboy.h"
+#include <windows.h>
+
+namespace attoboy {
+
+// Chunk size for streaming files into a digest. Large enough that per-call
+// overhead disappears next to the hashing itself.
+static const int DIGEST_FILE_CHUNK = 1024 * 1024;
+
+struct DigestImpl {
+  DigestAlgorithm algorithm;
+  union {
+    Sha256State sha256;
+    Blake2sState blake2s;
+  };
+  mutable SRWLOCK lock;
+};
+
+static inline void DigestStateInit(DigestImpl *impl) {
+  if (impl->algorithm == DIGEST_BLAKE2S)
+    Blake2sInit(&impl->blake2s);
+  else
+    Sha256Init(&impl->sha256);
+}
+
+static inline void DigestStateUpdate(DigestImpl *impl,
+                                     const unsigned char *data, int len) {
+  if (impl->algorithm == DIGEST_BLAKE2S)
+    Blake2sUpdate(&impl->blake2s, data, len);
+  else
+    Sha256Update(&impl->sha256, data, len);
+}
+
+/// Writes the 32-byte digest to out.
+static inline void DigestStateFinal(const DigestImpl *impl,
+                                    unsigned char *out) {
+  if (impl->algorithm == DIGEST_BLAKE2S)
+    Blake2sFinal(&impl->blake2s, out);
+  else
+    Sha256Final(&impl->sha256, out);
+}
+
+} // namespace attoboy
@@ -0,0 +1,605 @@
+#include "attodirectorywalker_internal.h"
+#include "attodatetime_internal.h"
+
+namespace attoboy {
+
+static WCHAR *CopyWalkString(const WCHAR *str, int len) {
+  WCHAR *copy =
+      (WCHAR *)HeapAlloc(GetProcessHeap(), 0, (len + 1) * sizeof(WCHAR));
+  if (!copy)
+    return nullptr;
+  CopyMemory(copy, str, len * sizeof(WCHAR));
+  copy[len] = 0;
+  return copy;
+}
+
+// Joins two path parts with a backslash unless first already ends in one,
+// as a drive root does; either may be empty. The result is heap-allocated.
+static WCHAR *JoinWalkPath(const WCHAR *first, const WCHAR *second) {
+  int firstLen = lstrlenW(first);
+  int secondLen = lstrlenW(second);
+  bool separator = firstLen > 0 && secondLen > 0 &&
+                   !IsPathSeparator(first[firstLen - 1]);
+  int len = firstLen + (separator ? 1 : 0) + secondLen;
+  WCHAR *joined =
+      (WCHAR *)HeapAlloc(GetProcessHeap(), 0, (len + 1) * sizeof(WCHAR));
+  if (!joined)
+    return nullptr;
+  CopyMemory(joined, first, firstLen * sizeof(WCHAR));
+  if (separator)
+    joined[firstLen] = L'\\';
+  CopyMemory(joined + len - secondLen, second, secondLen * sizeof(WCHAR));
+  joined[len] = 0;
+  return joined;
+}
+
+static WCHAR FoldWalkChar(WCHAR c) {
+  return c >= L'A' && c <= L'Z' ? (WCHAR)(c - L'A' + L'a') : c;
+}
+
+// Matches name against a pattern with * and ?, ignoring ASCII case.
+static bool MatchWalkPattern(const WCHAR *pattern, const WCHAR *name) {
+  const WCHAR *star = nullptr;
+  const WCHAR *resume = nullptr;
+  while (*name) {
+    if (*pattern == L'*') {
+      star = pattern++;
+      resume = name;
+    } else if (*pattern &&
+               (*pattern == L'?' ||
+                FoldWalkChar(*pattern) == FoldWalkChar(*name))) {
+      pattern++;
+      name++;
+    } else if (star) {
+      pattern = star + 1;
+      name = ++resume;
+    } else {
+      return false;
+    }
+  }
+  while (*pattern == L'*')
+    pattern++;
+  return *pattern == 0;
+}
+
+// Returns root in the \\?\ form, which lifts the MAX_PATH limit but skips
+// the usual normalization, so the path is made absolute first.
+static WCHAR *GetWalkListingRoot(const WCHAR *root) {
+  DWORD len = GetFullPathNameW(root, 0, nullptr, nullptr);
+  if (len == 0)
+    return nullptr;
+  WCHAR *full =
+      (WCHAR *)HeapAlloc(GetProcessHeap(), 0, (len + 1) * sizeof(WCHAR));
+  if (!full)
+    return nullptr;
+  GetFullPathNameW(root, len + 1, full, nullptr);
+  TrimPathSeparators(full);
+
+  // Drive paths become \\?\C:\..., UNC paths \\?\UNC\server\...; paths
+  // that already start with \\?\ or \\.\ are kept.
+  const WCHAR *prefix = L"\\\\?\\";
+  const WCHAR *rest = full;
+  if (full[0] == L'\\' && full[1] == L'\\') {
+    if (full[2] == L'?' || full[2] == L'.') {
+      prefix = L"";
+    } else {
+      prefix = L"\\\\?\\UNC";
+      rest = full + 1;
+    }
+  }
+  int prefixLen = lstrlenW(prefix);
+  int restLen = lstrlenW(rest);
+  WCHAR *result = (WCHAR *)HeapAlloc(
+      GetProcessHeap(), 0, (prefixLen + restLen + 1) * sizeof(WCHAR));
+  if (result) {
+    CopyMemory(result, prefix, prefixLen * sizeof(WCHAR));
+    CopyMemory(result + prefixLen, rest, (restLen + 1) * sizeof(WCHAR));
+  }
+  HeapFree(GetProcessHeap(), 0, full);
+  return result;
+}
+
+static void FreeWalkBatch(WalkBatch *batch) {
+  if (batch->dir)
+    HeapFree(GetProcessHeap(), 0, batch->dir);
+  if (batch->items)
+    HeapFree(GetProcessHeap(), 0, batch->items);
+  if (batch->names)
+    HeapFree(GetProcessHeap(), 0, batch->names);
+  HeapFree(GetProcessHeap(), 0, batch);
+}
+
+static void FreeWalkDir(WalkDir *dir) {
+  if (dir->dir)
+    HeapFree(GetProcessHeap(), 0, dir->dir);
+  HeapFree(GetProcessHeap(), 0, dir);
+}
+
+static WalkDir *NewWalkDir(WCHAR *path, int depth) {
+  if (!path)
+    return nullptr;
+  WalkDir *dir =
+      (WalkDir *)HeapAlloc(GetProcessHeap(), 0, sizeof(WalkDir));
+  if (!dir) {
+    HeapFree(GetProcessHeap(), 0, path);
+    return nullptr;
+  }
+  dir->dir = path;
+  dir->depth = depth;
+  dir->next = nullptr;
+  return dir;
+}
+
+// Grows an array to hold at least needed elements, doubling its capacity.
+static bool GrowWalkArray(void **data, int *capacity, int needed,
+                          int elementSize) {
+  if (needed <= *capacity)
+    return true;
+  int grown = *capacity ? *capacity * 2 : 64;
+  while (grown < needed)
+    grown *= 2;
+  void *larger =
+      *data ? HeapReAlloc(GetProcessHeap(), 0, *data, grown * elementSize)
+            : HeapAlloc(GetProcessHeap(), 0, grown * elementSize);
+  if (!larger)
+    return false;
+  *data = larger;
+  *capacity = grown;
+  return true;
+}
+
+static bool AddWalkItem(WalkBatch *batch, const WIN32_FIND_DATAW &data) {
+  int nameLen = lstrlenW(data.cFileName);
+  if (!GrowWalkArray((void **)&batch->items, &batch->itemCapacity,
+                     batch->count + 1, sizeof(WalkItem)) ||
+      !GrowWalkArray((void **)&batch->names, &batch->namesCapacity,
+                     batch->namesLength + nameLen + 1, sizeof(WCHAR)))
+    return false;
+
+  WalkItem *item = &batch->items[batch->count++];
+  item->nameOffset = batch->namesLength;
+  item->attributes = data.dwFileAttributes;
+  item->size = ((long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+  item->created = data.ftCreationTime;
+  item->accessed = data.ftLastAccessTime;
+  item->modified = data.ftLastWriteTime;
+  CopyMemory(batch->names + batch->namesLength, data.cFileName,
+             (nameLen + 1) * sizeof(WCHAR));
+  batch->namesLength += nameLen + 1;
+  return true;
+}
+
+static bool IsSkippedWalkDirectory(const DirectoryWalkerImpl *impl,
+                                   const WCHAR *name) {
+  for (int i = 0; i < impl->skippedCount; i++)
+    if (MatchWalkPattern(impl->skipped[i], name))
+      return true;
+  return false;
+}
+
+// Lists one directory with a single large-fetch enumeration that skips
+// short names. Reported entries go into *batch and directories to descend
+// into are prepended to *subdirs. Returns false if it could not be listed.
+static bool ListWalkDirectory(const DirectoryWalkerImpl *impl,
+                              const WalkDir *dir, WalkBatch **batch,
+                              WalkDir **subdirs) {
+  *batch = nullptr;
+  *subdirs = nullptr;
+  WCHAR *listed = JoinWalkPath(impl->root, dir->dir);
+  WCHAR *search = listed ? JoinWalkPath(listed, L"*") : nullptr;
+  if (listed)
+    HeapFree(GetProcessHeap(), 0, listed);
+  if (!search)
+    return false;
+
+  WIN32_FIND_DATAW data;
+  HANDLE find = FindFirstFileExW(search, FindExInfoBasic, &data,
+                                 FindExSearchNameMatch, nullptr,
+                                 FIND_FIRST_EX_LARGE_FETCH);
+  HeapFree(GetProcessHeap(), 0, search);
+  if (find == INVALID_HANDLE_VALUE)
+    return false;
+
+  WalkBatch *result = (WalkBatch *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(WalkBatch));
+  if (result) {
+    result->dir = CopyWalkString(dir->dir, lstrlenW(dir->dir));
+    result->depth = dir->depth;
+  }
+  bool ok = result && result->dir;
+  bool descend = impl->maxDepth < 0 || dir->depth < impl->maxDepth;
+
+  do {
+    if (!ok)
+      break;
+    const WCHAR *name = data.cFileName;
+    if (name[0] == L'.' &&
+        (name[1] == 0 || (name[1] == L'.' && name[2] == 0)))
+      continue;
+
+    bool isDir = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    if (isDir && IsSkippedWalkDirectory(impl, name))
+      continue;
+    if (isDir && descend &&
+        !(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+      WalkDir *subdir =
+          NewWalkDir(JoinWalkPath(dir->dir, name), dir->depth + 1);
+      if (subdir) {
+        subdir->next = *subdirs;
+        *subdirs = subdir;
+      }
+    }
+    if ((isDir && !impl->includeDirectories) ||
+        (impl->filter && !MatchWalkPattern(impl->filter, name)))
+      continue;
+    ok = AddWalkItem(result, data);
+  } while (FindNextFileW(find, &data));
+  FindClose(find);
+
+  if (result && result->count > 0)
+    *batch = result;
+  else if (result)
+    FreeWalkBatch(result);
+  return ok;
+}
+
+// Takes a pending directory, lists it without holding the lock and
+// publishes the results. Returns false if nothing was pending. Caller holds
+// the exclusive lock.
+static bool WalkOneDirectory(DirectoryWalkerImpl *impl) {
+  WalkDir *dir = impl->pending;
+  if (!dir)
+    return false;
+  impl->pending = dir->next;
+  impl->active++;
+  ReleaseSRWLockExclusive(&impl->lock);
+
+  WalkBatch *batch;
+  WalkDir *subdirs;
+  bool listed = ListWalkDirectory(impl, dir, &batch, &subdirs);
+  FreeWalkDir(dir);
+
+  AcquireSRWLockExclusive(&impl->lock);
+  impl->active--;
+  if (!listed)
+    impl->errorCount++;
+  while (subdirs) {
+    WalkDir *next = subdirs->next;
+    subdirs->next = impl->pending;
+    impl->pending = subdirs;
+    subdirs = next;
+  }
+  if (batch) {
+    if (impl->readyTail)
+      impl->readyTail->next = batch;
+    else
+      impl->readyHead = batch;
+    impl->readyTail = batch;
+    impl->readyCount++;
+  }
+  WakeAllConditionVariable(&impl->changed);
+  return true;
+}
+
+static bool IsWalkFinished(const DirectoryWalkerImpl *impl) {
+  return !impl->pending && impl->active == 0;
+}
+
+static DWORD WINAPI DirectoryWalkerWorkerProc(LPVOID param) {
+  DirectoryWalkerImpl *impl = (DirectoryWalkerImpl *)param;
+  AcquireSRWLockExclusive(&impl->lock);
+  for (;;) {
+    if (impl->stopping || IsWalkFinished(impl))
+      break;
+    if (!impl->pending || impl->readyCount >= DIRECTORY_WALKER_MAX_READY) {
+      SleepConditionVariableSRW(&impl->changed, &impl->lock, INFINITE, 0);
+      continue;
+    }
+    WalkOneDirectory(impl);
+  }
+  WakeAllConditionVariable(&impl->changed);
+  ReleaseSRWLockExclusive(&impl->lock);
+  return 0;
+}
+
+// Queues the root and starts the workers. Caller holds the exclusive lock.
+static void StartWalk(DirectoryWalkerImpl *impl) {
+  impl->started = true;
+  if (!impl->root)
+    return;
+  impl->pending = NewWalkDir(CopyWalkString(L"", 0), 0);
+
+  int threads = impl->threadCount;
+  if (threads <= 0) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    threads = (int)info.dwNumberOfProcessors;
+  }
+  // A single thread walks inline in next(), with no worker.
+  if (threads <= 1)
+    return;
+  impl->workers =
+      (HANDLE *)HeapAlloc(GetProcessHeap(), 0, threads * sizeof(HANDLE));
+  for (int i = 0; impl->workers && i < threads; i++) {
+    HANDLE worker =
+        CreateThread(nullptr, 0, DirectoryWalkerWorkerProc, impl, 0, nullptr);
+    if (worker)
+      impl->workers[impl->workerCount++] = worker;
+  }
+}
+
+static void FreeDirectoryWalkerImpl(DirectoryWalkerImpl *impl) {
+  AcquireSRWLockExclusive(&impl->lock);
+  impl->stopping = true;
+  WakeAllConditionVariable(&impl->changed);
+  ReleaseSRWLockExclusive(&impl->lock);
+  for (int i = 0; i < impl->workerCount; i++) {
+    WaitForSingleObject(impl->workers[i], INFINITE);
+    CloseHandle(impl->workers[i]);
+  }
+  if (impl->workers)
+    HeapFree(GetProcessHeap(), 0, impl->workers);
+
+  while (impl->pending) {
+    WalkDir *next = impl->pending->next;
+    FreeWalkDir(impl->pending);
+    impl->pending = next;
+  }
+  while (impl->readyHead) {
+    WalkBatch *next = impl->readyHead->next;
+    FreeWalkBatch(impl->readyHead);
+    impl->readyHead = next;
+  }
+  if (impl->current)
+    FreeWalkBatch(impl->current);
+  for (int i = 0; i < impl->skippedCount; i++)
+    HeapFree(GetProcessHeap(), 0, impl->skipped[i]);
+  if (impl->skipped)
+    HeapFree(GetProcessHeap(), 0, impl->skipped);
+  FreeConvertedString(impl->filter);
+  FreeConvertedString(impl->root);
+  FreeConvertedString(impl->shownRoot);
+  HeapFree(GetProcessHeap(), 0, impl);
+}
+
+static const WalkItem *GetWalkItem(const DirectoryWalkerImpl *impl) {
+  if (!impl || !impl->current || impl->position >= impl->current->count)
+    return nullptr;
+  return &impl->current->items[impl->position];
+}
+
+static DateTime WalkTimeToDateTime(const FILETIME &time) {
+  ULARGE_INTEGER uli;
+  uli.LowPart = time.dwLowDateTime;
+  uli.HighPart = time.dwHighDateTime;
+  return DateTime(Div64((long long)uli.QuadPart, 10000LL) - 11644473600000LL);
+}
+
+DirectoryWalker::DirectoryWalker(const Path &root, int maxDepth,
+                                 int threads) {
+  impl = (DirectoryWalkerImpl *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(DirectoryWalkerImpl));
+  if (!impl)
+    return;
+  InitializeSRWLock(&impl->lock);
+  InitializeConditionVariable(&impl->changed);
+  impl->refCount = 1;
+  impl->maxDepth = maxDepth;
+  impl->threadCount = threads;
+  impl->includeDirectories = true;
+
+  String shown = root.toString();
+  if (shown.isEmpty())
+    shown = String(".");
+  impl->shownRoot = Utf8ToWide(shown.c_str());
+  if (!impl->shownRoot)
+    return;
+  TrimPathSeparators(impl->shownRoot);
+  impl->root = GetWalkListingRoot(impl->shownRoot);
+}
+
+DirectoryWalker::DirectoryWalker(const DirectoryWalker &other) {
+  impl = other.impl;
+  if (impl)
+    InterlockedIncrement(&impl->refCount);
+}
+
+DirectoryWalker::~DirectoryWalker() {
+  if (impl && InterlockedDecrement(&impl->refCount) == 0)
+    FreeDirectoryWalkerImpl(impl);
+}
+
+DirectoryWalker &DirectoryWalker::operator=(const DirectoryWalker &other) {
+  if (this != &other) {
+    if (impl && InterlockedDecrement(&impl->refCount) == 0)
+      FreeDirectoryWalkerImpl(impl);
+    impl = other.impl;
+    if (impl)
+      InterlockedIncrement(&impl->refCount);
+  }
+  return *this;
+}
+
+DirectoryWalker &DirectoryWalker::setFilter(const String &pattern) {
+  if (!impl)
+    return *this;
+  WriteLockGuard guard(&impl->lock);
+  if (impl->started)
+    return *this;
+  FreeConvertedString(impl->filter);
+  impl->filter = pattern.isEmpty() ? nullptr : Utf8ToWide(pattern.c_str());
+  return *this;
+}
+
+DirectoryWalker &DirectoryWalker::skipDirectories(const String &pattern) {
+  if (!impl || pattern.isEmpty())
+    return *this;
+  WriteLockGuard guard(&impl->lock);
+  if (impl->started)
+    return *this;
+  WCHAR *wide = Utf8ToWide(pattern.c_str());
+  if (!wide)
+    return *this;
+  int count = impl->skippedCount + 1;
+  WCHAR **skipped =
+      impl->skipped
+          ? (WCHAR **)HeapReAlloc(GetProcessHeap(), 0, impl->skipped,
+                                  count * sizeof(WCHAR *))
+          : (WCHAR **)HeapAlloc(GetProcessHeap(), 0, sizeof(WCHAR *));
+  if (!skipped) {
+    FreeConvertedString(wide);
+    return *this;
+  }
+  skipped[impl->skippedCount] = wide;
+  impl->skipped = skipped;
+  impl->skippedCount = count;
+  return *this;
+}
+
+DirectoryWalker &DirectoryWalker::setIncludeDirectories(bool include) {
+  if (!impl)
+    return *this;
+  WriteLockGuard guard(&impl->lock);
+  if (!impl->started)
+    impl->includeDirectories = include;
+  return *this;
+}
+
+bool DirectoryWalker::next() {
+  if (!impl)
+    return false;
+
+  WalkBatch *finished = nullptr;
+  bool found = false;
+  AcquireSRWLockExclusive(&impl->lock);
+  if (!impl->started)
+    StartWalk(impl);
+  if (impl->current && ++impl->position < impl->current->count) {
+    found = true;
+  } else {
+    finished = impl->current;
+    impl->current = nullptr;
+    for (;;) {
+      if (impl->readyHead) {
+        impl->current = impl->readyHead;
+        impl->readyHead = impl->current->next;
+        if (!impl->readyHead)
+          impl->readyTail = nullptr;
+        impl->readyCount--;
+        impl->position = 0;
+        found = true;
+        WakeAllConditionVariable(&impl->changed);
+        break;
+      }
+      if (IsWalkFinished(impl))
+        break;
+      if (impl->workerCount == 0)
+        WalkOneDirectory(impl);
+      else
+        SleepConditionVariableSRW(&impl->changed, &impl->lock, INFINITE, 0);
+    }
+  }
+  ReleaseSRWLockExclusive(&impl->lock);
+
+  if (finished)
+    FreeWalkBatch(finished);
+  return found;
+}
+
+String DirectoryWalker::getPath() const {
+  if (!impl)
+    return String();
+  ReadLockGuard guard(&impl->lock);
+  const WalkItem *item = GetWalkItem(impl);
+  if (!item)
+    return String();
+  WCHAR *dir = JoinWalkPath(impl->shownRoot, impl->current->dir);
+  WCHAR *path =
+      dir ? JoinWalkPath(dir, impl->current->names + item->nameOffset)
+          : nullptr;
+  char *utf8 = WideToUtf8(path);
+  String result(utf8 ? utf8 : "");
+  FreeConvertedString(utf8);
+  FreeConvertedString(path);
+  FreeConvertedString(dir);
+  return result;
+}
+
+String DirectoryWalker::getName() const {
+  if (!impl)
+    return String();
+  ReadLockGuard guard(&impl->lock);
+  const WalkItem *item = GetWalkItem(impl);
+  if (!item)
+    return String();
+  char *utf8 = WideToUtf8(impl->current->names + item->nameOffset);
+  String result(utf8 ? utf8 : "");
+  FreeConvertedString(utf8);
+  return result;
+}
+
+int DirectoryWalker::getDepth() const {
+  if (!impl)
+    return 0;
+  ReadLockGuard guard(&impl->lock);
+  return GetWalkItem(impl) ? impl->current->depth : 0;
+}
+
+bool DirectoryWalker::isDirectory() const {
+  return (getAttributes() & FILE_ATTRIBUTE_DIRECTORY) != 0;
+}
+
+bool DirectoryWalker::isSymbolicLink() const {
+  return (getAttributes() & FILE_ATTRIBUTE_REPARSE_POINT) != 0;
+}
+
+int DirectoryWalker::getAttributes() const {
+  if (!impl)
+    return 0;
+  ReadLockGuard guard(&impl->lock);
+  const WalkItem *item = GetWalkItem(impl);
+  return item ? (int)item->attributes : 0;
+}
+
+long long DirectoryWalker::getSize() const {
+  if (!impl)
+    return 0;
+  ReadLockGuard guard(&impl->lock);
+  const WalkItem *item = GetWalkItem(impl);
+  if (!item || (item->attributes & FILE_ATTRIBUTE_DIRECTORY))
+    return 0;
+  return item->size;
+}
+
+DateTime DirectoryWalker::getCreatedOn() const {
+  if (!impl)
+    return DateTime(0LL);
+  ReadLockGuard guard(&impl->lock);
+  const WalkItem *item = GetWalkItem(impl);
+  return item ? WalkTimeToDateTime(item->created) : DateTime(0LL);
+}
+
+DateTime DirectoryWalker::getModifiedOn() const {
+  if (!impl)
+    return DateTime(0LL);
+  ReadLockGuard guard(&impl->lock);
+  const WalkItem *item = GetWalkItem(impl);
+  return item ? WalkTimeToDateTime(item->modified) : DateTime(0LL);
+}
+
+DateTime DirectoryWalker::getAccessedOn() const {
+  if (!impl)
+    return DateTime(0LL);
+  ReadLockGuard guard(&impl->lock);
+  const WalkItem *item = GetWalkItem(impl);
+  return item ? WalkTimeToDateTime(item->accessed) : DateTime(0LL);
+}
+
+int DirectoryWalker::getErrorCount() const {
+  if (!impl)
+    return 0;
+  ReadLockGuard guard(&impl->lock);
+  return impl->errorCount;
+}
+
+} // namespace attoboy
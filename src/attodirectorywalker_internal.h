@@ -0,0 +1,75 @@
+#pragma once
+#include "atto_internal_common.h"
+#include "attoboy/attoboy.h"
+#include <windows.h>
+
+namespace attoboy {
+
+// Finished batches waiting for next(); listing pauses beyond this so a
+// slow consumer does not buffer a whole volume.
+static const int DIRECTORY_WALKER_MAX_READY = 64;
+
+// One entry of a listed directory. The name lives in the batch's names.
+struct WalkItem {
+  int nameOffset;
+  DWORD attributes;
+  long long size;
+  FILETIME created;
+  FILETIME accessed;
+  FILETIME modified;
+};
+
+// The reported entries of one directory. dir is relative to the root
+// ("" for the root itself).
+struct WalkBatch {
+  WCHAR *dir;
+  int depth;
+  WalkItem *items;
+  int count;
+  int itemCapacity;
+  WCHAR *names;
+  int namesLength;
+  int namesCapacity;
+  WalkBatch *next;
+};
+
+// A directory waiting to be listed; its entries are at depth.
+struct WalkDir {
+  WCHAR *dir;
+  int depth;
+  WalkDir *next;
+};
+
+// root is the absolute \\?\ form used for listing; shownRoot is the path as
+// given, used to build reported paths. pending and ready are shared with
+// the workers; current and position belong to next().
+struct DirectoryWalkerImpl {
+  WCHAR *root;
+  WCHAR *shownRoot;
+  int maxDepth;
+  int threadCount;
+  WCHAR *filter;
+  WCHAR **skipped;
+  int skippedCount;
+  bool includeDirectories;
+
+  bool started;
+  bool stopping;
+  WalkDir *pending;
+  int active;
+  WalkBatch *readyHead;
+  WalkBatch *readyTail;
+  int readyCount;
+  int errorCount;
+  HANDLE *workers;
+  int workerCount;
+
+  WalkBatch *current;
+  int position;
+
+  SRWLOCK lock;
+  CONDITION_VARIABLE changed;
+  volatile LONG refCount;
+};
+
+} // namespace attoboy
@@ -0,0 +1,555 @@
+#include "attodirectorywatcher_internal.h"
+
+namespace attoboy {
+
+static WCHAR *CopyWatchString(const WCHAR *str, int len) {
+  WCHAR *copy =
+      (WCHAR *)HeapAlloc(GetProcessHeap(), 0, (len + 1) * sizeof(WCHAR));
+  if (!copy)
+    return nullptr;
+  CopyMemory(copy, str, len * sizeof(WCHAR));
+  copy[len] = 0;
+  return copy;
+}
+
+// Case-insensitive (ASCII) FNV-1a hash, checked before comparing paths.
+static DWORD HashWatchPath(const WCHAR *path) {
+  DWORD hash = 2166136261u;
+  for (; *path; path++) {
+    WCHAR c = *path;
+    if (c >= L'A' && c <= L'Z')
+      c = (WCHAR)(c - L'A' + L'a');
+    hash = (hash ^ c) * 16777619u;
+  }
+  return hash;
+}
+
+static WatchChange *FindWatchChange(DirectoryWatcherImpl *impl,
+                                    const WCHAR *path, DWORD hash) {
+  for (int i = impl->pendingCount - 1; i >= 0; i--) {
+    WatchChange *entry = &impl->pending[i];
+    if (entry->change && entry->hash == hash &&
+        lstrcmpiW(entry->path, path) == 0)
+      return entry;
+  }
+  return nullptr;
+}
+
+static void DropWatchChange(WatchChange *entry) {
+  FreeConvertedString(entry->path);
+  FreeConvertedString(entry->oldPath);
+  entry->path = nullptr;
+  entry->oldPath = nullptr;
+  entry->change = 0;
+}
+
+// Returns what a pending change becomes when next follows it, or 0 if the
+// two cancel out.
+static int MergeWatchChange(int previous, int next) {
+  if (previous == CHANGE_CREATED) {
+    if (next == CHANGE_DELETED)
+      return 0;
+    return next == CHANGE_RENAMED ? CHANGE_RENAMED : CHANGE_CREATED;
+  }
+  if (previous == CHANGE_DELETED && next == CHANGE_CREATED)
+    return CHANGE_MODIFIED;
+  if (previous == CHANGE_MODIFIED && next == CHANGE_CREATED)
+    return CHANGE_MODIFIED;
+  if (previous == CHANGE_RENAMED && next != CHANGE_DELETED)
+    return CHANGE_RENAMED;
+  return next;
+}
+
+// Merges a change to path into the pending entries. Takes ownership of
+// oldPath.
+static void RecordWatchChange(DirectoryWatcherImpl *impl, const WCHAR *path,
+                              int change, WCHAR *oldPath, ULONGLONG now) {
+  DWORD hash = HashWatchPath(path);
+  WatchChange *entry = FindWatchChange(impl, path, hash);
+  if (entry && entry->change == CHANGE_RENAMED && change == CHANGE_DELETED) {
+    // Renamed and then deleted: what disappeared is the original path.
+    WCHAR *original = entry->oldPath;
+    entry->oldPath = nullptr;
+    DropWatchChange(entry);
+    if (original)
+      RecordWatchChange(impl, original, CHANGE_DELETED, nullptr, now);
+    FreeConvertedString(original);
+    FreeConvertedString(oldPath);
+    return;
+  }
+  if (entry) {
+    int merged = MergeWatchChange(entry->change, change);
+    if (merged == 0) {
+      DropWatchChange(entry);
+      FreeConvertedString(oldPath);
+      return;
+    }
+    if (change == CHANGE_RENAMED) {
+      FreeConvertedString(entry->oldPath);
+      entry->oldPath = oldPath;
+    } else {
+      FreeConvertedString(oldPath);
+    }
+    entry->change = merged;
+    entry->lastSeen = now;
+    return;
+  }
+
+  if (impl->pendingCount == impl->pendingCapacity) {
+    int capacity = impl->pendingCapacity ? impl->pendingCapacity * 2 : 32;
+    WatchChange *grown =
+        impl->pending
+            ? (WatchChange *)HeapReAlloc(GetProcessHeap(), 0, impl->pending,
+                                         capacity * sizeof(WatchChange))
+            : (WatchChange *)HeapAlloc(GetProcessHeap(), 0,
+                                       capacity * sizeof(WatchChange));
+    if (!grown) {
+      FreeConvertedString(oldPath);
+      return;
+    }
+    impl->pending = grown;
+    impl->pendingCapacity = capacity;
+  }
+  WCHAR *copy = CopyWatchString(path, lstrlenW(path));
+  if (!copy) {
+    FreeConvertedString(oldPath);
+    return;
+  }
+  WatchChange *added = &impl->pending[impl->pendingCount++];
+  added->path = copy;
+  added->oldPath = oldPath;
+  added->hash = hash;
+  added->change = change;
+  added->firstSeen = now;
+  added->lastSeen = now;
+}
+
+static void RecordWatchRename(DirectoryWatcherImpl *impl, const WCHAR *from,
+                              const WCHAR *to, ULONGLONG now) {
+  WatchChange *entry = FindWatchChange(impl, from, HashWatchPath(from));
+  int previous = entry ? entry->change : 0;
+  WCHAR *original = nullptr;
+  if (entry) {
+    if (previous == CHANGE_RENAMED) {
+      original = entry->oldPath;
+      entry->oldPath = nullptr;
+    }
+    DropWatchChange(entry);
+  }
+
+  if (previous == CHANGE_CREATED) {
+    // Created under a temporary name: report the final name only.
+    RecordWatchChange(impl, to, CHANGE_CREATED, nullptr, now);
+  } else if (original && lstrcmpiW(original, to) == 0) {
+    FreeConvertedString(original);
+    RecordWatchChange(impl, to, CHANGE_MODIFIED, nullptr, now);
+  } else {
+    if (!original)
+      original = CopyWatchString(from, lstrlenW(from));
+    if (original)
+      RecordWatchChange(impl, to, CHANGE_RENAMED, original, now);
+  }
+}
+
+static void ParseWatchNotifications(DirectoryWatcherImpl *impl,
+                                    const BYTE *data) {
+  ULONGLONG now = GetTickCount64();
+  DWORD offset = 0;
+  for (;;) {
+    const FILE_NOTIFY_INFORMATION *info =
+        (const FILE_NOTIFY_INFORMATION *)(data + offset);
+    WCHAR *name = CopyWatchString(info->FileName,
+                                  info->FileNameLength / sizeof(WCHAR));
+    if (name) {
+      switch (info->Action) {
+      case FILE_ACTION_ADDED:
+        RecordWatchChange(impl, name, CHANGE_CREATED, nullptr, now);
+        break;
+      case FILE_ACTION_REMOVED:
+        RecordWatchChange(impl, name, CHANGE_DELETED, nullptr, now);
+        break;
+      case FILE_ACTION_MODIFIED:
+        RecordWatchChange(impl, name, CHANGE_MODIFIED, nullptr, now);
+        break;
+      case FILE_ACTION_RENAMED_OLD_NAME:
+        // An old name with no new name means the entry left the tree.
+        if (impl->renameFrom)
+          RecordWatchChange(impl, impl->renameFrom, CHANGE_DELETED, nullptr,
+                            now);
+        FreeConvertedString(impl->renameFrom);
+        impl->renameFrom = name;
+        name = nullptr;
+        break;
+      case FILE_ACTION_RENAMED_NEW_NAME:
+        if (impl->renameFrom)
+          RecordWatchRename(impl, impl->renameFrom, name, now);
+        else
+          RecordWatchChange(impl, name, CHANGE_CREATED, nullptr, now);
+        FreeConvertedString(impl->renameFrom);
+        impl->renameFrom = nullptr;
+        break;
+      }
+      FreeConvertedString(name);
+    }
+    if (info->NextEntryOffset == 0)
+      break;
+    offset += info->NextEntryOffset;
+  }
+}
+
+static const char *GetWatchChangeName(int change) {
+  switch (change) {
+  case CHANGE_CREATED:
+    return "created";
+  case CHANGE_MODIFIED:
+    return "modified";
+  case CHANGE_DELETED:
+    return "deleted";
+  case CHANGE_RENAMED:
+    return "renamed";
+  default:
+    return "overflow";
+  }
+}
+
+// Joins the root with a relative path ("" for the root itself). A drive
+// root already ends in a separator.
+static String GetWatchPath(const DirectoryWatcherImpl *impl,
+                           const WCHAR *relative) {
+  char *root = WideToUtf8(impl->root);
+  String result(root ? root : "");
+  FreeConvertedString(root);
+  if (relative && relative[0]) {
+    char *utf8 = WideToUtf8(relative);
+    int rootLen = lstrlenW(impl->root);
+    if (rootLen == 0 || !IsPathSeparator(impl->root[rootLen - 1]))
+      result = result + "\\";
+    result = result + (utf8 ? utf8 : "");
+    FreeConvertedString(utf8);
+  }
+  return result;
+}
+
+// Hands one change to the callback, or queues it for poll().
+static void DeliverWatchChange(DirectoryWatcherImpl *impl, int change,
+                               const WCHAR *path, const WCHAR *oldPath) {
+  String fullPath = GetWatchPath(impl, path);
+  String fullOldPath = oldPath ? GetWatchPath(impl, oldPath) : String();
+
+  AcquireSRWLockExclusive(&impl->lock);
+  DirectoryChangeCallback callback = impl->callback;
+  void *arg = impl->callbackArg;
+  if (!callback) {
+    Map event;
+    event.put(String("type"), String(GetWatchChangeName(change)));
+    event.put(String("path"), fullPath);
+    if (oldPath)
+      event.put(String("oldPath"), fullOldPath);
+    impl->ready->append(event);
+    WakeAllConditionVariable(&impl->changed);
+  }
+  ReleaseSRWLockExclusive(&impl->lock);
+
+  if (callback)
+    callback((DirectoryChange)change, fullPath, fullOldPath, arg);
+}
+
+// Returns when entry is due: once its path has been quiet for the debounce
+// window, or after DIRECTORY_WATCHER_MAX_WINDOWS windows in any case.
+static ULONGLONG GetWatchDeadline(const DirectoryWatcherImpl *impl,
+                                  const WatchChange *entry) {
+  ULONGLONG quiet = entry->lastSeen + impl->debounceMs;
+  ULONGLONG latest =
+      entry->firstSeen + MulU64By32((unsigned int)impl->debounceMs,
+                                    DIRECTORY_WATCHER_MAX_WINDOWS);
+  return quiet < latest ? quiet : latest;
+}
+
+// Returns how long the worker may wait before an entry is due.
+static DWORD GetWatchTimeout(const DirectoryWatcherImpl *impl) {
+  ULONGLONG now = GetTickCount64();
+  DWORD timeout = INFINITE;
+  for (int i = 0; i < impl->pendingCount; i++) {
+    if (!impl->pending[i].change)
+      continue;
+    ULONGLONG deadline = GetWatchDeadline(impl, &impl->pending[i]);
+    if (deadline <= now)
+      return 0;
+    if (deadline - now < timeout)
+      timeout = (DWORD)(deadline - now);
+  }
+  return timeout;
+}
+
+// Delivers the entries that are due (all of them if all is true), in the
+// order their paths first changed.
+static void FlushWatchChanges(DirectoryWatcherImpl *impl, bool all) {
+  ULONGLONG now = GetTickCount64();
+  int kept = 0;
+  for (int i = 0; i < impl->pendingCount; i++) {
+    WatchChange entry = impl->pending[i];
+    if (!entry.change)
+      continue;
+    if (!all && GetWatchDeadline(impl, &entry) > now) {
+      impl->pending[kept++] = entry;
+      continue;
+    }
+    DeliverWatchChange(impl, entry.change, entry.path, entry.oldPath);
+    FreeConvertedString(entry.path);
+    FreeConvertedString(entry.oldPath);
+  }
+  impl->pendingCount = kept;
+}
+
+static bool ReadWatchChanges(DirectoryWatcherImpl *impl, BYTE *buffer,
+                             OVERLAPPED *overlapped) {
+  DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+                 FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE |
+                 FILE_NOTIFY_CHANGE_CREATION;
+  return ReadDirectoryChangesW(impl->directory, buffer,
+                               DIRECTORY_WATCHER_BUFFER_SIZE, impl->recursive,
+                               filter, nullptr, overlapped, nullptr) != 0;
+}
+
+static void SetWatchStarted(DirectoryWatcherImpl *impl, bool running) {
+  AcquireSRWLockExclusive(&impl->lock);
+  impl->started = true;
+  impl->running = running;
+  WakeAllConditionVariable(&impl->changed);
+  ReleaseSRWLockExclusive(&impl->lock);
+}
+
+// Runs once both the handles and the worker are done with impl. The worker
+// handle is still set if it was stopped from its own callback.
+static void FreeDirectoryWatcherImpl(DirectoryWatcherImpl *impl) {
+  if (impl->worker)
+    CloseHandle(impl->worker);
+  if (impl->directory)
+    CloseHandle(impl->directory);
+  if (impl->stopEvent)
+    CloseHandle(impl->stopEvent);
+  for (int i = 0; i < impl->pendingCount; i++)
+    DropWatchChange(&impl->pending[i]);
+  if (impl->pending)
+    HeapFree(GetProcessHeap(), 0, impl->pending);
+  FreeConvertedString(impl->renameFrom);
+  FreeConvertedString(impl->root);
+  delete impl->ready;
+  HeapFree(GetProcessHeap(), 0, impl);
+}
+
+// Keeps one read outstanding at all times. A completed buffer is parsed
+// only after the next read has been issued into the other buffer, so the
+// system keeps collecting changes meanwhile.
+static DWORD WINAPI DirectoryWatcherWorkerProc(LPVOID param) {
+  DirectoryWatcherImpl *impl = (DirectoryWatcherImpl *)param;
+  BYTE *buffers[2];
+  buffers[0] = (BYTE *)HeapAlloc(GetProcessHeap(), 0,
+                                 DIRECTORY_WATCHER_BUFFER_SIZE * 2);
+  buffers[1] = buffers[0] ? buffers[0] + DIRECTORY_WATCHER_BUFFER_SIZE
+                          : nullptr;
+  OVERLAPPED overlapped;
+  ZeroMemory(&overlapped, sizeof(overlapped));
+  overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+  int current = 0;
+  bool outstanding = buffers[0] && overlapped.hEvent &&
+                     ReadWatchChanges(impl, buffers[current], &overlapped);
+  SetWatchStarted(impl, outstanding);
+
+  HANDLE waits[2] = {impl->stopEvent, overlapped.hEvent};
+  while (outstanding) {
+    DWORD result = WaitForMultipleObjects(2, waits, FALSE,
+                                          GetWatchTimeout(impl));
+    if (result == WAIT_OBJECT_0 || result == WAIT_FAILED)
+      break;
+    if (result == WAIT_OBJECT_0 + 1) {
+      outstanding = false;
+      DWORD bytes = 0;
+      if (!GetOverlappedResult(impl->directory, &overlapped, &bytes,
+                               FALSE) &&
+          GetLastError() != ERROR_NOTIFY_ENUM_DIR)
+        break;
+      int done = current;
+      current = 1 - current;
+      outstanding = ReadWatchChanges(impl, buffers[current], &overlapped);
+      if (bytes == 0) {
+        // The system's buffer overflowed: whatever is pending is
+        // incomplete, so deliver it and ask for a re-scan.
+        FreeConvertedString(impl->renameFrom);
+        impl->renameFrom = nullptr;
+        FlushWatchChanges(impl, true);
+        DeliverWatchChange(impl, CHANGE_OVERFLOW, nullptr, nullptr);
+      } else {
+        ParseWatchNotifications(impl, buffers[done]);
+      }
+    }
+    FlushWatchChanges(impl, false);
+  }
+
+  if (outstanding) {
+    DWORD bytes = 0;
+    CancelIoEx(impl->directory, &overlapped);
+    GetOverlappedResult(impl->directory, &overlapped, &bytes, TRUE);
+  }
+  if (impl->renameFrom) {
+    RecordWatchChange(impl, impl->renameFrom, CHANGE_DELETED, nullptr,
+                      GetTickCount64());
+    FreeConvertedString(impl->renameFrom);
+    impl->renameFrom = nullptr;
+  }
+  FlushWatchChanges(impl, true);
+
+  AcquireSRWLockExclusive(&impl->lock);
+  impl->running = false;
+  WakeAllConditionVariable(&impl->changed);
+  ReleaseSRWLockExclusive(&impl->lock);
+
+  if (overlapped.hEvent)
+    CloseHandle(overlapped.hEvent);
+  if (buffers[0])
+    HeapFree(GetProcessHeap(), 0, buffers[0]);
+  // A callback may have dropped the last handle, so impl can outlive it.
+  if (InterlockedDecrement(&impl->refCount) == 0)
+    FreeDirectoryWatcherImpl(impl);
+  return 0;
+}
+
+// Signals the worker and waits for it, unless called from the worker
+// itself (a callback), which only signals.
+static void StopWatch(DirectoryWatcherImpl *impl) {
+  AcquireSRWLockExclusive(&impl->lock);
+  HANDLE worker = impl->worker;
+  bool fromWorker = worker && GetCurrentThreadId() == impl->workerId;
+  if (!fromWorker)
+    impl->worker = nullptr;
+  ReleaseSRWLockExclusive(&impl->lock);
+  if (impl->stopEvent)
+    SetEvent(impl->stopEvent);
+  if (!worker || fromWorker)
+    return;
+  WaitForSingleObject(worker, INFINITE);
+  CloseHandle(worker);
+}
+
+// Drops one handle. The last one stops the worker and gives up the handles'
+// shared reference.
+static void ReleaseDirectoryWatcherImpl(DirectoryWatcherImpl *impl) {
+  if (InterlockedDecrement(&impl->handleCount) != 0)
+    return;
+  StopWatch(impl);
+  if (InterlockedDecrement(&impl->refCount) == 0)
+    FreeDirectoryWatcherImpl(impl);
+}
+
+DirectoryWatcher::DirectoryWatcher(const Path &root, bool recursive,
+                                   int debounceMs) {
+  impl = (DirectoryWatcherImpl *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(DirectoryWatcherImpl));
+  if (!impl)
+    return;
+  InitializeSRWLock(&impl->lock);
+  InitializeConditionVariable(&impl->changed);
+  impl->handleCount = 1;
+  impl->refCount = 1;
+  impl->recursive = recursive;
+  impl->debounceMs = debounceMs > 0 ? debounceMs : 0;
+  impl->ready = new List();
+
+  String shown = root.toString();
+  if (shown.isEmpty())
+    shown = String(".");
+  impl->root = Utf8ToWide(shown.c_str());
+  if (!impl->root)
+    return;
+  TrimPathSeparators(impl->root);
+
+  HANDLE directory = CreateFileW(
+      impl->root, FILE_LIST_DIRECTORY,
+      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+      OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+      nullptr);
+  if (directory == INVALID_HANDLE_VALUE)
+    return;
+  impl->directory = directory;
+  impl->stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+  if (!impl->stopEvent)
+    return;
+
+  // Wait until the first read is issued so no change made after the
+  // constructor returns is missed.
+  AcquireSRWLockExclusive(&impl->lock);
+  InterlockedIncrement(&impl->refCount);
+  impl->worker = CreateThread(nullptr, 0, DirectoryWatcherWorkerProc, impl,
+                              0, &impl->workerId);
+  if (!impl->worker)
+    InterlockedDecrement(&impl->refCount);
+  while (impl->worker && !impl->started)
+    SleepConditionVariableSRW(&impl->changed, &impl->lock, INFINITE, 0);
+  ReleaseSRWLockExclusive(&impl->lock);
+}
+
+DirectoryWatcher::DirectoryWatcher(const DirectoryWatcher &other) {
+  impl = other.impl;
+  if (impl)
+    InterlockedIncrement(&impl->handleCount);
+}
+
+DirectoryWatcher::~DirectoryWatcher() {
+  if (impl)
+    ReleaseDirectoryWatcherImpl(impl);
+}
+
+DirectoryWatcher &DirectoryWatcher::operator=(const DirectoryWatcher &other) {
+  if (this != &other) {
+    if (impl)
+      ReleaseDirectoryWatcherImpl(impl);
+    impl = other.impl;
+    if (impl)
+      InterlockedIncrement(&impl->handleCount);
+  }
+  return *this;
+}
+
+bool DirectoryWatcher::isValid() const {
+  if (!impl)
+    return false;
+  ReadLockGuard guard(&impl->lock);
+  return impl->running;
+}
+
+void DirectoryWatcher::setCallback(DirectoryChangeCallback callback,
+                                   void *arg) {
+  if (!impl)
+    return;
+  WriteLockGuard guard(&impl->lock);
+  impl->callback = callback;
+  impl->callbackArg = arg;
+}
+
+List DirectoryWatcher::poll(int timeoutMs) {
+  if (!impl)
+    return List();
+  AcquireSRWLockExclusive(&impl->lock);
+  ULONGLONG start = GetTickCount64();
+  while (impl->ready->isEmpty() && impl->running && timeoutMs != 0) {
+    DWORD wait = INFINITE;
+    if (timeoutMs > 0) {
+      ULONGLONG elapsed = GetTickCount64() - start;
+      if (elapsed >= (ULONGLONG)timeoutMs)
+        break;
+      wait = (DWORD)(timeoutMs - elapsed);
+    }
+    SleepConditionVariableSRW(&impl->changed, &impl->lock, wait, 0);
+  }
+  List events = *impl->ready;
+  impl->ready->clear();
+  ReleaseSRWLockExclusive(&impl->lock);
+  return events;
+}
+
+void DirectoryWatcher::stop() {
+  if (impl)
+    StopWatch(impl);
+}
+
+} // namespace attoboy
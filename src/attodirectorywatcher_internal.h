@@ -0,0 +1,56 @@
+#pragma once
+#include "atto_internal_common.h"
+#include "attoboy/attoboy.h"
+#include <windows.h>
+
+namespace attoboy {
+
+// Size of each ReadDirectoryChangesW buffer; larger buffers are refused on
+// network shares.
+static const DWORD DIRECTORY_WATCHER_BUFFER_SIZE = 64 * 1024;
+
+// A path that keeps changing is still reported after this many debounce
+// windows.
+static const int DIRECTORY_WATCHER_MAX_WINDOWS = 10;
+
+// A change waiting out the debounce window. path and oldPath are relative
+// to the root; change is 0 once the entry has been merged away.
+struct WatchChange {
+  WCHAR *path;
+  WCHAR *oldPath;
+  DWORD hash;
+  int change;
+  ULONGLONG firstSeen;
+  ULONGLONG lastSeen;
+};
+
+// pending and renameFrom belong to the worker; started, running, ready and
+// the callback are shared and guarded by lock. handleCount counts the
+// DirectoryWatcher copies; refCount counts them as one, plus the worker.
+struct DirectoryWatcherImpl {
+  WCHAR *root;
+  bool recursive;
+  int debounceMs;
+  HANDLE directory;
+  HANDLE stopEvent;
+  HANDLE worker;
+  DWORD workerId;
+
+  WatchChange *pending;
+  int pendingCount;
+  int pendingCapacity;
+  WCHAR *renameFrom;
+
+  bool started;
+  bool running;
+  List *ready;
+  DirectoryChangeCallback callback;
+  void *callbackArg;
+
+  SRWLOCK lock;
+  CONDITION_VARIABLE changed;
+  volatile LONG handleCount;
+  volatile LONG refCount;
+};
+
+} // namespace attoboy
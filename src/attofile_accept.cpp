@@ -22,25 +22,13 @@ File File::accept() {
     return invalid;
   }
 
-  FileImpl *clientImpl =
-      (FileImpl *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
-                            sizeof(FileImpl));
+  FileImpl *clientImpl = AllocSocketFileImpl(clientSock);
   if (!clientImpl) {
-    closesocket(clientSock);
     File invalid(Path(""));
     return invalid;
   }
-
-  InitializeSRWLock(&clientImpl->lock);
-  clientImpl->type = FILE_TYPE_SOCKET;
-  clientImpl->handle = INVALID_HANDLE_VALUE;
-  clientImpl->sock = clientSock;
-  clientImpl->pathStr = nullptr;
-  clientImpl->hostStr = nullptr;
-  clientImpl->port = -1;
-  clientImpl->isOpen = true;
-  clientImpl->isValid = true;
-  clientImpl->refCount = 1;
+  // Accepted sockets inherit the listener's blocking mode.
+  clientImpl->nonBlocking = impl->nonBlocking;
 
   File result(Path(""));
   if (result.impl && InterlockedDecrement(&result.impl->refCount) == 0) {
@@ -0,0 +1,197 @@
+#include "attoasyncresult_internal.h"
+
+namespace attoboy {
+
+bool AttachAsyncFile(AsyncResultImpl *op, const File &file,
+                     FileImpl *fileImpl) {
+  if (!fileImpl)
+    return false;
+  void *mem = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(File));
+  if (!mem)
+    return false;
+  op->file = new (mem) File(file);
+  op->fileImpl = fileImpl;
+  return true;
+}
+
+bool BindAsyncSocket(FileImpl *file) {
+  if (file->asyncBound)
+    return true;
+  HANDLE port = GetAsyncPort();
+  if (!port ||
+      !CreateIoCompletionPort((HANDLE)file->sock, port, ASYNC_KEY_IO, 0))
+    return false;
+  file->asyncBound = true;
+  return true;
+}
+
+static LPFN_ACCEPTEX GetAcceptEx(SOCKET sock) {
+  static LPFN_ACCEPTEX acceptEx = nullptr;
+  if (!acceptEx) {
+    GUID guid = WSAID_ACCEPTEX;
+    LPFN_ACCEPTEX fn = nullptr;
+    DWORD bytes = 0;
+    if (WSAIoctl(sock, SIO_GET_EXTENSION_FUNCTION_POINTER, &guid, sizeof(guid),
+                 &fn, sizeof(fn), &bytes, nullptr, nullptr) == 0)
+      acceptEx = fn;
+  }
+  return acceptEx;
+}
+
+// Starts op->requested bytes of reading into or writing from op->data.
+// Sockets get overlapped WSARecv/WSASend; other handles were opened for
+// synchronous I/O, so a dedicated thread performs the call instead.
+static void StartAsyncTransfer(AsyncResultImpl *op) {
+  FileImpl *file = op->fileImpl;
+  bool usable;
+  bool isSocket;
+  {
+    ReadLockGuard guard(&file->lock);
+    usable = file->isOpen && file->isValid &&
+             file->type != FILE_TYPE_SERVER_SOCKET;
+    isSocket = file->type == FILE_TYPE_SOCKET;
+  }
+  if (!usable) {
+    FailAsyncOp(op);
+    return;
+  }
+  if (!isSocket) {
+    QueueBlockingAsyncOp(op);
+    return;
+  }
+
+  bool started = false;
+  {
+    WriteLockGuard guard(&file->lock);
+    if (file->isOpen && BindAsyncSocket(file)) {
+      WSABUF wsaBuf;
+      wsaBuf.buf = (char *)op->data;
+      wsaBuf.len = (ULONG)op->requested;
+      int rc;
+      if (op->type == ASYNC_OP_READ) {
+        DWORD flags = 0;
+        rc = WSARecv(file->sock, &wsaBuf, 1, nullptr, &flags, &op->overlapped,
+                     nullptr);
+      } else {
+        rc = WSASend(file->sock, &wsaBuf, 1, nullptr, 0, &op->overlapped,
+                     nullptr);
+      }
+      // Immediate success still queues a completion packet.
+      started = rc == 0 || WSAGetLastError() == WSA_IO_PENDING;
+    }
+  }
+  if (!started)
+    FailAsyncOp(op);
+}
+
+AsyncResult File::readAsync(int count, AsyncCallback callback, void *arg) {
+  AsyncResultImpl *op = AllocAsyncResultImpl(ASYNC_OP_READ, callback, arg);
+  AsyncResult result(op);
+  if (!op)
+    return result;
+
+  void *mem = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(Buffer));
+  if (mem) {
+    op->buffer = new (mem) Buffer(count > 0 ? count : 0);
+    op->bufferImpl = op->buffer->impl;
+    op->data = op->bufferImpl ? op->bufferImpl->data : nullptr;
+    op->requested = count;
+  }
+
+  if (!op->data || !AttachAsyncFile(op, *this, impl)) {
+    FailAsyncOp(op);
+    return result;
+  }
+  StartAsyncTransfer(op);
+  return result;
+}
+
+AsyncResult File::writeAsync(const Buffer &buf, AsyncCallback callback,
+                             void *arg) {
+  AsyncResultImpl *op = AllocAsyncResultImpl(ASYNC_OP_WRITE, callback, arg);
+  AsyncResult result(op);
+  if (!op)
+    return result;
+
+  void *mem = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(Buffer));
+  if (!mem || !AttachAsyncFile(op, *this, impl)) {
+    if (mem)
+      HeapFree(GetProcessHeap(), 0, mem);
+    FailAsyncOp(op);
+    return result;
+  }
+
+  op->buffer = new (mem) Buffer(buf);
+  int len = 0;
+  op->data = (unsigned char *)op->buffer->c_ptr(&len);
+  op->requested = len;
+  StartAsyncTransfer(op);
+  return result;
+}
+
+AsyncResult File::acceptAsync(AsyncCallback callback, void *arg) {
+  AsyncResultImpl *op = AllocAsyncResultImpl(ASYNC_OP_ACCEPT, callback, arg);
+  AsyncResult result(op);
+  if (!op)
+    return result;
+
+  if (!AttachAsyncFile(op, *this, impl)) {
+    FailAsyncOp(op);
+    return result;
+  }
+
+  bool started = false;
+  {
+    WriteLockGuard guard(&impl->lock);
+    LPFN_ACCEPTEX acceptEx = nullptr;
+    if (impl->type == FILE_TYPE_SERVER_SOCKET && impl->isOpen &&
+        impl->isValid && BindAsyncSocket(impl))
+      acceptEx = GetAcceptEx(impl->sock);
+
+    SOCKET client = INVALID_SOCKET;
+    if (acceptEx) {
+      SOCKADDR_STORAGE local;
+      int localLen = sizeof(local);
+      int family = AF_INET;
+      if (getsockname(impl->sock, (struct sockaddr *)&local, &localLen) == 0)
+        family = local.ss_family;
+      client = WSASocketW(family, SOCK_STREAM, IPPROTO_TCP, nullptr, 0,
+                          WSA_FLAG_OVERLAPPED);
+    }
+
+    // The accepted File stays closed until the connection arrives.
+    FileImpl *clientImpl =
+        client != INVALID_SOCKET ? AllocSocketFileImpl(client) : nullptr;
+    void *mem = clientImpl ? HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                       sizeof(File))
+                           : nullptr;
+    if (mem) {
+      clientImpl->isOpen = false;
+      clientImpl->isValid = false;
+
+      File *accepted = new (mem) File(Path(""));
+      if (accepted->impl &&
+          InterlockedDecrement(&accepted->impl->refCount) == 0) {
+        FreeFileStr(accepted->impl->pathStr);
+        HeapFree(GetProcessHeap(), 0, accepted->impl);
+      }
+      accepted->impl = clientImpl;
+      op->accepted = accepted;
+      op->acceptedImpl = clientImpl;
+
+      DWORD received = 0;
+      started = acceptEx(impl->sock, client, op->acceptAddresses, 0,
+                         ASYNC_ADDRESS_SIZE, ASYNC_ADDRESS_SIZE, &received,
+                         &op->overlapped) ||
+                WSAGetLastError() == ERROR_IO_PENDING;
+    } else if (clientImpl) {
+      closesocket(client);
+      HeapFree(GetProcessHeap(), 0, clientImpl);
+    }
+  }
+  if (!started)
+    FailAsyncOp(op);
+  return result;
+}
+
+} // namespace attoboy
@@ -3,7 +3,7 @@
 
 namespace attoboy {
 
-static bool InitWinsock() {
+bool InitWinsock() {
   static bool initialized = false;
   if (!initialized) {
     WSADATA wsaData;
@@ -81,7 +81,7 @@ File::File(const Path &path) {
   }
 }
 
-File::File(const String &host, int port) {
+File::File(const String &host, int port, int connectTimeoutMs) {
   impl = (FileImpl *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
                                sizeof(FileImpl));
   if (!impl)
@@ -100,7 +100,7 @@ File::File(const String &host, int port) {
   }
 
   const char *hostCStr = host.c_str();
-  if (!hostCStr) {
+  if (!hostCStr || port < 0 || port > 65535) {
     impl->isValid = false;
     return;
   }
@@ -114,56 +114,18 @@ File::File(const String &host, int port) {
   ATTO_LSTRCPY(impl->hostStr, hostCStr);
   impl->port = port;
 
-  impl->sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  ResolvedAddress addrs[RESOLVE_MAX_ADDRESSES];
+  int count = ResolveHost(hostCStr, port, addrs, RESOLVE_MAX_ADDRESSES);
+  if (count > 0)
+    impl->sock = ConnectFirstAddress(addrs, count, connectTimeoutMs);
   if (impl->sock == INVALID_SOCKET) {
+    // The host may have moved; look it up again next time.
+    if (count > 0)
+      ForgetResolvedHost(hostCStr);
     impl->isValid = false;
     return;
   }
 
-  char hostA[256];
-  lstrcpyA(hostA, hostCStr);
-
-  char portStr[16];
-  int portVal = port;
-  int idx = 0;
-  if (portVal == 0) {
-    portStr[idx++] = '0';
-  } else {
-    char temp[16];
-    int tempIdx = 0;
-    while (portVal > 0) {
-      temp[tempIdx++] = '0' + (portVal % 10);
-      portVal /= 10;
-    }
-    for (int i = tempIdx - 1; i >= 0; i--) {
-      portStr[idx++] = temp[i];
-    }
-  }
-  portStr[idx] = '\0';
-
-  struct addrinfo hints, *result = nullptr;
-  ZeroMemory(&hints, sizeof(hints));
-  hints.ai_family = AF_INET;
-  hints.ai_socktype = SOCK_STREAM;
-  hints.ai_protocol = IPPROTO_TCP;
-
-  if (getaddrinfo(hostA, portStr, &hints, &result) != 0) {
-    closesocket(impl->sock);
-    impl->sock = INVALID_SOCKET;
-    impl->isValid = false;
-    return;
-  }
-
-  if (connect(impl->sock, result->ai_addr, (int)result->ai_addrlen) ==
-      SOCKET_ERROR) {
-    freeaddrinfo(result);
-    closesocket(impl->sock);
-    impl->sock = INVALID_SOCKET;
-    impl->isValid = false;
-    return;
-  }
-
-  freeaddrinfo(result);
   impl->type = FILE_TYPE_SOCKET;
   impl->isOpen = true;
   impl->isValid = true;
@@ -189,7 +151,29 @@ File::File(int port) {
 
   impl->port = port;
 
-  impl->sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  // Listen on both IPv6 and IPv4 where the host supports IPv6.
+  struct sockaddr_in6 addr6;
+  ZeroMemory(&addr6, sizeof(addr6));
+  addr6.sin6_family = AF_INET6;
+  addr6.sin6_port = htons((u_short)port);
+  struct sockaddr_in addr;
+  ZeroMemory(&addr, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = INADDR_ANY;
+  addr.sin_port = htons((u_short)port);
+  struct sockaddr *bindAddr = (struct sockaddr *)&addr6;
+  int bindLen = sizeof(addr6);
+
+  impl->sock = socket(AF_INET6, SOCK_STREAM, IPPROTO_TCP);
+  if (impl->sock != INVALID_SOCKET) {
+    DWORD v6Only = 0;
+    setsockopt(impl->sock, IPPROTO_IPV6, IPV6_V6ONLY, (const char *)&v6Only,
+               sizeof(v6Only));
+  } else {
+    impl->sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    bindAddr = (struct sockaddr *)&addr;
+    bindLen = sizeof(addr);
+  }
   if (impl->sock == INVALID_SOCKET) {
     impl->isValid = false;
     return;
@@ -199,14 +183,7 @@ File::File(int port) {
   setsockopt(impl->sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&optval,
              sizeof(optval));
 
-  struct sockaddr_in addr;
-  ZeroMemory(&addr, sizeof(addr));
-  addr.sin_family = AF_INET;
-  addr.sin_addr.s_addr = INADDR_ANY;
-  addr.sin_port = htons((u_short)port);
-
-  if (bind(impl->sock, (struct sockaddr *)&addr, sizeof(addr)) ==
-      SOCKET_ERROR) {
+  if (bind(impl->sock, bindAddr, bindLen) == SOCKET_ERROR) {
     closesocket(impl->sock);
     impl->sock = INVALID_SOCKET;
     impl->isValid = false;
@@ -220,6 +197,15 @@ File::File(int port) {
     return;
   }
 
+  // Port 0 binds to any free port; report the one actually chosen. The port
+  // sits at the same offset in IPv4 and IPv6 addresses.
+  if (port == 0) {
+    SOCKADDR_STORAGE bound;
+    int boundLen = sizeof(bound);
+    if (getsockname(impl->sock, (struct sockaddr *)&bound, &boundLen) == 0)
+      impl->port = ntohs(((struct sockaddr_in *)&bound)->sin_port);
+  }
+
   impl->type = FILE_TYPE_SERVER_SOCKET;
   impl->isOpen = true;
   impl->isValid = true;
@@ -344,4 +330,34 @@ bool File::isServerSocket() const {
   return impl->type == FILE_TYPE_SERVER_SOCKET;
 }
 
+bool File::setNonBlocking(bool enabled) {
+  if (!impl)
+    return false;
+  WriteLockGuard lock(&impl->lock);
+  if (!impl->isOpen || !impl->isValid)
+    return false;
+
+  if (impl->type == FILE_TYPE_SOCKET || impl->type == FILE_TYPE_SERVER_SOCKET) {
+    u_long mode = enabled ? 1 : 0;
+    if (ioctlsocket(impl->sock, FIONBIO, &mode) == SOCKET_ERROR)
+      return false;
+  } else if (impl->type == FILE_TYPE_NAMED_PIPE) {
+    DWORD mode = PIPE_READMODE_BYTE | (enabled ? PIPE_NOWAIT : PIPE_WAIT);
+    if (!SetNamedPipeHandleState(impl->handle, &mode, nullptr, nullptr))
+      return false;
+  } else {
+    return false;
+  }
+
+  impl->nonBlocking = enabled;
+  return true;
+}
+
+bool File::isNonBlocking() const {
+  if (!impl)
+    return false;
+  ReadLockGuard lock(&impl->lock);
+  return impl->nonBlocking;
+}
+
 } // namespace attoboy
@@ -31,6 +31,9 @@ struct FileImpl {
   int port;
   bool isOpen;
   bool isValid;
+  bool asyncBound;
+  bool nonBlocking;
+  int readTimeoutMs;
   SRWLOCK lock;
   volatile LONG refCount;
 };
@@ -45,4 +48,166 @@ static inline void FreeFileStr(ATTO_LPSTR str) {
     HeapFree(GetProcessHeap(), 0, str);
 }
 
+/// Starts Winsock on first use. Returns false if it could not be started.
+bool InitWinsock();
+
+// Most addresses a host name resolves to that a connect will try.
+static const int RESOLVE_MAX_ADDRESSES = 8;
+
+struct ResolvedAddress {
+  SOCKADDR_STORAGE addr;
+  int length;
+};
+
+/// Resolves host (through the process-wide cache) to at most max TCP
+/// addresses with port filled in, alternating address families starting
+/// with the resolver's preferred one.
+/// Returns the number of addresses, or 0 if the host did not resolve.
+int ResolveHost(const char *host, int port, ResolvedAddress *addrs, int max);
+
+/// Drops host from the resolver cache, so the next connect looks it up
+/// again. Used when none of its cached addresses answered.
+void ForgetResolvedHost(const char *host);
+
+/// Connects to the first of addrs to answer, starting a new attempt every
+/// 250 ms while earlier ones are pending and closing the losers. Gives up
+/// after timeoutMs (-1 = once every attempt has failed). Returns a blocking
+/// connected socket, or INVALID_SOCKET.
+SOCKET ConnectFirstAddress(const ResolvedAddress *addrs, int count,
+                           int timeoutMs);
+
+/// Creates the impl for a connected socket, taking ownership of sock.
+/// Returns nullptr (and closes sock) on allocation failure.
+static inline FileImpl *AllocSocketFileImpl(SOCKET sock) {
+  FileImpl *impl = (FileImpl *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                         sizeof(FileImpl));
+  if (!impl) {
+    closesocket(sock);
+    return nullptr;
+  }
+
+  InitializeSRWLock(&impl->lock);
+  impl->type = FILE_TYPE_SOCKET;
+  impl->handle = INVALID_HANDLE_VALUE;
+  impl->sock = sock;
+  impl->port = -1;
+  impl->isOpen = true;
+  impl->isValid = true;
+  impl->refCount = 1;
+  return impl;
+}
+
+/// Reads up to count bytes from a file, pipe or connected socket. Returns the
+/// number of bytes read, 0 at end of stream, or -1 on error. The caller must
+/// hold impl->lock.
+static inline int ReadFileImplChunk(FileImpl *impl, unsigned char *dest,
+                                    int count) {
+  if (impl->type == FILE_TYPE_SOCKET) {
+    int bytesRead = recv(impl->sock, (char *)dest, count, 0);
+    return bytesRead < 0 ? -1 : bytesRead;
+  }
+  if (impl->type == FILE_TYPE_SERVER_SOCKET)
+    return -1;
+
+  DWORD bytesRead = 0;
+  if (!ReadFile(impl->handle, dest, count, &bytesRead, nullptr))
+    return -1;
+  return (int)bytesRead;
+}
+
+// A non-blocking pipe cannot be waited on, so a waiting read retries it in
+// slices of this length.
+static const int FILE_PIPE_WAIT_SLICE_MS = 10;
+
+/// Like ReadFileImplChunk, but when a non-blocking socket or pipe has no data
+/// yet, waits up to timeoutMs (-1 = forever) for some, and a closed pipe
+/// counts as the end of the stream. Returns the number of bytes read, 0 at
+/// end of stream, or -1 on error or timeout. The caller must hold impl->lock.
+static inline int ReadFileImplWaiting(FileImpl *impl, unsigned char *dest,
+                                      int count, int timeoutMs) {
+  ULONGLONG deadline = GetTickCount64() + (timeoutMs > 0 ? timeoutMs : 0);
+  for (;;) {
+    int bytesRead = ReadFileImplChunk(impl, dest, count);
+    if (bytesRead >= 0)
+      return bytesRead;
+
+    int wait = timeoutMs;
+    if (timeoutMs > 0) {
+      ULONGLONG now = GetTickCount64();
+      if (now >= deadline)
+        return -1;
+      wait = (int)(deadline - now);
+    }
+
+    if (impl->type == FILE_TYPE_SOCKET) {
+      if (WSAGetLastError() != WSAEWOULDBLOCK)
+        return -1;
+      WSAPOLLFD fd;
+      fd.fd = impl->sock;
+      fd.events = POLLRDNORM;
+      fd.revents = 0;
+      if (WSAPoll(&fd, 1, wait) <= 0)
+        return -1;
+    } else {
+      DWORD error = GetLastError();
+      if (error == ERROR_BROKEN_PIPE)
+        return 0;
+      if (error != ERROR_NO_DATA || timeoutMs == 0)
+        return -1;
+      if (wait < 0 || wait > FILE_PIPE_WAIT_SLICE_MS)
+        wait = FILE_PIPE_WAIT_SLICE_MS;
+      ::Sleep((DWORD)wait);
+    }
+  }
+}
+
+/// Returns how long a read may wait for data: the setTimeouts() read
+/// timeout, or -1 (forever) if none was set.
+static inline int GetReadTimeout(const FileImpl *impl) {
+  return impl->readTimeoutMs > 0 ? impl->readTimeoutMs : -1;
+}
+
+/// Sends up to len bytes on a socket. Returns bytes sent, 0 if a
+/// non-blocking socket's send buffer is full, or -1 on error.
+static inline int SendFileImplChunk(FileImpl *impl, const char *data,
+                                    int len) {
+  int sent = send(impl->sock, data, len, 0);
+  if (sent == SOCKET_ERROR)
+    return WSAGetLastError() == WSAEWOULDBLOCK ? 0 : -1;
+  return sent;
+}
+
+/// Writes all len bytes to a file, pipe or connected socket, retrying short
+/// writes (and waiting for room on non-blocking sockets). Returns false on
+/// error. The caller must hold impl->lock.
+static inline bool WriteFileImplAll(FileImpl *impl, const unsigned char *data,
+                                    int len) {
+  while (len > 0) {
+    int written = 0;
+    if (impl->type == FILE_TYPE_SOCKET) {
+      written = SendFileImplChunk(impl, (const char *)data, len);
+      if (written < 0)
+        return false;
+      if (written == 0) {
+        WSAPOLLFD fd;
+        fd.fd = impl->sock;
+        fd.events = POLLWRNORM;
+        fd.revents = 0;
+        if (WSAPoll(&fd, 1, -1) <= 0)
+          return false;
+        continue;
+      }
+    } else {
+      DWORD bytesWritten = 0;
+      if (!WriteFile(impl->handle, data, len, &bytesWritten, nullptr) ||
+          bytesWritten == 0)
+        return false;
+      written = (int)bytesWritten;
+    }
+    data += written;
+    len -= written;
+  }
+  return true;
+}
+
 } // namespace attoboy
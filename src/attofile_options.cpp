@@ -0,0 +1,79 @@
+#include "attofile_internal.h"
+#include <mstcpip.h>
+
+namespace attoboy {
+
+// Windows defaults for the keep-alive timers, used when only one is given.
+static const int KEEPALIVE_DEFAULT_IDLE_MS = 2 * 60 * 60 * 1000;
+static const int KEEPALIVE_DEFAULT_INTERVAL_MS = 1000;
+
+static bool IsSocketFileImpl(const FileImpl *impl) {
+  return impl->isOpen && impl->isValid &&
+         (impl->type == FILE_TYPE_SOCKET ||
+          impl->type == FILE_TYPE_SERVER_SOCKET);
+}
+
+static bool SetSocketOption(SOCKET sock, int level, int name, DWORD value) {
+  return setsockopt(sock, level, name, (const char *)&value, sizeof(value)) !=
+         SOCKET_ERROR;
+}
+
+bool File::setNoDelay(bool enabled) {
+  if (!impl)
+    return false;
+  WriteLockGuard lock(&impl->lock);
+  if (!IsSocketFileImpl(impl))
+    return false;
+  return SetSocketOption(impl->sock, IPPROTO_TCP, TCP_NODELAY, enabled ? 1 : 0);
+}
+
+bool File::setBufferSizes(int receiveBytes, int sendBytes) {
+  if (!impl)
+    return false;
+  WriteLockGuard lock(&impl->lock);
+  if (!IsSocketFileImpl(impl))
+    return false;
+
+  bool ok = true;
+  if (receiveBytes >= 0)
+    ok = SetSocketOption(impl->sock, SOL_SOCKET, SO_RCVBUF, receiveBytes);
+  if (sendBytes >= 0)
+    ok = SetSocketOption(impl->sock, SOL_SOCKET, SO_SNDBUF, sendBytes) && ok;
+  return ok;
+}
+
+bool File::setKeepAlive(bool enabled, int idleMs, int intervalMs) {
+  if (!impl)
+    return false;
+  WriteLockGuard lock(&impl->lock);
+  if (!IsSocketFileImpl(impl))
+    return false;
+
+  if (!enabled || (idleMs <= 0 && intervalMs <= 0))
+    return SetSocketOption(impl->sock, SOL_SOCKET, SO_KEEPALIVE,
+                           enabled ? 1 : 0);
+
+  // Both timers are set together; fill in the default for the missing one.
+  struct tcp_keepalive settings;
+  settings.onoff = 1;
+  settings.keepalivetime = idleMs > 0 ? idleMs : KEEPALIVE_DEFAULT_IDLE_MS;
+  settings.keepaliveinterval =
+      intervalMs > 0 ? intervalMs : KEEPALIVE_DEFAULT_INTERVAL_MS;
+  DWORD bytes = 0;
+  return WSAIoctl(impl->sock, SIO_KEEPALIVE_VALS, &settings, sizeof(settings),
+                  nullptr, 0, &bytes, nullptr, nullptr) == 0;
+}
+
+bool File::setTimeouts(int readMs, int writeMs) {
+  if (!impl || readMs < 0 || writeMs < 0)
+    return false;
+  WriteLockGuard lock(&impl->lock);
+  if (!IsSocketFileImpl(impl))
+    return false;
+  // Kept for reads that wait on a non-blocking socket themselves.
+  impl->readTimeoutMs = readMs;
+  return SetSocketOption(impl->sock, SOL_SOCKET, SO_RCVTIMEO, readMs) &&
+         SetSocketOption(impl->sock, SOL_SOCKET, SO_SNDTIMEO, writeMs);
+}
+
+} // namespace attoboy
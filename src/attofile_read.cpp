@@ -1,85 +1,69 @@
 #include "attofile_internal.h"
+#include "attobuffer_internal.h"
 
 namespace attoboy {
 
+// First allocation for readUntilClosed when the length is not known ahead.
+static const int READ_UNTIL_CLOSED_INITIAL = 65536;
+// A Buffer holds at most 2 GB, so growth stops once it reaches 1 GB.
+static const int READ_UNTIL_CLOSED_MAX_GROWTH = 0x40000000;
+
 Buffer File::readAllToBuffer() {
   if (!impl || !impl->isOpen || !impl->isValid)
     return Buffer();
 
   ReadLockGuard lock(&impl->lock);
 
+  DWORD available = 0;
   if (impl->type == FILE_TYPE_SOCKET) {
-    unsigned char *tempBuf =
-        (unsigned char *)HeapAlloc(GetProcessHeap(), 0, 8192);
-    if (!tempBuf)
+    u_long pending = 0;
+    if (ioctlsocket(impl->sock, FIONREAD, &pending) == SOCKET_ERROR)
       return Buffer();
-
-    Buffer result;
-    int totalRead = 0;
-
-    u_long available = 0;
-    if (ioctlsocket(impl->sock, FIONREAD, &available) == SOCKET_ERROR) {
-      HeapFree(GetProcessHeap(), 0, tempBuf);
+    available = (DWORD)pending;
+  } else if (impl->type == FILE_TYPE_REGULAR) {
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(impl->handle, &fileSize))
       return Buffer();
-    }
 
-    if (available == 0) {
-      HeapFree(GetProcessHeap(), 0, tempBuf);
+    LARGE_INTEGER currentPos;
+    currentPos.QuadPart = 0;
+    if (!SetFilePointerEx(impl->handle, currentPos, &currentPos, FILE_CURRENT))
       return Buffer();
-    }
 
-    while (totalRead < (int)available) {
-      int toRead = (available - totalRead > 8192) ? 8192 : (available - totalRead);
-      int bytesRead = recv(impl->sock, (char *)tempBuf, toRead, 0);
-      if (bytesRead <= 0)
-        break;
-      result.append(tempBuf, bytesRead);
-      totalRead += bytesRead;
-    }
+    if (currentPos.QuadPart >= fileSize.QuadPart)
+      return Buffer();
 
-    HeapFree(GetProcessHeap(), 0, tempBuf);
-    return result;
+    // A Buffer holds at most 2 GB; use MappedFile for larger files.
+    long long remaining = fileSize.QuadPart - currentPos.QuadPart;
+    if (remaining > 0x7FFFFFFF)
+      return Buffer();
+    available = (DWORD)remaining;
   } else {
-    DWORD fileSize = 0;
-    if (impl->type == FILE_TYPE_REGULAR) {
-      fileSize = GetFileSize(impl->handle, nullptr);
-      if (fileSize == INVALID_FILE_SIZE)
-        return Buffer();
-
-      LARGE_INTEGER currentPos;
-      currentPos.QuadPart = 0;
-      if (!SetFilePointerEx(impl->handle, currentPos, &currentPos, FILE_CURRENT))
-        return Buffer();
-
-      if (currentPos.QuadPart >= fileSize)
-        return Buffer();
-
-      fileSize -= (DWORD)currentPos.QuadPart;
-    } else {
-      DWORD available = 0;
-      if (!PeekNamedPipe(impl->handle, nullptr, 0, nullptr, &available, nullptr))
-        return Buffer();
-      fileSize = available;
-    }
-
-    if (fileSize == 0)
+    if (!PeekNamedPipe(impl->handle, nullptr, 0, nullptr, &available, nullptr))
       return Buffer();
+  }
 
-    unsigned char *buffer =
-        (unsigned char *)HeapAlloc(GetProcessHeap(), 0, fileSize);
-    if (!buffer)
-      return Buffer();
+  if (available == 0)
+    return Buffer();
 
-    DWORD bytesRead = 0;
-    if (!ReadFile(impl->handle, buffer, fileSize, &bytesRead, nullptr)) {
-      HeapFree(GetProcessHeap(), 0, buffer);
-      return Buffer();
-    }
+  // Read straight into the result's storage.
+  Buffer result((int)available);
+  if (!result.impl || !result.impl->data)
+    return Buffer();
 
-    Buffer result(buffer, bytesRead);
-    HeapFree(GetProcessHeap(), 0, buffer);
-    return result;
+  int totalRead = 0;
+  while (totalRead < (int)available) {
+    int bytesRead = ReadFileImplChunk(impl, result.impl->data + totalRead,
+                                      (int)available - totalRead);
+    if (bytesRead <= 0)
+      break;
+    totalRead += bytesRead;
+    if (impl->type != FILE_TYPE_SOCKET)
+      break;
   }
+
+  result.impl->size = totalRead;
+  return result;
 }
 
 Buffer File::readToBuffer(int count) {
@@ -88,30 +72,95 @@ Buffer File::readToBuffer(int count) {
 
   ReadLockGuard lock(&impl->lock);
 
-  unsigned char *buffer =
-      (unsigned char *)HeapAlloc(GetProcessHeap(), 0, count);
-  if (!buffer)
+  Buffer result(count);
+  if (!result.impl || !result.impl->data)
     return Buffer();
 
-  int bytesRead = 0;
+  int bytesRead = ReadFileImplChunk(impl, result.impl->data, count);
+  if (bytesRead <= 0)
+    return Buffer();
+
+  result.impl->size = bytesRead;
+  // Don't pin a large allocation behind a short read.
+  if (bytesRead < count / 2)
+    result.trim();
+  return result;
+}
 
+Buffer File::readUntilClosed() {
+  if (!impl || !impl->isOpen || !impl->isValid)
+    return Buffer();
+
+  ReadLockGuard lock(&impl->lock);
+
+  // Start with room for what is already known to be there, plus a byte so
+  // the read that finds the end needs no growth.
+  long long known = 0;
   if (impl->type == FILE_TYPE_SOCKET) {
-    bytesRead = recv(impl->sock, (char *)buffer, count, 0);
-    if (bytesRead <= 0) {
-      HeapFree(GetProcessHeap(), 0, buffer);
-      return Buffer();
-    }
-  } else {
-    DWORD dwBytesRead = 0;
-    if (!ReadFile(impl->handle, buffer, count, &dwBytesRead, nullptr)) {
-      HeapFree(GetProcessHeap(), 0, buffer);
-      return Buffer();
+    u_long pending = 0;
+    if (ioctlsocket(impl->sock, FIONREAD, &pending) != SOCKET_ERROR)
+      known = pending;
+  } else if (impl->type == FILE_TYPE_REGULAR) {
+    LARGE_INTEGER fileSize;
+    LARGE_INTEGER currentPos;
+    currentPos.QuadPart = 0;
+    if (GetFileSizeEx(impl->handle, &fileSize) &&
+        SetFilePointerEx(impl->handle, currentPos, &currentPos, FILE_CURRENT))
+      known = fileSize.QuadPart - currentPos.QuadPart;
+  }
+  int initial = READ_UNTIL_CLOSED_INITIAL;
+  if (known >= 0x7FFFFFFF)
+    initial = 0x7FFFFFFF;
+  else if (known + 1 > initial)
+    initial = (int)known + 1;
+
+  Buffer result(initial);
+  BufferImpl *out = result.impl;
+  if (!out || !out->data)
+    return Buffer();
+
+  while (true) {
+    if (out->size == out->capacity) {
+      if (out->capacity >= READ_UNTIL_CLOSED_MAX_GROWTH ||
+          !EnsureBufferCapacity(out, out->size + 1))
+        break;
     }
-    bytesRead = (int)dwBytesRead;
+    int bytesRead = ReadFileImplWaiting(impl, out->data + out->size,
+                                        out->capacity - out->size,
+                                        GetReadTimeout(impl));
+    if (bytesRead <= 0)
+      break;
+    out->size += bytesRead;
+  }
+
+  if (out->size < out->capacity / 2)
+    result.trim();
+  return result;
+}
+
+Buffer File::readExact(int count) {
+  if (!impl || !impl->isOpen || !impl->isValid || count <= 0)
+    return Buffer();
+
+  ReadLockGuard lock(&impl->lock);
+
+  Buffer result(count);
+  if (!result.impl || !result.impl->data)
+    return Buffer();
+
+  int totalRead = 0;
+  while (totalRead < count) {
+    int bytesRead =
+        ReadFileImplWaiting(impl, result.impl->data + totalRead,
+                            count - totalRead, GetReadTimeout(impl));
+    if (bytesRead <= 0)
+      break;
+    totalRead += bytesRead;
   }
 
-  Buffer result(buffer, bytesRead);
-  HeapFree(GetProcessHeap(), 0, buffer);
+  result.impl->size = totalRead;
+  if (totalRead < count / 2)
+    result.trim();
   return result;
 }
 
@@ -141,8 +190,8 @@ bool File::hasAvailable() const {
       return false;
     return available > 0;
   } else if (impl->type == FILE_TYPE_REGULAR) {
-    DWORD fileSize = GetFileSize(impl->handle, nullptr);
-    if (fileSize == INVALID_FILE_SIZE)
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(impl->handle, &fileSize))
       return false;
 
     LARGE_INTEGER currentPos;
@@ -150,7 +199,7 @@ bool File::hasAvailable() const {
     if (!SetFilePointerEx(impl->handle, currentPos, &currentPos, FILE_CURRENT))
       return false;
 
-    return currentPos.QuadPart < fileSize;
+    return currentPos.QuadPart < fileSize.QuadPart;
   } else {
     DWORD available = 0;
     if (!PeekNamedPipe(impl->handle, nullptr, 0, nullptr, &available, nullptr))
@@ -171,8 +220,8 @@ int File::getAvailableCount() const {
       return 0;
     return (int)available;
   } else if (impl->type == FILE_TYPE_REGULAR) {
-    DWORD fileSize = GetFileSize(impl->handle, nullptr);
-    if (fileSize == INVALID_FILE_SIZE)
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(impl->handle, &fileSize))
       return 0;
 
     LARGE_INTEGER currentPos;
@@ -180,10 +229,11 @@ int File::getAvailableCount() const {
     if (!SetFilePointerEx(impl->handle, currentPos, &currentPos, FILE_CURRENT))
       return 0;
 
-    if (currentPos.QuadPart >= fileSize)
+    if (currentPos.QuadPart >= fileSize.QuadPart)
       return 0;
 
-    return (int)(fileSize - currentPos.QuadPart);
+    long long remaining = fileSize.QuadPart - currentPos.QuadPart;
+    return remaining > 0x7FFFFFFF ? 0x7FFFFFFF : (int)remaining;
   } else {
     DWORD available = 0;
     if (!PeekNamedPipe(impl->handle, nullptr, 0, nullptr, &available, nullptr))
@@ -0,0 +1,322 @@
+#include "attofile_internal.h"
+
+namespace attoboy {
+
+// getaddrinfo does not report record TTLs, so cached lookups expire after a
+// fixed time instead. The cache stops growing at RESOLVE_CACHE_MAX_HOSTS;
+// further hosts are resolved on every connect until entries expire.
+static const int RESOLVE_CACHE_DEFAULT_TTL_MS = 60000;
+static const int RESOLVE_CACHE_MAX_HOSTS = 256;
+// Delay before racing the next address (RFC 8305 recommends 250 ms).
+static const int CONNECT_ATTEMPT_DELAY_MS = 250;
+// Longest single WSAPoll wait. Before Windows 10 2004, WSAPoll does not
+// report a refused connect, so pending sockets are also checked with
+// SO_ERROR between waits.
+static const int CONNECT_POLL_SLICE_MS = 100;
+
+// Addresses are stored with port 0 and shared by every port of the host.
+struct ResolvedHost {
+  ATTO_LPSTR host;
+  ResolvedAddress addrs[RESOLVE_MAX_ADDRESSES];
+  int count;
+  ULONGLONG expires;
+  ResolvedHost *next;
+};
+
+static SRWLOCK g_resolveLock = SRWLOCK_INIT;
+static ResolvedHost *g_resolvedHosts = nullptr;
+static int g_resolvedHostCount = 0;
+static int g_resolveTtlMs = RESOLVE_CACHE_DEFAULT_TTL_MS;
+static long long g_resolveLookups = 0;
+
+static void FreeResolvedHostList(ResolvedHost *list) {
+  while (list) {
+    ResolvedHost *next = list->next;
+    FreeFileStr(list->host);
+    HeapFree(GetProcessHeap(), 0, list);
+    list = next;
+  }
+}
+
+// Unlinks expired hosts onto expired. Caller holds the exclusive lock.
+static void CollectExpiredHosts(ULONGLONG now, ResolvedHost **expired) {
+  ResolvedHost **link = &g_resolvedHosts;
+  while (*link) {
+    ResolvedHost *entry = *link;
+    if (now >= entry->expires) {
+      *link = entry->next;
+      entry->next = *expired;
+      *expired = entry;
+      g_resolvedHostCount--;
+    } else {
+      link = &entry->next;
+    }
+  }
+}
+
+// Copies the addresses of list into addrs, taking the families in turns
+// starting with the first one returned, so a broken family only delays the
+// connect by one attempt.
+static int InterleaveAddresses(const struct addrinfo *list,
+                               ResolvedAddress *addrs, int max) {
+  int count = 0;
+  int firstFamily = list ? list->ai_family : AF_UNSPEC;
+  const struct addrinfo *same = list;
+  const struct addrinfo *other = list;
+  bool takeSame = true;
+  while (count < max) {
+    const struct addrinfo **next = takeSame ? &same : &other;
+    while (*next && (((*next)->ai_family == firstFamily) != takeSame ||
+                     (*next)->ai_addrlen > sizeof(SOCKADDR_STORAGE)))
+      *next = (*next)->ai_next;
+    if (!*next) {
+      if (!same && !other)
+        break;
+      takeSame = !takeSame;
+      continue;
+    }
+    CopyMemory(&addrs[count].addr, (*next)->ai_addr, (*next)->ai_addrlen);
+    addrs[count].length = (int)(*next)->ai_addrlen;
+    count++;
+    *next = (*next)->ai_next;
+    takeSame = !takeSame;
+  }
+  return count;
+}
+
+static void SetAddressPort(ResolvedAddress *address, int port) {
+  u_short netPort = htons((u_short)port);
+  if (address->addr.ss_family == AF_INET6)
+    ((struct sockaddr_in6 *)&address->addr)->sin6_port = netPort;
+  else
+    ((struct sockaddr_in *)&address->addr)->sin_port = netPort;
+}
+
+// Copies entry's addresses to addrs. Caller holds the lock.
+static int CopyResolvedHost(const ResolvedHost *entry, ResolvedAddress *addrs,
+                            int max) {
+  int count = entry->count < max ? entry->count : max;
+  CopyMemory(addrs, entry->addrs, count * sizeof(ResolvedAddress));
+  return count;
+}
+
+int ResolveHost(const char *host, int port, ResolvedAddress *addrs, int max) {
+  if (!host || !*host || max <= 0 || !InitWinsock())
+    return 0;
+
+  int count = 0;
+  ResolvedHost *expired = nullptr;
+  {
+    WriteLockGuard guard(&g_resolveLock);
+    CollectExpiredHosts(GetTickCount64(), &expired);
+    for (ResolvedHost *entry = g_resolvedHosts; entry; entry = entry->next) {
+      if (lstrcmpiA(entry->host, host) == 0) {
+        count = CopyResolvedHost(entry, addrs, max);
+        break;
+      }
+    }
+    if (count == 0)
+      g_resolveLookups++;
+  }
+  FreeResolvedHostList(expired);
+
+  if (count == 0) {
+    // Resolved outside the lock; if another thread resolved the same host
+    // in the meantime, the later entry is simply not added.
+    struct addrinfo hints, *result = nullptr;
+    ZeroMemory(&hints, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    if (getaddrinfo(host, nullptr, &hints, &result) != 0)
+      return 0;
+
+    ResolvedHost *entry = (ResolvedHost *)HeapAlloc(
+        GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(ResolvedHost));
+    if (!entry) {
+      freeaddrinfo(result);
+      return 0;
+    }
+    entry->count =
+        InterleaveAddresses(result, entry->addrs, RESOLVE_MAX_ADDRESSES);
+    freeaddrinfo(result);
+    count = CopyResolvedHost(entry, addrs, max);
+
+    entry->host = AllocFileStr(ATTO_LSTRLEN(host));
+    bool cached = false;
+    if (entry->host && entry->count > 0) {
+      ATTO_LSTRCPY(entry->host, host);
+      WriteLockGuard guard(&g_resolveLock);
+      if (g_resolveTtlMs > 0 && g_resolvedHostCount < RESOLVE_CACHE_MAX_HOSTS) {
+        entry->expires = GetTickCount64() + (ULONGLONG)g_resolveTtlMs;
+        entry->next = g_resolvedHosts;
+        g_resolvedHosts = entry;
+        g_resolvedHostCount++;
+        cached = true;
+      }
+    }
+    if (!cached)
+      FreeResolvedHostList(entry);
+  }
+
+  for (int i = 0; i < count; i++)
+    SetAddressPort(&addrs[i], port);
+  return count;
+}
+
+void ForgetResolvedHost(const char *host) {
+  ResolvedHost *forgotten = nullptr;
+  {
+    WriteLockGuard guard(&g_resolveLock);
+    for (ResolvedHost **link = &g_resolvedHosts; *link;
+         link = &(*link)->next) {
+      if (lstrcmpiA((*link)->host, host) == 0) {
+        forgotten = *link;
+        *link = forgotten->next;
+        forgotten->next = nullptr;
+        g_resolvedHostCount--;
+        break;
+      }
+    }
+  }
+  FreeResolvedHostList(forgotten);
+}
+
+// Starts a non-blocking connect to address. Returns the socket, or
+// INVALID_SOCKET if the attempt failed at once.
+static SOCKET StartConnect(const ResolvedAddress *address) {
+  SOCKET sock = socket(address->addr.ss_family, SOCK_STREAM, IPPROTO_TCP);
+  if (sock == INVALID_SOCKET)
+    return INVALID_SOCKET;
+  u_long nonBlocking = 1;
+  if (ioctlsocket(sock, FIONBIO, &nonBlocking) == SOCKET_ERROR) {
+    closesocket(sock);
+    return INVALID_SOCKET;
+  }
+  if (connect(sock, (const struct sockaddr *)&address->addr,
+              address->length) == SOCKET_ERROR) {
+    int error = WSAGetLastError();
+    if (error != WSAEWOULDBLOCK && error != WSAEINPROGRESS) {
+      closesocket(sock);
+      return INVALID_SOCKET;
+    }
+  }
+  return sock;
+}
+
+// Returns true if the connect on sock has failed.
+static bool ConnectFailed(SOCKET sock) {
+  int error = 0;
+  int errorLen = sizeof(error);
+  if (getsockopt(sock, SOL_SOCKET, SO_ERROR, (char *)&error, &errorLen) ==
+      SOCKET_ERROR)
+    return true;
+  return error != 0;
+}
+
+// Returns true if a socket reported by WSAPoll finished connecting.
+static bool ConnectSucceeded(const WSAPOLLFD *fd) {
+  if (fd->revents & (POLLERR | POLLHUP | POLLNVAL))
+    return false;
+  return !ConnectFailed(fd->fd);
+}
+
+SOCKET ConnectFirstAddress(const ResolvedAddress *addrs, int count,
+                           int timeoutMs) {
+  if (count > RESOLVE_MAX_ADDRESSES)
+    count = RESOLVE_MAX_ADDRESSES;
+
+  WSAPOLLFD pending[RESOLVE_MAX_ADDRESSES];
+  int pendingCount = 0;
+  int started = 0;
+  SOCKET winner = INVALID_SOCKET;
+  ULONGLONG start = GetTickCount64();
+  ULONGLONG nextAttempt = start;
+
+  while (winner == INVALID_SOCKET) {
+    ULONGLONG now = GetTickCount64();
+    if (timeoutMs >= 0 && now - start >= (ULONGLONG)timeoutMs)
+      break;
+
+    // Start the next address when its turn comes, or at once when every
+    // earlier attempt has already failed.
+    if (started < count && (now >= nextAttempt || pendingCount == 0)) {
+      SOCKET sock = StartConnect(&addrs[started++]);
+      if (sock != INVALID_SOCKET) {
+        pending[pendingCount].fd = sock;
+        pending[pendingCount].events = POLLWRNORM;
+        pending[pendingCount].revents = 0;
+        pendingCount++;
+        nextAttempt = now + CONNECT_ATTEMPT_DELAY_MS;
+      }
+      continue;
+    }
+    if (pendingCount == 0)
+      break;
+
+    int waitMs = CONNECT_POLL_SLICE_MS;
+    if (started < count && (int)(nextAttempt - now) < waitMs)
+      waitMs = (int)(nextAttempt - now);
+    if (timeoutMs >= 0) {
+      int remainingMs = (int)(start + (ULONGLONG)timeoutMs - now);
+      if (remainingMs < waitMs)
+        waitMs = remainingMs;
+    }
+    if (WSAPoll(pending, (ULONG)pendingCount, waitMs) == SOCKET_ERROR)
+      break;
+
+    for (int i = 0; i < pendingCount;) {
+      if (pending[i].revents == 0 && !ConnectFailed(pending[i].fd)) {
+        i++;
+        continue;
+      }
+      if (pending[i].revents != 0 && ConnectSucceeded(&pending[i]))
+        winner = pending[i].fd;
+      else
+        closesocket(pending[i].fd);
+      pending[i] = pending[--pendingCount];
+      if (winner != INVALID_SOCKET)
+        break;
+    }
+  }
+
+  for (int i = 0; i < pendingCount; i++)
+    closesocket(pending[i].fd);
+  if (winner != INVALID_SOCKET) {
+    u_long nonBlocking = 0;
+    ioctlsocket(winner, FIONBIO, &nonBlocking);
+  }
+  return winner;
+}
+
+void File::SetResolverCache(int ttlMs) {
+  ResolvedHost *expired = nullptr;
+  {
+    WriteLockGuard guard(&g_resolveLock);
+    g_resolveTtlMs = ttlMs < 0 ? 0 : ttlMs;
+    if (g_resolveTtlMs == 0) {
+      expired = g_resolvedHosts;
+      g_resolvedHosts = nullptr;
+      g_resolvedHostCount = 0;
+    }
+  }
+  FreeResolvedHostList(expired);
+}
+
+void File::ClearResolverCache() {
+  ResolvedHost *expired = nullptr;
+  {
+    WriteLockGuard guard(&g_resolveLock);
+    expired = g_resolvedHosts;
+    g_resolvedHosts = nullptr;
+    g_resolvedHostCount = 0;
+  }
+  FreeResolvedHostList(expired);
+}
+
+long long File::GetResolverLookupCount() {
+  ReadLockGuard guard(&g_resolveLock);
+  return g_resolveLookups;
+}
+
+} // namespace attoboy
@@ -0,0 +1,192 @@
+#include "attoasyncresult_internal.h"
+
+namespace attoboy {
+
+// TransmitFile sends at most 2^31 - 2 bytes per call.
+static const long long TRANSMIT_CHUNK_BYTES = 1LL << 30;
+static const int COPY_CHUNK_BYTES = 65536;
+
+LPFN_TRANSMITFILE GetTransmitFile(SOCKET sock) {
+  static LPFN_TRANSMITFILE transmitFile = nullptr;
+  if (!transmitFile) {
+    GUID guid = WSAID_TRANSMITFILE;
+    LPFN_TRANSMITFILE fn = nullptr;
+    DWORD bytes = 0;
+    if (WSAIoctl(sock, SIO_GET_EXTENSION_FUNCTION_POINTER, &guid, sizeof(guid),
+                 &fn, sizeof(fn), &bytes, nullptr, nullptr) == 0)
+      transmitFile = fn;
+  }
+  return transmitFile;
+}
+
+// Sends the range with TransmitFile, so the bytes go from the file cache to
+// the socket without passing through user space. Each call is overlapped and
+// waited for here; the low bit on the event keeps the completion off the I/O
+// completion port the socket may be bound to. Returns bytes sent, or -1 if
+// nothing could be sent.
+static long long TransmitFileRange(SOCKET sock, HANDLE file, long long offset,
+                                   long long length) {
+  LPFN_TRANSMITFILE transmitFile = GetTransmitFile(sock);
+  HANDLE event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+  if (!transmitFile || !event) {
+    if (event)
+      CloseHandle(event);
+    return -1;
+  }
+
+  long long sent = 0;
+  while (sent < length) {
+    long long remaining = length - sent;
+    DWORD chunk = (DWORD)(remaining < TRANSMIT_CHUNK_BYTES
+                              ? remaining
+                              : TRANSMIT_CHUNK_BYTES);
+    long long position = offset + sent;
+    OVERLAPPED overlapped;
+    ZeroMemory(&overlapped, sizeof(overlapped));
+    overlapped.Offset = (DWORD)position;
+    overlapped.OffsetHigh = (DWORD)(position >> 32);
+    overlapped.hEvent = (HANDLE)((ULONG_PTR)event | 1);
+
+    if (!transmitFile(sock, file, chunk, 0, &overlapped, nullptr, 0) &&
+        WSAGetLastError() != WSA_IO_PENDING)
+      break;
+    DWORD bytes = 0;
+    DWORD flags = 0;
+    if (!WSAGetOverlappedResult(sock, &overlapped, &bytes, TRUE, &flags) ||
+        bytes == 0)
+      break;
+    sent += bytes;
+  }
+
+  CloseHandle(event);
+  return sent > 0 || length == 0 ? sent : -1;
+}
+
+// Fallback for files and pipes: copies the range through a small buffer.
+static long long CopyFileRange(FileImpl *impl, HANDLE file, long long offset,
+                               long long length) {
+  LARGE_INTEGER position;
+  position.QuadPart = offset;
+  if (!SetFilePointerEx(file, position, nullptr, FILE_BEGIN))
+    return -1;
+  unsigned char *scratch =
+      (unsigned char *)HeapAlloc(GetProcessHeap(), 0, COPY_CHUNK_BYTES);
+  if (!scratch)
+    return -1;
+
+  long long sent = 0;
+  while (sent < length) {
+    long long remaining = length - sent;
+    DWORD chunk =
+        (DWORD)(remaining < COPY_CHUNK_BYTES ? remaining : COPY_CHUNK_BYTES);
+    DWORD bytesRead = 0;
+    if (!ReadFile(file, scratch, chunk, &bytesRead, nullptr) ||
+        bytesRead == 0 || !WriteFileImplAll(impl, scratch, (int)bytesRead))
+      break;
+    sent += bytesRead;
+  }
+
+  HeapFree(GetProcessHeap(), 0, scratch);
+  return sent > 0 || length == 0 ? sent : -1;
+}
+
+// Opens path for sending and clamps length (-1 = to the end) to the bytes
+// after offset. Returns INVALID_HANDLE_VALUE if the file cannot be opened or
+// offset is past its end.
+static HANDLE OpenSendFile(const Path &path, long long offset,
+                           long long *length) {
+  WCHAR *pathWide = Utf8ToWide(path.toString().c_str());
+  if (!pathWide)
+    return INVALID_HANDLE_VALUE;
+  HANDLE file = CreateFileW(pathWide, GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                FILE_SHARE_DELETE,
+                            nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN,
+                            nullptr);
+  FreeConvertedString(pathWide);
+  if (file == INVALID_HANDLE_VALUE)
+    return INVALID_HANDLE_VALUE;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || offset > size.QuadPart) {
+    CloseHandle(file);
+    return INVALID_HANDLE_VALUE;
+  }
+  if (*length < 0 || *length > size.QuadPart - offset)
+    *length = size.QuadPart - offset;
+  return file;
+}
+
+long long File::sendFile(const Path &path, long long offset,
+                         long long length) {
+  if (!impl || !impl->isOpen || !impl->isValid || offset < 0 ||
+      impl->type == FILE_TYPE_SERVER_SOCKET)
+    return -1;
+
+  HANDLE file = OpenSendFile(path, offset, &length);
+  if (file == INVALID_HANDLE_VALUE)
+    return -1;
+
+  long long sent;
+  {
+    WriteLockGuard lock(&impl->lock);
+    if (impl->type == FILE_TYPE_SOCKET)
+      sent = TransmitFileRange(impl->sock, file, offset, length);
+    else
+      sent = CopyFileRange(impl, file, offset, length);
+  }
+
+  CloseHandle(file);
+  return sent;
+}
+
+AsyncResult File::sendFileAsync(const Path &path, long long offset,
+                                long long length, AsyncCallback callback,
+                                void *arg) {
+  AsyncResultImpl *op = AllocAsyncResultImpl(ASYNC_OP_SEND_FILE, callback, arg);
+  AsyncResult result(op);
+  if (!op)
+    return result;
+
+  HANDLE file = offset >= 0 ? OpenSendFile(path, offset, &length)
+                            : INVALID_HANDLE_VALUE;
+  if (file == INVALID_HANDLE_VALUE || !AttachAsyncFile(op, *this, impl)) {
+    if (file != INVALID_HANDLE_VALUE)
+      CloseHandle(file);
+    FailAsyncOp(op);
+    return result;
+  }
+  op->sourceFile = file;
+  op->requested = (int)(length < TRANSMIT_CHUNK_BYTES ? length
+                                                      : TRANSMIT_CHUNK_BYTES);
+
+  // TransmitFile reads a count of 0 as the whole file.
+  HANDLE port = GetAsyncPort();
+  if (op->requested == 0) {
+    if (!port ||
+        !PostQueuedCompletionStatus(port, 0, ASYNC_KEY_IO, &op->overlapped))
+      CompleteAsyncOp(op, true, 0);
+    return result;
+  }
+
+  bool started = false;
+  {
+    WriteLockGuard guard(&impl->lock);
+    LPFN_TRANSMITFILE transmitFile = nullptr;
+    if (impl->type == FILE_TYPE_SOCKET && impl->isOpen && impl->isValid &&
+        BindAsyncSocket(impl))
+      transmitFile = GetTransmitFile(impl->sock);
+    if (transmitFile) {
+      op->overlapped.Offset = (DWORD)offset;
+      op->overlapped.OffsetHigh = (DWORD)(offset >> 32);
+      started = transmitFile(impl->sock, file, (DWORD)op->requested, 0,
+                             &op->overlapped, nullptr, 0) ||
+                WSAGetLastError() == WSA_IO_PENDING;
+    }
+  }
+  if (!started)
+    FailAsyncOp(op);
+  return result;
+}
+
+} // namespace attoboy
@@ -1,4 +1,6 @@
 #include "attofile_internal.h"
+#include "attobuffer_internal.h"
+#include "attobufferchain_internal.h"
 
 namespace attoboy {
 
@@ -14,10 +16,7 @@ int File::write(const Buffer &buf) {
   WriteLockGuard lock(&impl->lock);
 
   if (impl->type == FILE_TYPE_SOCKET) {
-    int bytesSent = send(impl->sock, (const char *)data, len, 0);
-    if (bytesSent == SOCKET_ERROR)
-      return -1;
-    return bytesSent;
+    return SendFileImplChunk(impl, (const char *)data, len);
   } else {
     DWORD bytesWritten = 0;
     if (!WriteFile(impl->handle, data, len, &bytesWritten, nullptr))
@@ -44,10 +43,7 @@ int File::write(const String &str) {
   WriteLockGuard lock(&impl->lock);
 
   if (impl->type == FILE_TYPE_SOCKET) {
-    int bytesSent = send(impl->sock, (const char *)data, byteLen, 0);
-    if (bytesSent == SOCKET_ERROR)
-      return -1;
-    return bytesSent;
+    return SendFileImplChunk(impl, (const char *)data, byteLen);
   } else {
     DWORD bytesWritten = 0;
     if (!WriteFile(impl->handle, data, byteLen, &bytesWritten, nullptr))
@@ -77,10 +73,7 @@ int File::writeUpTo(const Buffer &buf, int count) {
   WriteLockGuard lock(&impl->lock);
 
   if (impl->type == FILE_TYPE_SOCKET) {
-    int bytesSent = send(impl->sock, (const char *)data, count, 0);
-    if (bytesSent == SOCKET_ERROR)
-      return -1;
-    return bytesSent;
+    return SendFileImplChunk(impl, (const char *)data, count);
   } else {
     DWORD bytesWritten = 0;
     if (!WriteFile(impl->handle, data, count, &bytesWritten, nullptr))
@@ -115,10 +108,7 @@ int File::writeUpTo(const String &str, int count) {
   WriteLockGuard lock(&impl->lock);
 
   if (impl->type == FILE_TYPE_SOCKET) {
-    int bytesSent = send(impl->sock, (const char *)data, count, 0);
-    if (bytesSent == SOCKET_ERROR)
-      return -1;
-    return bytesSent;
+    return SendFileImplChunk(impl, (const char *)data, count);
   } else {
     DWORD bytesWritten = 0;
     if (!WriteFile(impl->handle, data, count, &bytesWritten, nullptr))
@@ -128,6 +118,84 @@ int File::writeUpTo(const String &str, int count) {
   }
 }
 
+int File::write(const BufferChain &chain) {
+  if (!impl || !impl->isOpen || !impl->isValid)
+    return -1;
+  if (!chain.impl)
+    return 0;
+
+  BufferChainImpl *chainImpl = chain.impl;
+  ReadLockGuard chainLock(&chainImpl->lock);
+  if (chainImpl->size == 0)
+    return 0;
+
+  const BufferSegment *segments = chainImpl->segments + chainImpl->start;
+  int count = chainImpl->count;
+
+  WriteLockGuard lock(&impl->lock);
+
+  if (impl->type == FILE_TYPE_SOCKET) {
+    WSABUF *bufs =
+        (WSABUF *)HeapAlloc(GetProcessHeap(), 0, count * sizeof(WSABUF));
+    if (!bufs)
+      return -1;
+    for (int i = 0; i < count; i++) {
+      bufs[i].buf = (char *)segments[i].data;
+      bufs[i].len = (ULONG)segments[i].size;
+    }
+
+    DWORD bytesSent = 0;
+    int result = WSASend(impl->sock, bufs, (DWORD)count, &bytesSent, 0,
+                         nullptr, nullptr);
+    HeapFree(GetProcessHeap(), 0, bufs);
+    if (result == SOCKET_ERROR)
+      return -1;
+    return (int)bytesSent;
+  } else {
+    for (int i = 0; i < count; i++) {
+      if (!WriteFileImplAll(impl, segments[i].data, segments[i].size))
+        return -1;
+    }
+    FlushFileBuffers(impl->handle);
+    return chainImpl->size;
+  }
+}
+
+int File::writeBase64(const Buffer &buf, bool urlSafe, bool pad) {
+  if (!impl || !impl->isOpen || !impl->isValid)
+    return -1;
+
+  int len = 0;
+  const unsigned char *data = buf.c_ptr(&len);
+  if (!data || len == 0)
+    return 0;
+
+  // Input chunks are a multiple of 3 bytes so only the last one can pad.
+  const int chunkBytes = 48 * 1024;
+  int scratchSize = Base64EncodedLength(chunkBytes, true);
+  char *scratch = (char *)HeapAlloc(GetProcessHeap(), 0, scratchSize);
+  if (!scratch)
+    return -1;
+
+  WriteLockGuard lock(&impl->lock);
+
+  int total = 0;
+  for (int offset = 0; offset < len; offset += chunkBytes) {
+    int count = len - offset < chunkBytes ? len - offset : chunkBytes;
+    int encoded = Base64Encode(data + offset, count, scratch, urlSafe, pad);
+    if (!WriteFileImplAll(impl, (const unsigned char *)scratch, encoded)) {
+      HeapFree(GetProcessHeap(), 0, scratch);
+      return -1;
+    }
+    total += encoded;
+  }
+
+  HeapFree(GetProcessHeap(), 0, scratch);
+  if (impl->type != FILE_TYPE_SOCKET)
+    FlushFileBuffers(impl->handle);
+  return total;
+}
+
 bool File::flush() {
   if (!impl || !impl->isOpen || !impl->isValid)
     return false;
@@ -0,0 +1,461 @@
+#include "attofilecopier_internal.h"
+#include "attodatetime_internal.h"
+
+namespace attoboy {
+
+// Trims trailing separators so the root matches DirectoryWalker's paths.
+static WCHAR *GetCopyRoot(const Path &path) {
+  String text = path.toString();
+  if (text.isEmpty())
+    text = String(".");
+  WCHAR *root = Utf8ToWide(text.c_str());
+  if (root)
+    TrimPathSeparators(root);
+  return root;
+}
+
+// Returns whether path ends in a separator, as only a drive root does.
+static bool EndsWithCopySeparator(const WCHAR *path) {
+  int len = lstrlenW(path);
+  return len > 0 && IsPathSeparator(path[len - 1]);
+}
+
+static WCHAR *CopyCopierString(const WCHAR *str) {
+  int len = lstrlenW(str);
+  WCHAR *copy =
+      (WCHAR *)HeapAlloc(GetProcessHeap(), 0, (len + 1) * sizeof(WCHAR));
+  if (copy)
+    CopyMemory(copy, str, (len + 1) * sizeof(WCHAR));
+  return copy;
+}
+
+static WCHAR *JoinCopyPath(const WCHAR *first, const WCHAR *second) {
+  int firstLen = lstrlenW(first);
+  int secondLen = lstrlenW(second);
+  int separator = EndsWithCopySeparator(first) ? 0 : 1;
+  int len = firstLen + separator + secondLen;
+  WCHAR *joined =
+      (WCHAR *)HeapAlloc(GetProcessHeap(), 0, (len + 1) * sizeof(WCHAR));
+  if (!joined)
+    return nullptr;
+  CopyMemory(joined, first, firstLen * sizeof(WCHAR));
+  if (separator)
+    joined[firstLen] = L'\\';
+  CopyMemory(joined + firstLen + separator, second,
+             secondLen * sizeof(WCHAR));
+  joined[len] = 0;
+  return joined;
+}
+
+static bool GrowCopyArray(void **data, int *capacity, int needed,
+                          int elementSize) {
+  if (needed <= *capacity)
+    return true;
+  int grown = *capacity ? *capacity * 2 : 64;
+  while (grown < needed)
+    grown *= 2;
+  void *larger =
+      *data ? HeapReAlloc(GetProcessHeap(), 0, *data, grown * elementSize)
+            : HeapAlloc(GetProcessHeap(), 0, grown * elementSize);
+  if (!larger)
+    return false;
+  *data = larger;
+  *capacity = grown;
+  return true;
+}
+
+static long long CopyTimeToMilliseconds(const FILETIME &time) {
+  ULARGE_INTEGER uli;
+  uli.LowPart = time.dwLowDateTime;
+  uli.HighPart = time.dwHighDateTime;
+  return Div64((long long)uli.QuadPart, 10000LL) - 11644473600000LL;
+}
+
+// Takes ownership of source and destination.
+static bool AddCopyJob(FileCopierImpl *impl, WCHAR *source,
+                       WCHAR *destination, long long size,
+                       long long modified) {
+  if (!source || !destination ||
+      !GrowCopyArray((void **)&impl->jobs, &impl->jobCapacity,
+                     impl->jobCount + 1, sizeof(CopyJob))) {
+    FreeConvertedString(source);
+    FreeConvertedString(destination);
+    return false;
+  }
+  CopyJob *job = &impl->jobs[impl->jobCount++];
+  job->source = source;
+  job->destination = destination;
+  job->size = size;
+  job->modified = modified;
+  impl->totalBytes += size;
+  return true;
+}
+
+static void ClearCopyJobs(FileCopierImpl *impl) {
+  for (int i = 0; i < impl->jobCount; i++) {
+    FreeConvertedString(impl->jobs[i].source);
+    FreeConvertedString(impl->jobs[i].destination);
+  }
+  impl->jobCount = 0;
+  for (int i = 0; i < impl->directoryCount; i++)
+    FreeConvertedString(impl->directories[i]);
+  impl->directoryCount = 0;
+}
+
+static bool MakeCopyDirectory(const WCHAR *path) {
+  return CreateDirectoryW(path, nullptr) ||
+         GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+// Lists the files to copy and creates the destination directories, which
+// the walk reports before their contents.
+static bool CollectCopyJobs(FileCopierImpl *impl) {
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (!GetFileAttributesExW(impl->source, GetFileExInfoStandard, &data))
+    return false;
+  if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+    long long size =
+        ((long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    return AddCopyJob(impl, CopyCopierString(impl->source),
+                      CopyCopierString(impl->destination), size,
+                      CopyTimeToMilliseconds(data.ftLastWriteTime));
+  }
+
+  char *destination = WideToUtf8(impl->destination);
+  bool made = destination && Path(String(destination)).makeDirectory(true);
+  FreeConvertedString(destination);
+  if (!made && !MakeCopyDirectory(impl->destination))
+    return false;
+
+  char *source = WideToUtf8(impl->source);
+  WCHAR *root = CopyCopierString(impl->source);
+  if (!source || !root ||
+      !GrowCopyArray((void **)&impl->directories, &impl->directoryCapacity,
+                     1, sizeof(WCHAR *))) {
+    FreeConvertedString(source);
+    FreeConvertedString(root);
+    return false;
+  }
+  impl->directories[impl->directoryCount++] = root;
+  Path sourcePath = Path(String(source));
+  FreeConvertedString(source);
+  DirectoryWalker walker(sourcePath);
+  int prefix = lstrlenW(impl->source) +
+               (EndsWithCopySeparator(impl->source) ? 0 : 1);
+  while (walker.next()) {
+    if (walker.isDirectory() && walker.isSymbolicLink())
+      continue;
+    String relative = walker.getPath().substring(prefix);
+    WCHAR *name = Utf8ToWide(relative.c_str());
+    if (!name) {
+      InterlockedIncrement(&impl->failedFiles);
+      continue;
+    }
+    WCHAR *from = JoinCopyPath(impl->source, name);
+    WCHAR *to = JoinCopyPath(impl->destination, name);
+    FreeConvertedString(name);
+    if (!walker.isDirectory()) {
+      if (!AddCopyJob(impl, from, to, walker.getSize(),
+                      walker.getModifiedOn().timestamp()))
+        InterlockedIncrement(&impl->failedFiles);
+      continue;
+    }
+    if (!to || !MakeCopyDirectory(to))
+      InterlockedIncrement(&impl->failedFiles);
+    FreeConvertedString(to);
+    // Remembered (after their parents) so move() can remove the emptied
+    // source tree.
+    if (from && GrowCopyArray((void **)&impl->directories,
+                              &impl->directoryCapacity,
+                              impl->directoryCount + 1, sizeof(WCHAR *)))
+      impl->directories[impl->directoryCount++] = from;
+    else
+      FreeConvertedString(from);
+  }
+  impl->failedFiles += walker.getErrorCount();
+  return true;
+}
+
+// Calls the progress callback. Returns false once the copy is cancelled.
+static bool ReportCopyProgress(FileCopierImpl *impl) {
+  if (impl->cancelled)
+    return false;
+  if (!impl->callback)
+    return true;
+  AcquireSRWLockExclusive(&impl->progressLock);
+  bool proceed = impl->callback(impl->copiedBytes, impl->totalBytes,
+                                impl->copiedFiles, impl->jobCount,
+                                impl->callbackArg);
+  ReleaseSRWLockExclusive(&impl->progressLock);
+  if (!proceed)
+    InterlockedExchange(&impl->cancelled, 1);
+  return proceed;
+}
+
+// Progress of one CopyFileEx call; reported is what has been added to the
+// copier's byte count so far.
+struct CopyProgress {
+  FileCopierImpl *impl;
+  long long reported;
+};
+
+static DWORD CALLBACK CopyProgressRoutine(
+    LARGE_INTEGER totalSize, LARGE_INTEGER transferred,
+    LARGE_INTEGER streamSize, LARGE_INTEGER streamTransferred,
+    DWORD streamNumber, DWORD reason, HANDLE sourceFile,
+    HANDLE destinationFile, LPVOID data) {
+  CopyProgress *progress = (CopyProgress *)data;
+  long long delta = transferred.QuadPart - progress->reported;
+  if (delta > 0) {
+    progress->reported = transferred.QuadPart;
+    InterlockedExchangeAdd64(&progress->impl->copiedBytes, delta);
+  }
+  return ReportCopyProgress(progress->impl) ? PROGRESS_CONTINUE
+                                            : PROGRESS_CANCEL;
+}
+
+static bool IsCopyUpToDate(const CopyJob *job) {
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (!GetFileAttributesExW(job->destination, GetFileExInfoStandard, &data))
+    return false;
+  long long size =
+      ((long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+  return size == job->size &&
+         CopyTimeToMilliseconds(data.ftLastWriteTime) == job->modified;
+}
+
+static void CopyOneFile(FileCopierImpl *impl, const CopyJob *job) {
+  bool done;
+  if (impl->incremental && IsCopyUpToDate(job)) {
+    InterlockedIncrement(&impl->skippedFiles);
+    done = true;
+  } else {
+    // Unbuffered copies skip the cache, which only slows large files down
+    // and evicts everything else.
+    DWORD flags = 0;
+    if (impl->unbufferedThreshold >= 0 &&
+        job->size >= impl->unbufferedThreshold)
+      flags |= COPY_FILE_NO_BUFFERING;
+    CopyProgress progress = {impl, 0};
+    done = CopyFileExW(job->source, job->destination, CopyProgressRoutine,
+                       &progress, nullptr, flags) != 0;
+    if (done) {
+      InterlockedIncrement(&impl->copiedFiles);
+    } else {
+      InterlockedExchangeAdd64(&impl->copiedBytes, -progress.reported);
+      if (!impl->cancelled)
+        InterlockedIncrement(&impl->failedFiles);
+    }
+  }
+  if (done && impl->moving && !DeleteFileW(job->source))
+    InterlockedIncrement(&impl->failedFiles);
+  ReportCopyProgress(impl);
+}
+
+static DWORD WINAPI FileCopierWorkerProc(LPVOID param) {
+  FileCopierImpl *impl = (FileCopierImpl *)param;
+  while (!impl->cancelled) {
+    LONG index = InterlockedIncrement(&impl->nextJob) - 1;
+    if (index >= impl->jobCount)
+      break;
+    CopyOneFile(impl, &impl->jobs[index]);
+  }
+  return 0;
+}
+
+// Copies the collected jobs with a pool of workers that each take the next
+// job, so many small files keep every worker busy.
+static void CopyAllJobs(FileCopierImpl *impl) {
+  int threads = impl->threadCount;
+  if (threads <= 0) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    threads = (int)info.dwNumberOfProcessors;
+  }
+  if (threads > impl->jobCount)
+    threads = impl->jobCount;
+  // The calling thread is one of the workers.
+  HANDLE *workers = threads > 1 ? (HANDLE *)HeapAlloc(
+                                      GetProcessHeap(), 0,
+                                      (threads - 1) * sizeof(HANDLE))
+                                : nullptr;
+  int workerCount = 0;
+  for (int i = 0; workers && i < threads - 1; i++) {
+    HANDLE worker =
+        CreateThread(nullptr, 0, FileCopierWorkerProc, impl, 0, nullptr);
+    if (worker)
+      workers[workerCount++] = worker;
+  }
+  FileCopierWorkerProc(impl);
+  for (int i = 0; i < workerCount; i++) {
+    WaitForSingleObject(workers[i], INFINITE);
+    CloseHandle(workers[i]);
+  }
+  if (workers)
+    HeapFree(GetProcessHeap(), 0, workers);
+}
+
+static bool RunFileCopier(FileCopierImpl *impl, bool moving) {
+  {
+    WriteLockGuard guard(&impl->lock);
+    if (impl->running || !impl->source || !impl->destination)
+      return false;
+    impl->running = true;
+  }
+  ClearCopyJobs(impl);
+  impl->moving = moving;
+  impl->nextJob = 0;
+  impl->cancelled = 0;
+  impl->totalBytes = 0;
+  impl->copiedBytes = 0;
+  impl->copiedFiles = 0;
+  impl->skippedFiles = 0;
+  impl->failedFiles = 0;
+  impl->startTick = GetTickCount64();
+  impl->endTick = 0;
+
+  bool listed;
+  if (moving && MoveFileExW(impl->source, impl->destination, 0)) {
+    listed = true;
+  } else {
+    listed = CollectCopyJobs(impl);
+    if (listed)
+      CopyAllJobs(impl);
+    // Remove the emptied source directories, deepest first. Any that
+    // still hold a file that failed to move stay behind.
+    if (listed && moving && !impl->cancelled) {
+      bool clean = impl->failedFiles == 0;
+      for (int i = impl->directoryCount - 1; i >= 0; i--) {
+        if (!RemoveDirectoryW(impl->directories[i]) && clean)
+          InterlockedIncrement(&impl->failedFiles);
+      }
+    }
+  }
+  impl->endTick = GetTickCount64();
+
+  WriteLockGuard guard(&impl->lock);
+  impl->running = false;
+  return listed && !impl->cancelled && impl->failedFiles == 0;
+}
+
+static void FreeFileCopierImpl(FileCopierImpl *impl) {
+  ClearCopyJobs(impl);
+  if (impl->jobs)
+    HeapFree(GetProcessHeap(), 0, impl->jobs);
+  if (impl->directories)
+    HeapFree(GetProcessHeap(), 0, impl->directories);
+  FreeConvertedString(impl->source);
+  FreeConvertedString(impl->destination);
+  HeapFree(GetProcessHeap(), 0, impl);
+}
+
+FileCopier::FileCopier(const Path &source, const Path &destination) {
+  impl = (FileCopierImpl *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                     sizeof(FileCopierImpl));
+  if (!impl)
+    return;
+  InitializeSRWLock(&impl->lock);
+  InitializeSRWLock(&impl->progressLock);
+  impl->refCount = 1;
+  impl->threadCount = 4;
+  impl->unbufferedThreshold = FILE_COPIER_UNBUFFERED_THRESHOLD;
+  impl->source = GetCopyRoot(source);
+  impl->destination = GetCopyRoot(destination);
+}
+
+FileCopier::FileCopier(const FileCopier &other) {
+  impl = other.impl;
+  if (impl)
+    InterlockedIncrement(&impl->refCount);
+}
+
+FileCopier::~FileCopier() {
+  if (impl && InterlockedDecrement(&impl->refCount) == 0)
+    FreeFileCopierImpl(impl);
+}
+
+FileCopier &FileCopier::operator=(const FileCopier &other) {
+  if (this != &other) {
+    if (impl && InterlockedDecrement(&impl->refCount) == 0)
+      FreeFileCopierImpl(impl);
+    impl = other.impl;
+    if (impl)
+      InterlockedIncrement(&impl->refCount);
+  }
+  return *this;
+}
+
+FileCopier &FileCopier::setThreads(int threads) {
+  if (!impl)
+    return *this;
+  WriteLockGuard guard(&impl->lock);
+  if (!impl->running)
+    impl->threadCount = threads;
+  return *this;
+}
+
+FileCopier &FileCopier::setIncremental(bool incremental) {
+  if (!impl)
+    return *this;
+  WriteLockGuard guard(&impl->lock);
+  if (!impl->running)
+    impl->incremental = incremental;
+  return *this;
+}
+
+FileCopier &FileCopier::setUnbufferedThreshold(long long bytes) {
+  if (!impl)
+    return *this;
+  WriteLockGuard guard(&impl->lock);
+  if (!impl->running)
+    impl->unbufferedThreshold = bytes;
+  return *this;
+}
+
+FileCopier &FileCopier::setProgressCallback(CopyProgressCallback callback,
+                                            void *arg) {
+  if (!impl)
+    return *this;
+  WriteLockGuard guard(&impl->lock);
+  if (!impl->running) {
+    impl->callback = callback;
+    impl->callbackArg = arg;
+  }
+  return *this;
+}
+
+bool FileCopier::copy() { return impl && RunFileCopier(impl, false); }
+
+bool FileCopier::move() { return impl && RunFileCopier(impl, true); }
+
+long long FileCopier::getCopiedBytes() const {
+  return impl ? impl->copiedBytes : 0;
+}
+
+int FileCopier::getCopiedFileCount() const {
+  return impl ? impl->copiedFiles : 0;
+}
+
+int FileCopier::getSkippedFileCount() const {
+  return impl ? impl->skippedFiles : 0;
+}
+
+int FileCopier::getFailedFileCount() const {
+  return impl ? impl->failedFiles : 0;
+}
+
+long long FileCopier::getElapsedMilliseconds() const {
+  if (!impl || !impl->startTick)
+    return 0;
+  ULONGLONG end = impl->endTick ? impl->endTick : GetTickCount64();
+  return (long long)(end - impl->startTick);
+}
+
+long long FileCopier::getBytesPerSecond() const {
+  long long elapsed = getElapsedMilliseconds();
+  long long copied = getCopiedBytes();
+  return elapsed > 0 ? Div64((long long)MulU64By32(copied, 1000), elapsed)
+                     : copied;
+}
+
+} // namespace attoboy
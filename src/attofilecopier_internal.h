@@ -0,0 +1,54 @@
+#pragma once
+#include "atto_internal_common.h"
+#include "attoboy/attoboy.h"
+#include <windows.h>
+
+namespace attoboy {
+
+static const long long FILE_COPIER_UNBUFFERED_THRESHOLD = 64LL * 1024 * 1024;
+
+// One file to copy. modified is in milliseconds since 1970, as reported by
+// the directory listing.
+struct CopyJob {
+  WCHAR *source;
+  WCHAR *destination;
+  long long size;
+  long long modified;
+};
+
+// Settings are guarded by lock; jobs and the counters belong to the
+// running copy() or move(), whose workers update the counters with
+// interlocked operations. progressLock serializes the callback.
+struct FileCopierImpl {
+  WCHAR *source;
+  WCHAR *destination;
+  int threadCount;
+  bool incremental;
+  long long unbufferedThreshold;
+  CopyProgressCallback callback;
+  void *callbackArg;
+
+  bool running;
+  bool moving;
+  CopyJob *jobs;
+  int jobCount;
+  int jobCapacity;
+  WCHAR **directories;
+  int directoryCount;
+  int directoryCapacity;
+  volatile LONG nextJob;
+  volatile LONG cancelled;
+  long long totalBytes;
+  volatile LONGLONG copiedBytes;
+  volatile LONG copiedFiles;
+  volatile LONG skippedFiles;
+  volatile LONG failedFiles;
+  ULONGLONG startTick;
+  ULONGLONG endTick;
+
+  SRWLOCK lock;
+  SRWLOCK progressLock;
+  volatile LONG refCount;
+};
+
+} // namespace attoboy
@@ -0,0 +1,126 @@
+#include "attofile_internal.h"
+#include "attohasher_internal.h"
+
+namespace attoboy {
+
+static const int HASHER_FILE_CHUNK = 65536;
+
+static HasherImpl *AllocHasherImpl() {
+  HasherImpl *impl = (HasherImpl *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(HasherImpl));
+  if (impl)
+    InitializeSRWLock(&impl->lock);
+  return impl;
+}
+
+static void HasherFeed(HasherImpl *impl, const unsigned char *data, int len) {
+  XXH64Update(&impl->xxh, data, len);
+  impl->crc = Crc32cUpdate(impl->crc, data, len);
+}
+
+Hasher::Hasher(long long seed) {
+  impl = AllocHasherImpl();
+  if (impl)
+    XXH64Init(&impl->xxh, (unsigned long long)seed);
+}
+
+Hasher::Hasher(const Hasher &other) {
+  impl = AllocHasherImpl();
+  if (impl && other.impl) {
+    ReadLockGuard guard(&other.impl->lock);
+    impl->xxh = other.impl->xxh;
+    impl->crc = other.impl->crc;
+  }
+}
+
+Hasher::~Hasher() {
+  if (impl)
+    HeapFree(GetProcessHeap(), 0, impl);
+}
+
+Hasher &Hasher::operator=(const Hasher &other) {
+  if (this == &other || !impl || !other.impl)
+    return *this;
+
+  WriteLockGuard guard(&impl->lock);
+  ReadLockGuard otherGuard(&other.impl->lock);
+  impl->xxh = other.impl->xxh;
+  impl->crc = other.impl->crc;
+  return *this;
+}
+
+Hasher &Hasher::update(const Buffer &buf) {
+  int len = 0;
+  const unsigned char *data = buf.c_ptr(&len);
+  return update(data, len);
+}
+
+Hasher &Hasher::update(const String &str) {
+  return update((const unsigned char *)str.c_str(), str.byteLength());
+}
+
+Hasher &Hasher::update(const unsigned char *ptr, int size) {
+  if (!impl || !ptr || size <= 0)
+    return *this;
+
+  WriteLockGuard guard(&impl->lock);
+  HasherFeed(impl, ptr, size);
+  return *this;
+}
+
+Hasher &Hasher::update(File &file) {
+  FileImpl *fileImpl = file.impl;
+  if (!impl || !fileImpl || !fileImpl->isOpen || !fileImpl->isValid)
+    return *this;
+
+  unsigned char *chunk =
+      (unsigned char *)HeapAlloc(GetProcessHeap(), 0, HASHER_FILE_CHUNK);
+  if (!chunk)
+    return *this;
+
+  ReadLockGuard fileGuard(&fileImpl->lock);
+  WriteLockGuard guard(&impl->lock);
+
+  int bytesRead;
+  while ((bytesRead = ReadFileImplChunk(fileImpl, chunk, HASHER_FILE_CHUNK)) >
+         0)
+    HasherFeed(impl, chunk, bytesRead);
+
+  HeapFree(GetProcessHeap(), 0, chunk);
+  return *this;
+}
+
+void Hasher::reset() {
+  if (!impl)
+    return;
+
+  WriteLockGuard guard(&impl->lock);
+  XXH64Init(&impl->xxh, impl->xxh.seed);
+  impl->crc = 0;
+}
+
+long long Hasher::hash64() const {
+  if (!impl)
+    return 0;
+
+  ReadLockGuard guard(&impl->lock);
+  return (long long)XXH64Digest(&impl->xxh);
+}
+
+int Hasher::crc32c() const {
+  if (!impl)
+    return 0;
+
+  ReadLockGuard guard(&impl->lock);
+  return (int)impl->crc;
+}
+
+long long Hasher::length() const {
+  if (!impl)
+    return 0;
+
+  ReadLockGuard guard(&impl->lock);
+  return (long long)impl->xxh.total;
+}
+
+} // namespace attoboy
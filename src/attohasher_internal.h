@@ -0,0 +1,15 @@
+#pragma once
+#include "atto_internal_common.h"
+#include "atto_internal_hash.h"
+#include "attoboy/attoboy.h"
+#include <windows.h>
+
+namespace attoboy {
+
+struct HasherImpl {
+  XXH64State xxh;
+  unsigned int crc;
+  mutable SRWLOCK lock;
+};
+
+} // namespace attoboy
@@ -0,0 +1,271 @@
+#include "attomappedfile_internal.h"
+#include "attopath_internal.h"
+
+namespace attoboy {
+
+static void DestroyMappedView(BufferStorage *storage) {
+  MappedViewStorage *view = (MappedViewStorage *)storage;
+  if (view->base)
+    UnmapViewOfFile(view->base);
+  HeapFree(GetProcessHeap(), 0, view);
+}
+
+static long long AllocationGranularity() {
+  static DWORD granularity = 0;
+  if (granularity == 0) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    granularity = info.dwAllocationGranularity ? info.dwAllocationGranularity
+                                               : 65536;
+  }
+  return (long long)granularity;
+}
+
+// Drops the current view. Buffers still holding it keep it mapped.
+static void ReleaseWindow(MappedFileImpl *impl) {
+  ReleaseBufferStorage((BufferStorage *)impl->view);
+  impl->view = nullptr;
+  impl->data = nullptr;
+  impl->windowLength = 0;
+}
+
+// Maps length bytes starting at offset. Caller holds the write lock and has
+// clamped offset and length to the file.
+static bool MapWindow(MappedFileImpl *impl, long long offset, int length) {
+  ReleaseWindow(impl);
+  impl->windowOffset = offset;
+  if (length <= 0)
+    return true;
+
+  // The granularity is a power of two; masking avoids a 64-bit modulo.
+  long long aligned = offset & ~(AllocationGranularity() - 1);
+  SIZE_T viewSize = (SIZE_T)(offset - aligned) + (SIZE_T)length;
+  DWORD access = impl->writable ? FILE_MAP_WRITE : FILE_MAP_READ;
+  void *base = MapViewOfFile(impl->mapping, access,
+                             (DWORD)((unsigned long long)aligned >> 32),
+                             (DWORD)(aligned & 0xFFFFFFFF), viewSize);
+  if (!base)
+    return false;
+
+  MappedViewStorage *view = (MappedViewStorage *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(MappedViewStorage));
+  if (!view) {
+    UnmapViewOfFile(base);
+    return false;
+  }
+  view->header.refCount = 1;
+  view->header.capacity = length;
+  view->header.destroy = DestroyMappedView;
+  view->base = base;
+
+  impl->view = view;
+  impl->data = (unsigned char *)base + (offset - aligned);
+  impl->windowLength = length;
+  return true;
+}
+
+static void CloseMappedFile(MappedFileImpl *impl) {
+  ReleaseWindow(impl);
+  if (impl->mapping) {
+    CloseHandle(impl->mapping);
+    impl->mapping = nullptr;
+  }
+  if (impl->file != INVALID_HANDLE_VALUE) {
+    CloseHandle(impl->file);
+    impl->file = INVALID_HANDLE_VALUE;
+  }
+  impl->fileSize = 0;
+  impl->windowOffset = 0;
+}
+
+MappedFile::MappedFile(const Path &path, bool writable) {
+  impl = (MappedFileImpl *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                     sizeof(MappedFileImpl));
+  if (!impl)
+    return;
+  InitializeSRWLock(&impl->lock);
+  impl->file = INVALID_HANDLE_VALUE;
+  impl->writable = writable;
+  impl->refCount = 1;
+
+  if (!path.impl)
+    return;
+
+  WCHAR *pathWide = nullptr;
+  {
+    ReadLockGuard lock(&path.impl->lock);
+    if (path.impl->pathStr && path.impl->len > 0)
+      pathWide = Utf8ToWide(path.impl->pathStr);
+  }
+  if (!pathWide)
+    return;
+
+  DWORD access = writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+  impl->file = CreateFileW(pathWide, access, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                           nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                           nullptr);
+  FreeConvertedString(pathWide);
+  if (impl->file == INVALID_HANDLE_VALUE)
+    return;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(impl->file, &size)) {
+    CloseMappedFile(impl);
+    return;
+  }
+  impl->fileSize = size.QuadPart;
+
+  // Empty files cannot be mapped; they stay valid with an empty window.
+  if (impl->fileSize == 0)
+    return;
+
+  impl->mapping = CreateFileMappingW(
+      impl->file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0,
+      nullptr);
+  if (!impl->mapping) {
+    CloseMappedFile(impl);
+    return;
+  }
+
+  int length = impl->fileSize < MAPPED_DEFAULT_WINDOW ? (int)impl->fileSize
+                                                      : MAPPED_DEFAULT_WINDOW;
+  if (!MapWindow(impl, 0, length))
+    CloseMappedFile(impl);
+}
+
+MappedFile::MappedFile(const MappedFile &other) {
+  impl = other.impl;
+  if (impl)
+    InterlockedIncrement(&impl->refCount);
+}
+
+MappedFile::~MappedFile() {
+  if (impl && InterlockedDecrement(&impl->refCount) == 0) {
+    CloseMappedFile(impl);
+    HeapFree(GetProcessHeap(), 0, impl);
+  }
+}
+
+MappedFile &MappedFile::operator=(const MappedFile &other) {
+  if (this != &other) {
+    if (impl && InterlockedDecrement(&impl->refCount) == 0) {
+      CloseMappedFile(impl);
+      HeapFree(GetProcessHeap(), 0, impl);
+    }
+    impl = other.impl;
+    if (impl)
+      InterlockedIncrement(&impl->refCount);
+  }
+  return *this;
+}
+
+bool MappedFile::isValid() const {
+  if (!impl)
+    return false;
+  ReadLockGuard lock(&impl->lock);
+  return impl->file != INVALID_HANDLE_VALUE;
+}
+
+bool MappedFile::isWritable() const {
+  if (!impl)
+    return false;
+  ReadLockGuard lock(&impl->lock);
+  return impl->file != INVALID_HANDLE_VALUE && impl->writable;
+}
+
+long long MappedFile::getSize() const {
+  if (!impl)
+    return 0;
+  ReadLockGuard lock(&impl->lock);
+  return impl->fileSize;
+}
+
+bool MappedFile::setWindow(long long offset, int length) {
+  if (!impl)
+    return false;
+
+  WriteLockGuard lock(&impl->lock);
+  if (impl->file == INVALID_HANDLE_VALUE || offset < 0 ||
+      offset > impl->fileSize)
+    return false;
+
+  long long available = impl->fileSize - offset;
+  if (length < 0)
+    length = MAPPED_DEFAULT_WINDOW;
+  if (length > available)
+    length = (int)available;
+  return MapWindow(impl, offset, length);
+}
+
+long long MappedFile::getWindowOffset() const {
+  if (!impl)
+    return 0;
+  ReadLockGuard lock(&impl->lock);
+  return impl->windowOffset;
+}
+
+int MappedFile::getWindowLength() const {
+  if (!impl)
+    return 0;
+  ReadLockGuard lock(&impl->lock);
+  return impl->windowLength;
+}
+
+const unsigned char *MappedFile::c_ptr(int *len) const {
+  if (len)
+    *len = 0;
+  if (!impl)
+    return nullptr;
+
+  ReadLockGuard lock(&impl->lock);
+  if (len)
+    *len = impl->windowLength;
+  return impl->data;
+}
+
+unsigned char *MappedFile::writablePtr(int *len) {
+  if (len)
+    *len = 0;
+  if (!impl)
+    return nullptr;
+
+  ReadLockGuard lock(&impl->lock);
+  if (!impl->writable)
+    return nullptr;
+  if (len)
+    *len = impl->windowLength;
+  return impl->data;
+}
+
+Buffer MappedFile::toBuffer() const {
+  Buffer result;
+  if (!impl || !result.impl)
+    return result;
+
+  ReadLockGuard lock(&impl->lock);
+  if (impl->view)
+    ShareBufferStorage(result.impl, &impl->view->header, impl->data,
+                       impl->windowLength);
+  return result;
+}
+
+bool MappedFile::flush() {
+  if (!impl)
+    return false;
+
+  ReadLockGuard lock(&impl->lock);
+  if (impl->file == INVALID_HANDLE_VALUE || !impl->writable)
+    return false;
+  if (impl->data && !FlushViewOfFile(impl->data, (SIZE_T)impl->windowLength))
+    return false;
+  return FlushFileBuffers(impl->file) != 0;
+}
+
+void MappedFile::close() {
+  if (!impl)
+    return;
+  WriteLockGuard lock(&impl->lock);
+  CloseMappedFile(impl);
+}
+
+} // namespace attoboy
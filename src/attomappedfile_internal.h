@@ -0,0 +1,34 @@
+#pragma once
+#include "atto_internal_common.h"
+#include "attobuffer_internal.h"
+#include "attoboy/attoboy.h"
+#include <windows.h>
+
+namespace attoboy {
+
+// Default window: the whole file (up to the 2 GB Buffer limit) on 64-bit,
+// 64 MB on 32-bit where address space is scarce.
+static const int MAPPED_DEFAULT_WINDOW =
+    sizeof(void *) >= 8 ? 0x7FFF0000 : 64 * 1024 * 1024;
+
+/// External BufferStorage for one mapped view. Unmaps the view when the last
+/// Buffer or MappedFile referencing it lets go.
+struct MappedViewStorage {
+  BufferStorage header;
+  void *base;
+};
+
+struct MappedFileImpl {
+  HANDLE file;
+  HANDLE mapping;
+  bool writable;
+  long long fileSize;
+  MappedViewStorage *view;
+  unsigned char *data;
+  long long windowOffset;
+  int windowLength;
+  SRWLOCK lock;
+  volatile LONG refCount;
+};
+
+} // namespace attoboy
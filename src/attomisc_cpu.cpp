@@ -0,0 +1,82 @@
+#include "atto_internal_cpu.h"
+
+namespace attoboy {
+
+#if ATTO_X86
+static void QueryCpuid(int leaf, int subleaf, unsigned int regs[4]) {
+#ifdef _MSC_VER
+  int info[4];
+  __cpuidex(info, leaf, subleaf);
+  for (int i = 0; i < 4; i++)
+    regs[i] = (unsigned int)info[i];
+#else
+  regs[0] = regs[1] = regs[2] = regs[3] = 0;
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static unsigned int ReadXcr0() {
+#ifdef _MSC_VER
+  return (unsigned int)_xgetbv(0);
+#else
+  unsigned int lo, hi;
+  __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+  return lo;
+#endif
+}
+
+static int DetectCpuFeatures() {
+  unsigned int regs[4];
+  QueryCpuid(0, 0, regs);
+  unsigned int maxLeaf = regs[0];
+  if (maxLeaf < 1)
+    return 0;
+
+  int features = 0;
+  QueryCpuid(1, 0, regs);
+  unsigned int ecx = regs[2];
+  unsigned int edx = regs[3];
+
+  if (edx & (1u << 26))
+    features |= CPU_SSE2;
+  if (ecx & (1u << 9))
+    features |= CPU_SSSE3;
+  if (ecx & (1u << 19))
+    features |= CPU_SSE41;
+  if (ecx & (1u << 20))
+    features |= CPU_SSE42;
+
+  // AVX state must be enabled by the OS (XCR0 bits 1 and 2) before any
+  // 256-bit instruction can be used.
+  bool osAvx = false;
+  if ((ecx & (1u << 27)) && (ecx & (1u << 28)))
+    osAvx = (ReadXcr0() & 6) == 6;
+
+  if (maxLeaf >= 7) {
+    QueryCpuid(7, 0, regs);
+    unsigned int ebx = regs[1];
+    if (osAvx && (ebx & (1u << 5)))
+      features |= CPU_AVX2;
+    if ((ebx & (1u << 29)) && (features & CPU_SSE41))
+      features |= CPU_SHA;
+  }
+
+  return features;
+}
+#endif
+
+int GetCpuFeatures() {
+  static volatile LONG cached = -1;
+  LONG features = cached;
+  if (features < 0) {
+#if ATTO_X86
+    features = DetectCpuFeatures();
+#else
+    features = 0;
+#endif
+    InterlockedExchange(&cached, features);
+  }
+  return (int)features;
+}
+
+} // namespace attoboy
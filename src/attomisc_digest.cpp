@@ -0,0 +1,418 @@
+#include "atto_internal_cpu.h"
+#include "atto_internal_digest.h"
+
+namespace attoboy {
+
+static inline unsigned int Load32BE(const unsigned char *p) {
+  return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) |
+         ((unsigned int)p[2] << 8) | (unsigned int)p[3];
+}
+
+static inline unsigned int Load32LE(const unsigned char *p) {
+  return (unsigned int)p[0] | ((unsigned int)p[1] << 8) |
+         ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static inline void Store32BE(unsigned char *p, unsigned int v) {
+  p[0] = (unsigned char)(v >> 24);
+  p[1] = (unsigned char)(v >> 16);
+  p[2] = (unsigned char)(v >> 8);
+  p[3] = (unsigned char)v;
+}
+
+static inline void Store32LE(unsigned char *p, unsigned int v) {
+  p[0] = (unsigned char)v;
+  p[1] = (unsigned char)(v >> 8);
+  p[2] = (unsigned char)(v >> 16);
+  p[3] = (unsigned char)(v >> 24);
+}
+
+#define DIGEST_ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+//------------------------------------------------------------------------------
+// SHA-256
+//------------------------------------------------------------------------------
+
+static const unsigned int sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static void Sha256BlocksScalar(unsigned int h[8], const unsigned char *data,
+                               int blocks) {
+  unsigned int w[64];
+  while (blocks-- > 0) {
+    for (int i = 0; i < 16; i++)
+      w[i] = Load32BE(data + i * 4);
+    for (int i = 16; i < 64; i++) {
+      unsigned int s0 = DIGEST_ROTR32(w[i - 15], 7) ^
+                        DIGEST_ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      unsigned int s1 = DIGEST_ROTR32(w[i - 2], 17) ^
+                        DIGEST_ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    unsigned int a = h[0], b = h[1], c = h[2], d = h[3];
+    unsigned int e = h[4], f = h[5], g = h[6], hh = h[7];
+    for (int i = 0; i < 64; i++) {
+      unsigned int s1 =
+          DIGEST_ROTR32(e, 6) ^ DIGEST_ROTR32(e, 11) ^ DIGEST_ROTR32(e, 25);
+      unsigned int ch = (e & f) ^ (~e & g);
+      unsigned int t1 = hh + s1 + ch + sha256_k[i] + w[i];
+      unsigned int s0 =
+          DIGEST_ROTR32(a, 2) ^ DIGEST_ROTR32(a, 13) ^ DIGEST_ROTR32(a, 22);
+      unsigned int maj = (a & b) ^ (a & c) ^ (b & c);
+      unsigned int t2 = s0 + maj;
+      hh = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += hh;
+    data += 64;
+  }
+}
+
+#if ATTO_X86
+// SHA extensions path. The state is kept as ABEF/CDGH pairs, the layout the
+// sha256rnds2 instruction expects, and the message schedule for the next four
+// words is derived with sha256msg1/msg2 while the current ones are consumed.
+ATTO_TARGET("sha,sse4.1,ssse3")
+static void Sha256BlocksSHANI(unsigned int h[8], const unsigned char *data,
+                              int blocks) {
+  const __m128i byteSwap =
+      _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+  __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&h[0]),
+                                  0xB1);
+  __m128i state1 =
+      _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&h[4]), 0x1B);
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+  state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+  while (blocks-- > 0) {
+    __m128i abefSave = state0;
+    __m128i cdghSave = state1;
+    __m128i w[4];
+    for (int i = 0; i < 4; i++)
+      w[i] = _mm_shuffle_epi8(
+          _mm_loadu_si128((const __m128i *)(data + i * 16)), byteSwap);
+
+    for (int g = 0; g < 16; g++) {
+      __m128i msg = _mm_add_epi32(
+          w[g & 3], _mm_loadu_si128((const __m128i *)&sha256_k[g * 4]));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+      state0 = _mm_sha256rnds2_epu32(state0, state1,
+                                     _mm_shuffle_epi32(msg, 0x0E));
+      if (g < 12) {
+        __m128i next = _mm_sha256msg1_epu32(w[g & 3], w[(g + 1) & 3]);
+        next = _mm_add_epi32(
+            next, _mm_alignr_epi8(w[(g + 3) & 3], w[(g + 2) & 3], 4));
+        w[g & 3] = _mm_sha256msg2_epu32(next, w[(g + 3) & 3]);
+      }
+    }
+
+    state0 = _mm_add_epi32(state0, abefSave);
+    state1 = _mm_add_epi32(state1, cdghSave);
+    data += 64;
+  }
+
+  tmp = _mm_shuffle_epi32(state0, 0x1B);
+  state1 = _mm_shuffle_epi32(state1, 0xB1);
+  state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+  state1 = _mm_alignr_epi8(state1, tmp, 8);
+  _mm_storeu_si128((__m128i *)&h[0], state0);
+  _mm_storeu_si128((__m128i *)&h[4], state1);
+}
+#endif
+
+static void Sha256Blocks(unsigned int h[8], const unsigned char *data,
+                         int blocks) {
+#if ATTO_X86
+  if (HasCpuFeature(CPU_SHA) && HasCpuFeature(CPU_SSSE3)) {
+    Sha256BlocksSHANI(h, data, blocks);
+    return;
+  }
+#endif
+  Sha256BlocksScalar(h, data, blocks);
+}
+
+void Sha256Init(Sha256State *state) {
+  static const unsigned int iv[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                     0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                     0x1f83d9ab, 0x5be0cd19};
+  for (int i = 0; i < 8; i++)
+    state->h[i] = iv[i];
+  state->total = 0;
+  state->bufLen = 0;
+}
+
+void Sha256Update(Sha256State *state, const unsigned char *data, int len) {
+  if (!data || len <= 0)
+    return;
+
+  state->total += (unsigned int)len;
+
+  if (state->bufLen > 0) {
+    int fill = 64 - state->bufLen;
+    if (fill > len)
+      fill = len;
+    for (int i = 0; i < fill; i++)
+      state->buf[state->bufLen + i] = data[i];
+    state->bufLen += fill;
+    data += fill;
+    len -= fill;
+    if (state->bufLen < 64)
+      return;
+    Sha256Blocks(state->h, state->buf, 1);
+    state->bufLen = 0;
+  }
+
+  int blocks = len / 64;
+  if (blocks > 0) {
+    Sha256Blocks(state->h, data, blocks);
+    data += blocks * 64;
+    len -= blocks * 64;
+  }
+
+  for (int i = 0; i < len; i++)
+    state->buf[i] = data[i];
+  state->bufLen = len;
+}
+
+void Sha256Final(const Sha256State *state, unsigned char *out) {
+  unsigned int h[8];
+  unsigned char tail[128];
+  for (int i = 0; i < 8; i++)
+    h[i] = state->h[i];
+
+  int len = state->bufLen;
+  for (int i = 0; i < len; i++)
+    tail[i] = state->buf[i];
+  tail[len++] = 0x80;
+  int tailLen = len <= 56 ? 64 : 128;
+  while (len < tailLen - 8)
+    tail[len++] = 0;
+
+  unsigned long long bits = state->total << 3;
+  Store32BE(tail + tailLen - 8, (unsigned int)(bits >> 32));
+  Store32BE(tail + tailLen - 4, (unsigned int)bits);
+  Sha256Blocks(h, tail, tailLen / 64);
+
+  for (int i = 0; i < 8; i++)
+    Store32BE(out + i * 4, h[i]);
+}
+
+//------------------------------------------------------------------------------
+// BLAKE2s
+//------------------------------------------------------------------------------
+
+static const unsigned int blake2s_iv[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372,
+                                           0xA54FF53A, 0x510E527F, 0x9B05688C,
+                                           0x1F83D9AB, 0x5BE0CD19};
+
+static const unsigned char blake2s_sigma[10][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+    {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+    {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+    {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+    {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+    {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+    {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+    {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+    {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0}};
+
+#define BLAKE2S_G(a, b, c, d, x, y)                                            \
+  do {                                                                         \
+    a = a + b + x;                                                             \
+    d = DIGEST_ROTR32(d ^ a, 16);                                              \
+    c = c + d;                                                                 \
+    b = DIGEST_ROTR32(b ^ c, 12);                                              \
+    a = a + b + y;                                                             \
+    d = DIGEST_ROTR32(d ^ a, 8);                                               \
+    c = c + d;                                                                 \
+    b = DIGEST_ROTR32(b ^ c, 7);                                               \
+  } while (0)
+
+static void Blake2sCompressScalar(unsigned int h[8], const unsigned int m[16],
+                                  unsigned int t0, unsigned int t1,
+                                  unsigned int f0) {
+  unsigned int v[16];
+  for (int i = 0; i < 8; i++) {
+    v[i] = h[i];
+    v[i + 8] = blake2s_iv[i];
+  }
+  v[12] ^= t0;
+  v[13] ^= t1;
+  v[14] ^= f0;
+
+  for (int r = 0; r < 10; r++) {
+    const unsigned char *s = blake2s_sigma[r];
+    BLAKE2S_G(v[0], v[4], v[8], v[12], m[s[0]], m[s[1]]);
+    BLAKE2S_G(v[1], v[5], v[9], v[13], m[s[2]], m[s[3]]);
+    BLAKE2S_G(v[2], v[6], v[10], v[14], m[s[4]], m[s[5]]);
+    BLAKE2S_G(v[3], v[7], v[11], v[15], m[s[6]], m[s[7]]);
+    BLAKE2S_G(v[0], v[5], v[10], v[15], m[s[8]], m[s[9]]);
+    BLAKE2S_G(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+    BLAKE2S_G(v[2], v[7], v[8], v[13], m[s[12]], m[s[13]]);
+    BLAKE2S_G(v[3], v[4], v[9], v[14], m[s[14]], m[s[15]]);
+  }
+
+  for (int i = 0; i < 8; i++)
+    h[i] ^= v[i] ^ v[i + 8];
+}
+
+#if ATTO_X86
+// Row-parallel BLAKE2s: each xmm register holds one row of the 4x4 state, so
+// the four column (then diagonal) G functions of a round run at once.
+ATTO_TARGET("ssse3")
+static void Blake2sCompressSSSE3(unsigned int h[8], const unsigned int m[16],
+                                 unsigned int t0, unsigned int t1,
+                                 unsigned int f0) {
+  const __m128i rot16 =
+      _mm_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2);
+  const __m128i rot8 =
+      _mm_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1);
+
+  __m128i row1 = _mm_loadu_si128((const __m128i *)&h[0]);
+  __m128i row2 = _mm_loadu_si128((const __m128i *)&h[4]);
+  __m128i row3 = _mm_loadu_si128((const __m128i *)&blake2s_iv[0]);
+  __m128i row4 = _mm_xor_si128(
+      _mm_loadu_si128((const __m128i *)&blake2s_iv[4]),
+      _mm_set_epi32(0, (int)f0, (int)t1, (int)t0));
+  const __m128i h0 = row1;
+  const __m128i h1 = row2;
+
+  for (int r = 0; r < 10; r++) {
+    const unsigned char *s = blake2s_sigma[r];
+    for (int half = 0; half < 2; half++) {
+      const unsigned char *sh = s + half * 8;
+      __m128i mx = _mm_set_epi32((int)m[sh[6]], (int)m[sh[4]], (int)m[sh[2]],
+                                 (int)m[sh[0]]);
+      __m128i my = _mm_set_epi32((int)m[sh[7]], (int)m[sh[5]], (int)m[sh[3]],
+                                 (int)m[sh[1]]);
+
+      row1 = _mm_add_epi32(_mm_add_epi32(row1, row2), mx);
+      row4 = _mm_shuffle_epi8(_mm_xor_si128(row4, row1), rot16);
+      row3 = _mm_add_epi32(row3, row4);
+      row2 = _mm_xor_si128(row2, row3);
+      row2 = _mm_or_si128(_mm_srli_epi32(row2, 12), _mm_slli_epi32(row2, 20));
+      row1 = _mm_add_epi32(_mm_add_epi32(row1, row2), my);
+      row4 = _mm_shuffle_epi8(_mm_xor_si128(row4, row1), rot8);
+      row3 = _mm_add_epi32(row3, row4);
+      row2 = _mm_xor_si128(row2, row3);
+      row2 = _mm_or_si128(_mm_srli_epi32(row2, 7), _mm_slli_epi32(row2, 25));
+
+      if (half == 0) {
+        // Rotate rows so the diagonals line up as columns.
+        row2 = _mm_shuffle_epi32(row2, _MM_SHUFFLE(0, 3, 2, 1));
+        row3 = _mm_shuffle_epi32(row3, _MM_SHUFFLE(1, 0, 3, 2));
+        row4 = _mm_shuffle_epi32(row4, _MM_SHUFFLE(2, 1, 0, 3));
+      } else {
+        row2 = _mm_shuffle_epi32(row2, _MM_SHUFFLE(2, 1, 0, 3));
+        row3 = _mm_shuffle_epi32(row3, _MM_SHUFFLE(1, 0, 3, 2));
+        row4 = _mm_shuffle_epi32(row4, _MM_SHUFFLE(0, 3, 2, 1));
+      }
+    }
+  }
+
+  _mm_storeu_si128((__m128i *)&h[0],
+                   _mm_xor_si128(h0, _mm_xor_si128(row1, row3)));
+  _mm_storeu_si128((__m128i *)&h[4],
+                   _mm_xor_si128(h1, _mm_xor_si128(row2, row4)));
+}
+#endif
+
+static void Blake2sCompress(Blake2sState *state, const unsigned char *block,
+                            unsigned int f0) {
+  unsigned int m[16];
+  for (int i = 0; i < 16; i++)
+    m[i] = Load32LE(block + i * 4);
+#if ATTO_X86
+  if (HasCpuFeature(CPU_SSSE3)) {
+    Blake2sCompressSSSE3(state->h, m, state->t[0], state->t[1], f0);
+    return;
+  }
+#endif
+  Blake2sCompressScalar(state->h, m, state->t[0], state->t[1], f0);
+}
+
+static inline void Blake2sAddCounter(Blake2sState *state, unsigned int inc) {
+  state->t[0] += inc;
+  if (state->t[0] < inc)
+    state->t[1]++;
+}
+
+void Blake2sInit(Blake2sState *state) {
+  for (int i = 0; i < 8; i++)
+    state->h[i] = blake2s_iv[i];
+  // Parameter block: 32-byte digest, no key, fanout 1, depth 1.
+  state->h[0] ^= 0x01010000 | BLAKE2S_DIGEST_SIZE;
+  state->t[0] = 0;
+  state->t[1] = 0;
+  state->bufLen = 0;
+}
+
+void Blake2sUpdate(Blake2sState *state, const unsigned char *data, int len) {
+  if (!data || len <= 0)
+    return;
+
+  // The final block is compressed with a flag set, so a full buffer is only
+  // flushed once more input proves it was not the last one.
+  while (len > 0) {
+    if (state->bufLen == 64) {
+      Blake2sAddCounter(state, 64);
+      Blake2sCompress(state, state->buf, 0);
+      state->bufLen = 0;
+    }
+    if (state->bufLen == 0) {
+      while (len > 64) {
+        Blake2sAddCounter(state, 64);
+        Blake2sCompress(state, data, 0);
+        data += 64;
+        len -= 64;
+      }
+    }
+    int fill = 64 - state->bufLen;
+    if (fill > len)
+      fill = len;
+    for (int i = 0; i < fill; i++)
+      state->buf[state->bufLen + i] = data[i];
+    state->bufLen += fill;
+    data += fill;
+    len -= fill;
+  }
+}
+
+void Blake2sFinal(const Blake2sState *state, unsigned char *out) {
+  Blake2sState copy = *state;
+  Blake2sAddCounter(&copy, (unsigned int)copy.bufLen);
+  for (int i = copy.bufLen; i < 64; i++)
+    copy.buf[i] = 0;
+  Blake2sCompress(&copy, copy.buf, 0xFFFFFFFFu);
+
+  for (int i = 0; i < 8; i++)
+    Store32LE(out + i * 4, copy.h[i]);
+}
+
+} // namespace attoboy
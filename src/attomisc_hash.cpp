@@ -0,0 +1,349 @@
+#include "atto_internal_cpu.h"
+#include "atto_internal_hash.h"
+
+namespace attoboy {
+
+typedef unsigned long long U64;
+
+static inline unsigned int Read32(const unsigned char *p) {
+#ifdef _MSC_VER
+  return *(const unsigned int *)p;
+#else
+  unsigned int v;
+  __builtin_memcpy(&v, p, 4);
+  return v;
+#endif
+}
+
+static inline U64 Read64(const unsigned char *p) {
+#ifdef _MSC_VER
+  return *(const U64 *)p;
+#else
+  U64 v;
+  __builtin_memcpy(&v, p, 8);
+  return v;
+#endif
+}
+
+// 32-bit MSVC lowers 64-bit multiplies to _allmul, which is not available
+// without the CRT; build the product from 32x32->64 multiplies instead.
+static inline U64 Mul64(U64 a, U64 b) {
+#if defined(_MSC_VER) && defined(_M_IX86)
+  unsigned int alo = (unsigned int)a;
+  unsigned int ahi = (unsigned int)(a >> 32);
+  unsigned int blo = (unsigned int)b;
+  unsigned int bhi = (unsigned int)(b >> 32);
+  U64 lo = __emulu(alo, blo);
+  unsigned int hi = (unsigned int)(lo >> 32) + alo * bhi + ahi * blo;
+  return ((U64)hi << 32) | (unsigned int)lo;
+#else
+  return a * b;
+#endif
+}
+
+#define XXH_ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+//------------------------------------------------------------------------------
+// xxHash64
+//------------------------------------------------------------------------------
+
+static const U64 XXH_PRIME1 = 0x9E3779B185EBCA87ULL;
+static const U64 XXH_PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+static const U64 XXH_PRIME3 = 0x165667B19E3779F9ULL;
+static const U64 XXH_PRIME4 = 0x85EBCA77C2B2AE63ULL;
+static const U64 XXH_PRIME5 = 0x27D4EB2F165667C5ULL;
+
+static inline U64 XXH64Round(U64 acc, U64 input) {
+  acc += Mul64(input, XXH_PRIME2);
+  acc = XXH_ROTL64(acc, 31);
+  return Mul64(acc, XXH_PRIME1);
+}
+
+static inline U64 XXH64Merge(U64 acc, U64 val) {
+  acc ^= XXH64Round(0, val);
+  return Mul64(acc, XXH_PRIME1) + XXH_PRIME4;
+}
+
+// Consumes as many whole 32-byte stripes as possible and returns the number
+// of bytes used.
+static int XXH64Stripes(U64 v[4], const unsigned char *p, int len) {
+  U64 v1 = v[0], v2 = v[1], v3 = v[2], v4 = v[3];
+  int used = 0;
+  while (len - used >= 32) {
+    v1 = XXH64Round(v1, Read64(p + used));
+    v2 = XXH64Round(v2, Read64(p + used + 8));
+    v3 = XXH64Round(v3, Read64(p + used + 16));
+    v4 = XXH64Round(v4, Read64(p + used + 24));
+    used += 32;
+  }
+  v[0] = v1;
+  v[1] = v2;
+  v[2] = v3;
+  v[3] = v4;
+  return used;
+}
+
+void XXH64Init(XXH64State *state, U64 seed) {
+  state->seed = seed;
+  state->v[0] = seed + XXH_PRIME1 + XXH_PRIME2;
+  state->v[1] = seed + XXH_PRIME2;
+  state->v[2] = seed;
+  state->v[3] = seed - XXH_PRIME1;
+  state->total = 0;
+  state->memSize = 0;
+}
+
+void XXH64Update(XXH64State *state, const unsigned char *data, int len) {
+  if (!data || len <= 0)
+    return;
+
+  state->total += (unsigned int)len;
+
+  if (state->memSize + len < 32) {
+    for (int i = 0; i < len; i++)
+      state->mem[state->memSize + i] = data[i];
+    state->memSize += len;
+    return;
+  }
+
+  if (state->memSize > 0) {
+    int fill = 32 - state->memSize;
+    for (int i = 0; i < fill; i++)
+      state->mem[state->memSize + i] = data[i];
+    XXH64Stripes(state->v, state->mem, 32);
+    data += fill;
+    len -= fill;
+    state->memSize = 0;
+  }
+
+  int used = XXH64Stripes(state->v, data, len);
+  for (int i = used; i < len; i++)
+    state->mem[i - used] = data[i];
+  state->memSize = len - used;
+}
+
+U64 XXH64Digest(const XXH64State *state) {
+  U64 h;
+  if (state->total >= 32) {
+    const U64 *v = state->v;
+    h = XXH_ROTL64(v[0], 1) + XXH_ROTL64(v[1], 7) + XXH_ROTL64(v[2], 12) +
+        XXH_ROTL64(v[3], 18);
+    h = XXH64Merge(h, v[0]);
+    h = XXH64Merge(h, v[1]);
+    h = XXH64Merge(h, v[2]);
+    h = XXH64Merge(h, v[3]);
+  } else {
+    h = state->seed + XXH_PRIME5;
+  }
+  h += state->total;
+
+  const unsigned char *p = state->mem;
+  int len = state->memSize;
+  while (len >= 8) {
+    h ^= XXH64Round(0, Read64(p));
+    h = Mul64(XXH_ROTL64(h, 27), XXH_PRIME1) + XXH_PRIME4;
+    p += 8;
+    len -= 8;
+  }
+  if (len >= 4) {
+    h ^= Mul64((U64)Read32(p), XXH_PRIME1);
+    h = Mul64(XXH_ROTL64(h, 23), XXH_PRIME2) + XXH_PRIME3;
+    p += 4;
+    len -= 4;
+  }
+  while (len > 0) {
+    h ^= Mul64((U64)*p, XXH_PRIME5);
+    h = Mul64(XXH_ROTL64(h, 11), XXH_PRIME1);
+    p++;
+    len--;
+  }
+
+  h ^= h >> 33;
+  h = Mul64(h, XXH_PRIME2);
+  h ^= h >> 29;
+  h = Mul64(h, XXH_PRIME3);
+  h ^= h >> 32;
+  return h;
+}
+
+U64 XXH64(const unsigned char *data, int len, U64 seed) {
+  XXH64State state;
+  XXH64Init(&state, seed);
+  XXH64Update(&state, data, len);
+  return XXH64Digest(&state);
+}
+
+//------------------------------------------------------------------------------
+// CRC-32C
+//------------------------------------------------------------------------------
+
+// Slicing-by-8 tables for the reflected Castagnoli polynomial, built on first
+// use so they cost nothing in the binary.
+static unsigned int crc32c_table[8][256];
+static volatile LONG crc32c_table_ready = 0;
+
+static void BuildCrc32cTable() {
+  for (unsigned int i = 0; i < 256; i++) {
+    unsigned int c = i;
+    for (int k = 0; k < 8; k++)
+      c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : (c >> 1);
+    crc32c_table[0][i] = c;
+  }
+  for (unsigned int i = 0; i < 256; i++) {
+    unsigned int c = crc32c_table[0][i];
+    for (int t = 1; t < 8; t++) {
+      c = crc32c_table[0][c & 0xFF] ^ (c >> 8);
+      crc32c_table[t][i] = c;
+    }
+  }
+  InterlockedExchange(&crc32c_table_ready, 1);
+}
+
+static unsigned int Crc32cSoftware(unsigned int crc, const unsigned char *p,
+                                   int len) {
+  if (!crc32c_table_ready)
+    BuildCrc32cTable();
+
+  while (len > 0 && ((UINT_PTR)p & 3)) {
+    crc = crc32c_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    len--;
+  }
+  while (len >= 8) {
+    unsigned int lo = Read32(p) ^ crc;
+    unsigned int hi = Read32(p + 4);
+    crc = crc32c_table[7][lo & 0xFF] ^ crc32c_table[6][(lo >> 8) & 0xFF] ^
+          crc32c_table[5][(lo >> 16) & 0xFF] ^ crc32c_table[4][lo >> 24] ^
+          crc32c_table[3][hi & 0xFF] ^ crc32c_table[2][(hi >> 8) & 0xFF] ^
+          crc32c_table[1][(hi >> 16) & 0xFF] ^ crc32c_table[0][hi >> 24];
+    p += 8;
+    len -= 8;
+  }
+  while (len > 0) {
+    crc = crc32c_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    len--;
+  }
+  return crc;
+}
+
+#if ATTO_X86
+ATTO_TARGET("sse4.2")
+static unsigned int Crc32cSSE42(unsigned int crc, const unsigned char *p,
+                                int len) {
+  while (len > 0 && ((UINT_PTR)p & 7)) {
+    crc = _mm_crc32_u8(crc, *p++);
+    len--;
+  }
+#if defined(_M_X64) || defined(__x86_64__)
+  U64 c = crc;
+  while (len >= 32) {
+    c = _mm_crc32_u64(c, Read64(p));
+    c = _mm_crc32_u64(c, Read64(p + 8));
+    c = _mm_crc32_u64(c, Read64(p + 16));
+    c = _mm_crc32_u64(c, Read64(p + 24));
+    p += 32;
+    len -= 32;
+  }
+  while (len >= 8) {
+    c = _mm_crc32_u64(c, Read64(p));
+    p += 8;
+    len -= 8;
+  }
+  crc = (unsigned int)c;
+#endif
+  while (len >= 4) {
+    crc = _mm_crc32_u32(crc, Read32(p));
+    p += 4;
+    len -= 4;
+  }
+  while (len > 0) {
+    crc = _mm_crc32_u8(crc, *p++);
+    len--;
+  }
+  return crc;
+}
+#endif
+
+unsigned int Crc32cUpdate(unsigned int crc, const unsigned char *data,
+                          int len) {
+  if (!data || len <= 0)
+    return crc;
+
+  crc = ~crc;
+#if ATTO_X86
+  if (HasCpuFeature(CPU_SSE42))
+    return ~Crc32cSSE42(crc, data, len);
+#endif
+  return ~Crc32cSoftware(crc, data, len);
+}
+
+//------------------------------------------------------------------------------
+// CRC-32 and Adler-32 (gzip and zlib trailers)
+//------------------------------------------------------------------------------
+
+// Slicing-by-8 tables for the reflected IEEE polynomial used by gzip, built
+// on first use like the CRC-32C tables.
+static unsigned int crc32_table[8][256];
+static volatile LONG crc32_table_ready = 0;
+
+static void BuildCrc32Table() {
+  for (unsigned int i = 0; i < 256; i++) {
+    unsigned int c = i;
+    for (int k = 0; k < 8; k++)
+      c = (c & 1) ? (c >> 1) ^ 0xEDB88320u : (c >> 1);
+    crc32_table[0][i] = c;
+  }
+  for (unsigned int i = 0; i < 256; i++) {
+    unsigned int c = crc32_table[0][i];
+    for (int t = 1; t < 8; t++) {
+      c = crc32_table[0][c & 0xFF] ^ (c >> 8);
+      crc32_table[t][i] = c;
+    }
+  }
+  InterlockedExchange(&crc32_table_ready, 1);
+}
+
+unsigned int Crc32Update(unsigned int crc, const unsigned char *data,
+                         int len) {
+  if (!data || len <= 0)
+    return crc;
+  if (!crc32_table_ready)
+    BuildCrc32Table();
+
+  const unsigned char *p = data;
+  crc = ~crc;
+  while (len >= 8) {
+    unsigned int lo = Read32(p) ^ crc;
+    unsigned int hi = Read32(p + 4);
+    crc = crc32_table[7][lo & 0xFF] ^ crc32_table[6][(lo >> 8) & 0xFF] ^
+          crc32_table[5][(lo >> 16) & 0xFF] ^ crc32_table[4][lo >> 24] ^
+          crc32_table[3][hi & 0xFF] ^ crc32_table[2][(hi >> 8) & 0xFF] ^
+          crc32_table[1][(hi >> 16) & 0xFF] ^ crc32_table[0][hi >> 24];
+    p += 8;
+    len -= 8;
+  }
+  while (len > 0) {
+    crc = crc32_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    len--;
+  }
+  return ~crc;
+}
+
+unsigned int Adler32Update(unsigned int adler, const unsigned char *data,
+                           int len) {
+  unsigned int a = adler & 0xFFFF;
+  unsigned int b = adler >> 16;
+  while (len > 0) {
+    // 5552 is the most bytes that can be summed before b overflows.
+    int n = len < 5552 ? len : 5552;
+    len -= n;
+    while (n-- > 0) {
+      a += *data++;
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+  return (b << 16) | a;
+}
+
+} // namespace attoboy
@@ -1,19 +1,48 @@
-#include "attoboy/attoboy.h"
+#include "attobufferedwriter_internal.h"
 #include "attostring_internal.h"
-#include <windows.h>
 
 namespace attoboy {
 
 static HANDLE g_logFileHandle = nullptr;
 static bool g_logToFile = false;
+static BufferedWriterImpl *g_logWriter = nullptr;
+
+static const int LOG_BUFFER_SIZE = 65536;
+static const int LOG_FLUSH_INTERVAL_MS = 1000;
 
 static String GetCurrentDatetimeString() {
   DateTime dt;
   return dt.toString();
 }
 
+static bool LogFileSink(void *context, const unsigned char *data, int len) {
+  while (len > 0) {
+    DWORD written = 0;
+    if (!WriteFile((HANDLE)context, data, len, &written, nullptr) ||
+        written == 0)
+      return false;
+    data += written;
+    len -= written;
+  }
+  return true;
+}
+
+static void CloseLogFile() {
+  if (g_logWriter) {
+    FreeBufferedWriterImpl(g_logWriter);
+    g_logWriter = nullptr;
+  }
+  if (g_logFileHandle) {
+    CloseHandle(g_logFileHandle);
+    g_logFileHandle = nullptr;
+  }
+}
+
 static void PrintString(const String &s) {
-  if (g_logToFile && g_logFileHandle) {
+  if (g_logToFile && g_logWriter) {
+    BufferedWriterAppend(g_logWriter, (const unsigned char *)s.c_str(),
+                         s.byteLength());
+  } else if (g_logToFile && g_logFileHandle) {
     DWORD written;
     DWORD bytesToWrite = s.byteLength() * sizeof(char);
     WriteFile(g_logFileHandle, s.c_str(), bytesToWrite, &written, nullptr);
@@ -32,11 +61,8 @@ static void PrintString(const String &s) {
   }
 }
 
-void EnableLoggingToFile(const String &path, bool truncate) {
-  if (g_logFileHandle) {
-    CloseHandle(g_logFileHandle);
-    g_logFileHandle = nullptr;
-  }
+void EnableLoggingToFile(const String &path, bool truncate, bool buffered) {
+  CloseLogFile();
 
   DWORD creationDisposition = truncate ? CREATE_ALWAYS : OPEN_ALWAYS;
   g_logFileHandle =
@@ -47,6 +73,10 @@ void EnableLoggingToFile(const String &path, bool truncate) {
     if (!truncate) {
       SetFilePointer(g_logFileHandle, 0, nullptr, FILE_END);
     }
+    if (buffered)
+      g_logWriter = AllocBufferedWriterImpl(LogFileSink, g_logFileHandle,
+                                            LOG_BUFFER_SIZE, true,
+                                            LOG_FLUSH_INTERVAL_MS);
     g_logToFile = true;
   } else {
     g_logFileHandle = nullptr;
@@ -62,27 +92,30 @@ void EnableLoggingToFile(const String &path, bool truncate) {
 }
 
 void EnableLoggingToConsole() {
-  if (g_logFileHandle) {
-    CloseHandle(g_logFileHandle);
-    g_logFileHandle = nullptr;
-  }
+  CloseLogFile();
 
   g_logToFile = false;
 }
 
+void FlushLog() {
+  if (g_logWriter)
+    BufferedWriterFlush(g_logWriter);
+  if (g_logFileHandle)
+    FlushFileBuffers(g_logFileHandle);
+}
+
 namespace internal {
 void LogImpl(const String *args, int count, const String &prefix) {
-  if (!prefix.isEmpty()) {
-    PrintString(prefix);
-    PrintString(GetCurrentDatetimeString());
-    PrintString(String(": "));
-  }
+  // Assemble the whole line first so each message is a single write.
+  String line;
+  if (!prefix.isEmpty())
+    line = prefix + GetCurrentDatetimeString() + String(": ");
 
   for (int i = 0; i < count; i++) {
-    PrintString(args[i]);
+    line = line + args[i];
   }
 
-  PrintString(String("\n"));
+  PrintString(line + String("\n"));
 }
 } // namespace internal
 
@@ -0,0 +1,172 @@
+#include "atto_internal_cpu.h"
+#include "atto_internal_scan.h"
+
+namespace attoboy {
+
+static inline int LowestBit(unsigned int mask) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (int)index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+#if ATTO_X86
+
+ATTO_TARGET("sse2")
+static int FindByteSSE2(const unsigned char *data, int len,
+                        unsigned char value) {
+  __m128i target = _mm_set1_epi8((char)value);
+  int i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(data + i));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, target));
+    if (mask)
+      return i + LowestBit((unsigned int)mask);
+  }
+  for (; i < len; i++) {
+    if (data[i] == value)
+      return i;
+  }
+  return -1;
+}
+
+ATTO_TARGET("avx2")
+static int FindByteAVX2(const unsigned char *data, int len,
+                        unsigned char value) {
+  __m256i target = _mm256_set1_epi8((char)value);
+  int i = 0;
+  for (; i + 32 <= len; i += 32) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)(data + i));
+    unsigned int mask =
+        (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, target));
+    if (mask)
+      return i + LowestBit(mask);
+  }
+  int rest = FindByteSSE2(data + i, len - i, value);
+  return rest < 0 ? -1 : i + rest;
+}
+
+#endif
+
+int FindByte(const unsigned char *data, int len, unsigned char value) {
+  if (!data || len <= 0)
+    return -1;
+
+#if ATTO_X86
+  if (len >= 64 && HasCpuFeature(CPU_AVX2))
+    return FindByteAVX2(data, len, value);
+  if (len >= 16 && HasCpuFeature(CPU_SSE2))
+    return FindByteSSE2(data, len, value);
+#endif
+
+  for (int i = 0; i < len; i++) {
+    if (data[i] == value)
+      return i;
+  }
+  return -1;
+}
+
+// Scalar search from pos: jumps between candidate first bytes, then
+// compares the rest.
+static int FindBytesFrom(const unsigned char *data, int len, int pos,
+                         const unsigned char *needle, int needleLen) {
+  int last = len - needleLen;
+  while (pos <= last) {
+    int hit = FindByte(data + pos, last - pos + 1, needle[0]);
+    if (hit < 0)
+      return -1;
+    pos += hit;
+    int j = 1;
+    while (j < needleLen && data[pos + j] == needle[j])
+      j++;
+    if (j == needleLen)
+      return pos;
+    pos++;
+  }
+  return -1;
+}
+
+static inline bool SameBytes(const unsigned char *a, const unsigned char *b,
+                             int len) {
+  for (int i = 0; i < len; i++) {
+    if (a[i] != b[i])
+      return false;
+  }
+  return true;
+}
+
+#if ATTO_X86
+
+// Both vector versions test every position of a block at once for the
+// needle's first and last byte, and compare the middle only where both
+// agree. Unlike a first-byte scan this stays fast when the first byte is
+// common (a space, 'e').
+ATTO_TARGET("sse2")
+static int FindBytesSSE2(const unsigned char *data, int len,
+                         const unsigned char *needle, int needleLen) {
+  __m128i first = _mm_set1_epi8((char)needle[0]);
+  __m128i last = _mm_set1_epi8((char)needle[needleLen - 1]);
+  int i = 0;
+  for (; i + 16 + needleLen - 1 <= len; i += 16) {
+    __m128i head = _mm_loadu_si128((const __m128i *)(data + i));
+    __m128i tail =
+        _mm_loadu_si128((const __m128i *)(data + i + needleLen - 1));
+    unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_and_si128(
+        _mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last)));
+    while (mask) {
+      int bit = LowestBit(mask);
+      if (SameBytes(data + i + bit + 1, needle + 1, needleLen - 2))
+        return i + bit;
+      mask &= mask - 1;
+    }
+  }
+  return FindBytesFrom(data, len, i, needle, needleLen);
+}
+
+ATTO_TARGET("avx2")
+static int FindBytesAVX2(const unsigned char *data, int len,
+                         const unsigned char *needle, int needleLen) {
+  __m256i first = _mm256_set1_epi8((char)needle[0]);
+  __m256i last = _mm256_set1_epi8((char)needle[needleLen - 1]);
+  int i = 0;
+  for (; i + 32 + needleLen - 1 <= len; i += 32) {
+    __m256i head = _mm256_loadu_si256((const __m256i *)(data + i));
+    __m256i tail =
+        _mm256_loadu_si256((const __m256i *)(data + i + needleLen - 1));
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(
+        _mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last)));
+    while (mask) {
+      int bit = LowestBit(mask);
+      if (SameBytes(data + i + bit + 1, needle + 1, needleLen - 2))
+        return i + bit;
+      mask &= mask - 1;
+    }
+  }
+  return FindBytesFrom(data, len, i, needle, needleLen);
+}
+
+#endif
+
+int FindBytes(const unsigned char *data, int len, const unsigned char *needle,
+              int needleLen) {
+  if (needleLen <= 0)
+    return 0;
+  if (!data || !needle || len < needleLen)
+    return -1;
+  if (needleLen == 1)
+    return FindByte(data, len, needle[0]);
+
+#if ATTO_X86
+  if (len >= 64 && HasCpuFeature(CPU_AVX2))
+    return FindBytesAVX2(data, len, needle, needleLen);
+  if (len >= 32 && HasCpuFeature(CPU_SSE2))
+    return FindBytesSSE2(data, len, needle, needleLen);
+#endif
+
+  return FindBytesFrom(data, len, 0, needle, needleLen);
+}
+
+} // namespace attoboy
@@ -15,6 +15,8 @@
 namespace attoboy {
 
 void Exit(int exitCode) {
+  FlushLog();
+
   HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
   if (hOut != INVALID_HANDLE_VALUE) {
     FlushFileBuffers(hOut);
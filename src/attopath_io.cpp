@@ -1,6 +1,7 @@
 #include "attopath_internal.h"
 #include "attostring_internal.h"
 #include "attobuffer_internal.h"
+#include "attodigest_internal.h"
 
 namespace attoboy {
 
@@ -15,12 +16,14 @@ String Path::readToString() const {
   if (hFile == INVALID_HANDLE_VALUE)
     return String();
 
-  DWORD fileSize = GetFileSize(hFile, nullptr);
-  if (fileSize == INVALID_FILE_SIZE) {
+  LARGE_INTEGER fileSizeEx;
+  if (!GetFileSizeEx(hFile, &fileSizeEx) ||
+      fileSizeEx.QuadPart >= 0x7FFFFFFF) {
     CloseHandle(hFile);
     return String();
   }
 
+  DWORD fileSize = (DWORD)fileSizeEx.QuadPart;
   if (fileSize == 0) {
     CloseHandle(hFile);
     return String();
@@ -61,33 +64,83 @@ Buffer Path::readToBuffer() const {
   if (hFile == INVALID_HANDLE_VALUE)
     return Buffer();
 
-  DWORD fileSize = GetFileSize(hFile, nullptr);
-  if (fileSize == INVALID_FILE_SIZE || fileSize == 0) {
+  // A Buffer holds at most 2 GB; use map() for larger files.
+  LARGE_INTEGER fileSizeEx;
+  if (!GetFileSizeEx(hFile, &fileSizeEx) || fileSizeEx.QuadPart == 0 ||
+      fileSizeEx.QuadPart > 0x7FFFFFFF) {
     CloseHandle(hFile);
     return Buffer();
   }
+  DWORD fileSize = (DWORD)fileSizeEx.QuadPart;
 
-  unsigned char *buffer =
-      (unsigned char *)HeapAlloc(GetProcessHeap(), 0, fileSize);
-  if (!buffer) {
+  // Read straight into the result's storage.
+  Buffer result((int)fileSize);
+  if (!result.impl || !result.impl->data) {
     CloseHandle(hFile);
     return Buffer();
   }
 
   DWORD bytesRead = 0;
-  bool success = ReadFile(hFile, buffer, fileSize, &bytesRead, nullptr);
+  bool success =
+      ReadFile(hFile, result.impl->data, fileSize, &bytesRead, nullptr);
   CloseHandle(hFile);
 
-  if (!success || bytesRead == 0) {
-    HeapFree(GetProcessHeap(), 0, buffer);
+  if (!success || bytesRead == 0)
     return Buffer();
-  }
 
-  Buffer result(buffer, bytesRead);
-  HeapFree(GetProcessHeap(), 0, buffer);
+  result.impl->size = (int)bytesRead;
   return result;
 }
 
+MappedFile Path::map(bool writable) const {
+  return MappedFile(*this, writable);
+}
+
+Buffer Path::digest(DigestAlgorithm algorithm) const {
+  if (!impl || !impl->pathStr)
+    return Buffer();
+
+  ReadLockGuard guard(&impl->lock);
+
+  HANDLE hFile = CreateFileA(impl->pathStr, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (hFile == INVALID_HANDLE_VALUE)
+    return Buffer();
+
+  unsigned char *chunk =
+      (unsigned char *)HeapAlloc(GetProcessHeap(), 0, DIGEST_FILE_CHUNK);
+  if (!chunk) {
+    CloseHandle(hFile);
+    return Buffer();
+  }
+
+  DigestImpl state;
+  state.algorithm = algorithm == DIGEST_BLAKE2S ? DIGEST_BLAKE2S : DIGEST_SHA256;
+  DigestStateInit(&state);
+
+  bool success = true;
+  while (true) {
+    DWORD bytesRead = 0;
+    if (!ReadFile(hFile, chunk, DIGEST_FILE_CHUNK, &bytesRead, nullptr)) {
+      success = false;
+      break;
+    }
+    if (bytesRead == 0)
+      break;
+    DigestStateUpdate(&state, chunk, (int)bytesRead);
+  }
+
+  HeapFree(GetProcessHeap(), 0, chunk);
+  CloseHandle(hFile);
+
+  if (!success)
+    return Buffer();
+
+  unsigned char out[SHA256_DIGEST_SIZE];
+  DigestStateFinal(&state, out);
+  return Buffer(out, SHA256_DIGEST_SIZE);
+}
+
 bool Path::writeFromString(const String &str) const {
   if (!impl || !impl->pathStr)
     return false;
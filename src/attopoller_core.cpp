@@ -0,0 +1,479 @@
+#include "attopoller_internal.h"
+
+namespace attoboy {
+
+static void DestroyFileCopy(File *file) {
+  if (file) {
+    file->~File();
+    HeapFree(GetProcessHeap(), 0, file);
+  }
+}
+
+static File *NewFileCopy(const File &file) {
+  void *mem = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(File));
+  return mem ? new (mem) File(file) : nullptr;
+}
+
+static void DestroyDatagramCopy(Datagram *datagram) {
+  if (datagram) {
+    datagram->~Datagram();
+    HeapFree(GetProcessHeap(), 0, datagram);
+  }
+}
+
+static Datagram *NewDatagramCopy(const Datagram &datagram) {
+  void *mem = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(Datagram));
+  return mem ? new (mem) Datagram(datagram) : nullptr;
+}
+
+static void DestroyEntryCopy(PollerEntry *entry) {
+  DestroyFileCopy(entry->file);
+  DestroyDatagramCopy(entry->datagram);
+}
+
+static void ClearReady(PollerImpl *impl) {
+  for (int i = 0; i < impl->readyCount; i++) {
+    DestroyFileCopy(impl->ready[i]);
+    DestroyDatagramCopy(impl->readyDatagrams[i]);
+  }
+  impl->readyCount = 0;
+}
+
+static void FreeSnapshot(PollerEntry *entries, int count) {
+  for (int i = 0; i < count; i++)
+    DestroyEntryCopy(&entries[i]);
+  HeapFree(GetProcessHeap(), 0, entries);
+}
+
+static void FreePollerImpl(PollerImpl *impl) {
+  ClearReady(impl);
+  for (int i = 0; i < impl->count; i++)
+    DestroyEntryCopy(&impl->entries[i]);
+  if (impl->entries)
+    HeapFree(GetProcessHeap(), 0, impl->entries);
+  if (impl->ready)
+    HeapFree(GetProcessHeap(), 0, impl->ready);
+  if (impl->readyDatagrams)
+    HeapFree(GetProcessHeap(), 0, impl->readyDatagrams);
+  if (impl->readyEvents)
+    HeapFree(GetProcessHeap(), 0, impl->readyEvents);
+  HeapFree(GetProcessHeap(), 0, impl);
+}
+
+// owner is the FileImpl or DatagramImpl of the entry.
+static int FindEntry(const PollerImpl *impl, const void *owner) {
+  for (int i = 0; i < impl->count; i++) {
+    if (impl->entries[i].fileImpl == owner ||
+        impl->entries[i].datagramImpl == owner)
+      return i;
+  }
+  return -1;
+}
+
+// Grows entries and the ready arrays together so wait() never allocates
+// more than one WSAPOLLFD array.
+static bool GrowEntries(PollerImpl *impl) {
+  int newCapacity = impl->capacity < 8 ? 8 : impl->capacity * 2;
+  PollerEntry *entries = (PollerEntry *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, newCapacity * sizeof(PollerEntry));
+  File **ready = (File **)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                    newCapacity * sizeof(File *));
+  Datagram **readyDatagrams = (Datagram **)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, newCapacity * sizeof(Datagram *));
+  int *readyEvents = (int *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                      newCapacity * sizeof(int));
+  if (!entries || !ready || !readyDatagrams || !readyEvents) {
+    if (entries)
+      HeapFree(GetProcessHeap(), 0, entries);
+    if (ready)
+      HeapFree(GetProcessHeap(), 0, ready);
+    if (readyDatagrams)
+      HeapFree(GetProcessHeap(), 0, readyDatagrams);
+    if (readyEvents)
+      HeapFree(GetProcessHeap(), 0, readyEvents);
+    return false;
+  }
+
+  for (int i = 0; i < impl->count; i++)
+    entries[i] = impl->entries[i];
+  for (int i = 0; i < impl->readyCount; i++) {
+    ready[i] = impl->ready[i];
+    readyDatagrams[i] = impl->readyDatagrams[i];
+    readyEvents[i] = impl->readyEvents[i];
+  }
+  if (impl->entries)
+    HeapFree(GetProcessHeap(), 0, impl->entries);
+  if (impl->ready)
+    HeapFree(GetProcessHeap(), 0, impl->ready);
+  if (impl->readyDatagrams)
+    HeapFree(GetProcessHeap(), 0, impl->readyDatagrams);
+  if (impl->readyEvents)
+    HeapFree(GetProcessHeap(), 0, impl->readyEvents);
+  impl->entries = entries;
+  impl->ready = ready;
+  impl->readyDatagrams = readyDatagrams;
+  impl->readyEvents = readyEvents;
+  impl->capacity = newCapacity;
+  return true;
+}
+
+static int EventsFromRevents(SHORT revents) {
+  int events = 0;
+  if (revents & POLLRDNORM)
+    events |= POLL_READABLE;
+  if (revents & POLLWRNORM)
+    events |= POLL_WRITABLE;
+  if (revents & POLLHUP)
+    events |= POLL_CLOSED;
+  if (revents & (POLLERR | POLLNVAL))
+    events |= POLL_ERROR;
+  return events;
+}
+
+static int PipeEvents(const PollerEntry *entry) {
+  FileImpl *file = entry->fileImpl;
+  ReadLockGuard guard(&file->lock);
+  if (!file->isOpen || file->handle == INVALID_HANDLE_VALUE)
+    return POLL_CLOSED;
+
+  DWORD available = 0;
+  if (!PeekNamedPipe(file->handle, nullptr, 0, nullptr, &available, nullptr))
+    return GetLastError() == ERROR_BROKEN_PIPE ? POLL_CLOSED : POLL_ERROR;
+
+  int events = 0;
+  if ((entry->events & POLL_READABLE) && available > 0)
+    events |= POLL_READABLE;
+  if (entry->events & POLL_WRITABLE)
+    events |= POLL_WRITABLE;
+  return events;
+}
+
+static void AddReady(PollerImpl *impl, const PollerEntry *entry, int events) {
+  File *file = nullptr;
+  Datagram *datagram = nullptr;
+  if (entry->file)
+    file = NewFileCopy(*entry->file);
+  else
+    datagram = NewDatagramCopy(*entry->datagram);
+  if (!file && !datagram)
+    return;
+  impl->ready[impl->readyCount] = file;
+  impl->readyDatagrams[impl->readyCount] = datagram;
+  impl->readyEvents[impl->readyCount] = events;
+  impl->readyCount++;
+}
+
+// Adds an entry for a File or Datagram, or updates the events of an
+// existing one. The caller must hold impl->lock.
+static bool AddEntry(PollerImpl *impl, const File *file, FileImpl *fileImpl,
+                     const Datagram *datagram, DatagramImpl *datagramImpl,
+                     int events) {
+  int index = FindEntry(impl, fileImpl ? (const void *)fileImpl
+                                       : (const void *)datagramImpl);
+  if (index >= 0) {
+    impl->entries[index].events = events;
+    return true;
+  }
+
+  if (impl->count == impl->capacity && !GrowEntries(impl))
+    return false;
+  File *fileCopy = file ? NewFileCopy(*file) : nullptr;
+  Datagram *datagramCopy = datagram ? NewDatagramCopy(*datagram) : nullptr;
+  if (!fileCopy && !datagramCopy)
+    return false;
+
+  PollerEntry &entry = impl->entries[impl->count++];
+  entry.file = fileCopy;
+  entry.fileImpl = fileImpl;
+  entry.datagram = datagramCopy;
+  entry.datagramImpl = datagramImpl;
+  entry.events = events;
+  return true;
+}
+
+static bool RemoveEntry(PollerImpl *impl, const void *owner) {
+  int index = FindEntry(impl, owner);
+  if (index < 0)
+    return false;
+
+  DestroyEntryCopy(&impl->entries[index]);
+  for (int i = index; i < impl->count - 1; i++)
+    impl->entries[i] = impl->entries[i + 1];
+  impl->count--;
+  return true;
+}
+
+Poller::Poller() {
+  impl = (PollerImpl *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                 sizeof(PollerImpl));
+  if (impl) {
+    InitializeSRWLock(&impl->lock);
+    impl->refCount = 1;
+  }
+}
+
+Poller::Poller(const Poller &other) {
+  impl = other.impl;
+  if (impl)
+    InterlockedIncrement(&impl->refCount);
+}
+
+Poller::~Poller() {
+  if (impl && InterlockedDecrement(&impl->refCount) == 0)
+    FreePollerImpl(impl);
+}
+
+Poller &Poller::operator=(const Poller &other) {
+  if (this != &other) {
+    if (impl && InterlockedDecrement(&impl->refCount) == 0)
+      FreePollerImpl(impl);
+    impl = other.impl;
+    if (impl)
+      InterlockedIncrement(&impl->refCount);
+  }
+  return *this;
+}
+
+bool Poller::add(const File &file, int events) {
+  FileImpl *fileImpl = file.impl;
+  if (!impl || !fileImpl)
+    return false;
+
+  {
+    ReadLockGuard fileGuard(&fileImpl->lock);
+    if (!fileImpl->isOpen || !fileImpl->isValid)
+      return false;
+    if (fileImpl->type != FILE_TYPE_SOCKET &&
+        fileImpl->type != FILE_TYPE_SERVER_SOCKET &&
+        fileImpl->type != FILE_TYPE_NAMED_PIPE)
+      return false;
+  }
+
+  WriteLockGuard guard(&impl->lock);
+  return AddEntry(impl, &file, fileImpl, nullptr, nullptr, events);
+}
+
+bool Poller::remove(const File &file) {
+  if (!impl || !file.impl)
+    return false;
+
+  WriteLockGuard guard(&impl->lock);
+  return RemoveEntry(impl, file.impl);
+}
+
+bool Poller::add(const Datagram &datagram, int events) {
+  DatagramImpl *datagramImpl = datagram.impl;
+  if (!impl || !datagramImpl)
+    return false;
+
+  {
+    ReadLockGuard datagramGuard(&datagramImpl->lock);
+    if (datagramImpl->sock == INVALID_SOCKET)
+      return false;
+  }
+
+  WriteLockGuard guard(&impl->lock);
+  return AddEntry(impl, nullptr, nullptr, &datagram, datagramImpl, events);
+}
+
+bool Poller::remove(const Datagram &datagram) {
+  if (!impl || !datagram.impl)
+    return false;
+
+  WriteLockGuard guard(&impl->lock);
+  return RemoveEntry(impl, datagram.impl);
+}
+
+int Poller::count() const {
+  if (!impl)
+    return 0;
+
+  ReadLockGuard guard(&impl->lock);
+  return impl->count;
+}
+
+// Copies the registered entries, each with its own File or Datagram copy,
+// so wait() can poll them without holding the lock. Returns the number
+// copied, or -1.
+static int SnapshotEntries(PollerImpl *impl, PollerEntry **out) {
+  ReadLockGuard guard(&impl->lock);
+  *out = nullptr;
+  if (impl->count == 0)
+    return 0;
+
+  PollerEntry *entries = (PollerEntry *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, impl->count * sizeof(PollerEntry));
+  if (!entries)
+    return -1;
+  for (int i = 0; i < impl->count; i++) {
+    const PollerEntry &entry = impl->entries[i];
+    entries[i] = entry;
+    entries[i].file = entry.file ? NewFileCopy(*entry.file) : nullptr;
+    entries[i].datagram =
+        entry.datagram ? NewDatagramCopy(*entry.datagram) : nullptr;
+    if (!entries[i].file && !entries[i].datagram) {
+      FreeSnapshot(entries, i);
+      return -1;
+    }
+  }
+  *out = entries;
+  return impl->count;
+}
+
+int Poller::wait(int timeoutMs) {
+  if (!impl)
+    return -1;
+
+  {
+    WriteLockGuard guard(&impl->lock);
+    ClearReady(impl);
+  }
+  PollerEntry *entries;
+  int count = SnapshotEntries(impl, &entries);
+  if (count <= 0)
+    return count;
+
+  WSAPOLLFD *fds = (WSAPOLLFD *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                         count * sizeof(WSAPOLLFD));
+  int *owners = (int *)HeapAlloc(GetProcessHeap(), 0, count * sizeof(int));
+  int *found = (int *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                count * sizeof(int));
+  if (!fds || !owners || !found) {
+    if (fds)
+      HeapFree(GetProcessHeap(), 0, fds);
+    if (owners)
+      HeapFree(GetProcessHeap(), 0, owners);
+    if (found)
+      HeapFree(GetProcessHeap(), 0, found);
+    FreeSnapshot(entries, count);
+    return -1;
+  }
+
+  int socketCount = 0;
+  bool hasPipes = false;
+  for (int i = 0; i < count; i++) {
+    SOCKET sock;
+    FileImpl *file = entries[i].fileImpl;
+    if (file) {
+      ReadLockGuard fileGuard(&file->lock);
+      if (file->type == FILE_TYPE_NAMED_PIPE) {
+        hasPipes = true;
+        continue;
+      }
+      sock = file->sock;
+    } else {
+      DatagramImpl *datagram = entries[i].datagramImpl;
+      ReadLockGuard datagramGuard(&datagram->lock);
+      sock = datagram->sock;
+    }
+    // Only request flags are allowed in events; hang-ups and errors are
+    // always reported.
+    SHORT events = 0;
+    if (entries[i].events & POLL_READABLE)
+      events |= POLLRDNORM;
+    if (entries[i].events & POLL_WRITABLE)
+      events |= POLLWRNORM;
+    fds[socketCount].fd = sock;
+    fds[socketCount].events = events;
+    owners[socketCount] = i;
+    socketCount++;
+  }
+
+  ULONGLONG deadline = GetTickCount64() + (timeoutMs > 0 ? timeoutMs : 0);
+  int result = 0;
+  for (;;) {
+    int slice = timeoutMs;
+    if (timeoutMs > 0) {
+      ULONGLONG now = GetTickCount64();
+      slice = now >= deadline ? 0 : (int)(deadline - now);
+    }
+    if (hasPipes && (slice < 0 || slice > POLLER_PIPE_SLICE_MS))
+      slice = POLLER_PIPE_SLICE_MS;
+
+    if (socketCount > 0) {
+      if (WSAPoll(fds, (ULONG)socketCount, slice) == SOCKET_ERROR) {
+        result = -1;
+        break;
+      }
+      for (int i = 0; i < socketCount; i++) {
+        int events = EventsFromRevents(fds[i].revents);
+        if (events && !found[owners[i]]) {
+          found[owners[i]] = events;
+          result++;
+        }
+      }
+    } else if (slice > 0) {
+      ::Sleep((DWORD)slice);
+    }
+
+    if (hasPipes) {
+      for (int i = 0; i < count; i++) {
+        FileImpl *file = entries[i].fileImpl;
+        if (!file || file->type != FILE_TYPE_NAMED_PIPE)
+          continue;
+        int events = PipeEvents(&entries[i]);
+        if (events && !found[i]) {
+          found[i] = events;
+          result++;
+        }
+      }
+    }
+
+    if (result > 0 || timeoutMs == 0)
+      break;
+    if (timeoutMs > 0 && GetTickCount64() >= deadline)
+      break;
+  }
+
+  // Entries removed while the lock was not held are not reported.
+  if (result > 0) {
+    WriteLockGuard guard(&impl->lock);
+    ClearReady(impl);
+    for (int i = 0; i < count; i++) {
+      const void *owner = entries[i].fileImpl
+                              ? (const void *)entries[i].fileImpl
+                              : (const void *)entries[i].datagramImpl;
+      if (found[i] && FindEntry(impl, owner) >= 0)
+        AddReady(impl, &entries[i], found[i]);
+    }
+    result = impl->readyCount;
+  }
+
+  HeapFree(GetProcessHeap(), 0, fds);
+  HeapFree(GetProcessHeap(), 0, owners);
+  HeapFree(GetProcessHeap(), 0, found);
+  FreeSnapshot(entries, count);
+  return result;
+}
+
+File Poller::readyFile(int index) const {
+  if (!impl)
+    return File(Path(""));
+
+  ReadLockGuard guard(&impl->lock);
+  if (index < 0 || index >= impl->readyCount || !impl->ready[index])
+    return File(Path(""));
+  return *impl->ready[index];
+}
+
+Datagram Poller::readyDatagram(int index) const {
+  if (!impl)
+    return Datagram(-1);
+
+  ReadLockGuard guard(&impl->lock);
+  if (index < 0 || index >= impl->readyCount || !impl->readyDatagrams[index])
+    return Datagram(-1);
+  return *impl->readyDatagrams[index];
+}
+
+int Poller::readyEvents(int index) const {
+  if (!impl)
+    return 0;
+
+  ReadLockGuard guard(&impl->lock);
+  if (index < 0 || index >= impl->readyCount)
+    return 0;
+  return impl->readyEvents[index];
+}
+
+} // namespace attoboy
@@ -0,0 +1,37 @@
+#pragma once
+#include "attodatagram_internal.h"
+#include <new>
+
+namespace attoboy {
+
+// Pipes cannot be waited on with WSAPoll, so while any are registered the
+// wait is split into slices of this length and the pipes are peeked between
+// slices.
+static const int POLLER_PIPE_SLICE_MS = 10;
+
+// A registered File or Datagram; exactly one of file and datagram is set.
+// The copy is owning and keeps the handle alive.
+struct PollerEntry {
+  File *file;
+  FileImpl *fileImpl;
+  Datagram *datagram;
+  DatagramImpl *datagramImpl;
+  int events;
+};
+
+// ready/readyDatagrams/readyEvents hold owning copies of the Files and
+// Datagrams reported by the last wait() (one of the two per index), so
+// entries can be removed while the results are being handled.
+struct PollerImpl {
+  PollerEntry *entries;
+  int count;
+  int capacity;
+  File **ready;
+  Datagram **readyDatagrams;
+  int *readyEvents;
+  int readyCount;
+  SRWLOCK lock;
+  volatile LONG refCount;
+};
+
+} // namespace attoboy
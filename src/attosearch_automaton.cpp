@@ -0,0 +1,122 @@
+#include "attosearch_internal.h"
+
+namespace attoboy {
+
+static inline unsigned char FoldSearchByte(unsigned char c, bool ignoreCase) {
+  return ignoreCase && c >= 'A' && c <= 'Z' ? (unsigned char)(c + 32) : c;
+}
+
+static int *AllocSearchTable(int count, int fill) {
+  int *table = (int *)HeapAlloc(GetProcessHeap(), 0, count * sizeof(int));
+  if (table) {
+    for (int i = 0; i < count; i++)
+      table[i] = fill;
+  }
+  return table;
+}
+
+SearchAutomaton *BuildSearchAutomaton(unsigned char **patterns,
+                                      const int *lengths, int count,
+                                      bool ignoreCase) {
+  SearchAutomaton *automaton = (SearchAutomaton *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(SearchAutomaton));
+  if (!automaton)
+    return nullptr;
+
+  // Number the bytes that occur in patterns; upper-case letters share the
+  // class of their lower-case form when ignoring case.
+  automaton->classCount = 1;
+  int maxStates = 1;
+  for (int i = 0; i < count; i++) {
+    maxStates += lengths[i];
+    for (int j = 0; j < lengths[i]; j++) {
+      unsigned char c = FoldSearchByte(patterns[i][j], ignoreCase);
+      if (!automaton->classes[c])
+        automaton->classes[c] = (unsigned char)automaton->classCount++;
+    }
+  }
+  if (ignoreCase) {
+    for (int c = 'A'; c <= 'Z'; c++)
+      automaton->classes[c] = automaton->classes[c + 32];
+  }
+
+  int classCount = automaton->classCount;
+  automaton->next = AllocSearchTable(maxStates * classCount, -1);
+  automaton->match = AllocSearchTable(maxStates, -1);
+  automaton->outLink = AllocSearchTable(maxStates, -1);
+  int *fail = AllocSearchTable(maxStates, 0);
+  int *queue = AllocSearchTable(maxStates, 0);
+  if (!automaton->next || !automaton->match || !automaton->outLink || !fail ||
+      !queue) {
+    if (fail)
+      HeapFree(GetProcessHeap(), 0, fail);
+    if (queue)
+      HeapFree(GetProcessHeap(), 0, queue);
+    FreeSearchAutomaton(automaton);
+    return nullptr;
+  }
+  int *next = automaton->next;
+
+  // The trie: state 0 is the root, -1 marks a missing edge.
+  automaton->stateCount = 1;
+  for (int i = 0; i < count; i++) {
+    int state = 0;
+    for (int j = 0; j < lengths[i]; j++) {
+      unsigned char c = automaton->classes[patterns[i][j]];
+      int *edge = &next[state * classCount + c];
+      if (*edge < 0)
+        *edge = automaton->stateCount++;
+      state = *edge;
+    }
+    if (automaton->match[state] < 0)
+      automaton->match[state] = i;
+  }
+
+  // Breadth-first, fill every missing edge from the failure state, whose
+  // row is already complete because it is shallower.
+  int head = 0;
+  int tail = 0;
+  for (int c = 0; c < classCount; c++) {
+    if (next[c] < 0) {
+      next[c] = 0;
+    } else {
+      fail[next[c]] = 0;
+      queue[tail++] = next[c];
+    }
+  }
+  while (head < tail) {
+    int state = queue[head++];
+    int *row = &next[state * classCount];
+    const int *failRow = &next[fail[state] * classCount];
+    for (int c = 0; c < classCount; c++) {
+      if (row[c] < 0) {
+        row[c] = failRow[c];
+        continue;
+      }
+      int child = row[c];
+      int target = failRow[c];
+      fail[child] = target;
+      automaton->outLink[child] =
+          automaton->match[target] >= 0 ? target : automaton->outLink[target];
+      queue[tail++] = child;
+    }
+  }
+
+  HeapFree(GetProcessHeap(), 0, fail);
+  HeapFree(GetProcessHeap(), 0, queue);
+  return automaton;
+}
+
+void FreeSearchAutomaton(SearchAutomaton *automaton) {
+  if (!automaton)
+    return;
+  if (automaton->next)
+    HeapFree(GetProcessHeap(), 0, automaton->next);
+  if (automaton->match)
+    HeapFree(GetProcessHeap(), 0, automaton->match);
+  if (automaton->outLink)
+    HeapFree(GetProcessHeap(), 0, automaton->outLink);
+  HeapFree(GetProcessHeap(), 0, automaton);
+}
+
+} // namespace attoboy
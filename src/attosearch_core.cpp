@@ -0,0 +1,460 @@
+#include "attosearch_internal.h"
+#include "atto_internal_scan.h"
+
+namespace attoboy {
+
+// Position within the block being scanned. Newlines are counted lazily up
+// to each match: counted is how far they have been counted, and line and
+// lineStart describe the line containing that point.
+struct SearchCursor {
+  SearchImpl *impl;
+  const String *path;
+  const unsigned char *data;
+  int length;
+  int line;
+  int lineStart;
+  int counted;
+};
+
+static void CountSearchLines(SearchCursor *cursor, int offset) {
+  while (cursor->counted < offset) {
+    int hit = FindByte(cursor->data + cursor->counted,
+                       offset - cursor->counted, '\n');
+    if (hit < 0) {
+      cursor->counted = offset;
+      return;
+    }
+    cursor->counted += hit + 1;
+    cursor->line++;
+    cursor->lineStart = cursor->counted;
+  }
+}
+
+static void StopSearch(SearchImpl *impl) {
+  AcquireSRWLockExclusive(&impl->lock);
+  impl->stopped = 1;
+  WakeAllConditionVariable(&impl->changed);
+  ReleaseSRWLockExclusive(&impl->lock);
+}
+
+// Hands a match starting at offset to the callback. Returns false once the
+// search has stopped.
+static bool ReportSearchMatch(SearchCursor *cursor, int offset,
+                              int pattern) {
+  SearchImpl *impl = cursor->impl;
+  if (impl->stopped)
+    return false;
+  CountSearchLines(cursor, offset);
+  const unsigned char *data = cursor->data;
+  int end = FindByte(data + offset, cursor->length - offset, '\n');
+  end = end < 0 ? cursor->length : offset + end;
+  if (end > cursor->lineStart && data[end - 1] == '\r')
+    end--;
+  String text = String::FromCStr((const char *)data + cursor->lineStart,
+                                 end - cursor->lineStart);
+
+  AcquireSRWLockExclusive(&impl->callbackLock);
+  bool proceed = !impl->stopped;
+  if (proceed) {
+    InterlockedIncrement(&impl->matchCount);
+    proceed = impl->callback(*cursor->path, cursor->line,
+                             offset - cursor->lineStart + 1, text,
+                             impl->patternIndexes[pattern], impl->callbackArg);
+  }
+  ReleaseSRWLockExclusive(&impl->callbackLock);
+  if (!proceed)
+    StopSearch(impl);
+  return proceed;
+}
+
+static bool ScanSearchBlock(SearchCursor *cursor) {
+  SearchImpl *impl = cursor->impl;
+  const unsigned char *data = cursor->data;
+  int len = cursor->length;
+
+  if (!impl->automaton) {
+    const unsigned char *needle = impl->patterns[0];
+    int needleLen = impl->patternLengths[0];
+    int pos = 0;
+    while (pos <= len - needleLen) {
+      int hit = FindBytes(data + pos, len - pos, needle, needleLen);
+      if (hit < 0)
+        break;
+      if (!ReportSearchMatch(cursor, pos + hit, 0))
+        return false;
+      pos += hit + 1;
+    }
+    return true;
+  }
+
+  const SearchAutomaton *automaton = impl->automaton;
+  const int *next = automaton->next;
+  const unsigned char *classes = automaton->classes;
+  int classCount = automaton->classCount;
+  int state = 0;
+  for (int i = 0; i < len; i++) {
+    state = next[state * classCount + classes[data[i]]];
+    int found =
+        automaton->match[state] >= 0 ? state : automaton->outLink[state];
+    while (found >= 0) {
+      int pattern = automaton->match[found];
+      int start = i + 1 - impl->patternLengths[pattern];
+      if (!ReportSearchMatch(cursor, start, pattern))
+        return false;
+      found = automaton->outLink[found];
+    }
+  }
+  return true;
+}
+
+static void SearchOneFile(SearchImpl *impl, const String &path) {
+  Path filePath(path);
+  MappedFile file(filePath);
+  int len = 0;
+  const unsigned char *data = file.isValid() ? file.c_ptr(&len) : nullptr;
+  if (!data || len <= 0)
+    return;
+  int sniff = len < SEARCH_SNIFF_BYTES ? len : SEARCH_SNIFF_BYTES;
+  if (FindByte(data, sniff, 0) >= 0) {
+    InterlockedIncrement(&impl->binaryCount);
+    return;
+  }
+  InterlockedIncrement(&impl->fileCount);
+
+  // Files larger than one window are searched a window at a time. Each
+  // block ends at a newline so no line (and no match) straddles two; only
+  // a line longer than a whole window is split.
+  long long size = file.getSize();
+  SearchCursor cursor = {impl, &path, nullptr, 0, 1, 0, 0};
+  for (;;) {
+    data = file.c_ptr(&len);
+    if (!data || len <= 0)
+      return;
+    bool last = file.getWindowOffset() + len >= size;
+    int usable = len;
+    if (!last) {
+      int cut = len;
+      while (cut > 0 && data[cut - 1] != '\n')
+        cut--;
+      if (cut > 0)
+        usable = cut;
+    }
+    cursor.data = data;
+    cursor.length = usable;
+    cursor.lineStart = 0;
+    cursor.counted = 0;
+    if (!ScanSearchBlock(&cursor) || last)
+      return;
+    CountSearchLines(&cursor, usable);
+    if (!file.setWindow(file.getWindowOffset() + usable))
+      return;
+  }
+}
+
+static DWORD WINAPI SearchWorkerProc(LPVOID param) {
+  SearchImpl *impl = (SearchImpl *)param;
+  for (;;) {
+    AcquireSRWLockExclusive(&impl->lock);
+    while (impl->queueCount == 0 && !impl->walkDone && !impl->stopped)
+      SleepConditionVariableSRW(&impl->changed, &impl->lock, INFINITE, 0);
+    if (impl->queueCount == 0 || impl->stopped) {
+      ReleaseSRWLockExclusive(&impl->lock);
+      return 0;
+    }
+    String *path = impl->queue[impl->queueHead];
+    impl->queueHead = (impl->queueHead + 1) % SEARCH_QUEUE_SIZE;
+    impl->queueCount--;
+    WakeAllConditionVariable(&impl->changed);
+    ReleaseSRWLockExclusive(&impl->lock);
+
+    SearchOneFile(impl, *path);
+    delete path;
+  }
+}
+
+// Walks root on the calling thread and feeds the files to the workers.
+static void SearchTree(SearchImpl *impl, const Path &root, int threads,
+                       const String &filter, const List &skipped) {
+  HANDLE *workers =
+      (HANDLE *)HeapAlloc(GetProcessHeap(), 0, threads * sizeof(HANDLE));
+  int workerCount = 0;
+  for (int i = 0; workers && i < threads; i++) {
+    HANDLE worker =
+        CreateThread(nullptr, 0, SearchWorkerProc, impl, 0, nullptr);
+    if (worker)
+      workers[workerCount++] = worker;
+  }
+
+  DirectoryWalker walker(root);
+  walker.setIncludeDirectories(false).setFilter(filter);
+  for (int i = 0; i < skipped.length(); i++)
+    walker.skipDirectories(skipped.at<String>(i));
+  while (!impl->stopped && walker.next()) {
+    String *path = new String(walker.getPath());
+    if (workerCount == 0) {
+      SearchOneFile(impl, *path);
+      delete path;
+      continue;
+    }
+    AcquireSRWLockExclusive(&impl->lock);
+    while (impl->queueCount == SEARCH_QUEUE_SIZE && !impl->stopped)
+      SleepConditionVariableSRW(&impl->changed, &impl->lock, INFINITE, 0);
+    if (impl->stopped) {
+      ReleaseSRWLockExclusive(&impl->lock);
+      delete path;
+      break;
+    }
+    int tail = (impl->queueHead + impl->queueCount) % SEARCH_QUEUE_SIZE;
+    impl->queue[tail] = path;
+    impl->queueCount++;
+    WakeAllConditionVariable(&impl->changed);
+    ReleaseSRWLockExclusive(&impl->lock);
+  }
+
+  AcquireSRWLockExclusive(&impl->lock);
+  impl->walkDone = true;
+  WakeAllConditionVariable(&impl->changed);
+  ReleaseSRWLockExclusive(&impl->lock);
+  for (int i = 0; i < workerCount; i++) {
+    WaitForSingleObject(workers[i], INFINITE);
+    CloseHandle(workers[i]);
+  }
+  if (workers)
+    HeapFree(GetProcessHeap(), 0, workers);
+
+  // Left over when the callback stopped the search.
+  while (impl->queueCount > 0) {
+    delete impl->queue[impl->queueHead];
+    impl->queueHead = (impl->queueHead + 1) % SEARCH_QUEUE_SIZE;
+    impl->queueCount--;
+  }
+}
+
+// Empty patterns are left out, so each kept pattern remembers its index in
+// the caller's list for reporting.
+static void AddSearchPattern(SearchImpl *impl, const String &pattern,
+                             int index) {
+  int len = pattern.byteLength();
+  if (len <= 0)
+    return;
+  unsigned char *bytes =
+      (unsigned char *)HeapAlloc(GetProcessHeap(), 0, len);
+  if (!bytes)
+    return;
+  CopyMemory(bytes, pattern.c_str(), len);
+  impl->patterns[impl->patternCount] = bytes;
+  impl->patternLengths[impl->patternCount] = len;
+  impl->patternIndexes[impl->patternCount] = index;
+  impl->patternCount++;
+}
+
+static SearchImpl *NewSearchImpl(int capacity) {
+  SearchImpl *impl = (SearchImpl *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(SearchImpl));
+  if (!impl)
+    return nullptr;
+  InitializeSRWLock(&impl->lock);
+  InitializeConditionVariable(&impl->changed);
+  InitializeSRWLock(&impl->callbackLock);
+  impl->refCount = 1;
+  impl->filter = new String();
+  impl->skipped = new List();
+  impl->queue = (String **)HeapAlloc(GetProcessHeap(), 0,
+                                     SEARCH_QUEUE_SIZE * sizeof(String *));
+  if (capacity > 0) {
+    impl->patterns = (unsigned char **)HeapAlloc(
+        GetProcessHeap(), 0, capacity * sizeof(unsigned char *));
+    impl->patternLengths =
+        (int *)HeapAlloc(GetProcessHeap(), 0, capacity * sizeof(int));
+    impl->patternIndexes =
+        (int *)HeapAlloc(GetProcessHeap(), 0, capacity * sizeof(int));
+  }
+  return impl;
+}
+
+static void FreeSearchImpl(SearchImpl *impl) {
+  for (int i = 0; i < impl->patternCount; i++)
+    HeapFree(GetProcessHeap(), 0, impl->patterns[i]);
+  if (impl->patterns)
+    HeapFree(GetProcessHeap(), 0, impl->patterns);
+  if (impl->patternLengths)
+    HeapFree(GetProcessHeap(), 0, impl->patternLengths);
+  if (impl->patternIndexes)
+    HeapFree(GetProcessHeap(), 0, impl->patternIndexes);
+  if (impl->queue)
+    HeapFree(GetProcessHeap(), 0, impl->queue);
+  delete impl->filter;
+  delete impl->skipped;
+  HeapFree(GetProcessHeap(), 0, impl);
+}
+
+Search::Search(const String &pattern) {
+  impl = NewSearchImpl(1);
+  if (impl && impl->patterns && impl->patternLengths && impl->patternIndexes)
+    AddSearchPattern(impl, pattern, 0);
+}
+
+Search::Search(const List &patterns) {
+  impl = NewSearchImpl(patterns.length());
+  if (!impl || !impl->patterns || !impl->patternLengths ||
+      !impl->patternIndexes)
+    return;
+  for (int i = 0; i < patterns.length(); i++)
+    AddSearchPattern(impl, patterns.at<String>(i), i);
+}
+
+Search::Search(const Search &other) {
+  impl = other.impl;
+  if (impl)
+    InterlockedIncrement(&impl->refCount);
+}
+
+Search::~Search() {
+  if (impl && InterlockedDecrement(&impl->refCount) == 0)
+    FreeSearchImpl(impl);
+}
+
+Search &Search::operator=(const Search &other) {
+  if (this != &other) {
+    if (impl && InterlockedDecrement(&impl->refCount) == 0)
+      FreeSearchImpl(impl);
+    impl = other.impl;
+    if (impl)
+      InterlockedIncrement(&impl->refCount);
+  }
+  return *this;
+}
+
+Search &Search::setIgnoreCase(bool ignoreCase) {
+  if (!impl)
+    return *this;
+  WriteLockGuard guard(&impl->lock);
+  if (!impl->running)
+    impl->ignoreCase = ignoreCase;
+  return *this;
+}
+
+Search &Search::setThreads(int threads) {
+  if (!impl)
+    return *this;
+  WriteLockGuard guard(&impl->lock);
+  if (!impl->running)
+    impl->threadCount = threads;
+  return *this;
+}
+
+Search &Search::setFilter(const String &pattern) {
+  if (!impl)
+    return *this;
+  WriteLockGuard guard(&impl->lock);
+  if (!impl->running)
+    *impl->filter = pattern;
+  return *this;
+}
+
+Search &Search::skipDirectories(const String &pattern) {
+  if (!impl || pattern.isEmpty())
+    return *this;
+  WriteLockGuard guard(&impl->lock);
+  if (!impl->running)
+    impl->skipped->append(pattern);
+  return *this;
+}
+
+int Search::run(const Path &path, SearchCallback callback, void *arg) {
+  if (!impl || !callback || !impl->queue)
+    return -1;
+  String filter;
+  List skipped;
+  int threads;
+  {
+    WriteLockGuard guard(&impl->lock);
+    if (impl->running)
+      return -1;
+    impl->running = true;
+    filter = *impl->filter;
+    skipped = *impl->skipped;
+    threads = impl->threadCount;
+  }
+  if (threads <= 0) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    threads = (int)info.dwNumberOfProcessors;
+  }
+  impl->callback = callback;
+  impl->callbackArg = arg;
+  impl->queueHead = 0;
+  impl->queueCount = 0;
+  impl->walkDone = false;
+  impl->stopped = 0;
+  impl->matchCount = 0;
+  impl->fileCount = 0;
+  impl->binaryCount = 0;
+
+  // One case-sensitive pattern uses the SIMD substring scan; anything else
+  // goes through the automaton.
+  bool ready = true;
+  if (impl->patternCount > 1 || impl->ignoreCase) {
+    impl->automaton =
+        BuildSearchAutomaton(impl->patterns, impl->patternLengths,
+                             impl->patternCount, impl->ignoreCase);
+    ready = impl->automaton != nullptr;
+  }
+
+  int result = -1;
+  if (ready && path.exists()) {
+    if (impl->patternCount == 0)
+      result = 0;
+    else if (path.isDirectory())
+      SearchTree(impl, path, threads, filter, skipped);
+    else
+      SearchOneFile(impl, path.toString());
+    if (impl->patternCount > 0)
+      result = impl->matchCount;
+  }
+
+  FreeSearchAutomaton(impl->automaton);
+  impl->automaton = nullptr;
+  WriteLockGuard guard(&impl->lock);
+  impl->running = false;
+  return result;
+}
+
+// Collects matches for findAll(); remaining is how many more to keep
+// (-1 = no limit).
+struct SearchCollector {
+  List *matches;
+  int remaining;
+};
+
+static bool CollectSearchMatch(const String &path, int line, int column,
+                               const String &text, int pattern, void *arg) {
+  SearchCollector *collector = (SearchCollector *)arg;
+  Map match;
+  match.put(String("path"), path);
+  match.put(String("line"), line);
+  match.put(String("column"), column);
+  match.put(String("text"), text);
+  match.put(String("pattern"), pattern);
+  collector->matches->append(match);
+  if (collector->remaining > 0)
+    collector->remaining--;
+  return collector->remaining != 0;
+}
+
+List Search::findAll(const Path &path, int maxMatches) {
+  List matches;
+  if (maxMatches == 0)
+    return matches;
+  SearchCollector collector = {&matches, maxMatches};
+  run(path, CollectSearchMatch, &collector);
+  return matches;
+}
+
+int Search::getFileCount() const { return impl ? impl->fileCount : 0; }
+
+int Search::getBinaryFileCount() const {
+  return impl ? impl->binaryCount : 0;
+}
+
+} // namespace attoboy
@@ -0,0 +1,67 @@
+#pragma once
+#include "atto_internal_common.h"
+#include "attoboy/attoboy.h"
+#include <windows.h>
+
+namespace attoboy {
+
+// Files whose first bytes hold a NUL are treated as binary.
+static const int SEARCH_SNIFF_BYTES = 8192;
+
+// Paths listed ahead of the workers; the walk pauses beyond this.
+static const int SEARCH_QUEUE_SIZE = 256;
+
+// Aho-Corasick automaton as a dense transition table over byte classes:
+// bytes that appear in no pattern share class 0, so the table stays small.
+// match is the pattern ending at a state (or -1); outLink is the nearest
+// state on the failure chain with a match (or -1).
+struct SearchAutomaton {
+  unsigned char classes[256];
+  int classCount;
+  int stateCount;
+  int *next;
+  int *match;
+  int *outLink;
+};
+
+// Settings are guarded by lock. The rest belongs to the running run():
+// queue is shared between the walk and the workers under lock, and
+// callbackLock serializes the callback.
+struct SearchImpl {
+  unsigned char **patterns;
+  int *patternLengths;
+  int *patternIndexes;
+  int patternCount;
+  bool ignoreCase;
+  int threadCount;
+  String *filter;
+  List *skipped;
+
+  bool running;
+  SearchAutomaton *automaton;
+  SearchCallback callback;
+  void *callbackArg;
+  String **queue;
+  int queueHead;
+  int queueCount;
+  bool walkDone;
+  volatile LONG stopped;
+  volatile LONG matchCount;
+  volatile LONG fileCount;
+  volatile LONG binaryCount;
+
+  SRWLOCK lock;
+  CONDITION_VARIABLE changed;
+  SRWLOCK callbackLock;
+  volatile LONG refCount;
+};
+
+/// Builds an automaton for the patterns, folding ASCII case if ignoreCase.
+/// Returns nullptr on allocation failure.
+SearchAutomaton *BuildSearchAutomaton(unsigned char **patterns,
+                                      const int *lengths, int count,
+                                      bool ignoreCase);
+
+void FreeSearchAutomaton(SearchAutomaton *automaton);
+
+} // namespace attoboy
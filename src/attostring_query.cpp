@@ -1,3 +1,4 @@
+#include "atto_internal_hash.h"
 #include "attostring_internal.h"
 
 namespace attoboy {
@@ -407,4 +408,18 @@ int String::hash() const {
   return (int)hash;
 }
 
+long long String::hash64() const {
+  if (!impl)
+    return (long long)XXH64(nullptr, 0, 0);
+  ReadLockGuard guard(&impl->lock);
+  return (long long)XXH64((const unsigned char *)impl->data, impl->len, 0);
+}
+
+int String::crc32c() const {
+  if (!impl)
+    return 0;
+  ReadLockGuard guard(&impl->lock);
+  return (int)Crc32cUpdate(0, (const unsigned char *)impl->data, impl->len);
+}
+
 } // namespace attoboy
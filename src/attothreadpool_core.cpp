@@ -0,0 +1,369 @@
+#include "attothreadpool_internal.h"
+
+namespace attoboy {
+
+// TLS slot holding the PoolWorker of the current thread, shared by every
+// pool.
+static SRWLOCK g_poolTlsLock = SRWLOCK_INIT;
+static DWORD g_poolTls = TLS_OUT_OF_INDEXES;
+
+static DWORD GetPoolTls() {
+  {
+    ReadLockGuard guard(&g_poolTlsLock);
+    if (g_poolTls != TLS_OUT_OF_INDEXES)
+      return g_poolTls;
+  }
+  WriteLockGuard guard(&g_poolTlsLock);
+  if (g_poolTls == TLS_OUT_OF_INDEXES)
+    g_poolTls = TlsAlloc();
+  return g_poolTls;
+}
+
+// Returns the calling thread's worker if it belongs to pool. Only compares
+// pointers, so pool need not be alive.
+static PoolWorker *CurrentPoolWorker(const ThreadPoolImpl *pool) {
+  DWORD tls = GetPoolTls();
+  if (tls == TLS_OUT_OF_INDEXES)
+    return nullptr;
+  PoolWorker *worker = (PoolWorker *)TlsGetValue(tls);
+  return worker && worker->pool == pool ? worker : nullptr;
+}
+
+static bool PushDeque(PoolDeque *deque, FutureImpl *task) {
+  WriteLockGuard guard(&deque->lock);
+  if (deque->tail - deque->head == deque->capacity) {
+    unsigned int capacity = deque->capacity * 2;
+    FutureImpl **items = (FutureImpl **)HeapAlloc(
+        GetProcessHeap(), 0, capacity * sizeof(FutureImpl *));
+    if (!items)
+      return false;
+    for (unsigned int i = deque->head; i != deque->tail; i++)
+      items[i & (capacity - 1)] = deque->items[i & (deque->capacity - 1)];
+    HeapFree(GetProcessHeap(), 0, deque->items);
+    deque->items = items;
+    deque->capacity = capacity;
+  }
+  deque->items[deque->tail & (deque->capacity - 1)] = task;
+  deque->tail++;
+  return true;
+}
+
+// Takes the newest task; only the owning worker pops.
+static FutureImpl *PopDeque(PoolDeque *deque) {
+  if (deque->head == deque->tail)
+    return nullptr;
+  WriteLockGuard guard(&deque->lock);
+  if (deque->head == deque->tail)
+    return nullptr;
+  deque->tail--;
+  return deque->items[deque->tail & (deque->capacity - 1)];
+}
+
+// Takes the oldest task, which is the one its owner will reach last.
+static FutureImpl *StealDeque(PoolDeque *deque) {
+  if (deque->head == deque->tail)
+    return nullptr;
+  WriteLockGuard guard(&deque->lock);
+  if (deque->head == deque->tail)
+    return nullptr;
+  FutureImpl *task = deque->items[deque->head & (deque->capacity - 1)];
+  deque->head++;
+  return task;
+}
+
+// Returns the next task for worker: its own newest, or else the oldest of
+// another worker's, starting from a random victim.
+static FutureImpl *FindPoolTask(PoolWorker *worker) {
+  ThreadPoolImpl *pool = worker->pool;
+  FutureImpl *task = PopDeque(&worker->deque);
+  if (!task) {
+    worker->seed = worker->seed * 1103515245u + 12345u;
+    int start = (int)((worker->seed >> 16) % (unsigned int)pool->workerCount);
+    for (int i = 0; i < pool->workerCount && !task; i++) {
+      PoolWorker *victim = &pool->workers[(start + i) % pool->workerCount];
+      if (victim != worker)
+        task = StealDeque(&victim->deque);
+    }
+    if (task)
+      InterlockedIncrement64(&pool->steals);
+  }
+  if (task)
+    InterlockedDecrement(&pool->queued);
+  return task;
+}
+
+// Waits until a task may be queued. Returns false when the pool is closing
+// and every task has finished.
+static bool WaitForPoolTask(ThreadPoolImpl *pool) {
+  for (int i = 0; i < POOL_SPIN_ROUNDS; i++) {
+    if (pool->queued > 0)
+      return true;
+    YieldProcessor();
+  }
+
+  // sleepers is raised before queued is checked and queued before sleepers,
+  // so either this worker sees the task or the submitter wakes it.
+  WriteLockGuard guard(&pool->sleepLock);
+  for (;;) {
+    if (pool->queued > 0)
+      return true;
+    if (pool->closing && pool->outstanding == 0)
+      return false;
+    InterlockedIncrement(&pool->sleepers);
+    if (pool->queued <= 0)
+      SleepConditionVariableSRW(&pool->wake, &pool->sleepLock, INFINITE, 0);
+    InterlockedDecrement(&pool->sleepers);
+  }
+}
+
+static void FreeThreadPoolImpl(ThreadPoolImpl *impl) {
+  for (int i = 0; i < impl->workerCount; i++) {
+    if (impl->workers[i].thread)
+      CloseHandle(impl->workers[i].thread);
+    HeapFree(GetProcessHeap(), 0, impl->workers[i].deque.items);
+  }
+  if (impl->workers)
+    HeapFree(GetProcessHeap(), 0, impl->workers);
+  HeapFree(GetProcessHeap(), 0, impl);
+}
+
+static void ReleaseThreadPoolImpl(ThreadPoolImpl *impl) {
+  if (InterlockedDecrement(&impl->refCount) == 0)
+    FreeThreadPoolImpl(impl);
+}
+
+static DWORD WINAPI PoolWorkerProc(LPVOID param) {
+  PoolWorker *worker = (PoolWorker *)param;
+  ThreadPoolImpl *pool = worker->pool;
+  TlsSetValue(GetPoolTls(), worker);
+  for (;;) {
+    FutureImpl *task = FindPoolTask(worker);
+    if (task)
+      RunFutureTask(task);
+    else if (!WaitForPoolTask(pool))
+      break;
+  }
+  TlsSetValue(GetPoolTls(), nullptr);
+  if (InterlockedDecrement(&pool->liveWorkers) == 0)
+    ReleaseThreadPoolImpl(pool);
+  return 0;
+}
+
+bool QueuePoolTask(ThreadPoolImpl *pool, FutureImpl *impl) {
+  PoolWorker *worker = CurrentPoolWorker(pool);
+  if (!worker) {
+    unsigned int next = (unsigned int)InterlockedIncrement(&pool->nextWorker);
+    worker = &pool->workers[next % (unsigned int)pool->workerCount];
+  }
+
+  InterlockedIncrement(&impl->refCount);
+  if (!PushDeque(&worker->deque, impl)) {
+    InterlockedDecrement(&impl->refCount);
+    return false;
+  }
+  InterlockedIncrement(&pool->queued);
+  if (pool->sleepers > 0) {
+    WriteLockGuard guard(&pool->sleepLock);
+    WakeConditionVariable(&pool->wake);
+  }
+  return true;
+}
+
+void FinishPoolTask(ThreadPoolImpl *pool) {
+  if (InterlockedDecrement(&pool->outstanding) != 0)
+    return;
+  WriteLockGuard guard(&pool->sleepLock);
+  WakeAllConditionVariable(&pool->idle);
+  if (pool->closing)
+    WakeAllConditionVariable(&pool->wake);
+}
+
+bool HelpPoolUntilDone(FutureImpl *impl) {
+  ThreadPoolImpl *pool;
+  {
+    ReadLockGuard guard(&impl->lock);
+    if (impl->state == FUTURE_DONE || impl->state == FUTURE_CANCELLED)
+      return true;
+    pool = impl->pool;
+  }
+  PoolWorker *worker = CurrentPoolWorker(pool);
+  if (!worker)
+    return false;
+
+  // Running other tasks here is what lets a task wait on tasks it spawned
+  // without tying up its worker.
+  for (;;) {
+    FutureImpl *task = FindPoolTask(worker);
+    if (task) {
+      RunFutureTask(task);
+      ReadLockGuard guard(&impl->lock);
+      if (impl->state == FUTURE_DONE || impl->state == FUTURE_CANCELLED)
+        return true;
+      continue;
+    }
+    WriteLockGuard guard(&impl->lock);
+    if (impl->state == FUTURE_DONE || impl->state == FUTURE_CANCELLED)
+      return true;
+    SleepConditionVariableSRW(&impl->finished, &impl->lock, POOL_HELP_WAIT_MS,
+                              0);
+  }
+}
+
+ThreadPool::ThreadPool(int workerCount) {
+  impl = (ThreadPoolImpl *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                     sizeof(ThreadPoolImpl));
+  if (!impl)
+    return;
+  InitializeSRWLock(&impl->sleepLock);
+  InitializeConditionVariable(&impl->wake);
+  InitializeConditionVariable(&impl->idle);
+  impl->handles = 1;
+  impl->refCount = 2;
+
+  if (workerCount <= 0) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    workerCount = (int)info.dwNumberOfProcessors;
+    if (workerCount < 1)
+      workerCount = 1;
+  }
+  if (GetPoolTls() != TLS_OUT_OF_INDEXES)
+    impl->workers = (PoolWorker *)HeapAlloc(
+        GetProcessHeap(), HEAP_ZERO_MEMORY, workerCount * sizeof(PoolWorker));
+
+  // Every deque exists before any worker starts, since workers steal from
+  // all of them.
+  int count = 0;
+  while (impl->workers && count < workerCount) {
+    PoolWorker *worker = &impl->workers[count];
+    worker->deque.items = (FutureImpl **)HeapAlloc(
+        GetProcessHeap(), 0,
+        POOL_DEQUE_INITIAL_CAPACITY * sizeof(FutureImpl *));
+    if (!worker->deque.items)
+      break;
+    worker->deque.capacity = POOL_DEQUE_INITIAL_CAPACITY;
+    InitializeSRWLock(&worker->deque.lock);
+    worker->pool = impl;
+    worker->seed = (unsigned int)count * 2654435761u + 1;
+    count++;
+  }
+  impl->workerCount = count;
+
+  // A worker that fails to start leaves its deque empty; submissions
+  // placed there are stolen by the others.
+  impl->liveWorkers = count;
+  for (int i = 0; i < count; i++) {
+    impl->workers[i].thread =
+        CreateThread(nullptr, 0, PoolWorkerProc, &impl->workers[i], 0, nullptr);
+    if (!impl->workers[i].thread)
+      InterlockedDecrement(&impl->liveWorkers);
+  }
+  if (impl->liveWorkers == 0)
+    InterlockedDecrement(&impl->refCount);
+}
+
+ThreadPool::ThreadPool(const ThreadPool &other) {
+  impl = other.impl;
+  if (impl) {
+    InterlockedIncrement(&impl->handles);
+    InterlockedIncrement(&impl->refCount);
+  }
+}
+
+// Drops a handle. The last one lets queued tasks finish, then stops the
+// workers; inside one of the pool's tasks it cannot wait, so the workers
+// finish the queue and release the pool themselves.
+static void ReleaseThreadPoolHandle(ThreadPoolImpl *impl) {
+  if (InterlockedDecrement(&impl->handles) != 0) {
+    ReleaseThreadPoolImpl(impl);
+    return;
+  }
+
+  bool inside = CurrentPoolWorker(impl) != nullptr;
+  if (!inside && impl->liveWorkers > 0) {
+    WriteLockGuard guard(&impl->sleepLock);
+    while (impl->outstanding > 0)
+      SleepConditionVariableSRW(&impl->idle, &impl->sleepLock, INFINITE, 0);
+  }
+  {
+    WriteLockGuard guard(&impl->sleepLock);
+    InterlockedExchange(&impl->closing, 1);
+    WakeAllConditionVariable(&impl->wake);
+  }
+  if (!inside) {
+    for (int i = 0; i < impl->workerCount; i++) {
+      if (impl->workers[i].thread)
+        WaitForSingleObject(impl->workers[i].thread, INFINITE);
+    }
+  }
+  ReleaseThreadPoolImpl(impl);
+}
+
+ThreadPool::~ThreadPool() {
+  if (impl)
+    ReleaseThreadPoolHandle(impl);
+}
+
+ThreadPool &ThreadPool::operator=(const ThreadPool &other) {
+  if (this != &other) {
+    if (other.impl) {
+      InterlockedIncrement(&other.impl->handles);
+      InterlockedIncrement(&other.impl->refCount);
+    }
+    if (impl)
+      ReleaseThreadPoolHandle(impl);
+    impl = other.impl;
+  }
+  return *this;
+}
+
+// Queues func(arg) with token, or a new token if token is nullptr.
+static FutureImpl *SubmitPoolTask(ThreadPoolImpl *pool, TaskFunction func,
+                                  void *arg, CancelTokenImpl *token) {
+  if (!pool || !func || pool->liveWorkers == 0)
+    return nullptr;
+  FutureImpl *task = AllocFutureImpl(pool, token);
+  if (!task)
+    return nullptr;
+  task->func = func;
+  task->arg = arg;
+
+  InterlockedIncrement(&pool->outstanding);
+  if (!QueuePoolTask(pool, task)) {
+    CompleteFuture(task, FUTURE_CANCELLED, nullptr);
+    FinishPoolTask(pool);
+  }
+  return task;
+}
+
+Future ThreadPool::submit(TaskFunction func, void *arg) {
+  return Future(SubmitPoolTask(impl, func, arg, nullptr));
+}
+
+Future ThreadPool::submit(TaskFunction func, void *arg,
+                          const CancelToken &token) {
+  return Future(SubmitPoolTask(impl, func, arg, token.impl));
+}
+
+int ThreadPool::getWorkerCount() const {
+  return impl ? (int)impl->liveWorkers : 0;
+}
+
+int ThreadPool::getPendingCount() const {
+  return impl ? (int)impl->outstanding : 0;
+}
+
+long long ThreadPool::getStealCount() const {
+  return impl ? impl->steals : 0;
+}
+
+bool ThreadPool::waitIdle() {
+  if (!impl || CurrentPoolWorker(impl))
+    return false;
+  WriteLockGuard guard(&impl->sleepLock);
+  while (impl->outstanding > 0)
+    SleepConditionVariableSRW(&impl->idle, &impl->sleepLock, INFINITE, 0);
+  return true;
+}
+
+} // namespace attoboy
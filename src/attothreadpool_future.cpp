@@ -0,0 +1,270 @@
+#include "attothreadpool_internal.h"
+
+namespace attoboy {
+
+static CancelTokenImpl *AllocCancelTokenImpl() {
+  CancelTokenImpl *impl = (CancelTokenImpl *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(CancelTokenImpl));
+  if (impl)
+    impl->refCount = 1;
+  return impl;
+}
+
+static void ReleaseCancelTokenImpl(CancelTokenImpl *impl) {
+  if (impl && InterlockedDecrement(&impl->refCount) == 0)
+    HeapFree(GetProcessHeap(), 0, impl);
+}
+
+static bool IsFutureFinished(const FutureImpl *impl) {
+  return impl->state == FUTURE_DONE || impl->state == FUTURE_CANCELLED;
+}
+
+FutureImpl *AllocFutureImpl(ThreadPoolImpl *pool, CancelTokenImpl *token) {
+  FutureImpl *impl = (FutureImpl *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(FutureImpl));
+  if (!impl)
+    return nullptr;
+  if (token) {
+    InterlockedIncrement(&token->refCount);
+    impl->token = token;
+  } else {
+    impl->token = AllocCancelTokenImpl();
+    if (!impl->token) {
+      HeapFree(GetProcessHeap(), 0, impl);
+      return nullptr;
+    }
+  }
+
+  InitializeSRWLock(&impl->lock);
+  InitializeConditionVariable(&impl->finished);
+  impl->pool = pool;
+  impl->state = FUTURE_PENDING;
+  impl->refCount = 1;
+  return impl;
+}
+
+void ReleaseFutureImpl(FutureImpl *impl) {
+  if (InterlockedDecrement(&impl->refCount) != 0)
+    return;
+  ReleaseCancelTokenImpl(impl->token);
+  HeapFree(GetProcessHeap(), 0, impl);
+}
+
+// Queues continuation once its antecedent finished with state and result,
+// or skips it if the antecedent was skipped or it was cancelled itself.
+// Drops the antecedent's reference to it.
+static void StartContinuation(FutureImpl *continuation, FutureState state,
+                              void *result) {
+  ThreadPoolImpl *pool = continuation->pool;
+  bool queue = false;
+  {
+    WriteLockGuard guard(&continuation->lock);
+    if (continuation->state == FUTURE_PENDING && state == FUTURE_DONE) {
+      continuation->result = result;
+      queue = true;
+    }
+  }
+  if (!queue || !QueuePoolTask(pool, continuation)) {
+    CompleteFuture(continuation, FUTURE_CANCELLED, nullptr);
+    FinishPoolTask(pool);
+  }
+  ReleaseFutureImpl(continuation);
+}
+
+void CompleteFuture(FutureImpl *impl, FutureState state, void *result) {
+  FutureImpl *continuations;
+  {
+    WriteLockGuard guard(&impl->lock);
+    if (IsFutureFinished(impl))
+      return;
+    impl->state = state;
+    impl->result = state == FUTURE_DONE ? result : nullptr;
+    continuations = impl->continuations;
+    impl->continuations = nullptr;
+  }
+  WakeAllConditionVariable(&impl->finished);
+
+  while (continuations) {
+    FutureImpl *next = continuations->next;
+    StartContinuation(continuations, state, result);
+    continuations = next;
+  }
+}
+
+void RunFutureTask(FutureImpl *impl) {
+  bool run = false;
+  {
+    WriteLockGuard guard(&impl->lock);
+    if (impl->state == FUTURE_PENDING && !impl->token->cancelled) {
+      impl->state = FUTURE_RUNNING;
+      run = true;
+    }
+  }
+
+  ThreadPoolImpl *pool = impl->pool;
+  if (run) {
+    void *result;
+    if (impl->continuation) {
+      result = impl->continuation(impl->result, impl->arg);
+    } else {
+      CancelToken token(impl->token);
+      result = impl->func(impl->arg, token);
+    }
+    CompleteFuture(impl, FUTURE_DONE, result);
+  } else {
+    CompleteFuture(impl, FUTURE_CANCELLED, nullptr);
+  }
+  FinishPoolTask(pool);
+  ReleaseFutureImpl(impl);
+}
+
+CancelToken::CancelToken() { impl = AllocCancelTokenImpl(); }
+
+CancelToken::CancelToken(CancelTokenImpl *shared) {
+  impl = shared;
+  if (impl)
+    InterlockedIncrement(&impl->refCount);
+}
+
+CancelToken::CancelToken(const CancelToken &other) {
+  impl = other.impl;
+  if (impl)
+    InterlockedIncrement(&impl->refCount);
+}
+
+CancelToken::~CancelToken() { ReleaseCancelTokenImpl(impl); }
+
+CancelToken &CancelToken::operator=(const CancelToken &other) {
+  if (this != &other) {
+    if (other.impl)
+      InterlockedIncrement(&other.impl->refCount);
+    ReleaseCancelTokenImpl(impl);
+    impl = other.impl;
+  }
+  return *this;
+}
+
+void CancelToken::cancel() {
+  if (impl)
+    InterlockedExchange(&impl->cancelled, 1);
+}
+
+bool CancelToken::isCancelled() const { return impl && impl->cancelled; }
+
+Future::Future(FutureImpl *adopted) : impl(adopted) {}
+
+Future::Future(const Future &other) {
+  impl = other.impl;
+  if (impl)
+    InterlockedIncrement(&impl->refCount);
+}
+
+Future::~Future() {
+  if (impl)
+    ReleaseFutureImpl(impl);
+}
+
+Future &Future::operator=(const Future &other) {
+  if (this != &other) {
+    if (other.impl)
+      InterlockedIncrement(&other.impl->refCount);
+    if (impl)
+      ReleaseFutureImpl(impl);
+    impl = other.impl;
+  }
+  return *this;
+}
+
+bool Future::isReady() const {
+  if (!impl)
+    return true;
+  ReadLockGuard guard(&impl->lock);
+  return IsFutureFinished(impl);
+}
+
+void *Future::await() {
+  if (!impl)
+    return nullptr;
+
+  HelpPoolUntilDone(impl);
+  WriteLockGuard guard(&impl->lock);
+  while (!IsFutureFinished(impl))
+    SleepConditionVariableSRW(&impl->finished, &impl->lock, INFINITE, 0);
+  return impl->result;
+}
+
+bool Future::wait(int timeoutMs) {
+  if (!impl)
+    return true;
+  if (timeoutMs < 0) {
+    await();
+    return true;
+  }
+
+  ULONGLONG deadline = GetTickCount64() + timeoutMs;
+  WriteLockGuard guard(&impl->lock);
+  while (!IsFutureFinished(impl)) {
+    ULONGLONG now = GetTickCount64();
+    if (now >= deadline)
+      return false;
+    SleepConditionVariableSRW(&impl->finished, &impl->lock,
+                              (DWORD)(deadline - now), 0);
+  }
+  return true;
+}
+
+void Future::cancel() {
+  if (!impl)
+    return;
+  InterlockedExchange(&impl->token->cancelled, 1);
+
+  // A task that has not started finishes now; the worker that dequeues it
+  // later only drops it.
+  bool pending;
+  {
+    ReadLockGuard guard(&impl->lock);
+    pending = impl->state == FUTURE_PENDING;
+  }
+  if (pending)
+    CompleteFuture(impl, FUTURE_CANCELLED, nullptr);
+}
+
+bool Future::isCancelled() const {
+  if (!impl)
+    return true;
+  ReadLockGuard guard(&impl->lock);
+  return impl->state == FUTURE_CANCELLED;
+}
+
+Future Future::then(ContinuationFunction func, void *arg) {
+  if (!impl || !func)
+    return Future(nullptr);
+  FutureImpl *continuation = AllocFutureImpl(nullptr, impl->token);
+  if (!continuation)
+    return Future(nullptr);
+  continuation->continuation = func;
+  continuation->arg = arg;
+
+  {
+    WriteLockGuard guard(&impl->lock);
+    if (!IsFutureFinished(impl)) {
+      continuation->pool = impl->pool;
+      InterlockedIncrement(&impl->pool->outstanding);
+      InterlockedIncrement(&continuation->refCount);
+      continuation->next = impl->continuations;
+      impl->continuations = continuation;
+      return Future(continuation);
+    }
+  }
+
+  // Already finished: the state no longer changes, so run it here.
+  if (impl->state == FUTURE_DONE && !impl->token->cancelled) {
+    continuation->result = func(impl->result, arg);
+    continuation->state = FUTURE_DONE;
+  } else {
+    continuation->state = FUTURE_CANCELLED;
+  }
+  return Future(continuation);
+}
+
+} // namespace attoboy
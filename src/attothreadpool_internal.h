@@ -0,0 +1,114 @@
+#pragma once
+#include "attoboy/attoboy.h"
+#include "atto_internal_common.h"
+#include <windows.h>
+
+namespace attoboy {
+
+// Initial slots in each worker's deque; it doubles when full.
+static const int POOL_DEQUE_INITIAL_CAPACITY = 256;
+// Rounds a worker checks for new tasks (pausing between them) before it
+// sleeps.
+static const int POOL_SPIN_ROUNDS = 64;
+// A worker waiting in await() with nothing to run rechecks this often.
+static const int POOL_HELP_WAIT_MS = 1;
+
+enum FutureState {
+  FUTURE_PENDING = 0,
+  FUTURE_RUNNING,
+  FUTURE_DONE,
+  FUTURE_CANCELLED
+};
+
+struct CancelTokenImpl {
+  volatile LONG cancelled;
+  volatile LONG refCount;
+};
+
+struct ThreadPoolImpl;
+
+// One task, or a continuation (with continuation set, which receives its
+// antecedent's result in result). The queue holds one reference, every
+// Future handle another. Continuations wait in the continuations list
+// (linked through next, which holds a reference) until the task finishes;
+// each is already counted in the pool's outstanding. pool is only used
+// while the task is unfinished, which keeps it alive.
+struct FutureImpl {
+  TaskFunction func;
+  ContinuationFunction continuation;
+  void *arg;
+  void *result;
+  CancelTokenImpl *token;
+  ThreadPoolImpl *pool;
+  FutureState state;
+  FutureImpl *continuations;
+  FutureImpl *next;
+  CONDITION_VARIABLE finished;
+  SRWLOCK lock;
+  volatile LONG refCount;
+};
+
+// Tasks between head and tail in a ring of capacity (a power of two). The
+// owning worker pushes and pops at the tail; other workers steal from the
+// head.
+struct PoolDeque {
+  FutureImpl **items;
+  unsigned int capacity;
+  volatile unsigned int head;
+  volatile unsigned int tail;
+  SRWLOCK lock;
+};
+
+struct PoolWorker {
+  ThreadPoolImpl *pool;
+  HANDLE thread;
+  PoolDeque deque;
+  unsigned int seed;
+};
+
+// queued counts tasks sitting in deques; outstanding counts tasks submitted
+// but not yet finished (including registered continuations). Workers sleep
+// on wake when nothing is queued; waitIdle() sleeps on idle. handles counts
+// ThreadPool copies. refCount holds one reference per handle and one for
+// the running workers together, so the last worker can free the pool when
+// the last ThreadPool goes away inside a task.
+struct ThreadPoolImpl {
+  PoolWorker *workers;
+  int workerCount;
+  volatile LONG liveWorkers;
+  volatile LONG nextWorker;
+  volatile LONG queued;
+  volatile LONG outstanding;
+  volatile LONG sleepers;
+  volatile LONG closing;
+  volatile long long steals;
+  SRWLOCK sleepLock;
+  CONDITION_VARIABLE wake;
+  CONDITION_VARIABLE idle;
+  volatile LONG handles;
+  volatile LONG refCount;
+};
+
+/// Allocates a pending task with one reference for the caller's Future.
+/// token may be nullptr for a fresh one. Returns nullptr on failure.
+FutureImpl *AllocFutureImpl(ThreadPoolImpl *pool, CancelTokenImpl *token);
+/// Drops one reference, freeing the task with the last one.
+void ReleaseFutureImpl(FutureImpl *impl);
+/// Queues a task that is already counted in outstanding, taking a reference
+/// for the queue. Returns false if it could not be queued.
+bool QueuePoolTask(ThreadPoolImpl *pool, FutureImpl *impl);
+/// Runs queued tasks on the calling worker until impl finishes. Returns
+/// false at once if the caller is not one of impl->pool's workers.
+bool HelpPoolUntilDone(FutureImpl *impl);
+/// Finishes an unfinished task with state (FUTURE_DONE or FUTURE_CANCELLED),
+/// waking waiters and queuing (or skipping) its continuations. Does nothing
+/// if the task has already finished.
+void CompleteFuture(FutureImpl *impl, FutureState state, void *result);
+/// Runs a dequeued task (or skips it if cancelled), completes it and drops
+/// the queue's reference.
+void RunFutureTask(FutureImpl *impl);
+/// Records that one outstanding task finished, waking idle waiters and
+/// closing workers when none are left.
+void FinishPoolTask(ThreadPoolImpl *pool);
+
+} // namespace attoboy
@@ -0,0 +1,186 @@
+#include "attowebrequest_internal.h"
+
+namespace attoboy {
+
+static const int WEB_BATCH_MAX_BACKOFF_MS = 30000;
+
+// Shared state for one DoAll() call. Workers claim items through next and
+// park finished responses in results; the calling thread hands them to the
+// callback. done lists finished indexes in completion order.
+struct WebBatch {
+  const List *requests;
+  int count;
+  int timeout;
+  int retries;
+  int backoffMs;
+  volatile LONG next;
+  WebResponse **results;
+  int *done;
+  int doneCount;
+  SRWLOCK lock;
+  CONDITION_VARIABLE finished;
+};
+
+static bool ShouldRetryWebResponse(const WebResponse &response) {
+  int status = response.getStatusCode();
+  return status == 0 || status == 429 || status >= 500;
+}
+
+// Doubles the base delay per attempt with jitter in its upper half, or
+// honours a Retry-After given in seconds if that is longer.
+static int WebBatchBackoff(const WebBatch *batch, int attempt,
+                           const WebResponse &response) {
+  int delay = batch->backoffMs;
+  for (int i = 0; i < attempt && delay < WEB_BATCH_MAX_BACKOFF_MS; i++)
+    delay *= 2;
+  if (delay > WEB_BATCH_MAX_BACKOFF_MS)
+    delay = WEB_BATCH_MAX_BACKOFF_MS;
+  delay = delay / 2 + Math::RandomRange(0, delay / 2 + 1);
+
+  String retryAfter =
+      response.getResponseHeaders().get<String, String>(String("Retry-After"));
+  if (retryAfter.isNumber()) {
+    int seconds = retryAfter.toInteger();
+    int wanted = seconds < WEB_BATCH_MAX_BACKOFF_MS / 1000
+                     ? seconds * 1000
+                     : WEB_BATCH_MAX_BACKOFF_MS;
+    if (wanted > delay)
+      delay = wanted;
+  }
+  return delay;
+}
+
+// Sends one batch item: a URL String for a GET, or a Map with "url" and
+// optional "method", "body" (String, or Map/List sent as JSON), "params",
+// "headers" and "timeout".
+static WebResponse SendWebBatchItem(const WebBatch *batch, int index) {
+  if (batch->requests->typeAt(index) != TYPE_MAP) {
+    WebRequest request(batch->requests->at<String>(index));
+    return request.doGet(batch->timeout);
+  }
+
+  Map item = batch->requests->at<Map>(index);
+  String method = item.get<String, String>(String("method"), String("GET"));
+  Map headers = item.get<String, Map>(String("headers"));
+  int timeout = item.get<String, int>(String("timeout"), batch->timeout);
+
+  Buffer body;
+  ValueType bodyType = item.typeAt(String("body"));
+  if (bodyType == TYPE_STRING) {
+    body = Buffer(item.get<String, String>(String("body")));
+  } else if (bodyType == TYPE_MAP || bodyType == TYPE_LIST) {
+    body = Buffer(bodyType == TYPE_MAP
+                      ? String(item.get<String, Map>(String("body")))
+                      : String(item.get<String, List>(String("body"))));
+    if (!headers.hasKey<String>(String("Content-Type")))
+      headers.put(String("Content-Type"), String("application/json"));
+  }
+
+  WebRequest request(item.get<String, String>(String("url")),
+                     item.get<String, Map>(String("params")), headers);
+  return request.doRequest(method.upper(), body, timeout);
+}
+
+static DWORD WINAPI WebBatchWorkerProc(LPVOID param) {
+  WebBatch *batch = (WebBatch *)param;
+  for (;;) {
+    int index = (int)InterlockedIncrement(&batch->next) - 1;
+    if (index >= batch->count)
+      return 0;
+
+    WebResponse response = SendWebBatchItem(batch, index);
+    for (int attempt = 0;
+         attempt < batch->retries && ShouldRetryWebResponse(response);
+         attempt++) {
+      Sleep(WebBatchBackoff(batch, attempt, response));
+      response = SendWebBatchItem(batch, index);
+    }
+
+    WebResponse *result = new WebResponse(response);
+    WriteLockGuard guard(&batch->lock);
+    batch->results[index] = result;
+    batch->done[batch->doneCount++] = index;
+    WakeAllConditionVariable(&batch->finished);
+  }
+}
+
+int WebRequest::DoAll(const List &requests, WebResponseCallback callback,
+                      void *arg, int concurrency, int timeout, int retries,
+                      int backoffMs, bool ordered) {
+  int count = requests.length();
+  if (count == 0)
+    return 0;
+
+  WebBatch batch;
+  ZeroMemory(&batch, sizeof(batch));
+  batch.requests = &requests;
+  batch.count = count;
+  batch.timeout = timeout;
+  batch.retries = retries > 0 ? retries : 0;
+  batch.backoffMs = backoffMs > 0 ? backoffMs : 0;
+  InitializeSRWLock(&batch.lock);
+  InitializeConditionVariable(&batch.finished);
+  batch.results = (WebResponse **)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, count * sizeof(WebResponse *));
+  batch.done = (int *)HeapAlloc(GetProcessHeap(), 0, count * sizeof(int));
+  if (!batch.results || !batch.done) {
+    if (batch.results)
+      HeapFree(GetProcessHeap(), 0, batch.results);
+    if (batch.done)
+      HeapFree(GetProcessHeap(), 0, batch.done);
+    return 0;
+  }
+
+  if (concurrency <= 0)
+    concurrency = 1;
+  int workerCount = concurrency < count ? concurrency : count;
+  HANDLE *workers =
+      (HANDLE *)HeapAlloc(GetProcessHeap(), 0, workerCount * sizeof(HANDLE));
+  int started = 0;
+  for (int i = 0; workers && i < workerCount; i++) {
+    workers[started] =
+        CreateThread(nullptr, 0, WebBatchWorkerProc, &batch, 0, nullptr);
+    if (workers[started])
+      started++;
+  }
+  // Without any worker the batch still completes, one request at a time.
+  if (started == 0)
+    WebBatchWorkerProc(&batch);
+
+  int succeeded = 0;
+  for (int delivered = 0; delivered < count; delivered++) {
+    int index;
+    WebResponse *result;
+    {
+      WriteLockGuard guard(&batch.lock);
+      for (;;) {
+        if (ordered)
+          index = delivered;
+        else
+          index = delivered < batch.doneCount ? batch.done[delivered] : -1;
+        if (index >= 0 && batch.results[index])
+          break;
+        SleepConditionVariableSRW(&batch.finished, &batch.lock, INFINITE, 0);
+      }
+      result = batch.results[index];
+      batch.results[index] = nullptr;
+    }
+    if (result->succeeded())
+      succeeded++;
+    if (callback)
+      callback(index, *result, arg);
+    delete result;
+  }
+
+  for (int i = 0; i < started; i++) {
+    WaitForSingleObject(workers[i], INFINITE);
+    CloseHandle(workers[i]);
+  }
+  if (workers)
+    HeapFree(GetProcessHeap(), 0, workers);
+  HeapFree(GetProcessHeap(), 0, batch.results);
+  HeapFree(GetProcessHeap(), 0, batch.done);
+  return succeeded;
+}
+
+} // namespace attoboy
@@ -0,0 +1,596 @@
+#include "attowebrequest_internal.h"
+#include "atto_internal_hash.h"
+
+namespace attoboy {
+
+static const unsigned char WEB_CACHE_MAGIC[4] = {'A', 'W', 'C', '1'};
+static const unsigned int WEB_CACHE_TICKS_PER_SECOND = 10000000;
+
+// One cached response on disk, named by the hash of its key. lastUsed is a
+// FILETIME and is also kept as the file's write time, so recency survives
+// between runs.
+struct WebCacheEntry {
+  unsigned long long id;
+  long long size;
+  ULONGLONG lastUsed;
+  WebCacheEntry *next;
+};
+
+static SRWLOCK g_webCacheLock = SRWLOCK_INIT;
+static String *g_webCacheDir = nullptr;
+static List *g_webCacheVary = nullptr;
+static long long g_webCacheMaxBytes = 0;
+static long long g_webCacheBytes = 0;
+static WebCacheEntry *g_webCacheEntries = nullptr;
+static long long g_webCacheHits = 0;
+static long long g_webCacheMisses = 0;
+static long long g_webCacheRevalidations = 0;
+static ULONGLONG g_webCacheLastUse = 0;
+
+static ULONGLONG GetWebCacheTime() {
+  FILETIME now;
+  GetSystemTimeAsFileTime(&now);
+  return ((ULONGLONG)now.dwHighDateTime << 32) | now.dwLowDateTime;
+}
+
+// The system clock can repeat within a tick, so uses are made strictly
+// increasing to keep the LRU order exact. Caller holds the exclusive lock.
+static ULONGLONG NextWebCacheUse() {
+  ULONGLONG now = GetWebCacheTime();
+  g_webCacheLastUse = now > g_webCacheLastUse ? now : g_webCacheLastUse + 1;
+  return g_webCacheLastUse;
+}
+
+static String GetWebCacheDirectory() {
+  String local = Path::GetLocalAppDirectory().toString();
+  if (local.isEmpty())
+    return String();
+  return local + "\\attoboy\\WebCache";
+}
+
+static String GetWebCacheFileName(unsigned long long id) {
+  static const char hex[] = "0123456789abcdef";
+  char name[21];
+  // Works on 32-bit halves; variable 64-bit shifts need CRT helpers.
+  for (int i = 0; i < 16; i++) {
+    unsigned int half = (unsigned int)(i < 8 ? id >> 32 : id);
+    name[i] = hex[(half >> ((7 - (i & 7)) * 4)) & 0xF];
+  }
+  name[16] = '.';
+  name[17] = 'a';
+  name[18] = 'w';
+  name[19] = 'c';
+  name[20] = 0;
+  return String(name);
+}
+
+// Parses the id back out of a cache file name. Returns false for anything
+// that is not one.
+static bool ParseWebCacheFileName(const WCHAR *name, unsigned long long *id) {
+  unsigned long long value = 0;
+  for (int i = 0; i < 16; i++) {
+    WCHAR c = name[i];
+    int digit;
+    if (c >= L'0' && c <= L'9')
+      digit = c - L'0';
+    else if (c >= L'a' && c <= L'f')
+      digit = c - L'a' + 10;
+    else
+      return false;
+    value = (value << 4) | (unsigned long long)digit;
+  }
+  if (lstrcmpiW(name + 16, L".awc") != 0)
+    return false;
+  *id = value;
+  return true;
+}
+
+static void FreeWebCacheEntries(WebCacheEntry *entry) {
+  while (entry) {
+    WebCacheEntry *next = entry->next;
+    HeapFree(GetProcessHeap(), 0, entry);
+    entry = next;
+  }
+}
+
+// Lists the cache files in dir, with their sizes and write times.
+static WebCacheEntry *ScanWebCache(const String &dir, long long *total) {
+  *total = 0;
+  WCHAR *pattern = Utf8ToWide((dir + "\\*.awc").c_str());
+  if (!pattern)
+    return nullptr;
+  WIN32_FIND_DATAW data;
+  HANDLE find = FindFirstFileW(pattern, &data);
+  FreeConvertedString(pattern);
+  if (find == INVALID_HANDLE_VALUE)
+    return nullptr;
+
+  WebCacheEntry *entries = nullptr;
+  do {
+    unsigned long long id;
+    if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ||
+        !ParseWebCacheFileName(data.cFileName, &id))
+      continue;
+    WebCacheEntry *entry = (WebCacheEntry *)HeapAlloc(
+        GetProcessHeap(), 0, sizeof(WebCacheEntry));
+    if (!entry)
+      break;
+    entry->id = id;
+    entry->size = ((long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    entry->lastUsed = ((ULONGLONG)data.ftLastWriteTime.dwHighDateTime << 32) |
+                      data.ftLastWriteTime.dwLowDateTime;
+    entry->next = entries;
+    entries = entry;
+    *total += entry->size;
+  } while (FindNextFileW(find, &data));
+  FindClose(find);
+  return entries;
+}
+
+static void DeleteWebCacheFile(const String &dir, unsigned long long id) {
+  Path(dir + "\\" + GetWebCacheFileName(id)).deleteFile();
+}
+
+// Deletes least recently used entries until the cache fits its cap,
+// sparing keep. Caller holds the exclusive cache lock.
+static void TrimWebCache(unsigned long long keep) {
+  while (g_webCacheBytes > g_webCacheMaxBytes) {
+    WebCacheEntry **oldest = nullptr;
+    for (WebCacheEntry **link = &g_webCacheEntries; *link;
+         link = &(*link)->next) {
+      if ((*link)->id != keep &&
+          (!oldest || (*link)->lastUsed < (*oldest)->lastUsed))
+        oldest = link;
+    }
+    if (!oldest)
+      return;
+    WebCacheEntry *entry = *oldest;
+    *oldest = entry->next;
+    g_webCacheBytes -= entry->size;
+    DeleteWebCacheFile(*g_webCacheDir, entry->id);
+    HeapFree(GetProcessHeap(), 0, entry);
+  }
+}
+
+static WebCacheEntry *FindWebCacheEntry(unsigned long long id) {
+  for (WebCacheEntry *entry = g_webCacheEntries; entry; entry = entry->next)
+    if (entry->id == id)
+      return entry;
+  return nullptr;
+}
+
+// Marks an entry as just used, in the index and on disk.
+static void TouchWebCacheEntry(const String &dir, unsigned long long id) {
+  ULONGLONG now;
+  {
+    WriteLockGuard guard(&g_webCacheLock);
+    now = NextWebCacheUse();
+    WebCacheEntry *entry = FindWebCacheEntry(id);
+    if (entry)
+      entry->lastUsed = now;
+  }
+
+  WCHAR *path = Utf8ToWide((dir + "\\" + GetWebCacheFileName(id)).c_str());
+  if (!path)
+    return;
+  HANDLE file = CreateFileW(path, FILE_WRITE_ATTRIBUTES,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                FILE_SHARE_DELETE,
+                            nullptr, OPEN_EXISTING, 0, nullptr);
+  FreeConvertedString(path);
+  if (file == INVALID_HANDLE_VALUE)
+    return;
+  FILETIME time;
+  time.dwLowDateTime = (DWORD)now;
+  time.dwHighDateTime = (DWORD)(now >> 32);
+  SetFileTime(file, nullptr, nullptr, &time);
+  CloseHandle(file);
+}
+
+// Adds or resizes an entry in the index and evicts others to make room.
+static void RecordWebCacheEntry(unsigned long long id, long long size) {
+  WriteLockGuard guard(&g_webCacheLock);
+  if (!g_webCacheDir)
+    return;
+  WebCacheEntry *entry = FindWebCacheEntry(id);
+  if (!entry) {
+    entry = (WebCacheEntry *)HeapAlloc(GetProcessHeap(), 0,
+                                       sizeof(WebCacheEntry));
+    if (!entry)
+      return;
+    entry->id = id;
+    entry->size = 0;
+    entry->next = g_webCacheEntries;
+    g_webCacheEntries = entry;
+  }
+  g_webCacheBytes += size - entry->size;
+  entry->size = size;
+  entry->lastUsed = NextWebCacheUse();
+  TrimWebCache(id);
+}
+
+static void ForgetWebCacheEntry(const String &dir, unsigned long long id) {
+  WriteLockGuard guard(&g_webCacheLock);
+  WebCacheEntry **link = &g_webCacheEntries;
+  while (*link && (*link)->id != id)
+    link = &(*link)->next;
+  if (*link) {
+    WebCacheEntry *entry = *link;
+    *link = entry->next;
+    g_webCacheBytes -= entry->size;
+    HeapFree(GetProcessHeap(), 0, entry);
+  }
+  DeleteWebCacheFile(dir, id);
+}
+
+static String GetWebHeader(const Map *headers, const char *name) {
+  String key;
+  if (!FindWebHeader(headers, name, &key))
+    return String();
+  return headers->get<String, String>(key);
+}
+
+// Reads the number after "max-age=" in a Cache-Control value, or -1.
+static int ParseWebMaxAge(const String &cacheControl) {
+  int at = cacheControl.getPositionOf(String("max-age="));
+  if (at < 0 || (at > 0 && cacheControl.c_str()[at - 1] == '-'))
+    return -1;
+  const char *digits = cacheControl.c_str() + at + 8;
+  if (*digits < '0' || *digits > '9')
+    return -1;
+  int number = 0;
+  for (; *digits >= '0' && *digits <= '9'; digits++) {
+    if (number > (0x7FFFFFFF - 9) / 10)
+      return 0x7FFFFFFF;
+    number = number * 10 + (*digits - '0');
+  }
+  return number;
+}
+
+static ULONGLONG WebCacheSecondsToTicks(int seconds) {
+  return MulU64By32((unsigned int)seconds, WEB_CACHE_TICKS_PER_SECOND);
+}
+
+// Works out until when a response may be served without revalidation,
+// from max-age less Age. Returns false if it must not be stored at all.
+static bool GetWebFreshness(const Map *headers, ULONGLONG now,
+                            ULONGLONG *expires) {
+  String cacheControl = GetWebHeader(headers, "cache-control").lower();
+  if (cacheControl.contains(String("no-store")) ||
+      GetWebHeader(headers, "vary").trim() == "*")
+    return false;
+
+  *expires = now;
+  int maxAge = ParseWebMaxAge(cacheControl);
+  if (maxAge > 0 && !cacheControl.contains(String("no-cache"))) {
+    String age = GetWebHeader(headers, "age").trim();
+    if (age.isNumber() && age.toInteger() > 0)
+      maxAge -= age.toInteger();
+    if (maxAge > 0)
+      *expires = now + WebCacheSecondsToTicks(maxAge);
+  }
+  return true;
+}
+
+// The key is the URL plus the selected request headers, so requests that
+// differ only in those get separate entries.
+static String GetWebCacheKey(const WebRequestImpl *reqImpl,
+                             const List &vary) {
+  char *url = WideToUtf8(reqImpl->url);
+  String key = String("GET ") + (url ? url : "");
+  FreeConvertedString(url);
+  for (int i = 0; i < vary.length(); i++) {
+    String name = vary.at<String>(i).lower();
+    key = key + "\n" + name + ": " +
+          GetWebHeader(reqImpl->headers, name.c_str());
+  }
+  return key;
+}
+
+static void AppendWebCacheNumber(Buffer &buf, unsigned long long value,
+                                 int bytes) {
+  unsigned char encoded[8];
+  for (int i = 0; i < bytes; i++) {
+    unsigned int half = (unsigned int)(i < 4 ? value : value >> 32);
+    encoded[i] = (unsigned char)(half >> ((i & 3) * 8));
+  }
+  buf.append(encoded, bytes);
+}
+
+// A cache file holds the magic, the expiry time, the length of a JSON block
+// with the key, status, URL and headers, then the LZ4-compressed body.
+static long long WriteWebCacheFile(const String &dir, unsigned long long id,
+                                   ULONGLONG expires, const Map &meta,
+                                   const Buffer &body) {
+  String json = meta.toJSONString();
+  Buffer file(WEB_CACHE_MAGIC, sizeof(WEB_CACHE_MAGIC));
+  AppendWebCacheNumber(file, expires, 8);
+  AppendWebCacheNumber(file, (unsigned long long)json.byteLength(), 4);
+  file.append(json);
+  file.append(body.compress());
+
+  // Written under a temporary name and renamed over the old entry, so a
+  // concurrent reader never sees half a file.
+  String name = GetWebCacheFileName(id);
+  String temp = dir + "\\" + name + "." + String((int)GetCurrentThreadId()) +
+                ".tmp";
+  if (!Path(temp).writeFromBuffer(file))
+    return 0;
+  WCHAR *from = Utf8ToWide(temp.c_str());
+  WCHAR *to = Utf8ToWide((dir + "\\" + name).c_str());
+  bool moved = from && to && MoveFileExW(from, to, MOVEFILE_REPLACE_EXISTING);
+  FreeConvertedString(from);
+  FreeConvertedString(to);
+  if (!moved) {
+    Path(temp).deleteFile();
+    return 0;
+  }
+  return file.length();
+}
+
+static bool ReadWebCacheFile(const String &dir, unsigned long long id,
+                             const String &key, ULONGLONG *expires,
+                             Map *meta, Buffer *body) {
+  Buffer file = Path(dir + "\\" + GetWebCacheFileName(id)).readToBuffer();
+  BufferView view(file);
+  Buffer magic = view.readBytes(sizeof(WEB_CACHE_MAGIC));
+  *expires = (ULONGLONG)view.readU64LE();
+  int jsonLength = (int)view.readU32LE();
+  if (view.failed() || jsonLength < 0 || jsonLength > view.remaining() ||
+      !magic.compare(Buffer(WEB_CACHE_MAGIC, sizeof(WEB_CACHE_MAGIC))))
+    return false;
+
+  *meta = Map::FromJSONString(view.readString(jsonLength));
+  if (meta->get<String, String>(String("key")) != key)
+    return false;
+  int length = meta->get<String, int>(String("length"), -1);
+  *body = file.slice(view.getPosition()).decompress();
+  return length >= 0 && body->length() == length;
+}
+
+// Builds a response from a cache entry, as if it had just been received.
+static WebResponseImpl *NewCachedWebResponse(const Map &meta,
+                                             const Buffer &body) {
+  WebResponseImpl *respImpl =
+      (WebResponseImpl *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                   sizeof(WebResponseImpl));
+  if (!respImpl)
+    return nullptr;
+  InitializeSRWLock(&respImpl->lock);
+  respImpl->refCount = 1;
+  respImpl->statusCode = meta.get<String, int>(String("status"));
+  respImpl->statusReason =
+      Utf8ToWide(meta.get<String, String>(String("reason")).c_str());
+  respImpl->finalUrl =
+      Utf8ToWide(meta.get<String, String>(String("url")).c_str());
+  respImpl->headers = new Map(meta.get<String, Map>(String("headers")));
+  respImpl->bodyComplete = true;
+
+  int length = 0;
+  const unsigned char *data = body.c_ptr(&length);
+  if (length > 0) {
+    respImpl->body =
+        (unsigned char *)HeapAlloc(GetProcessHeap(), 0, (SIZE_T)length);
+    if (respImpl->body) {
+      CopyMemory(respImpl->body, data, length);
+      respImpl->bodySize = length;
+    } else {
+      respImpl->bodyComplete = false;
+    }
+  }
+  return respImpl;
+}
+
+static void FreeWebResponseImpl(WebResponseImpl *respImpl) {
+  if (InterlockedDecrement(&respImpl->refCount) != 0)
+    return;
+  FreeWebString(respImpl->statusReason);
+  FreeWebString(respImpl->finalUrl);
+  if (respImpl->body)
+    HeapFree(GetProcessHeap(), 0, respImpl->body);
+  if (respImpl->headers)
+    delete respImpl->headers;
+  HeapFree(GetProcessHeap(), 0, respImpl);
+}
+
+static Map GetWebCacheMeta(const String &key, const WebResponseImpl *resp) {
+  Map meta;
+  char *reason = WideToUtf8(resp->statusReason);
+  char *url = WideToUtf8(resp->finalUrl);
+  meta.put(String("key"), key);
+  meta.put(String("status"), resp->statusCode);
+  meta.put(String("reason"), String(reason ? reason : ""));
+  meta.put(String("url"), String(url ? url : ""));
+  meta.put(String("headers"), *resp->headers);
+  meta.put(String("length"), resp->bodySize);
+  FreeConvertedString(reason);
+  FreeConvertedString(url);
+  return meta;
+}
+
+static void CountWebCache(long long *counter) {
+  WriteLockGuard guard(&g_webCacheLock);
+  (*counter)++;
+}
+
+// Requests that carry their own conditions or ranges, or forbid storing,
+// go straight to the network.
+static bool BypassWebCache(const Map *headers) {
+  return FindWebHeader(headers, "range", nullptr) ||
+         FindWebHeader(headers, "if-none-match", nullptr) ||
+         FindWebHeader(headers, "if-modified-since", nullptr) ||
+         GetWebHeader(headers, "cache-control").lower().contains(
+             String("no-store"));
+}
+
+static void SetWebValidator(Map *headers, const Map &cached,
+                            const char *from, const char *to) {
+  String value = GetWebHeader(&cached, from);
+  if (!value.isEmpty())
+    headers->put(String(to), value);
+}
+
+WebResponseImpl *PerformCachedGet(WebRequestImpl *reqImpl, int timeout) {
+  String dir;
+  List vary;
+  {
+    ReadLockGuard guard(&g_webCacheLock);
+    if (g_webCacheDir) {
+      dir = *g_webCacheDir;
+      vary = *g_webCacheVary;
+    }
+  }
+  if (dir.isEmpty() || BypassWebCache(reqImpl->headers))
+    return PerformRequest(reqImpl, L"GET", nullptr, 0, timeout);
+
+  String key = GetWebCacheKey(reqImpl, vary);
+  unsigned long long id =
+      XXH64((const unsigned char *)key.c_str(), key.byteLength(), 0);
+  ULONGLONG expires = 0;
+  Map meta;
+  Buffer body;
+  bool cached = ReadWebCacheFile(dir, id, key, &expires, &meta, &body);
+
+  String requestControl = GetWebHeader(reqImpl->headers, "cache-control");
+  bool revalidate = requestControl.lower().contains(String("no-cache")) ||
+                    ParseWebMaxAge(requestControl.lower()) == 0;
+  if (cached && !revalidate && GetWebCacheTime() < expires) {
+    CountWebCache(&g_webCacheHits);
+    TouchWebCacheEntry(dir, id);
+    return NewCachedWebResponse(meta, body);
+  }
+
+  // A stale entry is revalidated, so an unchanged resource costs a 304
+  // with no body. The conditions are removed again once sent.
+  Map cachedHeaders = meta.get<String, Map>(String("headers"));
+  if (cached) {
+    SetWebValidator(reqImpl->headers, cachedHeaders, "etag",
+                    "If-None-Match");
+    SetWebValidator(reqImpl->headers, cachedHeaders, "last-modified",
+                    "If-Modified-Since");
+  }
+  WebResponseImpl *response =
+      PerformRequest(reqImpl, L"GET", nullptr, 0, timeout);
+  reqImpl->headers->remove(String("If-None-Match"));
+  reqImpl->headers->remove(String("If-Modified-Since"));
+
+  ULONGLONG now = GetWebCacheTime();
+  if (response && cached && response->statusCode == 304) {
+    // The 304's headers update the stored ones, except for the length,
+    // which describes the empty 304 body.
+    List keys = response->headers->keys();
+    for (int i = 0; i < keys.length(); i++) {
+      String name = keys.at<String>(i);
+      if (name.lower() != "content-length")
+        cachedHeaders.put(name, response->headers->get<String, String>(name));
+    }
+    FreeWebResponseImpl(response);
+    meta.put(String("headers"), cachedHeaders);
+    if (GetWebFreshness(&cachedHeaders, now, &expires)) {
+      long long size = WriteWebCacheFile(dir, id, expires, meta, body);
+      if (size > 0)
+        RecordWebCacheEntry(id, size);
+    } else {
+      ForgetWebCacheEntry(dir, id);
+    }
+    {
+      WriteLockGuard guard(&g_webCacheLock);
+      g_webCacheHits++;
+      g_webCacheRevalidations++;
+    }
+    return NewCachedWebResponse(meta, body);
+  }
+
+  CountWebCache(&g_webCacheMisses);
+  if (!response || !response->bodyComplete || response->statusCode != 200)
+    return response;
+
+  // Only worth keeping if it can be served fresh or revalidated later.
+  bool storable = GetWebFreshness(response->headers, now, &expires) &&
+                  (expires > now ||
+                   FindWebHeader(response->headers, "etag", nullptr) ||
+                   FindWebHeader(response->headers, "last-modified", nullptr));
+  long long size = 0;
+  if (storable)
+    size = WriteWebCacheFile(
+        dir, id, expires, GetWebCacheMeta(key, response),
+        Buffer(response->body, response->bodySize));
+  if (size > 0)
+    RecordWebCacheEntry(id, size);
+  else if (cached)
+    ForgetWebCacheEntry(dir, id);
+  return response;
+}
+
+bool WebRequest::EnableCache(long long maxBytes, const List &varyHeaders) {
+  if (maxBytes <= 0)
+    return false;
+  String dir = GetWebCacheDirectory();
+  if (dir.isEmpty())
+    return false;
+  Path(dir).makeDirectory(true);
+  if (!Path(dir).isDirectory())
+    return false;
+
+  long long total = 0;
+  WebCacheEntry *entries = ScanWebCache(dir, &total);
+
+  WriteLockGuard guard(&g_webCacheLock);
+  FreeWebCacheEntries(g_webCacheEntries);
+  if (!g_webCacheDir) {
+    g_webCacheDir = new String(dir);
+    g_webCacheVary = new List(varyHeaders);
+  } else {
+    *g_webCacheDir = dir;
+    *g_webCacheVary = varyHeaders;
+  }
+  g_webCacheEntries = entries;
+  g_webCacheBytes = total;
+  g_webCacheMaxBytes = maxBytes;
+  TrimWebCache(0);
+  return true;
+}
+
+void WebRequest::DisableCache() {
+  WriteLockGuard guard(&g_webCacheLock);
+  FreeWebCacheEntries(g_webCacheEntries);
+  g_webCacheEntries = nullptr;
+  g_webCacheBytes = 0;
+  delete g_webCacheDir;
+  delete g_webCacheVary;
+  g_webCacheDir = nullptr;
+  g_webCacheVary = nullptr;
+}
+
+void WebRequest::ClearCache() {
+  String dir = GetWebCacheDirectory();
+  if (dir.isEmpty())
+    return;
+  long long total = 0;
+  WebCacheEntry *entries = ScanWebCache(dir, &total);
+
+  WriteLockGuard guard(&g_webCacheLock);
+  for (WebCacheEntry *entry = entries; entry; entry = entry->next)
+    DeleteWebCacheFile(dir, entry->id);
+  FreeWebCacheEntries(entries);
+  FreeWebCacheEntries(g_webCacheEntries);
+  g_webCacheEntries = nullptr;
+  g_webCacheBytes = 0;
+}
+
+long long WebRequest::GetCacheHitCount() {
+  ReadLockGuard guard(&g_webCacheLock);
+  return g_webCacheHits;
+}
+
+long long WebRequest::GetCacheMissCount() {
+  ReadLockGuard guard(&g_webCacheLock);
+  return g_webCacheMisses;
+}
+
+long long WebRequest::GetCacheRevalidationCount() {
+  ReadLockGuard guard(&g_webCacheLock);
+  return g_webCacheRevalidations;
+}
+
+} // namespace attoboy
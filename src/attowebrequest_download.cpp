@@ -3,6 +3,127 @@
 
 namespace attoboy {
 
+// Destination for a download. The file is opened when the first body bytes
+// arrive, so a failed request leaves an existing file untouched.
+struct WebFileSink {
+  WCHAR *path;
+  HANDLE file;
+  long long offset;
+  bool started;
+  bool failed;
+};
+
+// Reads the number after prefix in a Content-Range value such as
+// "bytes 100-199/200" (prefix "bytes ") or "bytes */200" (prefix "/").
+// Returns -1 if there is none or it is implausibly large.
+static long long ParseContentRangeNumber(const String &value,
+                                         const char *prefix) {
+  int at = value.getPositionOf(String(prefix));
+  if (at < 0)
+    return -1;
+  const char *digits = value.c_str() + at + lstrlenA(prefix);
+  if (*digits < '0' || *digits > '9')
+    return -1;
+  long long number = 0;
+  for (; *digits >= '0' && *digits <= '9'; digits++) {
+    number = (long long)MulU64By32(number, 10) + (*digits - '0');
+    if (number > (1LL << 53))
+      return -1;
+  }
+  return number;
+}
+
+static String GetContentRange(const WebResponseImpl *response) {
+  if (!response->headers)
+    return String();
+  return response->headers->get<String, String>(String("Content-Range"));
+}
+
+// Opens the file and positions it for the body: after the bytes already on
+// disk for a 206 that continues them, otherwise at the start.
+static bool StartWebFileBody(WebFileSink *sink,
+                             const WebResponseImpl *response) {
+  sink->started = true;
+  long long start = 0;
+  if (response->statusCode == 206) {
+    start = ParseContentRangeNumber(GetContentRange(response), "bytes ");
+    if (start != sink->offset)
+      return false;
+  }
+
+  sink->file = CreateFileW(sink->path, GENERIC_WRITE, FILE_SHARE_READ,
+                           nullptr, OPEN_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN,
+                           nullptr);
+  if (sink->file == INVALID_HANDLE_VALUE)
+    return false;
+  LARGE_INTEGER position;
+  position.QuadPart = start;
+  return SetFilePointerEx(sink->file, position, nullptr, FILE_BEGIN) &&
+         SetEndOfFile(sink->file);
+}
+
+static bool WriteWebFileChunk(void *context, const WebResponseImpl *response,
+                              const unsigned char *data, int length) {
+  WebFileSink *sink = (WebFileSink *)context;
+  if (!sink->started && !StartWebFileBody(sink, response)) {
+    sink->failed = true;
+    return false;
+  }
+  DWORD written = 0;
+  if (!WriteFile(sink->file, data, (DWORD)length, &written, nullptr) ||
+      (int)written != length) {
+    sink->failed = true;
+    return false;
+  }
+  return true;
+}
+
+// Streams the GET response body for reqImpl into savePath. With resume, the
+// bytes already in the file are requested with Range and only the rest is
+// appended; a partial file is kept on failure so it can be resumed later.
+static bool DownloadToFile(WebRequestImpl *reqImpl, const String &savePath,
+                           int timeout, bool resume) {
+  WebFileSink sink;
+  ZeroMemory(&sink, sizeof(sink));
+  sink.file = INVALID_HANDLE_VALUE;
+  sink.path = Utf8ToWide(savePath.c_str());
+  if (!sink.path)
+    return false;
+
+  if (resume) {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (GetFileAttributesExW(sink.path, GetFileExInfoStandard, &data))
+      sink.offset = ((long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    if (sink.offset > 0)
+      reqImpl->headers->put(String("Range"),
+                            String("bytes=") + String(sink.offset) + "-");
+  }
+
+  WebResponseImpl *response = PerformRequest(reqImpl, L"GET", nullptr, 0,
+                                             timeout, WriteWebFileChunk, &sink);
+  reqImpl->response = response;
+  reqImpl->hasCompleted = true;
+
+  bool success = false;
+  if (response && !sink.failed && response->bodyComplete) {
+    int status = response->statusCode;
+    if (status >= 200 && status < 300) {
+      success = sink.started || StartWebFileBody(&sink, response);
+    } else if (status == 416 && sink.offset > 0) {
+      // Nothing left to fetch if the file already has the full length.
+      success = ParseContentRangeNumber(GetContentRange(response), "/") ==
+                sink.offset;
+    }
+  }
+
+  if (sink.file != INVALID_HANDLE_VALUE)
+    CloseHandle(sink.file);
+  if (!success && sink.started && !resume)
+    DeleteFileW(sink.path);
+  FreeConvertedString(sink.path);
+  return success;
+}
+
 bool WebRequest::Download(const String &url, const String &savePath,
                           const Map &params, const Map &headers,
                           bool overwrite, int timeout) {
@@ -12,16 +133,18 @@ bool WebRequest::Download(const String &url, const String &savePath,
     return false;
 
   WebRequest req(url, params, headers);
-  WebResponse resp = req.doGet(timeout);
-
-  if (!resp.succeeded()) {
+  if (!req.impl)
     return false;
-  }
-
-  Buffer data = resp.asBuffer();
+  return DownloadToFile(req.impl, savePath, timeout, false);
+}
 
-  bool success = filePath.writeFromBuffer(data);
-  return success;
+bool WebRequest::ResumeDownload(const String &url, const String &savePath,
+                                const Map &params, const Map &headers,
+                                int timeout) {
+  WebRequest req(url, params, headers);
+  if (!req.impl)
+    return false;
+  return DownloadToFile(req.impl, savePath, timeout, true);
 }
 
 } // namespace attoboy
@@ -14,6 +14,7 @@ struct WebResponseImpl {
   WCHAR *finalUrl;
   unsigned char *body;
   int bodySize;
+  bool bodyComplete;
   Map *headers;
   mutable SRWLOCK lock;
   volatile LONG refCount;
@@ -29,6 +30,61 @@ struct WebRequestImpl {
   volatile LONG refCount;
 };
 
+// A pooled host. WinHTTP keeps idle keep-alive sockets in the session, so
+// each host gets its own session and closing it drops that host's
+// connections. inUse counts requests in flight.
+struct WebHostEntry {
+  WCHAR *host;
+  INTERNET_PORT port;
+  bool secure;
+  HINTERNET session;
+  HINTERNET connect;
+  int inUse;
+  ULONGLONG lastUsed;
+  WebHostEntry *next;
+};
+
+// Passed as the request context so the status callback can report whether
+// WinHTTP opened a new socket for the request.
+struct WebConnectionTrace {
+  int connects;
+  bool sent;
+};
+
+/// Returns the pooled entry for a host, creating it on first use, or nullptr
+/// on failure. Pair with ReleaseWebHost().
+WebHostEntry *AcquireWebHost(const WCHAR *host, INTERNET_PORT port,
+                             bool secure);
+
+/// Returns a host to the pool and records whether trace's request reused a
+/// connection (trace may be nullptr if nothing was sent).
+void ReleaseWebHost(WebHostEntry *entry, const WebConnectionTrace *trace);
+
+// Bodies are read (and streamed) in chunks of this size; a Content-Length up
+// to WEB_BODY_MAX_PRESIZE sizes the in-memory body up front.
+static const DWORD WEB_BODY_CHUNK = 65536;
+static const DWORD WEB_BODY_MAX_PRESIZE = 64 * 1024 * 1024;
+
+/// Receives a chunk of a 2xx response body as it arrives. Returning false
+/// stops the transfer.
+typedef bool (*WebBodySink)(void *context, const WebResponseImpl *response,
+                            const unsigned char *data, int length);
+
+/// Sends the request and reads the response. With a sink, a 2xx body is
+/// passed to it instead of being kept. Returns nullptr on failure.
+WebResponseImpl *PerformRequest(WebRequestImpl *reqImpl, const WCHAR *method,
+                                const unsigned char *body, int bodySize,
+                                int timeout, WebBodySink sink = nullptr,
+                                void *sinkContext = nullptr);
+
+/// Performs a GET through the response cache if WebRequest::EnableCache()
+/// is on, otherwise sends it directly. Returns nullptr on failure.
+WebResponseImpl *PerformCachedGet(WebRequestImpl *reqImpl, int timeout);
+
+/// Looks up a header by lowercase name, ignoring the case of the map's keys.
+/// Sets *key to the key as stored if key is not nullptr.
+bool FindWebHeader(const Map *headers, const char *name, String *key);
+
 static inline WCHAR *AllocWebString(int len) {
   return (WCHAR *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
                             (len + 1) * sizeof(WCHAR));
@@ -0,0 +1,221 @@
+#include "attowebrequest_internal.h"
+
+namespace attoboy {
+
+static const int WEB_POOL_DEFAULT_MAX_CONNS = 16;
+static const int WEB_POOL_DEFAULT_IDLE_MS = 60000;
+
+static SRWLOCK g_webPoolLock = SRWLOCK_INIT;
+static WebHostEntry *g_webHosts = nullptr;
+static int g_webMaxConnsPerHost = WEB_POOL_DEFAULT_MAX_CONNS;
+static int g_webIdleTimeoutMs = WEB_POOL_DEFAULT_IDLE_MS;
+static long long g_webNewConnections = 0;
+static long long g_webReusedConnections = 0;
+static CONDITION_VARIABLE g_webReaperWake = CONDITION_VARIABLE_INIT;
+static bool g_webReaperRunning = false;
+
+// Called on the requesting thread when WinHTTP opens a new socket rather
+// than taking one from the session's pool.
+static void CALLBACK WebPoolStatusCallback(HINTERNET handle, DWORD_PTR context,
+                                           DWORD status, LPVOID info,
+                                           DWORD infoLength) {
+  if (status == WINHTTP_CALLBACK_STATUS_CONNECTED_TO_SERVER && context)
+    ((WebConnectionTrace *)context)->connects++;
+}
+
+static void ApplyWebHostLimits(WebHostEntry *entry) {
+  DWORD maxConns = (DWORD)g_webMaxConnsPerHost;
+  WinHttpSetOption(entry->session, WINHTTP_OPTION_MAX_CONNS_PER_SERVER,
+                   &maxConns, sizeof(maxConns));
+  WinHttpSetOption(entry->session, WINHTTP_OPTION_MAX_CONNS_PER_1_0_SERVER,
+                   &maxConns, sizeof(maxConns));
+}
+
+static void DestroyWebHost(WebHostEntry *entry) {
+  if (entry->connect)
+    WinHttpCloseHandle(entry->connect);
+  if (entry->session)
+    WinHttpCloseHandle(entry->session);
+  FreeWebString(entry->host);
+  HeapFree(GetProcessHeap(), 0, entry);
+}
+
+static WebHostEntry *NewWebHost(const WCHAR *host, INTERNET_PORT port,
+                                bool secure) {
+  WebHostEntry *entry = (WebHostEntry *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(WebHostEntry));
+  if (!entry)
+    return nullptr;
+  entry->host = AllocWebString(lstrlenW(host));
+  entry->port = port;
+  entry->secure = secure;
+  entry->session =
+      WinHttpOpen(L"libattoboy/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+                  WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+  if (entry->host)
+    lstrcpyW(entry->host, host);
+  if (entry->session)
+    entry->connect = WinHttpConnect(entry->session, host, port, 0);
+  if (!entry->host || !entry->connect) {
+    DestroyWebHost(entry);
+    return nullptr;
+  }
+
+  WinHttpSetStatusCallback(entry->session, WebPoolStatusCallback,
+                           WINHTTP_CALLBACK_FLAG_CONNECTED_TO_SERVER, 0);
+  ApplyWebHostLimits(entry);
+  return entry;
+}
+
+// Unlinks hosts that have been idle for the timeout onto expired. Caller
+// holds the exclusive pool lock.
+static void CollectIdleWebHosts(ULONGLONG now, WebHostEntry **expired) {
+  WebHostEntry **link = &g_webHosts;
+  while (*link) {
+    WebHostEntry *entry = *link;
+    if (entry->inUse == 0 &&
+        now - entry->lastUsed >= (ULONGLONG)g_webIdleTimeoutMs) {
+      *link = entry->next;
+      entry->next = *expired;
+      *expired = entry;
+    } else {
+      link = &entry->next;
+    }
+  }
+}
+
+static void DestroyWebHostList(WebHostEntry *list) {
+  while (list) {
+    WebHostEntry *next = list->next;
+    DestroyWebHost(list);
+    list = next;
+  }
+}
+
+// Returns how long until the next idle host expires, or INFINITE if every
+// host is in use. Caller holds the pool lock.
+static DWORD GetWebReaperWait(ULONGLONG now) {
+  DWORD wait = INFINITE;
+  for (WebHostEntry *entry = g_webHosts; entry; entry = entry->next) {
+    if (entry->inUse > 0)
+      continue;
+    ULONGLONG expires = entry->lastUsed + (ULONGLONG)g_webIdleTimeoutMs;
+    DWORD remaining = expires > now ? (DWORD)(expires - now) : 0;
+    if (remaining < wait)
+      wait = remaining;
+  }
+  return wait;
+}
+
+// Closes hosts once they have been idle for the timeout, so their sockets do
+// not linger until the next request. Started when a host goes idle; exits
+// when the pool is empty.
+static DWORD WINAPI WebReaperProc(LPVOID param) {
+  AcquireSRWLockExclusive(&g_webPoolLock);
+  while (g_webHosts) {
+    ULONGLONG now = GetTickCount64();
+    WebHostEntry *expired = nullptr;
+    CollectIdleWebHosts(now, &expired);
+    if (expired) {
+      ReleaseSRWLockExclusive(&g_webPoolLock);
+      DestroyWebHostList(expired);
+      AcquireSRWLockExclusive(&g_webPoolLock);
+      continue;
+    }
+    SleepConditionVariableSRW(&g_webReaperWake, &g_webPoolLock,
+                              GetWebReaperWait(now), 0);
+  }
+  g_webReaperRunning = false;
+  ReleaseSRWLockExclusive(&g_webPoolLock);
+  return 0;
+}
+
+// Starts the reaper, or wakes it to recompute its deadline. Caller holds the
+// exclusive pool lock.
+static void WakeWebReaper() {
+  if (g_webReaperRunning) {
+    WakeConditionVariable(&g_webReaperWake);
+    return;
+  }
+  HANDLE thread = CreateThread(nullptr, 0, WebReaperProc, nullptr, 0, nullptr);
+  if (thread) {
+    g_webReaperRunning = true;
+    CloseHandle(thread);
+  }
+}
+
+WebHostEntry *AcquireWebHost(const WCHAR *host, INTERNET_PORT port,
+                             bool secure) {
+  WebHostEntry *expired = nullptr;
+  WebHostEntry *found = nullptr;
+  {
+    WriteLockGuard guard(&g_webPoolLock);
+    CollectIdleWebHosts(GetTickCount64(), &expired);
+    for (WebHostEntry *entry = g_webHosts; entry; entry = entry->next) {
+      if (entry->port == port && entry->secure == secure &&
+          lstrcmpiW(entry->host, host) == 0) {
+        entry->inUse++;
+        found = entry;
+        break;
+      }
+    }
+  }
+  DestroyWebHostList(expired);
+  if (found)
+    return found;
+
+  // Opened outside the lock; if another thread added the same host in the
+  // meantime, both entries serve requests until one expires.
+  WebHostEntry *entry = NewWebHost(host, port, secure);
+  if (!entry)
+    return nullptr;
+  WriteLockGuard guard(&g_webPoolLock);
+  entry->inUse = 1;
+  entry->next = g_webHosts;
+  g_webHosts = entry;
+  return entry;
+}
+
+void ReleaseWebHost(WebHostEntry *entry, const WebConnectionTrace *trace) {
+  WriteLockGuard guard(&g_webPoolLock);
+  entry->inUse--;
+  entry->lastUsed = GetTickCount64();
+  if (entry->inUse == 0)
+    WakeWebReaper();
+  if (!trace)
+    return;
+  if (trace->connects > 0)
+    g_webNewConnections += trace->connects;
+  else if (trace->sent)
+    g_webReusedConnections++;
+}
+
+void WebRequest::SetConnectionPool(int maxConnectionsPerHost,
+                                   int idleTimeoutMs) {
+  WebHostEntry *expired = nullptr;
+  {
+    WriteLockGuard guard(&g_webPoolLock);
+    g_webMaxConnsPerHost = maxConnectionsPerHost > 0
+                               ? maxConnectionsPerHost
+                               : WEB_POOL_DEFAULT_MAX_CONNS;
+    g_webIdleTimeoutMs = idleTimeoutMs >= 0 ? idleTimeoutMs : 0;
+    for (WebHostEntry *entry = g_webHosts; entry; entry = entry->next)
+      ApplyWebHostLimits(entry);
+    CollectIdleWebHosts(GetTickCount64(), &expired);
+    if (g_webHosts)
+      WakeWebReaper();
+  }
+  DestroyWebHostList(expired);
+}
+
+long long WebRequest::GetNewConnectionCount() {
+  ReadLockGuard guard(&g_webPoolLock);
+  return g_webNewConnections;
+}
+
+long long WebRequest::GetReusedConnectionCount() {
+  ReadLockGuard guard(&g_webPoolLock);
+  return g_webReusedConnections;
+}
+
+} // namespace attoboy
@@ -1,11 +1,91 @@
 #include "attowebrequest_internal.h"
 #include "attostring_internal.h"
+#include "attobuffer_internal.h"
 
 namespace attoboy {
 
-static WebResponseImpl *
-PerformRequest(WebRequestImpl *reqImpl, const WCHAR *method,
-               const unsigned char *body, int bodySize, int timeout) {
+bool FindWebHeader(const Map *headers, const char *name, String *key) {
+  if (!headers)
+    return false;
+  List keys = headers->keys();
+  for (int i = 0; i < keys.length(); i++) {
+    String candidate = keys.at<String>(i);
+    if (candidate.lower() == name) {
+      if (key)
+        *key = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Reads a gzip or deflate Content-Encoding. Once the body is decoded the
+// encoding and length headers no longer describe it, so they are dropped.
+static bool GetWebContentEncoding(Map *headers, CompressionFormat *format) {
+  String key;
+  if (!FindWebHeader(headers, "content-encoding", &key))
+    return false;
+  String encoding = headers->get<String, String>(key).trim().lower();
+  if (encoding == "gzip" || encoding == "x-gzip")
+    *format = COMPRESSION_GZIP;
+  else if (encoding == "deflate")
+    *format = COMPRESSION_DEFLATE;
+  else
+    return false;
+
+  headers->remove(key);
+  if (FindWebHeader(headers, "content-length", &key))
+    headers->remove(key);
+  return true;
+}
+
+// Where body bytes go: the caller's sink for a streamed 2xx body, otherwise
+// the response's body, grown geometrically.
+struct WebBodyTarget {
+  WebResponseImpl *response;
+  WebBodySink sink;
+  void *sinkContext;
+  DWORD capacity;
+};
+
+static bool GrowWebBody(WebBodyTarget *target, DWORD needed) {
+  if (needed <= target->capacity)
+    return true;
+  if (needed > 0x7FFFFFFF)
+    return false;
+  DWORD grown = target->capacity ? target->capacity : WEB_BODY_CHUNK;
+  while (grown < needed)
+    grown *= 2;
+  WebResponseImpl *response = target->response;
+  unsigned char *body =
+      response->body
+          ? (unsigned char *)HeapReAlloc(GetProcessHeap(), 0, response->body,
+                                         grown)
+          : (unsigned char *)HeapAlloc(GetProcessHeap(), 0, grown);
+  if (!body)
+    return false;
+  response->body = body;
+  target->capacity = grown;
+  return true;
+}
+
+static bool DeliverWebBody(void *context, const unsigned char *data,
+                           int length) {
+  WebBodyTarget *target = (WebBodyTarget *)context;
+  if (target->sink)
+    return target->sink(target->sinkContext, target->response, data, length);
+  WebResponseImpl *response = target->response;
+  if (!GrowWebBody(target, (DWORD)response->bodySize + (DWORD)length))
+    return false;
+  CopyMemory(response->body + response->bodySize, data, length);
+  response->bodySize += length;
+  return true;
+}
+
+WebResponseImpl *PerformRequest(WebRequestImpl *reqImpl, const WCHAR *method,
+                                const unsigned char *body, int bodySize,
+                                int timeout, WebBodySink sink,
+                                void *sinkContext) {
   if (!reqImpl || !reqImpl->url)
     return nullptr;
 
@@ -45,10 +125,10 @@ PerformRequest(WebRequestImpl *reqImpl, const WCHAR *method,
     return nullptr;
   }
 
-  HINTERNET hSession =
-      WinHttpOpen(L"libattoboy/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
-                  WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
-  if (!hSession) {
+  // The host's pooled session keeps keep-alive connections between requests.
+  bool secure = urlComp.nScheme == INTERNET_SCHEME_HTTPS;
+  WebHostEntry *host = AcquireWebHost(hostname, urlComp.nPort, secure);
+  if (!host) {
     HeapFree(GetProcessHeap(), 0, hostname);
     HeapFree(GetProcessHeap(), 0, urlPath);
     delete respImpl->headers;
@@ -56,13 +136,12 @@ PerformRequest(WebRequestImpl *reqImpl, const WCHAR *method,
     return nullptr;
   }
 
-  if (timeout > 0) {
-    WinHttpSetTimeouts(hSession, timeout, timeout, timeout, timeout);
-  }
-
-  HINTERNET hConnect = WinHttpConnect(hSession, hostname, urlComp.nPort, 0);
-  if (!hConnect) {
-    WinHttpCloseHandle(hSession);
+  DWORD flags = secure ? WINHTTP_FLAG_SECURE : 0;
+  HINTERNET hRequest = WinHttpOpenRequest(host->connect, method, urlPath,
+                                          nullptr, WINHTTP_NO_REFERER,
+                                          WINHTTP_DEFAULT_ACCEPT_TYPES, flags);
+  if (!hRequest) {
+    ReleaseWebHost(host, nullptr);
     HeapFree(GetProcessHeap(), 0, hostname);
     HeapFree(GetProcessHeap(), 0, urlPath);
     delete respImpl->headers;
@@ -70,26 +149,21 @@ PerformRequest(WebRequestImpl *reqImpl, const WCHAR *method,
     return nullptr;
   }
 
-  DWORD flags = (urlComp.nScheme == INTERNET_SCHEME_HTTPS)
-                    ? WINHTTP_FLAG_SECURE
-                    : 0;
-  HINTERNET hRequest =
-      WinHttpOpenRequest(hConnect, method, urlPath, nullptr,
-                         WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, flags);
-  if (!hRequest) {
-    WinHttpCloseHandle(hConnect);
-    WinHttpCloseHandle(hSession);
-    HeapFree(GetProcessHeap(), 0, hostname);
-    HeapFree(GetProcessHeap(), 0, urlPath);
-    delete respImpl->headers;
-    HeapFree(GetProcessHeap(), 0, respImpl);
-    return nullptr;
+  if (timeout > 0) {
+    WinHttpSetTimeouts(hRequest, timeout, timeout, timeout, timeout);
   }
 
   HeapFree(GetProcessHeap(), 0, hostname);
   HeapFree(GetProcessHeap(), 0, urlPath);
 
+  // Ask for a compressed body unless the caller negotiates the encoding or
+  // asks for a byte range, whose offsets would refer to the encoded bytes.
+  bool acceptEncoding =
+      !FindWebHeader(reqImpl->headers, "accept-encoding", nullptr) &&
+      !FindWebHeader(reqImpl->headers, "range", nullptr);
   String headersStr;
+  if (acceptEncoding)
+    headersStr = String("Accept-Encoding: gzip, deflate\r\n");
   if (reqImpl->headers && !reqImpl->headers->isEmpty()) {
     List keys = reqImpl->headers->keys();
     for (int i = 0; i < keys.length(); i++) {
@@ -109,30 +183,24 @@ PerformRequest(WebRequestImpl *reqImpl, const WCHAR *method,
     headersLen = WINHTTP_NO_REQUEST_DATA;
   }
 
+  WebConnectionTrace trace;
+  trace.connects = 0;
+  trace.sent = false;
   BOOL sent = WinHttpSendRequest(
       hRequest, headersWide ? headersWide : WINHTTP_NO_ADDITIONAL_HEADERS,
-      headersLen, (LPVOID)body, bodySize, bodySize, 0);
+      headersLen, (LPVOID)body, bodySize, bodySize, (DWORD_PTR)&trace);
 
   if (headersWide)
     FreeConvertedString(headersWide);
 
-  if (!sent) {
-    WinHttpCloseHandle(hRequest);
-    WinHttpCloseHandle(hConnect);
-    WinHttpCloseHandle(hSession);
-    delete respImpl->headers;
-    HeapFree(GetProcessHeap(), 0, respImpl);
-    return nullptr;
-  }
-
-  if (!WinHttpReceiveResponse(hRequest, nullptr)) {
+  if (!sent || !WinHttpReceiveResponse(hRequest, nullptr)) {
     WinHttpCloseHandle(hRequest);
-    WinHttpCloseHandle(hConnect);
-    WinHttpCloseHandle(hSession);
+    ReleaseWebHost(host, &trace);
     delete respImpl->headers;
     HeapFree(GetProcessHeap(), 0, respImpl);
     return nullptr;
   }
+  trace.sent = true;
 
   DWORD statusCode = 0;
   DWORD statusCodeSize = sizeof(statusCode);
@@ -185,46 +253,88 @@ PerformRequest(WebRequestImpl *reqImpl, const WCHAR *method,
     HeapFree(GetProcessHeap(), 0, allHeaders);
   }
 
-  DWORD totalSize = 0;
-  DWORD availableSize = 0;
-  unsigned char *buffer = nullptr;
+  // A 2xx body goes to the sink if there is one; anything else is collected
+  // in memory, sized from Content-Length when known and grown geometrically.
+  // A gzip or deflate body we asked for is decoded on the way through.
+  WebBodyTarget target;
+  target.response = respImpl;
+  target.sink = sink && statusCode >= 200 && statusCode < 300 ? sink : nullptr;
+  target.sinkContext = sinkContext;
+  target.capacity = 0;
+
+  InflateStream *inflater = nullptr;
+  if (acceptEncoding) {
+    CompressionFormat format;
+    if (GetWebContentEncoding(respImpl->headers, &format)) {
+      inflater = CreateInflateStream(format, DeliverWebBody, &target);
+      if (!inflater) {
+        WinHttpCloseHandle(hRequest);
+        ReleaseWebHost(host, &trace);
+        return respImpl;
+      }
+    }
+  }
 
-  do {
-    availableSize = 0;
+  bool direct = !target.sink && !inflater;
+  unsigned char *scratch = nullptr;
+  if (direct) {
+    DWORD contentLength = 0;
+    DWORD contentLengthSize = sizeof(contentLength);
+    if (WinHttpQueryHeaders(
+            hRequest, WINHTTP_QUERY_CONTENT_LENGTH | WINHTTP_QUERY_FLAG_NUMBER,
+            WINHTTP_HEADER_NAME_BY_INDEX, &contentLength, &contentLengthSize,
+            WINHTTP_NO_HEADER_INDEX) &&
+        contentLength <= WEB_BODY_MAX_PRESIZE)
+      GrowWebBody(&target, contentLength);
+  } else {
+    scratch = (unsigned char *)HeapAlloc(GetProcessHeap(), 0, WEB_BODY_CHUNK);
+  }
+
+  for (;;) {
+    DWORD availableSize = 0;
     if (!WinHttpQueryDataAvailable(hRequest, &availableSize))
       break;
-    if (availableSize == 0)
-      break;
-
-    unsigned char *newBuffer;
-    if (buffer) {
-      newBuffer = (unsigned char *)HeapReAlloc(
-          GetProcessHeap(), 0, buffer, totalSize + availableSize);
-    } else {
-      newBuffer = (unsigned char *)HeapAlloc(
-          GetProcessHeap(), 0, totalSize + availableSize);
-    }
-    if (!newBuffer) {
-      if (buffer)
-        HeapFree(GetProcessHeap(), 0, buffer);
+    if (availableSize == 0) {
+      respImpl->bodyComplete = true;
       break;
     }
-    buffer = newBuffer;
 
     DWORD bytesRead = 0;
-    if (!WinHttpReadData(hRequest, buffer + totalSize, availableSize,
-                         &bytesRead))
-      break;
+    if (direct) {
+      // Read straight into the body, with no intermediate copy.
+      DWORD size = (DWORD)respImpl->bodySize;
+      if (!GrowWebBody(&target, size + availableSize) ||
+          !WinHttpReadData(hRequest, respImpl->body + size, availableSize,
+                           &bytesRead))
+        break;
+      respImpl->bodySize += (int)bytesRead;
+      continue;
+    }
 
-    totalSize += bytesRead;
-  } while (availableSize > 0);
+    DWORD wanted =
+        availableSize < WEB_BODY_CHUNK ? availableSize : WEB_BODY_CHUNK;
+    if (!scratch ||
+        !WinHttpReadData(hRequest, scratch, wanted, &bytesRead))
+      break;
+    bool delivered =
+        inflater ? InflateStreamWrite(inflater, scratch, (int)bytesRead)
+                 : DeliverWebBody(&target, scratch, (int)bytesRead);
+    if (!delivered)
+      break;
+  }
 
-  respImpl->body = buffer;
-  respImpl->bodySize = totalSize;
+  if (inflater) {
+    if (respImpl->bodyComplete && !InflateStreamFinish(inflater))
+      respImpl->bodyComplete = false;
+    FreeInflateStream(inflater);
+  }
+  if (scratch)
+    HeapFree(GetProcessHeap(), 0, scratch);
 
+  // Closing the request after reading the whole body returns its connection
+  // to the host's pool.
   WinHttpCloseHandle(hRequest);
-  WinHttpCloseHandle(hConnect);
-  WinHttpCloseHandle(hSession);
+  ReleaseWebHost(host, &trace);
 
   return respImpl;
 }
@@ -237,7 +347,7 @@ WebResponse WebRequest::doGet(int timeout) {
   if (impl->hasCompleted)
     return WebResponse();
 
-  impl->response = PerformRequest(impl, L"GET", nullptr, 0, timeout);
+  impl->response = PerformCachedGet(impl, timeout);
   impl->hasCompleted = true;
 
   if (!impl->response)
@@ -405,4 +515,63 @@ WebResponse WebRequest::doRequest(const String &method,
   return resp;
 }
 
+struct WebChunkTarget {
+  WebChunkCallback callback;
+  void *arg;
+  File *file;
+};
+
+static bool DeliverWebChunk(void *context, const WebResponseImpl *response,
+                            const unsigned char *data, int length) {
+  WebChunkTarget *target = (WebChunkTarget *)context;
+  if (target->file)
+    return target->file->write(Buffer(data, length)) == length;
+  return target->callback(data, length, target->arg);
+}
+
+WebResponse WebRequest::doGet(WebChunkCallback callback, void *arg,
+                              int timeout) {
+  if (!impl || !callback)
+    return WebResponse();
+
+  WriteLockGuard lock(&impl->lock);
+  if (impl->hasCompleted)
+    return WebResponse();
+
+  WebChunkTarget target = {callback, arg, nullptr};
+  impl->response = PerformRequest(impl, L"GET", nullptr, 0, timeout,
+                                  DeliverWebChunk, &target);
+  impl->hasCompleted = true;
+
+  if (!impl->response)
+    return WebResponse();
+
+  WebResponse resp;
+  resp.impl = impl->response;
+  InterlockedIncrement(&impl->response->refCount);
+  return resp;
+}
+
+WebResponse WebRequest::doGet(File &destination, int timeout) {
+  if (!impl)
+    return WebResponse();
+
+  WriteLockGuard lock(&impl->lock);
+  if (impl->hasCompleted)
+    return WebResponse();
+
+  WebChunkTarget target = {nullptr, nullptr, &destination};
+  impl->response = PerformRequest(impl, L"GET", nullptr, 0, timeout,
+                                  DeliverWebChunk, &target);
+  impl->hasCompleted = true;
+
+  if (!impl->response)
+    return WebResponse();
+
+  WebResponse resp;
+  resp.impl = impl->response;
+  InterlockedIncrement(&impl->response->refCount);
+  return resp;
+}
+
 } // namespace attoboy
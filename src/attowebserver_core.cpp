@@ -0,0 +1,638 @@
+#include "attowebserver_internal.h"
+
+namespace attoboy {
+
+// Consecutive failed accepts after which the listener is given up on, so a
+// broken listener does not spin the I/O workers.
+static const int WEB_MAX_ACCEPT_FAILURES = 64;
+
+static void OnWebAccept(AsyncResult &result, void *arg);
+static void OnWebRead(AsyncResult &result, void *arg);
+static void OnWebWrite(AsyncResult &result, void *arg);
+static void OnWebFileSent(AsyncResult &result, void *arg);
+static void ContinueWebBatch(WebConnection *conn);
+
+static char *CopyRouteText(const String &str, int *len) {
+  *len = str.byteLength();
+  char *copy = (char *)HeapAlloc(GetProcessHeap(), 0, *len + 1);
+  if (copy) {
+    for (int i = 0; i < *len; i++)
+      copy[i] = str.c_str()[i];
+    copy[*len] = '\0';
+  }
+  return copy;
+}
+
+static void DestroyFileCopy(File *file) {
+  if (file) {
+    file->~File();
+    HeapFree(GetProcessHeap(), 0, file);
+  }
+}
+
+static File *NewFileCopy(const File &file) {
+  void *mem = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(File));
+  return mem ? new (mem) File(file) : nullptr;
+}
+
+static void RetainWebServer(WebServerImpl *impl) {
+  InterlockedIncrement(&impl->refCount);
+}
+
+static void ReleaseWebServer(WebServerImpl *impl) {
+  if (InterlockedDecrement(&impl->refCount) != 0)
+    return;
+
+  for (int i = 0; i < impl->routeCount; i++) {
+    HeapFree(GetProcessHeap(), 0, impl->routes[i].method);
+    HeapFree(GetProcessHeap(), 0, impl->routes[i].prefix);
+  }
+  if (impl->routes)
+    HeapFree(GetProcessHeap(), 0, impl->routes);
+  DestroyFileCopy(impl->listener);
+  HeapFree(GetProcessHeap(), 0, impl);
+}
+
+//------------------------------------------------------------------------------
+// Connections
+//------------------------------------------------------------------------------
+
+static WebConnection *NewWebConnection(WebServerImpl *impl, const File &file) {
+  WebConnection *conn = (WebConnection *)HeapAlloc(
+      GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(WebConnection));
+  if (!conn)
+    return nullptr;
+  void *inMem = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(Buffer));
+  void *outMem = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(Buffer));
+  void *pathMem = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(String));
+  conn->file = NewFileCopy(file);
+  if (!inMem || !outMem || !pathMem || !conn->file) {
+    if (inMem)
+      HeapFree(GetProcessHeap(), 0, inMem);
+    if (outMem)
+      HeapFree(GetProcessHeap(), 0, outMem);
+    if (pathMem)
+      HeapFree(GetProcessHeap(), 0, pathMem);
+    DestroyFileCopy(conn->file);
+    HeapFree(GetProcessHeap(), 0, conn);
+    return nullptr;
+  }
+  conn->inbox = new (inMem) Buffer();
+  conn->outbox = new (outMem) Buffer();
+  conn->sendPath = new (pathMem) String();
+  conn->server = impl;
+  return conn;
+}
+
+static void DestroyWebConnection(WebConnection *conn) {
+  conn->file->close();
+  DestroyFileCopy(conn->file);
+  conn->inbox->~Buffer();
+  HeapFree(GetProcessHeap(), 0, conn->inbox);
+  conn->outbox->~Buffer();
+  HeapFree(GetProcessHeap(), 0, conn->outbox);
+  conn->sendPath->~String();
+  HeapFree(GetProcessHeap(), 0, conn->sendPath);
+  HeapFree(GetProcessHeap(), 0, conn);
+}
+
+static void CloseWebConnection(WebConnection *conn) {
+  WebServerImpl *impl = conn->server;
+  {
+    WriteLockGuard guard(&impl->lock);
+    if (conn->prev)
+      conn->prev->next = conn->next;
+    else
+      impl->connections = conn->next;
+    if (conn->next)
+      conn->next->prev = conn->prev;
+    impl->connectionCount--;
+    WakeAllConditionVariable(&impl->drained);
+  }
+  DestroyWebConnection(conn);
+  ReleaseWebServer(impl);
+}
+
+static void StartWebRead(WebConnection *conn, int size) {
+  conn->file->readAsync(size, OnWebRead, conn);
+}
+
+// Answers the complete requests in the inbox, in order, collecting the
+// responses for the whole batch in the outbox. A response with a file body
+// ends the batch and leaves the file in conn->sendPath, to be streamed once
+// the outbox is sent; the requests after it wait for the next batch. Returns
+// false if the connection should close once everything is sent. nextRead
+// receives the size of the read that would complete a partial request.
+static bool ServeWebInbox(WebConnection *conn, int *nextRead) {
+  WebServerImpl *impl = conn->server;
+  BufferChain out;
+  bool keep = true;
+  int handled = 0;
+  int consumed = 0;
+  int len = 0;
+  const unsigned char *data = conn->inbox->c_ptr(&len);
+
+  while (keep && consumed < len) {
+    WebServerRequestImpl request;
+    request.source = conn->inbox;
+    request.offset = consumed;
+    WebParseStatus status = ParseWebRequest(data + consumed, len - consumed,
+                                            &conn->scanned, &request);
+    if (status == WEB_PARSE_INCOMPLETE) {
+      if (request.headLength > 0) {
+        if (request.expectContinue && !conn->continued) {
+          out.append(String("HTTP/1.1 100 Continue\r\n\r\n"));
+          conn->continued = true;
+        }
+        int missing =
+            request.headLength + request.bodyLength - (len - consumed);
+        *nextRead = missing < WEB_READ_SIZE       ? WEB_READ_SIZE
+                    : missing > WEB_MAX_READ_SIZE ? WEB_MAX_READ_SIZE
+                                                  : missing;
+      }
+      break;
+    }
+
+    WebServerResponseImpl response;
+    response.status = 200;
+    response.hasContentType = false;
+    response.request = &request;
+    response.fileOffset = 0;
+    response.fileLength = 0;
+    response.hasFile = false;
+    bool headOnly = false;
+    if (status == WEB_PARSE_ERROR) {
+      response.status = request.errorStatus;
+      response.body.append(String(GetWebStatusText(request.errorStatus)));
+      keep = false;
+    } else {
+      headOnly = request.methodLen == 4 && request.method[0] == 'H' &&
+                 request.method[1] == 'E' && request.method[2] == 'A' &&
+                 request.method[3] == 'D';
+      DispatchWebRequest(impl, &request, &response);
+      {
+        ReadLockGuard guard(&impl->lock);
+        keep = request.keepAlive && !impl->stopping;
+      }
+      consumed += request.headLength + request.bodyLength;
+      conn->scanned = 0;
+      conn->continued = false;
+      handled++;
+    }
+
+    bool hasBody = !headOnly && !IsWebBodylessStatus(response.status);
+    long long fileLength = response.hasFile ? response.fileLength : 0;
+    Buffer head(256);
+    BuildWebResponseHead(&response, response.body.length() + fileLength,
+                         !keep, &head);
+    out.append(head);
+    if (hasBody)
+      out.append(response.body);
+
+    // A file body goes straight from the file cache to the socket, after
+    // everything queued before it.
+    if (hasBody && fileLength > 0) {
+      *conn->sendPath = response.filePath;
+      conn->sendOffset = response.fileOffset;
+      conn->sendRemaining = fileLength;
+      conn->pipelined = consumed < len;
+      break;
+    }
+  }
+
+  if (!out.isEmpty())
+    *conn->outbox = out.toBuffer();
+
+  if (consumed >= len)
+    conn->inbox->clear();
+  else if (consumed > 0)
+    *conn->inbox = conn->inbox->slice(consumed);
+
+  if (handled > 0) {
+    WriteLockGuard guard(&impl->lock);
+    impl->requestCount += handled;
+  }
+  return keep;
+}
+
+// Reads the next request once a batch has been answered, or closes the
+// connection.
+static void FinishWebBatch(WebConnection *conn) {
+  WebServerImpl *impl = conn->server;
+  bool keep = conn->keep;
+  if (keep) {
+    WriteLockGuard guard(&impl->lock);
+    keep = !impl->stopping;
+    if (keep)
+      conn->state = WEB_CONN_READING;
+  }
+  if (keep)
+    StartWebRead(conn, conn->nextRead);
+  else
+    CloseWebConnection(conn);
+}
+
+// Runs the handlers for the inbox and starts sending their responses.
+// Handlers may block, so this runs on the system thread pool rather than on
+// the I/O workers, and the sends are overlapped so a slow client holds no
+// thread at all.
+static DWORD WINAPI ServeWebProc(LPVOID param) {
+  WebConnection *conn = (WebConnection *)param;
+  conn->nextRead = WEB_READ_SIZE;
+  conn->keep = ServeWebInbox(conn, &conn->nextRead);
+  if (conn->outbox->isEmpty()) {
+    ContinueWebBatch(conn);
+  } else {
+    conn->outboxSent = 0;
+    conn->file->writeAsync(*conn->outbox, OnWebWrite, conn);
+  }
+  return 0;
+}
+
+static void QueueWebBatch(WebConnection *conn) {
+  if (!QueueUserWorkItem(ServeWebProc, conn, WT_EXECUTELONGFUNCTION))
+    ServeWebProc(conn);
+}
+
+// Runs once the outbox is sent: streams a pending file body, then serves
+// the requests that were waiting behind it or reads the next ones.
+static void ContinueWebBatch(WebConnection *conn) {
+  if (conn->sendRemaining > 0) {
+    conn->file->sendFileAsync(Path(*conn->sendPath), conn->sendOffset,
+                              conn->sendRemaining, OnWebFileSent, conn);
+    return;
+  }
+  if (conn->keep && conn->pipelined) {
+    conn->pipelined = false;
+    QueueWebBatch(conn);
+    return;
+  }
+  FinishWebBatch(conn);
+}
+
+static void OnWebWrite(AsyncResult &result, void *arg) {
+  WebConnection *conn = (WebConnection *)arg;
+  int sent = result.getCount();
+  if (!result.succeeded() || sent <= 0) {
+    CloseWebConnection(conn);
+    return;
+  }
+
+  conn->outboxSent += sent;
+  if (conn->outboxSent < conn->outbox->length()) {
+    conn->file->writeAsync(conn->outbox->slice(conn->outboxSent), OnWebWrite,
+                           conn);
+    return;
+  }
+  conn->outbox->clear();
+  ContinueWebBatch(conn);
+}
+
+// sendFileAsync() sends at most 1 GB per call, so larger bodies take several.
+static void OnWebFileSent(AsyncResult &result, void *arg) {
+  WebConnection *conn = (WebConnection *)arg;
+  int sent = result.getCount();
+  if (!result.succeeded() || sent <= 0) {
+    CloseWebConnection(conn);
+    return;
+  }
+
+  conn->sendOffset += sent;
+  conn->sendRemaining -= sent;
+  ContinueWebBatch(conn);
+}
+
+static void OnWebRead(AsyncResult &result, void *arg) {
+  WebConnection *conn = (WebConnection *)arg;
+  WebServerImpl *impl = conn->server;
+  Buffer chunk = result.getBuffer();
+  if (!result.succeeded() || chunk.isEmpty()) {
+    CloseWebConnection(conn);
+    return;
+  }
+
+  {
+    WriteLockGuard guard(&impl->lock);
+    conn->state = WEB_CONN_HANDLING;
+  }
+  if (conn->inbox->isEmpty())
+    *conn->inbox = chunk;
+  else
+    conn->inbox->append(chunk);
+
+  QueueWebBatch(conn);
+}
+
+//------------------------------------------------------------------------------
+// Accepting
+//------------------------------------------------------------------------------
+
+static void StartWebAccept(WebServerImpl *impl) {
+  File *listener = nullptr;
+  {
+    WriteLockGuard guard(&impl->lock);
+    if (!impl->running || impl->stopping || !impl->listener)
+      return;
+    listener = NewFileCopy(*impl->listener);
+    if (!listener)
+      return;
+    impl->pendingAccepts++;
+  }
+  RetainWebServer(impl);
+  listener->acceptAsync(OnWebAccept, impl);
+  DestroyFileCopy(listener);
+}
+
+static void OnWebAccept(AsyncResult &result, void *arg) {
+  WebServerImpl *impl = (WebServerImpl *)arg;
+  File client = result.getFile();
+  // Responses go out as soon as they are written, not after the client's
+  // delayed ACK of the previous segment.
+  if (client.isValid())
+    client.setNoDelay(true);
+  WebConnection *conn =
+      client.isValid() ? NewWebConnection(impl, client) : nullptr;
+
+  bool rearm;
+  bool linked = false;
+  {
+    WriteLockGuard guard(&impl->lock);
+    impl->pendingAccepts--;
+    impl->acceptFailures = client.isValid() ? 0 : impl->acceptFailures + 1;
+    rearm = impl->running && !impl->stopping &&
+            impl->acceptFailures < WEB_MAX_ACCEPT_FAILURES;
+    if (conn && rearm) {
+      conn->state = WEB_CONN_READING;
+      conn->next = impl->connections;
+      if (impl->connections)
+        impl->connections->prev = conn;
+      impl->connections = conn;
+      impl->connectionCount++;
+      linked = true;
+    }
+    WakeAllConditionVariable(&impl->drained);
+  }
+
+  if (linked) {
+    RetainWebServer(impl);
+    StartWebRead(conn, WEB_READ_SIZE);
+  } else if (conn) {
+    DestroyWebConnection(conn);
+  }
+  if (rearm)
+    StartWebAccept(impl);
+  ReleaseWebServer(impl);
+}
+
+//------------------------------------------------------------------------------
+// Routing
+//------------------------------------------------------------------------------
+
+static bool RouteMatches(const WebRoute *route,
+                         const WebServerRequestImpl *request) {
+  if (route->methodLen > 0) {
+    bool same = route->methodLen == request->methodLen;
+    for (int i = 0; same && i < route->methodLen; i++)
+      same = route->method[i] == request->method[i];
+    bool getForHead = route->methodLen == 3 && route->method[0] == 'G' &&
+                      route->method[1] == 'E' && route->method[2] == 'T' &&
+                      request->methodLen == 4 && request->method[0] == 'H' &&
+                      request->method[1] == 'E' && request->method[2] == 'A' &&
+                      request->method[3] == 'D';
+    if (!same && !getForHead)
+      return false;
+  }
+
+  // "/api" matches "/api" and "/api/users" but not "/apis".
+  if (request->pathLen < route->prefixLen)
+    return false;
+  for (int i = 0; i < route->prefixLen; i++) {
+    if (route->prefix[i] != request->target[i])
+      return false;
+  }
+  return request->pathLen == route->prefixLen ||
+         route->prefix[route->prefixLen - 1] == '/' ||
+         request->target[route->prefixLen] == '/';
+}
+
+void DispatchWebRequest(WebServerImpl *server, WebServerRequestImpl *request,
+                        WebServerResponseImpl *response) {
+  WebHandler handler = nullptr;
+  void *arg = nullptr;
+  {
+    ReadLockGuard guard(&server->lock);
+    int bestLen = -1;
+    for (int i = 0; i < server->routeCount; i++) {
+      const WebRoute *route = &server->routes[i];
+      if (route->prefixLen > bestLen && RouteMatches(route, request)) {
+        bestLen = route->prefixLen;
+        handler = route->handler;
+        arg = route->arg;
+      }
+    }
+  }
+
+  WebServerRequest req(request);
+  WebServerResponse res(response);
+  if (!handler) {
+    res.setStatus(404);
+    res.write(String(GetWebStatusText(404)));
+    return;
+  }
+  handler(req, res, arg);
+}
+
+//------------------------------------------------------------------------------
+// WebServer
+//------------------------------------------------------------------------------
+
+// Stops the server, waiting up to timeoutMs for busy connections. Any still
+// busy afterwards close themselves once their current batch is answered.
+static void StopWebServer(WebServerImpl *impl, int timeoutMs) {
+  ULONGLONG deadline = GetTickCount64() + (timeoutMs > 0 ? timeoutMs : 0);
+  WriteLockGuard guard(&impl->lock);
+  if (!impl->running)
+    return;
+
+  if (!impl->stopping) {
+    impl->stopping = true;
+    if (impl->listener)
+      impl->listener->close();
+    // Idle connections are waiting in a read; closing them completes it.
+    for (WebConnection *conn = impl->connections; conn; conn = conn->next) {
+      if (conn->state == WEB_CONN_READING)
+        conn->file->close();
+    }
+  }
+
+  while (impl->connectionCount > 0 || impl->pendingAccepts > 0) {
+    DWORD remaining = INFINITE;
+    if (timeoutMs >= 0) {
+      ULONGLONG now = GetTickCount64();
+      if (now >= deadline)
+        break;
+      remaining = (DWORD)(deadline - now);
+    }
+    SleepConditionVariableSRW(&impl->drained, &impl->lock, remaining, 0);
+  }
+  impl->running = false;
+}
+
+WebServer::WebServer(int port) {
+  impl = (WebServerImpl *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                    sizeof(WebServerImpl));
+  if (!impl)
+    return;
+  InitializeSRWLock(&impl->lock);
+  InitializeConditionVariable(&impl->drained);
+  impl->port = port;
+  impl->handles = 1;
+  impl->refCount = 1;
+}
+
+WebServer::WebServer(const WebServer &other) {
+  impl = other.impl;
+  if (impl) {
+    InterlockedIncrement(&impl->handles);
+    RetainWebServer(impl);
+  }
+}
+
+WebServer::~WebServer() {
+  if (!impl)
+    return;
+  if (InterlockedDecrement(&impl->handles) == 0)
+    StopWebServer(impl, WEB_STOP_TIMEOUT_MS);
+  ReleaseWebServer(impl);
+}
+
+WebServer &WebServer::operator=(const WebServer &other) {
+  if (this != &other) {
+    if (impl) {
+      if (InterlockedDecrement(&impl->handles) == 0)
+        StopWebServer(impl, WEB_STOP_TIMEOUT_MS);
+      ReleaseWebServer(impl);
+    }
+    impl = other.impl;
+    if (impl) {
+      InterlockedIncrement(&impl->handles);
+      RetainWebServer(impl);
+    }
+  }
+  return *this;
+}
+
+bool WebServer::addRoute(const String &method, const String &pathPrefix,
+                         WebHandler handler, void *arg) {
+  if (!impl || !handler)
+    return false;
+
+  WebRoute route;
+  route.handler = handler;
+  route.arg = arg;
+  route.method = CopyRouteText(method, &route.methodLen);
+  route.prefix = CopyRouteText(pathPrefix.isEmpty() ? String("/") : pathPrefix,
+                               &route.prefixLen);
+  if (!route.method || !route.prefix || route.prefix[0] != '/') {
+    if (route.method)
+      HeapFree(GetProcessHeap(), 0, route.method);
+    if (route.prefix)
+      HeapFree(GetProcessHeap(), 0, route.prefix);
+    return false;
+  }
+
+  WriteLockGuard guard(&impl->lock);
+  if (impl->routeCount == impl->routeCapacity) {
+    int newCapacity = impl->routeCapacity < 8 ? 8 : impl->routeCapacity * 2;
+    WebRoute *routes = (WebRoute *)HeapAlloc(GetProcessHeap(), 0,
+                                             newCapacity * sizeof(WebRoute));
+    if (!routes) {
+      HeapFree(GetProcessHeap(), 0, route.method);
+      HeapFree(GetProcessHeap(), 0, route.prefix);
+      return false;
+    }
+    for (int i = 0; i < impl->routeCount; i++)
+      routes[i] = impl->routes[i];
+    if (impl->routes)
+      HeapFree(GetProcessHeap(), 0, impl->routes);
+    impl->routes = routes;
+    impl->routeCapacity = newCapacity;
+  }
+  impl->routes[impl->routeCount++] = route;
+  return true;
+}
+
+bool WebServer::start() {
+  if (!impl)
+    return false;
+
+  {
+    ReadLockGuard guard(&impl->lock);
+    if (impl->running)
+      return false;
+  }
+
+  File listener(impl->port);
+  if (!listener.isValid())
+    return false;
+  File *copy = NewFileCopy(listener);
+  if (!copy)
+    return false;
+
+  {
+    WriteLockGuard guard(&impl->lock);
+    if (impl->running) {
+      DestroyFileCopy(copy);
+      return false;
+    }
+    DestroyFileCopy(impl->listener);
+    impl->listener = copy;
+    impl->port = listener.getPort();
+    impl->running = true;
+    impl->stopping = false;
+    impl->acceptFailures = 0;
+  }
+
+  for (int i = 0; i < WEB_PENDING_ACCEPTS; i++)
+    StartWebAccept(impl);
+  return true;
+}
+
+void WebServer::stop(int timeoutMs) {
+  if (impl)
+    StopWebServer(impl, timeoutMs);
+}
+
+bool WebServer::isRunning() const {
+  if (!impl)
+    return false;
+
+  ReadLockGuard guard(&impl->lock);
+  return impl->running;
+}
+
+int WebServer::getPort() const {
+  if (!impl)
+    return -1;
+
+  ReadLockGuard guard(&impl->lock);
+  return impl->port;
+}
+
+int WebServer::getConnectionCount() const {
+  if (!impl)
+    return 0;
+
+  ReadLockGuard guard(&impl->lock);
+  return impl->connectionCount;
+}
+
+long long WebServer::getRequestCount() const {
+  if (!impl)
+    return 0;
+
+  ReadLockGuard guard(&impl->lock);
+  return impl->requestCount;
+}
+
+} // namespace attoboy
@@ -0,0 +1,157 @@
+#pragma once
+#include "attoasyncresult_internal.h"
+#include "atto_internal_scan.h"
+
+namespace attoboy {
+
+static const int WEB_READ_SIZE = 16384;
+static const int WEB_MAX_READ_SIZE = 1024 * 1024;
+static const int WEB_MAX_HEAD_BYTES = 65536;
+static const int WEB_MAX_HEADERS = 100;
+static const int WEB_MAX_BODY_BYTES = 256 * 1024 * 1024;
+// Accepts kept outstanding on the listener, so bursts of connections do not
+// wait for a worker to re-arm AcceptEx.
+static const int WEB_PENDING_ACCEPTS = 16;
+static const int WEB_STOP_TIMEOUT_MS = 5000;
+
+enum WebParseStatus {
+  WEB_PARSE_INCOMPLETE = 0,
+  WEB_PARSE_DONE,
+  WEB_PARSE_ERROR
+};
+
+// Points into the bytes being parsed; nothing is copied.
+struct WebHeaderField {
+  const char *name;
+  int nameLen;
+  const char *value;
+  int valueLen;
+};
+
+// One parsed request. The pointers refer to the connection's receive
+// buffer (source), where the request starts at offset, and stay valid while
+// the handler runs.
+struct WebServerRequestImpl {
+  const char *method;
+  int methodLen;
+  const char *target;
+  int targetLen;
+  int pathLen;
+  int minorVersion;
+  WebHeaderField headers[WEB_MAX_HEADERS];
+  int headerCount;
+  int headLength;
+  int bodyLength;
+  bool keepAlive;
+  bool expectContinue;
+  int errorStatus;
+  const Buffer *source;
+  int offset;
+};
+
+// Lives on the worker's stack while a handler builds the response. A file
+// body set by sendFile() follows body and is sent with
+// File::sendFileAsync().
+struct WebServerResponseImpl {
+  int status;
+  Buffer head;
+  BufferChain body;
+  bool hasContentType;
+  const WebServerRequestImpl *request;
+  String filePath;
+  long long fileOffset;
+  long long fileLength;
+  bool hasFile;
+};
+
+enum WebConnectionState { WEB_CONN_READING = 0, WEB_CONN_HANDLING };
+
+// An accepted connection. At most one read or write is outstanding, so
+// requests on a connection are handled in order by one thread at a time.
+// outbox holds the answers being sent, of which outboxSent bytes have gone.
+// A file body then follows from sendPath; pipelined says requests are left
+// in the inbox behind it. keep and nextRead say how to continue once all is
+// sent. file, inbox, outbox and sendPath are owning copies placed in heap
+// memory.
+struct WebConnection {
+  WebServerImpl *server;
+  File *file;
+  Buffer *inbox;
+  Buffer *outbox;
+  int outboxSent;
+  String *sendPath;
+  long long sendOffset;
+  long long sendRemaining;
+  bool pipelined;
+  bool keep;
+  int nextRead;
+  int scanned;
+  bool continued;
+  WebConnectionState state;
+  WebConnection *prev;
+  WebConnection *next;
+};
+
+struct WebRoute {
+  char *method;
+  int methodLen;
+  char *prefix;
+  int prefixLen;
+  WebHandler handler;
+  void *arg;
+};
+
+// handles counts WebServer objects; refCount also counts connections and
+// pending accepts, which keep the impl alive after the last handle is gone.
+struct WebServerImpl {
+  int port;
+  File *listener;
+  WebRoute *routes;
+  int routeCount;
+  int routeCapacity;
+  WebConnection *connections;
+  int connectionCount;
+  int pendingAccepts;
+  int acceptFailures;
+  bool running;
+  bool stopping;
+  long long requestCount;
+  CONDITION_VARIABLE drained;
+  SRWLOCK lock;
+  volatile LONG handles;
+  volatile LONG refCount;
+};
+
+/// Returns true for statuses that never carry a body (1xx, 204 and 304).
+static inline bool IsWebBodylessStatus(int status) {
+  return status < 200 || status == 204 || status == 304;
+}
+
+/// Parses the request at the start of data[0, len). scanned carries how far
+/// the header terminator search got, so a partial head is not rescanned when
+/// more bytes arrive. On WEB_PARSE_ERROR, req->errorStatus holds the status
+/// to answer with.
+WebParseStatus ParseWebRequest(const unsigned char *data, int len,
+                               int *scanned, WebServerRequestImpl *req);
+
+/// Parses a Range header value against a resource of size bytes. Returns 1
+/// with the inclusive byte range in start and end, 0 if the header should be
+/// ignored (malformed or several ranges), or -1 if it cannot be satisfied.
+int ParseWebRange(const char *value, int len, long long size, long long *start,
+                  long long *end);
+
+/// Returns the reason phrase for a status code, or "" if unknown.
+const char *GetWebStatusText(int status);
+
+/// Returns the Content-Type for a file extension (without the dot).
+String GetWebContentType(const String &extension);
+
+/// Appends the status line and headers for a response with bodyLength bytes
+/// of body to out.
+void BuildWebResponseHead(WebServerResponseImpl *response,
+                          long long bodyLength, bool close, Buffer *out);
+
+void DispatchWebRequest(WebServerImpl *server, WebServerRequestImpl *request,
+                        WebServerResponseImpl *response);
+
+} // namespace attoboy
@@ -0,0 +1,432 @@
+#include "attowebserver_internal.h"
+
+namespace attoboy {
+
+static int HexValue(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return 10 + c - 'a';
+  if (c >= 'A' && c <= 'F')
+    return 10 + c - 'A';
+  return -1;
+}
+
+static bool NameEquals(const char *a, int aLen, const char *b, int bLen) {
+  if (aLen != bLen)
+    return false;
+  for (int i = 0; i < aLen; i++) {
+    char x = a[i];
+    char y = b[i];
+    if (x >= 'A' && x <= 'Z')
+      x += 'a' - 'A';
+    if (y >= 'A' && y <= 'Z')
+      y += 'a' - 'A';
+    if (x != y)
+      return false;
+  }
+  return true;
+}
+
+static void AppendText(Buffer *out, const char *text, int len = -1) {
+  if (len < 0) {
+    len = 0;
+    while (text[len])
+      len++;
+  }
+  out->append((const unsigned char *)text, len);
+}
+
+// Appends a non-negative value in decimal. 64-bit division needs CRT
+// helpers on x86, so larger values are divided by 10 in 16-bit limbs.
+static void AppendNumber(Buffer *out, long long value) {
+  char digits[24];
+  int pos = sizeof(digits);
+  unsigned long long number = value > 0 ? (unsigned long long)value : 0;
+  if (number <= 0xFFFFFFFFULL) {
+    unsigned int small = (unsigned int)number;
+    do {
+      digits[--pos] = (char)('0' + small % 10);
+      small /= 10;
+    } while (small > 0);
+  } else {
+    unsigned int limbs[4] = {(unsigned int)(number >> 48) & 0xFFFF,
+                             (unsigned int)(number >> 32) & 0xFFFF,
+                             (unsigned int)(number >> 16) & 0xFFFF,
+                             (unsigned int)number & 0xFFFF};
+    bool more;
+    do {
+      unsigned int remainder = 0;
+      more = false;
+      for (int i = 0; i < 4; i++) {
+        unsigned int current = (remainder << 16) | limbs[i];
+        limbs[i] = current / 10;
+        remainder = current % 10;
+        more = more || limbs[i] != 0;
+      }
+      digits[--pos] = (char)('0' + remainder);
+    } while (more);
+  }
+  AppendText(out, digits + pos, (int)sizeof(digits) - pos);
+}
+
+const char *GetWebStatusText(int status) {
+  switch (status) {
+  case 100:
+    return "Continue";
+  case 200:
+    return "OK";
+  case 201:
+    return "Created";
+  case 202:
+    return "Accepted";
+  case 204:
+    return "No Content";
+  case 206:
+    return "Partial Content";
+  case 301:
+    return "Moved Permanently";
+  case 302:
+    return "Found";
+  case 303:
+    return "See Other";
+  case 304:
+    return "Not Modified";
+  case 307:
+    return "Temporary Redirect";
+  case 308:
+    return "Permanent Redirect";
+  case 400:
+    return "Bad Request";
+  case 401:
+    return "Unauthorized";
+  case 403:
+    return "Forbidden";
+  case 404:
+    return "Not Found";
+  case 405:
+    return "Method Not Allowed";
+  case 408:
+    return "Request Timeout";
+  case 409:
+    return "Conflict";
+  case 411:
+    return "Length Required";
+  case 413:
+    return "Content Too Large";
+  case 414:
+    return "URI Too Long";
+  case 416:
+    return "Range Not Satisfiable";
+  case 417:
+    return "Expectation Failed";
+  case 429:
+    return "Too Many Requests";
+  case 431:
+    return "Request Header Fields Too Large";
+  case 500:
+    return "Internal Server Error";
+  case 501:
+    return "Not Implemented";
+  case 502:
+    return "Bad Gateway";
+  case 503:
+    return "Service Unavailable";
+  case 505:
+    return "HTTP Version Not Supported";
+  default:
+    return "";
+  }
+}
+
+String GetWebContentType(const String &extension) {
+  String ext = extension.lower();
+
+  // Text formats
+  if (ext == "html" || ext == "htm")
+    return "text/html; charset=utf-8";
+  if (ext == "css")
+    return "text/css; charset=utf-8";
+  if (ext == "js")
+    return "text/javascript; charset=utf-8";
+  if (ext == "json")
+    return "application/json; charset=utf-8";
+  if (ext == "xml")
+    return "application/xml; charset=utf-8";
+  if (ext == "txt")
+    return "text/plain; charset=utf-8";
+  if (ext == "csv")
+    return "text/csv; charset=utf-8";
+  if (ext == "md")
+    return "text/markdown; charset=utf-8";
+
+  // Images
+  if (ext == "png")
+    return "image/png";
+  if (ext == "jpg" || ext == "jpeg")
+    return "image/jpeg";
+  if (ext == "gif")
+    return "image/gif";
+  if (ext == "ico")
+    return "image/x-icon";
+  if (ext == "svg")
+    return "image/svg+xml";
+  if (ext == "webp")
+    return "image/webp";
+  if (ext == "bmp")
+    return "image/bmp";
+
+  // Fonts
+  if (ext == "woff")
+    return "font/woff";
+  if (ext == "woff2")
+    return "font/woff2";
+  if (ext == "ttf")
+    return "font/ttf";
+  if (ext == "otf")
+    return "font/otf";
+  if (ext == "eot")
+    return "application/vnd.ms-fontobject";
+
+  // Documents
+  if (ext == "pdf")
+    return "application/pdf";
+  if (ext == "zip")
+    return "application/zip";
+  if (ext == "gz" || ext == "gzip")
+    return "application/gzip";
+  if (ext == "tar")
+    return "application/x-tar";
+
+  // Audio/Video
+  if (ext == "mp3")
+    return "audio/mpeg";
+  if (ext == "wav")
+    return "audio/wav";
+  if (ext == "ogg")
+    return "audio/ogg";
+  if (ext == "mp4")
+    return "video/mp4";
+  if (ext == "webm")
+    return "video/webm";
+
+  // Default binary
+  return "application/octet-stream";
+}
+
+void BuildWebResponseHead(WebServerResponseImpl *response,
+                          long long bodyLength, bool close, Buffer *out) {
+  AppendText(out, "HTTP/1.1 ");
+  AppendNumber(out, response->status);
+  AppendText(out, " ");
+  AppendText(out, GetWebStatusText(response->status));
+  AppendText(out, "\r\nServer: attoboy\r\n");
+  out->append(response->head);
+
+  if (!IsWebBodylessStatus(response->status)) {
+    if (!response->hasContentType && bodyLength > 0)
+      AppendText(out, "Content-Type: text/plain; charset=utf-8\r\n");
+    AppendText(out, "Content-Length: ");
+    AppendNumber(out, bodyLength);
+    AppendText(out, "\r\n");
+  }
+  if (close)
+    AppendText(out, "Connection: close\r\n");
+  AppendText(out, "\r\n");
+}
+
+//------------------------------------------------------------------------------
+// WebServerRequest
+//------------------------------------------------------------------------------
+
+WebServerRequest::WebServerRequest(WebServerRequestImpl *impl) : impl(impl) {}
+
+String WebServerRequest::getMethod() const {
+  if (!impl)
+    return String();
+  return String::FromCStr(impl->method, impl->methodLen);
+}
+
+String WebServerRequest::getPath() const {
+  if (!impl || impl->pathLen <= 0)
+    return String();
+
+  // Percent-decoding only ever shrinks the path.
+  const char *src = impl->target;
+  int len = impl->pathLen;
+  char *decoded = (char *)HeapAlloc(GetProcessHeap(), 0, len);
+  if (!decoded)
+    return String();
+  int out = 0;
+  for (int i = 0; i < len; i++) {
+    int hi = -1;
+    int lo = -1;
+    if (src[i] == '%' && i + 2 < len) {
+      hi = HexValue(src[i + 1]);
+      lo = HexValue(src[i + 2]);
+    }
+    if (hi >= 0 && lo >= 0) {
+      decoded[out++] = (char)(hi * 16 + lo);
+      i += 2;
+    } else {
+      decoded[out++] = src[i];
+    }
+  }
+  String result = String::FromCStr(decoded, out);
+  HeapFree(GetProcessHeap(), 0, decoded);
+  return result;
+}
+
+String WebServerRequest::getQuery() const {
+  if (!impl || impl->pathLen >= impl->targetLen)
+    return String();
+  return String::FromCStr(impl->target + impl->pathLen + 1,
+                          impl->targetLen - impl->pathLen - 1);
+}
+
+String WebServerRequest::getHeader(const String &name) const {
+  if (!impl)
+    return String();
+
+  const char *wanted = name.c_str();
+  int wantedLen = name.byteLength();
+  for (int i = 0; i < impl->headerCount; i++) {
+    const WebHeaderField &field = impl->headers[i];
+    if (NameEquals(field.name, field.nameLen, wanted, wantedLen))
+      return String::FromCStr(field.value, field.valueLen);
+  }
+  return String();
+}
+
+Map WebServerRequest::getHeaders() const {
+  Map headers;
+  if (!impl)
+    return headers;
+
+  for (int i = 0; i < impl->headerCount; i++) {
+    const WebHeaderField &field = impl->headers[i];
+    headers.put(String::FromCStr(field.name, field.nameLen),
+                String::FromCStr(field.value, field.valueLen));
+  }
+  return headers;
+}
+
+Buffer WebServerRequest::getBody() const {
+  if (!impl || !impl->source || impl->bodyLength <= 0)
+    return Buffer();
+  int start = impl->offset + impl->headLength;
+  return impl->source->slice(start, start + impl->bodyLength);
+}
+
+//------------------------------------------------------------------------------
+// WebServerResponse
+//------------------------------------------------------------------------------
+
+WebServerResponse::WebServerResponse(WebServerResponseImpl *impl)
+    : impl(impl) {}
+
+void WebServerResponse::setStatus(int statusCode) {
+  if (impl && statusCode >= 100 && statusCode <= 999)
+    impl->status = statusCode;
+}
+
+void WebServerResponse::setHeader(const String &name, const String &value) {
+  if (!impl)
+    return;
+
+  const char *n = name.c_str();
+  int nLen = name.byteLength();
+  if (nLen == 0 || NameEquals(n, nLen, "content-length", 14) ||
+      NameEquals(n, nLen, "connection", 10))
+    return;
+  // Reject values that would split the header.
+  const char *v = value.c_str();
+  int vLen = value.byteLength();
+  for (int i = 0; i < vLen; i++) {
+    if (v[i] == '\r' || v[i] == '\n')
+      return;
+  }
+  if (NameEquals(n, nLen, "content-type", 12))
+    impl->hasContentType = true;
+
+  AppendText(&impl->head, n, nLen);
+  AppendText(&impl->head, ": ", 2);
+  AppendText(&impl->head, v, vLen);
+  AppendText(&impl->head, "\r\n", 2);
+}
+
+void WebServerResponse::write(const String &str) {
+  if (impl && !str.isEmpty())
+    impl->body.append(str);
+}
+
+void WebServerResponse::write(const Buffer &buf) {
+  if (impl && !buf.isEmpty())
+    impl->body.append(buf);
+}
+
+bool WebServerResponse::sendFile(const Path &path) {
+  if (!impl || !path.isRegularFile())
+    return false;
+  long long size = path.getSize();
+  if (size < 0)
+    return false;
+
+  impl->body.clear();
+  impl->hasFile = true;
+  impl->filePath = path.toString();
+  impl->fileOffset = 0;
+  impl->fileLength = size;
+  setHeader("Accept-Ranges", "bytes");
+  if (!impl->hasContentType)
+    setHeader("Content-Type", GetWebContentType(path.getExtension()));
+
+  // Honor a single byte range on GET and HEAD. If-Range would need a
+  // validator the server does not send, so its presence means the full file.
+  const WebServerRequestImpl *request = impl->request;
+  if (!request || impl->status != 200)
+    return true;
+  bool getOrHead =
+      (request->methodLen == 3 && request->method[0] == 'G' &&
+       request->method[1] == 'E' && request->method[2] == 'T') ||
+      (request->methodLen == 4 && request->method[0] == 'H' &&
+       request->method[1] == 'E' && request->method[2] == 'A' &&
+       request->method[3] == 'D');
+  const WebHeaderField *range = nullptr;
+  for (int i = 0; i < request->headerCount; i++) {
+    const WebHeaderField &field = request->headers[i];
+    if (NameEquals(field.name, field.nameLen, "if-range", 8))
+      return true;
+    if (NameEquals(field.name, field.nameLen, "range", 5))
+      range = &field;
+  }
+  if (!getOrHead || !range)
+    return true;
+
+  long long start = 0;
+  long long end = 0;
+  int result = ParseWebRange(range->value, range->valueLen, size, &start, &end);
+  if (result == 0)
+    return true;
+
+  Buffer contentRange(64);
+  AppendText(&contentRange, "bytes ");
+  if (result < 0) {
+    impl->status = 416;
+    impl->hasFile = false;
+    AppendText(&contentRange, "*");
+  } else {
+    impl->status = 206;
+    impl->fileOffset = start;
+    impl->fileLength = end - start + 1;
+    AppendNumber(&contentRange, start);
+    AppendText(&contentRange, "-");
+    AppendNumber(&contentRange, end);
+  }
+  AppendText(&contentRange, "/");
+  AppendNumber(&contentRange, size);
+  setHeader("Content-Range", contentRange.toString());
+  return true;
+}
+
+} // namespace attoboy
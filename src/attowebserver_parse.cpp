@@ -0,0 +1,277 @@
+#include "attowebserver_internal.h"
+
+namespace attoboy {
+
+static bool EqualsIgnoreCase(const char *a, int aLen, const char *b) {
+  int i = 0;
+  for (; i < aLen && b[i]; i++) {
+    char x = a[i];
+    char y = b[i];
+    if (x >= 'A' && x <= 'Z')
+      x += 'a' - 'A';
+    if (y >= 'A' && y <= 'Z')
+      y += 'a' - 'A';
+    if (x != y)
+      return false;
+  }
+  return i == aLen && !b[i];
+}
+
+// Returns true if the comma-separated list holds token (case-insensitive).
+static bool ListHasToken(const char *value, int len, const char *token) {
+  int start = 0;
+  while (start < len) {
+    int end = start;
+    while (end < len && value[end] != ',')
+      end++;
+    int a = start;
+    int b = end;
+    while (a < b && (value[a] == ' ' || value[a] == '\t'))
+      a++;
+    while (b > a && (value[b - 1] == ' ' || value[b - 1] == '\t'))
+      b--;
+    if (EqualsIgnoreCase(value + a, b - a, token))
+      return true;
+    start = end + 1;
+  }
+  return false;
+}
+
+static bool IsTokenChar(unsigned char c) {
+  if (c >= 'a' && c <= 'z')
+    return true;
+  if (c >= 'A' && c <= 'Z')
+    return true;
+  if (c >= '0' && c <= '9')
+    return true;
+  switch (c) {
+  case '!':
+  case '#':
+  case '$':
+  case '%':
+  case '&':
+  case '\'':
+  case '*':
+  case '+':
+  case '-':
+  case '.':
+  case '^':
+  case '_':
+  case '`':
+  case '|':
+  case '~':
+    return true;
+  default:
+    return false;
+  }
+}
+
+static WebParseStatus FailWebRequest(WebServerRequestImpl *req, int status) {
+  req->errorStatus = status;
+  return WEB_PARSE_ERROR;
+}
+
+// Parses the request line. Returns 0 or the status to fail with.
+static int ParseRequestLine(const char *line, int len,
+                            WebServerRequestImpl *req) {
+  int pos = 0;
+  while (pos < len && IsTokenChar((unsigned char)line[pos]))
+    pos++;
+  if (pos == 0 || pos >= len || line[pos] != ' ')
+    return 400;
+  req->method = line;
+  req->methodLen = pos;
+
+  int targetStart = ++pos;
+  while (pos < len && line[pos] != ' ')
+    pos++;
+  if (pos == targetStart || pos >= len)
+    return 400;
+  req->target = line + targetStart;
+  req->targetLen = pos - targetStart;
+  if (req->target[0] != '/' &&
+      !(req->targetLen == 1 && req->target[0] == '*'))
+    return 400;
+  req->pathLen = req->targetLen;
+  for (int i = 0; i < req->targetLen; i++) {
+    unsigned char c = (unsigned char)req->target[i];
+    if (c <= ' ' || c == 0x7f)
+      return 400;
+    if (c == '?' && req->pathLen == req->targetLen)
+      req->pathLen = i;
+  }
+
+  const char *version = line + pos + 1;
+  int versionLen = len - pos - 1;
+  if (versionLen != 8 || version[0] != 'H' || version[1] != 'T' ||
+      version[2] != 'T' || version[3] != 'P' || version[4] != '/' ||
+      version[6] != '.' || version[7] < '0' || version[7] > '9')
+    return 400;
+  if (version[5] != '1')
+    return 505;
+  req->minorVersion = version[7] - '0';
+  return 0;
+}
+
+WebParseStatus ParseWebRequest(const unsigned char *data, int len,
+                               int *scanned, WebServerRequestImpl *req) {
+  static const unsigned char terminator[4] = {'\r', '\n', '\r', '\n'};
+  req->headLength = 0;
+  req->headerCount = 0;
+  req->bodyLength = 0;
+  req->errorStatus = 0;
+  req->expectContinue = false;
+
+  int from = *scanned > 3 ? *scanned - 3 : 0;
+  int found = FindBytes(data + from, len - from, terminator, 4);
+  if (found < 0) {
+    *scanned = len;
+    if (len > WEB_MAX_HEAD_BYTES)
+      return FailWebRequest(req, 431);
+    return WEB_PARSE_INCOMPLETE;
+  }
+  int headLength = from + found + 4;
+  *scanned = headLength - 4;
+  if (headLength > WEB_MAX_HEAD_BYTES)
+    return FailWebRequest(req, 431);
+
+  const char *head = (const char *)data;
+  int lineEnd = FindBytes(data, headLength, terminator, 2);
+  int status = ParseRequestLine(head, lineEnd, req);
+  if (status)
+    return FailWebRequest(req, status);
+
+  bool sawLength = false;
+  bool closeToken = false;
+  bool keepAliveToken = false;
+  int contentLength = 0;
+  int pos = lineEnd + 2;
+  while (pos < headLength - 2) {
+    int end = pos + FindBytes(data + pos, headLength - pos, terminator, 2);
+    int colon = pos;
+    while (colon < end && head[colon] != ':')
+      colon++;
+    if (colon == pos || colon == end)
+      return FailWebRequest(req, 400);
+    for (int i = pos; i < colon; i++) {
+      if (!IsTokenChar((unsigned char)head[i]))
+        return FailWebRequest(req, 400);
+    }
+    if (req->headerCount == WEB_MAX_HEADERS)
+      return FailWebRequest(req, 431);
+
+    int valueStart = colon + 1;
+    int valueEnd = end;
+    while (valueStart < valueEnd &&
+           (head[valueStart] == ' ' || head[valueStart] == '\t'))
+      valueStart++;
+    while (valueEnd > valueStart &&
+           (head[valueEnd - 1] == ' ' || head[valueEnd - 1] == '\t'))
+      valueEnd--;
+
+    WebHeaderField &field = req->headers[req->headerCount++];
+    field.name = head + pos;
+    field.nameLen = colon - pos;
+    field.value = head + valueStart;
+    field.valueLen = valueEnd - valueStart;
+
+    if (EqualsIgnoreCase(field.name, field.nameLen, "content-length")) {
+      if (field.valueLen == 0)
+        return FailWebRequest(req, 400);
+      // The limit is checked before each digit, so value stays in an int.
+      int value = 0;
+      for (int i = 0; i < field.valueLen; i++) {
+        char c = field.value[i];
+        if (c < '0' || c > '9')
+          return FailWebRequest(req, 400);
+        if (value > WEB_MAX_BODY_BYTES / 10)
+          return FailWebRequest(req, 413);
+        value = value * 10 + (c - '0');
+        if (value > WEB_MAX_BODY_BYTES)
+          return FailWebRequest(req, 413);
+      }
+      if (sawLength && value != contentLength)
+        return FailWebRequest(req, 400);
+      sawLength = true;
+      contentLength = value;
+    } else if (EqualsIgnoreCase(field.name, field.nameLen,
+                                "transfer-encoding")) {
+      if (!EqualsIgnoreCase(field.value, field.valueLen, "identity"))
+        return FailWebRequest(req, 501);
+    } else if (EqualsIgnoreCase(field.name, field.nameLen, "connection")) {
+      closeToken = closeToken ||
+                   ListHasToken(field.value, field.valueLen, "close");
+      keepAliveToken = keepAliveToken ||
+                       ListHasToken(field.value, field.valueLen, "keep-alive");
+    } else if (EqualsIgnoreCase(field.name, field.nameLen, "expect")) {
+      if (!EqualsIgnoreCase(field.value, field.valueLen, "100-continue"))
+        return FailWebRequest(req, 417);
+      req->expectContinue = true;
+    }
+    pos = end + 2;
+  }
+
+  req->headLength = headLength;
+  req->bodyLength = contentLength;
+  req->keepAlive = req->minorVersion >= 1 ? !closeToken : keepAliveToken;
+  if (len < headLength + contentLength)
+    return WEB_PARSE_INCOMPLETE;
+  return WEB_PARSE_DONE;
+}
+
+// Reads decimal digits from value[*pos, len). Returns -1 if there are none or
+// the number is implausibly large.
+static long long ParseRangeNumber(const char *value, int len, int *pos) {
+  long long number = 0;
+  int start = *pos;
+  while (*pos < len && value[*pos] >= '0' && value[*pos] <= '9') {
+    number = (long long)MulU64By32(number, 10) + (value[*pos] - '0');
+    if (number > (1LL << 53))
+      return -1;
+    (*pos)++;
+  }
+  return *pos > start ? number : -1;
+}
+
+int ParseWebRange(const char *value, int len, long long size, long long *start,
+                  long long *end) {
+  if (len < 7 || !EqualsIgnoreCase(value, 6, "bytes="))
+    return 0;
+  int pos = 6;
+  while (pos < len && value[pos] == ' ')
+    pos++;
+
+  long long first = -1;
+  long long last = -1;
+  if (pos < len && value[pos] == '-') {
+    // Suffix range: the final N bytes.
+    pos++;
+    long long suffix = ParseRangeNumber(value, len, &pos);
+    if (suffix < 0 || pos != len)
+      return 0;
+    if (suffix == 0 || size == 0)
+      return -1;
+    first = suffix < size ? size - suffix : 0;
+    last = size - 1;
+  } else {
+    first = ParseRangeNumber(value, len, &pos);
+    if (first < 0 || pos >= len || value[pos] != '-')
+      return 0;
+    pos++;
+    if (pos < len) {
+      last = ParseRangeNumber(value, len, &pos);
+      if (last < 0 || pos != len || last < first)
+        return 0;
+    }
+    if (first >= size)
+      return -1;
+    if (last < 0 || last >= size)
+      last = size - 1;
+  }
+
+  *start = first;
+  *end = last;
+  return 1;
+}
+
+} // namespace attoboy
@@ -0,0 +1,152 @@
+#include "test_framework.h"
+
+struct CallbackState {
+  volatile LONG calls;
+  volatile LONG bytes;
+};
+
+static void CountCompletion(AsyncResult &result, void *arg) {
+  CallbackState *state = (CallbackState *)arg;
+  InterlockedExchangeAdd(&state->bytes, result.getCount());
+  InterlockedIncrement(&state->calls);
+}
+
+static void WaitForCalls(CallbackState *state, int expected) {
+  for (int i = 0; i < 500 && state->calls < expected; i++)
+    Sleep(10);
+}
+
+void atto_main() {
+  EnableLoggingToFile("test_asyncresult_comprehensive.log", true);
+  Log("=== Comprehensive AsyncResult and Async File I/O Tests ===");
+
+  Path path("test_asyncresult_temp.txt");
+  path.deleteFile();
+
+  // readAsync() on a regular file
+  {
+    path.writeFromString(String("hello async world"));
+    File f(path);
+    AsyncResult result = f.readAsync(5);
+    REGISTER_TESTED(File_readAsync);
+    REGISTER_TESTED(AsyncResult_wait);
+    REGISTER_TESTED(AsyncResult_isDone);
+    REGISTER_TESTED(AsyncResult_succeeded);
+    REGISTER_TESTED(AsyncResult_getCount);
+    REGISTER_TESTED(AsyncResult_getBuffer);
+    ASSERT_TRUE(result.wait());
+    ASSERT_TRUE(result.isDone());
+    ASSERT_TRUE(result.succeeded());
+    ASSERT_EQ(result.getCount(), 5);
+    ASSERT_EQ(result.getBuffer().toString(), String("hello"));
+
+    AsyncResult rest = f.readAsync(100);
+    ASSERT_EQ(rest.getBuffer().toString(), String(" async world"));
+
+    AsyncResult atEnd = f.readAsync(100);
+    ASSERT_TRUE(atEnd.succeeded());
+    ASSERT_EQ(atEnd.getCount(), 0);
+    ASSERT_TRUE(atEnd.getBuffer().isEmpty());
+    f.close();
+    path.deleteFile();
+    Log("readAsync() on a file: passed");
+  }
+
+  // writeAsync() on a regular file, with a callback
+  {
+    CallbackState state = {0, 0};
+    File f(path);
+    Buffer data(String("written asynchronously"));
+    AsyncResult result = f.writeAsync(data, CountCompletion, &state);
+    REGISTER_TESTED(File_writeAsync);
+    ASSERT_TRUE(result.succeeded());
+    ASSERT_EQ(result.getCount(), data.length());
+    WaitForCalls(&state, 1);
+    ASSERT_EQ((int)state.calls, 1);
+    ASSERT_EQ((int)state.bytes, data.length());
+    f.close();
+    ASSERT_EQ(path.readToString(), String("written asynchronously"));
+    path.deleteFile();
+    Log("writeAsync() on a file: passed");
+  }
+
+  // Failures complete instead of blocking
+  {
+    File closed(path);
+    closed.close();
+    AsyncResult read = closed.readAsync(10);
+    ASSERT_TRUE(read.wait(5000));
+    ASSERT_FALSE(read.succeeded());
+    ASSERT_TRUE(read.getBuffer().isEmpty());
+
+    AsyncResult notServer = closed.acceptAsync();
+    ASSERT_FALSE(notServer.succeeded());
+    ASSERT_FALSE(notServer.getFile().isValid());
+
+    File f(path);
+    ASSERT_FALSE(f.readAsync(0).succeeded());
+    f.close();
+    path.deleteFile();
+    Log("failed operations: passed");
+  }
+
+  // AsyncResult(const AsyncResult&) and operator=
+  {
+    path.writeFromString(String("abc"));
+    File f(path);
+    AsyncResult a = f.readAsync(3);
+    AsyncResult b(a);
+    REGISTER_TESTED(AsyncResult_constructor_copy);
+    // Reads on one file share its position, so finish the first before
+    // starting another.
+    ASSERT_TRUE(a.wait(5000));
+    AsyncResult c = f.readAsync(1);
+    c = a;
+    REGISTER_TESTED(AsyncResult_operator_assign);
+    ASSERT_EQ(b.getBuffer().toString(), String("abc"));
+    ASSERT_EQ(c.getCount(), 3);
+    f.close();
+    path.deleteFile();
+    Log("copy and assignment: passed");
+  }
+
+  // acceptAsync(), readAsync() and writeAsync() on loopback sockets
+  {
+    const int port = 47931;
+    File server(port);
+    REGISTER_TESTED(File_acceptAsync);
+    REGISTER_TESTED(AsyncResult_getFile);
+    if (!server.isValid()) {
+      Log("acceptAsync(): skipped (port unavailable)");
+    } else {
+      const int clients = 32;
+      for (int i = 0; i < clients; i++) {
+        AsyncResult pending = server.acceptAsync();
+        File client(String("127.0.0.1"), port);
+        ASSERT_TRUE(client.isValid());
+        ASSERT_TRUE(pending.wait(5000));
+        File connection = pending.getFile();
+        ASSERT_TRUE(connection.isValid());
+        ASSERT_TRUE(connection.isSocket());
+
+        // Client sends; server reads asynchronously and echoes back.
+        client.write(String("ping ") + String(i));
+        AsyncResult request = connection.readAsync(64);
+        Buffer received = request.getBuffer();
+        ASSERT_EQ(received.toString(), String("ping ") + String(i));
+        ASSERT_TRUE(connection.writeAsync(received).succeeded());
+        ASSERT_EQ(client.readToString(64), String("ping ") + String(i));
+
+        connection.close();
+        client.close();
+      }
+      server.close();
+      Log("socket acceptAsync()/readAsync()/writeAsync(): passed");
+    }
+  }
+
+  Log("=== All AsyncResult Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_asyncresult_comprehensive");
+  Exit(0);
+}
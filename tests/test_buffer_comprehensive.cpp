@@ -178,6 +178,22 @@ void atto_main() {
     Log("slice(): passed");
   }
 
+  // slice() and copies keep their bytes when the source changes
+  {
+    Buffer b;
+    b.append(String("hello world"));
+    Buffer sliced = b.slice(6, 11);
+    Buffer copy(b);
+    b.clear();
+    b.append(String("HELLO WORLD"));
+    ASSERT_EQ(sliced.toString(), String("world"));
+    ASSERT_EQ(copy.toString(), String("hello world"));
+    sliced.append(String("!"));
+    ASSERT_EQ(sliced.toString(), String("world!"));
+    ASSERT_EQ(copy.toString(), String("hello world"));
+    Log("slice() sharing: passed");
+  }
+
   // remove()
   {
     Buffer b;
@@ -237,6 +253,51 @@ void atto_main() {
     Log("compare(): passed");
   }
 
+  // hash64()
+  {
+    Buffer empty;
+    Buffer abc(String("abc"));
+    REGISTER_TESTED(Buffer_hash64);
+    ASSERT_EQ(empty.hash64(), (long long)0xEF46DB3751D8E999ULL);
+    ASSERT_EQ(abc.hash64(), (long long)0x44BC2CF5AD770999ULL);
+    ASSERT_EQ(abc.hash64(), Buffer(String("abc")).hash64());
+    ASSERT_NE(abc.hash64(), Buffer(String("abd")).hash64());
+    Log("hash64(): passed");
+  }
+
+  // crc32c()
+  {
+    Buffer b(String("123456789"));
+    REGISTER_TESTED(Buffer_crc32c);
+    ASSERT_EQ(b.crc32c(), (int)0xE3069283u);
+    ASSERT_EQ(Buffer().crc32c(), 0);
+    Log("crc32c(): passed");
+  }
+
+  // sha256()
+  {
+    Buffer digest = Buffer(String("abc")).sha256();
+    REGISTER_TESTED(Buffer_sha256);
+    ASSERT_EQ(digest.length(), 32);
+    int len = 0;
+    const unsigned char *p = digest.c_ptr(&len);
+    ASSERT_EQ(p[0], 0xba);
+    ASSERT_EQ(p[31], 0xad);
+    Log("sha256(): passed");
+  }
+
+  // blake2s()
+  {
+    Buffer digest = Buffer(String("abc")).blake2s();
+    REGISTER_TESTED(Buffer_blake2s);
+    ASSERT_EQ(digest.length(), 32);
+    int len = 0;
+    const unsigned char *p = digest.c_ptr(&len);
+    ASSERT_EQ(p[0], 0x50);
+    ASSERT_EQ(p[31], 0x82);
+    Log("blake2s(): passed");
+  }
+
   // operator==
   {
     Buffer b1;
@@ -285,6 +346,63 @@ void atto_main() {
     Log("decompress(): passed");
   }
 
+  // compress()/decompress() with gzip and deflate
+  {
+    Buffer original;
+    for (int i = 0; i < 2000; i++)
+      original.append(String("line ") + String(i % 37) + "\n");
+    Buffer gzip = original.compress(COMPRESSION_GZIP);
+    ASSERT_TRUE(gzip.length() < original.length());
+    int len = 0;
+    const unsigned char *bytes = gzip.c_ptr(&len);
+    ASSERT_TRUE(len > 18 && bytes[0] == 0x1f && bytes[1] == 0x8b);
+    ASSERT_TRUE(gzip.decompress(COMPRESSION_GZIP).compare(original));
+
+    Buffer deflate = original.compress(COMPRESSION_DEFLATE);
+    ASSERT_TRUE(deflate.decompress(COMPRESSION_DEFLATE).compare(original));
+
+    // zlib.compress(b"a") from another implementation.
+    const unsigned char zlibA[] = {0x78, 0x9c, 0x4b, 0x04, 0x00,
+                                   0x00, 0x62, 0x00, 0x62};
+    Buffer decoded =
+        Buffer(zlibA, sizeof(zlibA)).decompress(COMPRESSION_DEFLATE);
+    ASSERT_TRUE(decoded.compare(Buffer(String("a"))));
+
+    // zlib.compress(data, 9) from another implementation, where data[i] is
+    // 'a' + (i * i + i / 3) % 11 for i < 200: one dynamic-Huffman block
+    // with length/distance pairs.
+    const unsigned char zlibDynamic[] = {
+        0x78, 0xda, 0xd5, 0xca, 0xc1, 0x11, 0x00, 0x30, 0x08, 0x02, 0xb0,
+        0x59, 0x41, 0x51, 0x38, 0xf7, 0xff, 0x77, 0x8e, 0xe6, 0x1d, 0x50,
+        0xb7, 0x1a, 0xc3, 0xea, 0x49, 0x5d, 0x02, 0x5d, 0x1c, 0x6e, 0x91,
+        0x9d, 0x06, 0xfe, 0x08, 0x0f, 0x32, 0xc6, 0x4f, 0x66};
+    unsigned char expected[200];
+    for (int i = 0; i < 200; i++)
+      expected[i] = (unsigned char)('a' + (i * i + i / 3) % 11);
+    decoded = Buffer(zlibDynamic, sizeof(zlibDynamic))
+                  .decompress(COMPRESSION_DEFLATE);
+    ASSERT_TRUE(decoded.compare(Buffer(expected, sizeof(expected))));
+
+    // gzip.compress(b"hello, ") + gzip.compress(b"world\n"): two members
+    // decode as one stream.
+    const unsigned char gzipMembers[] = {
+        0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xcb,
+        0x48, 0xcd, 0xc9, 0xc9, 0xd7, 0x51, 0x00, 0x00, 0x99, 0x56, 0xea,
+        0x11, 0x07, 0x00, 0x00, 0x00, 0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x02, 0x03, 0x2b, 0xcf, 0x2f, 0xca, 0x49, 0xe1, 0x02,
+        0x00, 0xa8, 0x61, 0x38, 0xdd, 0x06, 0x00, 0x00, 0x00};
+    decoded =
+        Buffer(gzipMembers, sizeof(gzipMembers)).decompress(COMPRESSION_GZIP);
+    ASSERT_TRUE(decoded.compare(Buffer(String("hello, world\n"))));
+
+    // Truncated or corrupt input yields an empty buffer.
+    ASSERT_TRUE(gzip.slice(0, gzip.length() - 4)
+                    .decompress(COMPRESSION_GZIP)
+                    .isEmpty());
+    ASSERT_TRUE(original.decompress(COMPRESSION_GZIP).isEmpty());
+    Log("compress()/decompress() gzip and deflate: passed");
+  }
+
   // ========== ENCRYPTION ==========
 
   // crypt(String, String)
@@ -365,6 +483,52 @@ void atto_main() {
     Log("fromBase64(): passed");
   }
 
+  // toBase64() - RFC 4648 test vectors
+  {
+    ASSERT_EQ(Buffer(String("f")).toBase64(), String("Zg=="));
+    ASSERT_EQ(Buffer(String("fo")).toBase64(), String("Zm8="));
+    ASSERT_EQ(Buffer(String("foo")).toBase64(), String("Zm9v"));
+    ASSERT_EQ(Buffer(String("foob")).toBase64(), String("Zm9vYg=="));
+    ASSERT_EQ(Buffer(String("fooba")).toBase64(), String("Zm9vYmE="));
+    ASSERT_EQ(Buffer(String("foobar")).toBase64(), String("Zm9vYmFy"));
+    Log("toBase64() test vectors: passed");
+  }
+
+  // toBase64(urlSafe, pad)
+  {
+    unsigned char raw[] = {0xfb, 0xff, 0xbf, 0xfe};
+    Buffer b(raw, 4);
+    ASSERT_EQ(b.toBase64(), String("+/+//g=="));
+    ASSERT_EQ(b.toBase64(true), String("-_-__g=="));
+    ASSERT_EQ(b.toBase64(true, false), String("-_-__g"));
+    ASSERT_TRUE(Buffer::fromBase64(String("-_-__g")).compare(b));
+    ASSERT_TRUE(Buffer::fromBase64(String("+/+//g")).compare(b));
+    REGISTER_TESTED(Buffer_toBase64_variants);
+    Log("toBase64(urlSafe, pad): passed");
+  }
+
+  // toBase64()/fromBase64() - round trip across vectorized block sizes
+  {
+    for (int len = 0; len < 200; len++) {
+      Buffer b;
+      for (int i = 0; i < len; i++) {
+        unsigned char byte = (unsigned char)(i * 37 + len);
+        b.append(&byte, 1);
+      }
+      ASSERT_TRUE(Buffer::fromBase64(b.toBase64()).compare(b));
+      ASSERT_TRUE(Buffer::fromBase64(b.toBase64(true, false)).compare(b));
+    }
+    Log("Base64 round trip (0-199 bytes): passed");
+  }
+
+  // fromBase64() - whitespace and line breaks are skipped
+  {
+    String wrapped("  Zm9v\r\nYmFy\n");
+    Buffer decoded = Buffer::fromBase64(wrapped);
+    ASSERT_TRUE(decoded.compare(Buffer(String("foobar"))));
+    Log("fromBase64() with whitespace: passed");
+  }
+
   // toString()
   {
     Buffer b;
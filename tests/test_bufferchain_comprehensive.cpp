@@ -0,0 +1,187 @@
+#include "test_framework.h"
+
+void atto_main() {
+  EnableLoggingToFile("test_bufferchain_comprehensive.log", true);
+  Log("=== Comprehensive BufferChain Class Tests ===");
+
+  // BufferChain()
+  {
+    BufferChain chain;
+    REGISTER_TESTED(BufferChain_constructor_empty);
+    REGISTER_TESTED(BufferChain_length);
+    REGISTER_TESTED(BufferChain_isEmpty);
+    REGISTER_TESTED(BufferChain_segmentCount);
+    ASSERT_EQ(chain.length(), 0);
+    ASSERT_TRUE(chain.isEmpty());
+    ASSERT_EQ(chain.segmentCount(), 0);
+    int len = -1;
+    ASSERT(chain.c_ptr(&len) == nullptr);
+    ASSERT_EQ(len, 0);
+    Log("BufferChain(): passed");
+  }
+
+  // BufferChain(const Buffer&)
+  {
+    BufferChain chain(Buffer(String("body")));
+    REGISTER_TESTED(BufferChain_constructor_buffer);
+    ASSERT_EQ(chain.length(), 4);
+    ASSERT_EQ(chain.segmentCount(), 1);
+    Log("BufferChain(Buffer): passed");
+  }
+
+  // append() and prepend() keep segments separate
+  {
+    Buffer body(String("<html></html>"));
+    BufferChain chain(body);
+    chain.prepend(String("\r\n"));
+    chain.prepend(Buffer(String("Content-Length: 13")));
+    chain.prepend(String("HTTP/1.1 200 OK\r\n"));
+    chain.append(String("\r\n"));
+    REGISTER_TESTED(BufferChain_append_buffer);
+    REGISTER_TESTED(BufferChain_append_string);
+    REGISTER_TESTED(BufferChain_prepend_buffer);
+    REGISTER_TESTED(BufferChain_prepend_string);
+    ASSERT_EQ(chain.segmentCount(), 5);
+    ASSERT_EQ(chain.length(), 17 + 18 + 2 + 13 + 2);
+
+    REGISTER_TESTED(BufferChain_toBuffer);
+    ASSERT_EQ(chain.toBuffer().toString(),
+              String("HTTP/1.1 200 OK\r\nContent-Length: 13\r\n<html></html>"
+                     "\r\n"));
+    ASSERT_EQ(chain.segmentCount(), 1);
+    Log("append/prepend: passed");
+  }
+
+  // Many prepends and appends
+  {
+    BufferChain chain;
+    for (int i = 0; i < 100; i++) {
+      chain.prepend(String("a"));
+      chain.append(String("b"));
+    }
+    ASSERT_EQ(chain.segmentCount(), 200);
+    String joined = chain.toBuffer().toString();
+    ASSERT_EQ(joined.length(), 200);
+    ASSERT_TRUE(joined.startsWith(String("aaaa")));
+    ASSERT_TRUE(joined.endsWith(String("bbbb")));
+    ASSERT_EQ(joined.substring(99, 101), String("ab"));
+    Log("repeated prepend/append: passed");
+  }
+
+  // Segments share bytes with the source buffer
+  {
+    Buffer source(String("shared"));
+    BufferChain chain(source);
+    source.clear();
+    source.append(String("changed"));
+    ASSERT_EQ(chain.toBuffer().toString(), String("shared"));
+    Log("segment sharing: passed");
+  }
+
+  // append(const BufferChain&)
+  {
+    BufferChain a(Buffer(String("one")));
+    BufferChain b(Buffer(String("two")));
+    b.append(String("three"));
+    a.append(b);
+    REGISTER_TESTED(BufferChain_append_chain);
+    ASSERT_EQ(a.segmentCount(), 3);
+    ASSERT_EQ(a.toBuffer().toString(), String("onetwothree"));
+    a.append(a);
+    ASSERT_EQ(a.toBuffer().toString(), String("onetwothreeonetwothree"));
+    Log("append(BufferChain): passed");
+  }
+
+  // insert() - at a boundary and inside a segment
+  {
+    BufferChain chain(Buffer(String("hello")));
+    chain.append(String("world"));
+    chain.insert(5, String(", "));
+    REGISTER_TESTED(BufferChain_insert_string);
+    ASSERT_EQ(chain.segmentCount(), 3);
+    chain.insert(2, Buffer(String("--")));
+    REGISTER_TESTED(BufferChain_insert_buffer);
+    ASSERT_EQ(chain.segmentCount(), 5);
+    ASSERT_EQ(chain.toBuffer().toString(), String("he--llo, world"));
+    chain.insert(0, String("<"));
+    chain.insert(100, String(">"));
+    ASSERT_EQ(chain.toBuffer().toString(), String("<he--llo, world>"));
+    Log("insert(): passed");
+  }
+
+  // segmentAt()
+  {
+    BufferChain chain(Buffer(String("ab")));
+    chain.append(String("cd"));
+    REGISTER_TESTED(BufferChain_segmentAt);
+    ASSERT_EQ(chain.segmentAt(1).toString(), String("cd"));
+    ASSERT_TRUE(chain.segmentAt(2).isEmpty());
+    ASSERT_TRUE(chain.segmentAt(-1).isEmpty());
+    Log("segmentAt(): passed");
+  }
+
+  // c_ptr()
+  {
+    BufferChain chain(Buffer(String("abc")));
+    chain.append(String("def"));
+    int len = 0;
+    const unsigned char *data = chain.c_ptr(&len);
+    REGISTER_TESTED(BufferChain_c_ptr);
+    ASSERT_EQ(len, 6);
+    ASSERT_EQ(String::FromCStr((const char *)data, len), String("abcdef"));
+    ASSERT_EQ(chain.segmentCount(), 1);
+    Log("c_ptr(): passed");
+  }
+
+  // BufferChain(const BufferChain&), operator=, clear()
+  {
+    BufferChain a(Buffer(String("x")));
+    a.append(String("y"));
+    BufferChain b(a);
+    REGISTER_TESTED(BufferChain_constructor_copy);
+    a.append(String("z"));
+    ASSERT_EQ(b.toBuffer().toString(), String("xy"));
+
+    BufferChain c;
+    c = a;
+    REGISTER_TESTED(BufferChain_operator_assign);
+    ASSERT_EQ(c.toBuffer().toString(), String("xyz"));
+
+    c.clear();
+    REGISTER_TESTED(BufferChain_clear);
+    ASSERT_TRUE(c.isEmpty());
+    ASSERT_EQ(a.length(), 3);
+    Log("copy/assign/clear: passed");
+  }
+
+  // File::write(const BufferChain&)
+  {
+    Path path("test_bufferchain_temp.txt");
+    path.deleteFile();
+
+    Buffer body;
+    for (int i = 0; i < 5000; i++)
+      body.append(String("0123456789"));
+    BufferChain chain(body);
+    chain.prepend(String("header\n"));
+    chain.append(String("\nfooter"));
+
+    {
+      File f(path);
+      ASSERT_EQ(f.write(chain), chain.length());
+      REGISTER_TESTED(File_write_chain);
+      f.close();
+    }
+    ASSERT_EQ(chain.segmentCount(), 3);
+
+    Buffer written = path.readToBuffer();
+    ASSERT_TRUE(written.compare(chain.toBuffer()));
+    path.deleteFile();
+    Log("File::write(BufferChain): passed");
+  }
+
+  Log("=== All BufferChain Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_bufferchain_comprehensive");
+  Exit(0);
+}
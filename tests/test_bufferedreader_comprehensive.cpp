@@ -0,0 +1,203 @@
+#include "test_framework.h"
+
+static bool CountLine(const char *line, int length, void *arg) {
+  int *totals = (int *)arg;
+  totals[0]++;
+  totals[1] += length;
+  return true;
+}
+
+static bool StopAfterTwo(const char *line, int length, void *arg) {
+  int *seen = (int *)arg;
+  (*seen)++;
+  return *seen < 2;
+}
+
+static void *WriteLater(void *arg) {
+  Sleep(100);
+  ((File *)arg)->write(String("late line\n"));
+  return nullptr;
+}
+
+void atto_main() {
+  EnableLoggingToFile("test_bufferedreader_comprehensive.log", true);
+  Log("=== Comprehensive BufferedReader Class Tests ===");
+
+  Path path("test_bufferedreader_temp.txt");
+  path.deleteFile();
+
+  // readLine() - LF, CRLF, empty lines and a last line without an ending
+  {
+    path.writeFromString(String("first\nsecond\r\n\nlast"));
+    File f(path);
+    BufferedReader reader(f);
+    REGISTER_TESTED(BufferedReader_constructor_file);
+    REGISTER_TESTED(BufferedReader_readLine);
+    REGISTER_TESTED(BufferedReader_isAtEnd);
+    ASSERT_FALSE(reader.isAtEnd());
+    ASSERT_EQ(reader.readLine(), String("first"));
+    ASSERT_EQ(reader.readLine(), String("second"));
+    ASSERT_EQ(reader.readLine(), String(""));
+    ASSERT_FALSE(reader.isAtEnd());
+    ASSERT_EQ(reader.readLine(), String("last"));
+    ASSERT_TRUE(reader.isAtEnd());
+    ASSERT_EQ(reader.readLine(), String(""));
+    f.close();
+    Log("readLine(): passed");
+  }
+
+  // readLine() - lines longer than the buffer and many refills
+  {
+    String longLine = String("x").repeat(10000);
+    String content;
+    for (int i = 0; i < 50; i++)
+      content = content + String(i) + String("\n");
+    content = content + longLine + String("\nafter\n");
+    path.writeFromString(content);
+
+    File f(path);
+    BufferedReader reader(f, 4096);
+    for (int i = 0; i < 50; i++)
+      ASSERT_EQ(reader.readLine(), String(i));
+    ASSERT_EQ(reader.readLine(), longLine);
+    ASSERT_EQ(reader.readLine(), String("after"));
+    ASSERT_TRUE(reader.isAtEnd());
+    f.close();
+    Log("readLine() long lines: passed");
+  }
+
+  // readUntil() - multi-byte delimiter, including one split across refills
+  {
+    String content;
+    for (int i = 0; i < 2000; i++)
+      content = content + String("record") + String(i) + String("||");
+    content = content + String("tail");
+    path.writeFromString(content);
+
+    File f(path);
+    BufferedReader reader(f, 4096);
+    REGISTER_TESTED(BufferedReader_readUntil);
+    for (int i = 0; i < 2000; i++)
+      ASSERT_EQ(reader.readUntil(String("||")), String("record", i));
+    ASSERT_EQ(reader.readUntil(String("||")), String("tail"));
+    ASSERT_TRUE(reader.isAtEnd());
+    f.close();
+    Log("readUntil(): passed");
+  }
+
+  // readExact() - small reads mixed with lines, and a read larger than the
+  // buffer
+  {
+    Buffer data;
+    data.append(String("HEAD\n"));
+    for (int i = 0; i < 20000; i++) {
+      unsigned char byte = (unsigned char)(i * 17);
+      data.append(&byte, 1);
+    }
+    path.writeFromBuffer(data);
+
+    File f(path);
+    BufferedReader reader(f, 4096);
+    REGISTER_TESTED(BufferedReader_readExact);
+    REGISTER_TESTED(BufferedReader_bufferedCount);
+    ASSERT_EQ(reader.readLine(), String("HEAD"));
+    ASSERT(reader.bufferedCount() > 0);
+    Buffer small = reader.readExact(10);
+    ASSERT_TRUE(small.compare(data.slice(5, 15)));
+    Buffer big = reader.readExact(15000);
+    ASSERT_TRUE(big.compare(data.slice(15, 15015)));
+    Buffer rest = reader.readExact(100000);
+    ASSERT_EQ(rest.length(), 20005 - 15015);
+    ASSERT_TRUE(rest.compare(data.slice(15015, 20005)));
+    ASSERT_TRUE(reader.isAtEnd());
+    ASSERT_TRUE(reader.readExact(5).isEmpty());
+    f.close();
+    Log("readExact(): passed");
+  }
+
+  // forEachLine()
+  {
+    String content;
+    for (int i = 0; i < 1000; i++)
+      content = content + String("line ") + String(i) + String("\r\n");
+    path.writeFromString(content);
+
+    File f(path);
+    BufferedReader reader(f, 4096);
+    int totals[2] = {0, 0};
+    int lines = reader.forEachLine(CountLine, totals);
+    REGISTER_TESTED(BufferedReader_forEachLine);
+    ASSERT_EQ(lines, 1000);
+    ASSERT_EQ(totals[0], 1000);
+    ASSERT_EQ(totals[1], content.byteLength() - 1000 * 2);
+    f.close();
+
+    File f2(path);
+    BufferedReader stopping(f2);
+    int seen = 0;
+    ASSERT_EQ(stopping.forEachLine(StopAfterTwo, &seen), 2);
+    ASSERT_EQ(stopping.readLine(), String("line 2"));
+    f2.close();
+    Log("forEachLine(): passed");
+  }
+
+  // BufferedReader(const BufferedReader&) and operator= share the position
+  {
+    path.writeFromString(String("a\nb\nc\n"));
+    File f(path);
+    BufferedReader a(f);
+    ASSERT_EQ(a.readLine(), String("a"));
+    BufferedReader b(a);
+    REGISTER_TESTED(BufferedReader_constructor_copy);
+    ASSERT_EQ(b.readLine(), String("b"));
+    BufferedReader c(f);
+    c = a;
+    REGISTER_TESTED(BufferedReader_operator_assign);
+    ASSERT_EQ(c.readLine(), String("c"));
+    ASSERT_TRUE(a.isAtEnd());
+    f.close();
+    Log("copy and assignment: passed");
+  }
+
+  // BufferedReader(const Subprocess&)
+  {
+    Path cmd("C:\\Windows\\System32\\cmd.exe");
+    Subprocess proc(cmd, "/c", "echo one&& echo two");
+    BufferedReader reader(proc);
+    REGISTER_TESTED(BufferedReader_constructor_subprocess);
+    ASSERT_EQ(reader.readLine().trim(), String("one"));
+    ASSERT_EQ(reader.readLine().trim(), String("two"));
+    ASSERT_TRUE(reader.isAtEnd());
+    proc.wait();
+    Log("BufferedReader(Subprocess): passed");
+  }
+
+  // A non-blocking socket waits for data instead of ending the stream
+  {
+    const int port = 47933;
+    File server(port);
+    if (!server.isValid()) {
+      Log("non-blocking socket: skipped (port unavailable)");
+    } else {
+      File client(String("127.0.0.1"), port);
+      File connection = server.accept();
+      ASSERT_TRUE(connection.setNonBlocking(true));
+      Thread writer(WriteLater, &client);
+      BufferedReader reader(connection);
+      ASSERT_EQ(reader.readLine(), String("late line"));
+      writer.await();
+      client.close();
+      ASSERT_TRUE(reader.readLine().isEmpty());
+      ASSERT_TRUE(reader.isAtEnd());
+      server.close();
+      Log("non-blocking socket: passed");
+    }
+  }
+
+  path.deleteFile();
+
+  Log("=== All BufferedReader Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_bufferedreader_comprehensive");
+  Exit(0);
+}
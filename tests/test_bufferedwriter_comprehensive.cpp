@@ -0,0 +1,157 @@
+#include "test_framework.h"
+
+void atto_main() {
+  EnableLoggingToFile("test_bufferedwriter_comprehensive.log", true);
+  Log("=== Comprehensive BufferedWriter Class Tests ===");
+
+  Path path("test_bufferedwriter_temp.txt");
+  path.deleteFile();
+
+  // write(String) - bytes stay buffered until flush()
+  {
+    File f(path);
+    {
+      BufferedWriter writer(f, 4096);
+      REGISTER_TESTED(BufferedWriter_constructor);
+      REGISTER_TESTED(BufferedWriter_write_string);
+      REGISTER_TESTED(BufferedWriter_bufferedCount);
+      REGISTER_TESTED(BufferedWriter_flush);
+      ASSERT_EQ(writer.write(String("alpha,")), 6);
+      ASSERT_EQ(writer.write(String("beta\n")), 5);
+      ASSERT_EQ(writer.bufferedCount(), 11);
+      ASSERT_TRUE(writer.flush());
+      ASSERT_EQ(writer.bufferedCount(), 0);
+      ASSERT_EQ(writer.write(String("")), 0);
+    }
+    f.close();
+    ASSERT_EQ(path.readToString(), String("alpha,beta\n"));
+    path.deleteFile();
+    Log("write(String)/flush(): passed");
+  }
+
+  // Flushes at the threshold; destruction flushes the rest
+  {
+    String expected;
+    File f(path);
+    {
+      BufferedWriter writer(f, 4096);
+      REGISTER_TESTED(BufferedWriter_destructor);
+      for (int i = 0; i < 2000; i++) {
+        String row = String(i) + String(",row,") + String(i * 7) + "\n";
+        expected = expected + row;
+        writer.write(row);
+        ASSERT(writer.bufferedCount() < 4096);
+      }
+      ASSERT(writer.bufferedCount() > 0);
+    }
+    f.close();
+    ASSERT_EQ(path.readToString(), expected);
+    path.deleteFile();
+    Log("threshold and destructor flush: passed");
+  }
+
+  // write(Buffer), write(ptr, size) - including writes larger than the buffer
+  {
+    Buffer big(20000);
+    for (int i = 0; i < 20000; i++) {
+      unsigned char b = (unsigned char)(i % 251);
+      big.append(&b, 1);
+    }
+    const unsigned char head[] = {'H', 'D', 'R'};
+
+    File f(path);
+    {
+      BufferedWriter writer(f, 4096);
+      REGISTER_TESTED(BufferedWriter_write_buffer);
+      REGISTER_TESTED(BufferedWriter_write_ptr);
+      ASSERT_EQ(writer.write(big), 20000);
+      ASSERT_EQ(writer.write(head, 3), 3);
+      ASSERT_EQ(writer.write(big), 20000);
+      ASSERT_EQ(writer.write(head, 0), 0);
+      ASSERT_EQ(writer.write(nullptr, 5), 0);
+      ASSERT_TRUE(writer.flush());
+    }
+    f.close();
+
+    Buffer expected = big + Buffer(head, 3) + big;
+    ASSERT_TRUE(path.readToBuffer().compare(expected));
+    path.deleteFile();
+    Log("write(Buffer)/write(ptr): passed");
+  }
+
+  // Background mode - many small writes, ordered output
+  {
+    String expected;
+    File f(path);
+    {
+      BufferedWriter writer(f, 4096, true);
+      REGISTER_TESTED(BufferedWriter_isBackground);
+      ASSERT_TRUE(writer.isBackground());
+      for (int i = 0; i < 20000; i++) {
+        String row = String("line ") + String(i) + "\n";
+        expected = expected + row;
+        ASSERT_EQ(writer.write(row), row.byteLength());
+      }
+      ASSERT_TRUE(writer.flush());
+      ASSERT_EQ(writer.bufferedCount(), 0);
+      writer.write(String("tail\n"));
+      expected = expected + "tail\n";
+    }
+    f.close();
+    ASSERT_EQ(path.readToString(), expected);
+    path.deleteFile();
+
+    File g(path);
+    BufferedWriter foreground(g);
+    ASSERT_FALSE(foreground.isBackground());
+    g.close();
+    path.deleteFile();
+    Log("background mode: passed");
+  }
+
+  // BufferedWriter(const BufferedWriter&) and operator= share one buffer
+  {
+    File f(path);
+    {
+      BufferedWriter a(f);
+      BufferedWriter b(a);
+      REGISTER_TESTED(BufferedWriter_constructor_copy);
+      a.write(String("a"));
+      b.write(String("b"));
+      ASSERT_EQ(a.bufferedCount(), 2);
+
+      File other(Path("test_bufferedwriter_other.txt"));
+      BufferedWriter c(other);
+      c = a;
+      REGISTER_TESTED(BufferedWriter_operator_assign);
+      c.write(String("c"));
+      ASSERT_EQ(b.bufferedCount(), 3);
+      other.close();
+      Path("test_bufferedwriter_other.txt").deleteFile();
+    }
+    f.close();
+    ASSERT_EQ(path.readToString(), String("abc"));
+    path.deleteFile();
+    Log("copy and assignment: passed");
+  }
+
+  // failed() - writes to a closed file are reported on flush and rejected
+  {
+    File f(path);
+    BufferedWriter writer(f);
+    REGISTER_TESTED(BufferedWriter_failed);
+    ASSERT_FALSE(writer.failed());
+    f.close();
+    ASSERT_EQ(writer.write(String("lost")), 4);
+    ASSERT_FALSE(writer.flush());
+    ASSERT_TRUE(writer.failed());
+    ASSERT_EQ(writer.write(String("more")), -1);
+    path.deleteFile();
+    Log("failed(): passed");
+  }
+
+  Log("=== All BufferedWriter Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_bufferedwriter_comprehensive");
+  Exit(0);
+}
@@ -0,0 +1,164 @@
+#include "test_framework.h"
+
+void atto_main() {
+  EnableLoggingToFile("test_bufferview_comprehensive.log", true);
+  Log("=== Comprehensive BufferView Class Tests ===");
+
+  const unsigned char bytes[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+                                 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C};
+
+  // BufferView(const Buffer&)
+  {
+    BufferView view(Buffer(bytes, 12));
+    REGISTER_TESTED(BufferView_constructor);
+    REGISTER_TESTED(BufferView_length);
+    REGISTER_TESTED(BufferView_getPosition);
+    REGISTER_TESTED(BufferView_remaining);
+    REGISTER_TESTED(BufferView_isAtEnd);
+    REGISTER_TESTED(BufferView_failed);
+    ASSERT_EQ(view.length(), 12);
+    ASSERT_EQ(view.getPosition(), 0);
+    ASSERT_EQ(view.remaining(), 12);
+    ASSERT_FALSE(view.isAtEnd());
+    ASSERT_FALSE(view.failed());
+
+    BufferView empty{Buffer()};
+    ASSERT_EQ(empty.length(), 0);
+    ASSERT_TRUE(empty.isAtEnd());
+    Log("BufferView(Buffer): passed");
+  }
+
+  // readU8(), readU16LE(), readU16BE()
+  {
+    BufferView view(Buffer(bytes, 12));
+    REGISTER_TESTED(BufferView_readU8);
+    REGISTER_TESTED(BufferView_readU16LE);
+    REGISTER_TESTED(BufferView_readU16BE);
+    ASSERT_EQ(view.readU8(), 0x01);
+    ASSERT_EQ(view.readU16LE(), 0x0302);
+    ASSERT_EQ(view.readU16BE(), 0x0405);
+    ASSERT_EQ(view.getPosition(), 5);
+
+    const unsigned char high[] = {0xFF, 0xFE};
+    BufferView unsignedView(Buffer(high, 2));
+    ASSERT_EQ(unsignedView.readU16LE(), 0xFEFF);
+    Log("readU8/readU16: passed");
+  }
+
+  // readU32LE(), readU32BE()
+  {
+    BufferView view(Buffer(bytes, 12));
+    REGISTER_TESTED(BufferView_readU32LE);
+    REGISTER_TESTED(BufferView_readU32BE);
+    ASSERT_EQ((int)view.readU32LE(), 0x04030201);
+    ASSERT_EQ((int)view.readU32BE(), 0x05060708);
+    Log("readU32: passed");
+  }
+
+  // readU64LE(), readU64BE()
+  {
+    BufferView view(Buffer(bytes, 12));
+    REGISTER_TESTED(BufferView_readU64LE);
+    ASSERT_EQ(view.readU64LE(), 0x0807060504030201LL);
+
+    BufferView beView(Buffer(bytes, 12));
+    REGISTER_TESTED(BufferView_readU64BE);
+    ASSERT_EQ(beView.readU64BE(), 0x0102030405060708LL);
+    Log("readU64: passed");
+  }
+
+  // readF32LE()
+  {
+    const unsigned char oneAndHalf[] = {0x00, 0x00, 0xC0, 0x3F};
+    BufferView view(Buffer(oneAndHalf, 4));
+    REGISTER_TESTED(BufferView_readF32LE);
+    ASSERT_EQ(view.readF32LE(), 1.5f);
+    ASSERT_TRUE(view.isAtEnd());
+    Log("readF32LE(): passed");
+  }
+
+  // Reading past the end
+  {
+    BufferView view(Buffer(bytes, 3));
+    ASSERT_EQ(view.readU16BE(), 0x0102);
+    ASSERT_EQ((int)view.readU32LE(), 0);
+    ASSERT_TRUE(view.failed());
+    ASSERT_EQ(view.getPosition(), 2);
+    ASSERT_EQ(view.readU8(), 0x03);
+    ASSERT_TRUE(view.failed());
+    Log("read past end: passed");
+  }
+
+  // setPosition(), skip()
+  {
+    BufferView view(Buffer(bytes, 12));
+    REGISTER_TESTED(BufferView_setPosition);
+    REGISTER_TESTED(BufferView_skip);
+    ASSERT_TRUE(view.setPosition(10));
+    ASSERT_EQ(view.readU8(), 0x0B);
+    ASSERT_FALSE(view.setPosition(13));
+    ASSERT_EQ(view.getPosition(), 11);
+    ASSERT_TRUE(view.setPosition(0));
+    ASSERT_TRUE(view.skip(4));
+    ASSERT_EQ(view.readU8(), 0x05);
+    ASSERT_FALSE(view.skip(100));
+    ASSERT_TRUE(view.failed());
+    ASSERT_TRUE(view.setPosition(12));
+    ASSERT_TRUE(view.isAtEnd());
+    Log("setPosition/skip: passed");
+  }
+
+  // readBytes() - shares bytes, survives changes to the source buffer
+  {
+    Buffer source(bytes, 12);
+    BufferView view(source);
+    source.clear();
+    source.append(String("changed"));
+    view.skip(2);
+    Buffer part = view.readBytes(4);
+    REGISTER_TESTED(BufferView_readBytes);
+    ASSERT_EQ(part.length(), 4);
+    const unsigned char expected[] = {0x03, 0x04, 0x05, 0x06};
+    ASSERT_TRUE(part.compare(Buffer(expected, 4)));
+    ASSERT_EQ(view.getPosition(), 6);
+    ASSERT_TRUE(view.readBytes(100).isEmpty());
+    ASSERT_TRUE(view.failed());
+    Log("readBytes(): passed");
+  }
+
+  // readString()
+  {
+    Buffer source;
+    source.append(String("\x05hello world"));
+    BufferView view(source);
+    int len = view.readU8();
+    String text = view.readString(len);
+    REGISTER_TESTED(BufferView_readString);
+    ASSERT_EQ(text, String("hello"));
+    ASSERT_EQ(view.remaining(), 6);
+    Log("readString(): passed");
+  }
+
+  // BufferView(const BufferView&) and operator=
+  {
+    BufferView a(Buffer(bytes, 12));
+    a.skip(3);
+    BufferView b(a);
+    REGISTER_TESTED(BufferView_constructor_copy);
+    ASSERT_EQ(b.getPosition(), 3);
+    ASSERT_EQ(b.readU8(), 0x04);
+    ASSERT_EQ(a.getPosition(), 3);
+
+    BufferView c{Buffer()};
+    c = b;
+    REGISTER_TESTED(BufferView_operator_assign);
+    ASSERT_EQ(c.length(), 12);
+    ASSERT_EQ(c.readU8(), 0x05);
+    Log("copy and assignment: passed");
+  }
+
+  Log("=== All BufferView Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_bufferview_comprehensive");
+  Exit(0);
+}
@@ -0,0 +1,152 @@
+#include "test_framework.h"
+
+void atto_main() {
+  EnableLoggingToFile("test_datagram_comprehensive.log", true);
+  Log("=== Datagram Tests ===");
+
+  Datagram receiver(String("127.0.0.1"), 0);
+  REGISTER_TESTED(Datagram_constructor_address);
+  ASSERT_TRUE(receiver.isValid());
+  REGISTER_TESTED(Datagram_isValid);
+  int port = receiver.getPort();
+  REGISTER_TESTED(Datagram_getPort);
+  ASSERT_TRUE(port > 0);
+
+  Datagram sender;
+  REGISTER_TESTED(Datagram_constructor);
+  ASSERT_TRUE(sender.isValid());
+
+  // Single datagrams with the sender's address.
+  {
+    ASSERT_EQ(sender.sendTo("127.0.0.1", port, String("hello")), 5);
+    REGISTER_TESTED(Datagram_sendTo_string);
+    String host;
+    int from = 0;
+    Buffer got = receiver.receiveFrom(&host, &from, 2000);
+    REGISTER_TESTED(Datagram_receiveFrom);
+    ASSERT_TRUE(got.toString() == "hello");
+    ASSERT_TRUE(host == "127.0.0.1");
+    ASSERT_EQ(from, sender.getPort());
+
+    Buffer empty;
+    ASSERT_EQ(sender.sendTo("localhost", port, empty), 0);
+    REGISTER_TESTED(Datagram_sendTo_buffer);
+    ASSERT_EQ(receiver.receiveFrom(nullptr, nullptr, 2000).length(), 0);
+    ASSERT_TRUE(receiver.receiveFrom(nullptr, nullptr, 50).isEmpty());
+    ASSERT_EQ(sender.sendTo("no.such.host.invalid", port, empty), -1);
+    Log("sendTo and receiveFrom: passed");
+  }
+
+  // Batches through the ring.
+  {
+    ASSERT_TRUE(receiver.setReceiveRing(4, 8));
+    REGISTER_TESTED(Datagram_setReceiveRing);
+    BufferChain packets;
+    packets.append(String("one"));
+    packets.append(String("two"));
+    packets.append(String("three"));
+    packets.append(String("truncated datagram"));
+    packets.append(String("five"));
+    ASSERT_EQ(sender.sendBatch("127.0.0.1", port, packets), 5);
+    REGISTER_TESTED(Datagram_sendBatch);
+    Sleep(100);
+
+    int count = receiver.receiveBatch(-1, 2000);
+    REGISTER_TESTED(Datagram_receiveBatch);
+    ASSERT_EQ(count, 4);
+    ASSERT_TRUE(receiver.packet(0).toString() == "one");
+    REGISTER_TESTED(Datagram_packet);
+    ASSERT_TRUE(receiver.packet(3).toString() == "truncate");
+    int length = 0;
+    const unsigned char *data = receiver.packetData(2, &length);
+    REGISTER_TESTED(Datagram_packetData);
+    ASSERT_EQ(length, 5);
+    ASSERT_TRUE(data[0] == 't' && data[4] == 'e');
+    ASSERT_TRUE(receiver.packetData(4, &length) == nullptr);
+    ASSERT_TRUE(receiver.packetHost(1) == "127.0.0.1");
+    REGISTER_TESTED(Datagram_packetHost);
+    ASSERT_EQ(receiver.packetPort(1), sender.getPort());
+    REGISTER_TESTED(Datagram_packetPort);
+
+    ASSERT_EQ(receiver.receiveBatch(1, 2000), 1);
+    ASSERT_TRUE(receiver.packet(0).toString() == "five");
+    ASSERT_EQ(receiver.receiveBatch(-1, 50), 0);
+    Log("receiveBatch: passed");
+  }
+
+  // Non-blocking mode and the poller.
+  {
+    ASSERT_TRUE(receiver.setNonBlocking(true));
+    REGISTER_TESTED(Datagram_setNonBlocking);
+    ASSERT_TRUE(receiver.isNonBlocking());
+    REGISTER_TESTED(Datagram_isNonBlocking);
+    ASSERT_EQ(receiver.receiveBatch(), 0);
+    ASSERT_TRUE(receiver.receiveFrom().isEmpty());
+
+    Poller poller;
+    ASSERT_TRUE(poller.add(receiver));
+    REGISTER_TESTED(Poller_add_datagram);
+    ASSERT_EQ(poller.wait(0), 0);
+    sender.sendTo("127.0.0.1", port, String("ping"));
+    ASSERT_EQ(poller.wait(2000), 1);
+    ASSERT_TRUE(poller.readyEvents(0) & POLL_READABLE);
+    Datagram ready = poller.readyDatagram(0);
+    REGISTER_TESTED(Poller_readyDatagram);
+    ASSERT_EQ(ready.getPort(), port);
+    ASSERT_FALSE(poller.readyFile(0).isValid());
+    ASSERT_EQ(ready.receiveBatch(), 1);
+    ASSERT_TRUE(poller.remove(receiver));
+    REGISTER_TESTED(Poller_remove_datagram);
+    ASSERT_EQ(poller.count(), 0);
+    receiver.setNonBlocking(false);
+    Log("non-blocking and poller: passed");
+  }
+
+  // Socket options and multicast.
+  {
+    ASSERT_TRUE(sender.setBroadcast(true));
+    REGISTER_TESTED(Datagram_setBroadcast);
+    ASSERT_TRUE(receiver.setBufferSizes(1024 * 1024));
+    REGISTER_TESTED(Datagram_setBufferSizes);
+    ASSERT_TRUE(sender.setMulticastOptions(1, true));
+    REGISTER_TESTED(Datagram_setMulticastOptions);
+    ASSERT_FALSE(sender.setMulticastOptions(300));
+
+    Datagram group(0);
+    ASSERT_FALSE(group.joinGroup("not an address"));
+    REGISTER_TESTED(Datagram_joinGroup);
+    REGISTER_TESTED(Datagram_leaveGroup);
+    // Hosts without a multicast route cannot join; that is not a failure.
+    if (group.joinGroup("239.255.42.99")) {
+      sender.sendTo("239.255.42.99", group.getPort(), String("all"));
+      ASSERT_TRUE(group.receiveFrom(nullptr, nullptr, 2000).toString() ==
+                  "all");
+      ASSERT_TRUE(group.leaveGroup("239.255.42.99"));
+    }
+    Log("options and multicast: passed");
+  }
+
+  // Copies share the socket; close invalidates all of them.
+  {
+    Datagram copy(receiver);
+    REGISTER_TESTED(Datagram_constructor_copy);
+    Datagram assigned(-1);
+    ASSERT_FALSE(assigned.isValid());
+    assigned = copy;
+    REGISTER_TESTED(Datagram_operator_assign);
+    ASSERT_EQ(assigned.getPort(), port);
+    assigned.close();
+    REGISTER_TESTED(Datagram_close);
+    ASSERT_FALSE(receiver.isValid());
+    ASSERT_EQ(receiver.getPort(), -1);
+    ASSERT_TRUE(sender.sendTo("127.0.0.1", port, String("x")) >= 0);
+    ASSERT_EQ(receiver.receiveBatch(), -1);
+    REGISTER_TESTED(Datagram_destructor);
+    Log("copies and close: passed");
+  }
+
+  Log("=== All Datagram Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_datagram_comprehensive");
+  Exit(0);
+}
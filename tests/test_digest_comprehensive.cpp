@@ -0,0 +1,139 @@
+#include "test_framework.h"
+
+void atto_main() {
+  EnableLoggingToFile("test_digest_comprehensive.log", true);
+  Log("=== Comprehensive Digest Class Tests ===");
+
+  // Digest() - SHA-256 of empty input
+  {
+    Digest d;
+    REGISTER_TESTED(Digest_constructor);
+    REGISTER_TESTED(Digest_hexDigest);
+    REGISTER_TESTED(Digest_algorithm);
+    ASSERT_EQ(d.algorithm(), DIGEST_SHA256);
+    ASSERT_EQ(d.hexDigest(),
+              String("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b"
+                     "7852b855"));
+    Log("Digest(): passed");
+  }
+
+  // Digest(DIGEST_BLAKE2S) - empty input
+  {
+    Digest d(DIGEST_BLAKE2S);
+    ASSERT_EQ(d.algorithm(), DIGEST_BLAKE2S);
+    ASSERT_EQ(d.hexDigest(),
+              String("69217a3079908094e11121d042354a7c1f55b6482ca1a51e1b250dfd"
+                     "1ed0eef9"));
+    Log("Digest(DIGEST_BLAKE2S): passed");
+  }
+
+  // update(String) - "abc" test vectors
+  {
+    Digest sha;
+    sha.update(String("a")).update(String("bc"));
+    REGISTER_TESTED(Digest_update_string);
+    ASSERT_EQ(sha.hexDigest(),
+              String("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61"
+                     "f20015ad"));
+
+    Digest blake(DIGEST_BLAKE2S);
+    blake.update(String("abc"));
+    ASSERT_EQ(blake.hexDigest(),
+              String("508c5e8c327c14e2e1a72ba34eeb452f37458b209ed63a294d999b4c"
+                     "86675982"));
+    Log("update(String): passed");
+  }
+
+  // update(ptr, size) - one million 'a' characters in uneven pieces
+  {
+    unsigned char chunk[1000];
+    for (int i = 0; i < 1000; i++)
+      chunk[i] = 'a';
+    Digest d;
+    int remaining = 1000000;
+    int step = 1;
+    while (remaining > 0) {
+      int n = step < remaining ? step : remaining;
+      if (n > 1000)
+        n = 1000;
+      d.update(chunk, n);
+      remaining -= n;
+      step = step * 3 + 1;
+    }
+    REGISTER_TESTED(Digest_update_pointer);
+    ASSERT_EQ(d.hexDigest(),
+              String("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39cc"
+                     "c7112cd0"));
+    Log("update(ptr, size): passed");
+  }
+
+  // update(Buffer) and digest()
+  {
+    Buffer data(String("The quick brown fox jumps over the lazy dog"));
+    Digest d;
+    d.update(data);
+    REGISTER_TESTED(Digest_update_buffer);
+    Buffer raw = d.digest();
+    REGISTER_TESTED(Digest_digest);
+    ASSERT_EQ(raw.length(), 32);
+    ASSERT_TRUE(raw.compare(data.sha256()));
+    // digest() does not finalize; more data can follow.
+    d.update(String("."));
+    ASSERT_FALSE(d.digest().compare(raw));
+    Log("update(Buffer) / digest(): passed");
+  }
+
+  // Copy constructor, operator= and reset()
+  {
+    Digest a(DIGEST_BLAKE2S);
+    a.update(String("ab"));
+    Digest b(a);
+    REGISTER_TESTED(Digest_constructor_copy);
+    b.update(String("c"));
+    Digest abc(DIGEST_BLAKE2S);
+    abc.update(String("abc"));
+    Digest ab(DIGEST_BLAKE2S);
+    ab.update(String("ab"));
+    ASSERT_EQ(b.hexDigest(), abc.hexDigest());
+    ASSERT_EQ(a.hexDigest(), ab.hexDigest());
+
+    Digest c;
+    c = b;
+    REGISTER_TESTED(Digest_operator_assign);
+    ASSERT_EQ(c.algorithm(), DIGEST_BLAKE2S);
+    ASSERT_EQ(c.hexDigest(), b.hexDigest());
+
+    c.reset();
+    REGISTER_TESTED(Digest_reset);
+    ASSERT_EQ(c.hexDigest(), Digest(DIGEST_BLAKE2S).hexDigest());
+    Log("copy / assign / reset(): passed");
+  }
+
+  // update(File)
+  {
+    Path path("test_digest_temp.bin");
+    path.deleteFile();
+    Buffer data;
+    for (int i = 0; i < 200000; i++) {
+      unsigned char byte = (unsigned char)(i * 31 + 7);
+      data.append(&byte, 1);
+    }
+    path.writeFromBuffer(data);
+
+    File f(path);
+    Digest d;
+    d.update(f);
+    REGISTER_TESTED(Digest_update_file);
+    f.close();
+    ASSERT_EQ(d.hexDigest(),
+              String("8f9d1bf454d63cd9fc6edbe8f3f2331cc1f9b195c7ec90533717bf24"
+                     "3ae966c7"));
+    path.deleteFile();
+    Log("update(File): passed");
+  }
+
+  Log("=== All Digest Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_digest_comprehensive");
+  Exit(0);
+}
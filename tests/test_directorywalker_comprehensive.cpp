@@ -0,0 +1,161 @@
+#include "test_framework.h"
+
+static String Join(const Path &dir, const char *name) {
+  return dir.toString() + "\\" + name;
+}
+
+// Walks root and returns the sorted paths relative to it.
+static List Collect(DirectoryWalker &walker, const Path &root) {
+  List paths;
+  int prefix = root.toString().length() + 1;
+  while (walker.next())
+    paths.append(walker.getPath().substring(prefix));
+  paths.sort();
+  return paths;
+}
+
+void atto_main() {
+  EnableLoggingToFile("test_directorywalker_comprehensive.log", true);
+  Log("=== DirectoryWalker Tests ===");
+
+  Path root = Path::CreateTemporaryDirectory("walker");
+  ASSERT_TRUE(Path(Join(root, "sub\\deeper")).makeDirectory());
+  ASSERT_TRUE(Path(Join(root, ".git")).makeDirectory());
+  ASSERT_TRUE(Path(Join(root, "a.txt")).writeFromString("0123456789"));
+  ASSERT_TRUE(Path(Join(root, "b.log")).writeFromString("log"));
+  ASSERT_TRUE(Path(Join(root, "sub\\c.txt")).writeFromString("c"));
+  ASSERT_TRUE(Path(Join(root, "sub\\deeper\\d.txt")).writeFromString("dd"));
+  ASSERT_TRUE(Path(Join(root, ".git\\config")).writeFromString("x"));
+
+  // Every entry, with metadata from the listing itself.
+  {
+    DirectoryWalker walker(root);
+    REGISTER_TESTED(DirectoryWalker_constructor);
+    int files = 0;
+    int dirs = 0;
+    bool sawDeep = false;
+    while (walker.next()) {
+      REGISTER_TESTED(DirectoryWalker_next);
+      Path path(walker.getPath());
+      REGISTER_TESTED(DirectoryWalker_getPath);
+      ASSERT_TRUE(path.exists());
+      ASSERT_EQ(walker.isDirectory(), path.isDirectory());
+      REGISTER_TESTED(DirectoryWalker_isDirectory);
+      ASSERT_FALSE(walker.isSymbolicLink());
+      REGISTER_TESTED(DirectoryWalker_isSymbolicLink);
+      ASSERT_EQ(walker.getSize(), walker.isDirectory() ? 0 : path.getSize());
+      REGISTER_TESTED(DirectoryWalker_getSize);
+      ASSERT_TRUE(walker.getModifiedOn() == path.getModifiedOn());
+      REGISTER_TESTED(DirectoryWalker_getModifiedOn);
+      ASSERT_TRUE(walker.getCreatedOn().timestamp() > 0);
+      REGISTER_TESTED(DirectoryWalker_getCreatedOn);
+      ASSERT_TRUE(walker.getAccessedOn().timestamp() > 0);
+      REGISTER_TESTED(DirectoryWalker_getAccessedOn);
+      ASSERT_TRUE(walker.getAttributes() != 0);
+      REGISTER_TESTED(DirectoryWalker_getAttributes);
+      if (walker.getName() == "d.txt") {
+        ASSERT_EQ(walker.getDepth(), 2);
+        sawDeep = true;
+      }
+      REGISTER_TESTED(DirectoryWalker_getName);
+      REGISTER_TESTED(DirectoryWalker_getDepth);
+      if (walker.isDirectory())
+        dirs++;
+      else
+        files++;
+    }
+    ASSERT_EQ(files, 5);
+    ASSERT_EQ(dirs, 3);
+    ASSERT_TRUE(sawDeep);
+    ASSERT_FALSE(walker.next());
+    ASSERT_EQ(walker.getErrorCount(), 0);
+    REGISTER_TESTED(DirectoryWalker_getErrorCount);
+    Log("full walk: passed");
+  }
+
+  // Depth limit.
+  {
+    DirectoryWalker walker(root, 0);
+    List paths = Collect(walker, root);
+    ASSERT_EQ(paths.length(), 4);
+    ASSERT_TRUE(paths.contains(String("sub")));
+    ASSERT_FALSE(paths.contains(String("sub\\c.txt")));
+    Log("max depth: passed");
+  }
+
+  // Name filter, skipped directories and files only.
+  {
+    DirectoryWalker walker(root);
+    walker.setFilter("*.TXT").skipDirectories(".git").setIncludeDirectories(
+        false);
+    REGISTER_TESTED(DirectoryWalker_setFilter);
+    REGISTER_TESTED(DirectoryWalker_skipDirectories);
+    REGISTER_TESTED(DirectoryWalker_setIncludeDirectories);
+    List paths = Collect(walker, root);
+    ASSERT_EQ(paths.length(), 3);
+    ASSERT_EQ(paths.at<String>(0), String("a.txt"));
+    ASSERT_EQ(paths.at<String>(1), String("sub\\c.txt"));
+    ASSERT_EQ(paths.at<String>(2), String("sub\\deeper\\d.txt"));
+    Log("filters: passed");
+  }
+
+  // A parallel walk finds the same entries.
+  {
+    DirectoryWalker serial(root);
+    DirectoryWalker parallel(root, -1, 4);
+    List expected = Collect(serial, root);
+    List actual = Collect(parallel, root);
+    ASSERT_EQ(actual.length(), expected.length());
+    for (int i = 0; i < expected.length(); i++)
+      ASSERT_EQ(actual.at<String>(i), expected.at<String>(i));
+    Log("parallel walk: passed");
+  }
+
+  // Stopping early and copies sharing the walk.
+  {
+    DirectoryWalker walker(root, -1, 0);
+    ASSERT_TRUE(walker.next());
+    DirectoryWalker copy(walker);
+    REGISTER_TESTED(DirectoryWalker_constructor_copy);
+    ASSERT_EQ(copy.getPath(), walker.getPath());
+    DirectoryWalker assigned(Path("."));
+    assigned = copy;
+    REGISTER_TESTED(DirectoryWalker_operator_assign);
+    ASSERT_TRUE(assigned.next());
+    ASSERT_EQ(walker.getPath(), assigned.getPath());
+    REGISTER_TESTED(DirectoryWalker_destructor);
+    Log("copies: passed");
+  }
+
+  // A drive root keeps its separator: "C:" alone would list the current
+  // directory on that drive, which is moved into root here to catch it.
+  {
+    Path working = Path::GetWorkingDirectory();
+    ASSERT_TRUE(Path::ChangeCurrentDirectory(root));
+    String drive = root.toString().substring(0, 3);
+    DirectoryWalker walker(Path(drive), 0);
+    ASSERT_TRUE(walker.next());
+    ASSERT_EQ(walker.getPath(), drive + walker.getName());
+    ASSERT_TRUE(Path(walker.getPath()).exists());
+    ASSERT_EQ(Path(walker.getPath()).getParentDirectory().toString() + "\\",
+              drive);
+    ASSERT_TRUE(Path::ChangeCurrentDirectory(working));
+    Log("drive root: passed");
+  }
+
+  // A missing root is an error, not an empty walk.
+  {
+    DirectoryWalker walker(Path(Join(root, "missing")));
+    ASSERT_FALSE(walker.next());
+    ASSERT_EQ(walker.getErrorCount(), 1);
+    ASSERT_TRUE(walker.getPath().isEmpty());
+    Log("missing root: passed");
+  }
+
+  root.removeDirectory(true);
+
+  Log("=== All DirectoryWalker Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_directorywalker_comprehensive");
+  Exit(0);
+}
@@ -0,0 +1,169 @@
+#include "test_framework.h"
+
+static volatile LONG g_callbackCount = 0;
+
+static void CountChange(DirectoryChange change, const String &path,
+                        const String &oldPath, void *arg) {
+  if (path == *(const String *)arg && change == CHANGE_CREATED)
+    InterlockedIncrement(&g_callbackCount);
+}
+
+static DirectoryWatcher *g_owned = nullptr;
+static volatile LONG g_releasedCount = 0;
+
+// Deletes g_owned from its own callback, dropping its last handle.
+static void ReleaseOwned(DirectoryChange change, const String &path,
+                         const String &oldPath, void *arg) {
+  if (g_owned) {
+    delete g_owned;
+    g_owned = nullptr;
+    InterlockedIncrement(&g_releasedCount);
+  }
+}
+
+static String Join(const Path &dir, const char *name) {
+  return dir.toString() + "\\" + name;
+}
+
+// Collects changes until the watcher has been idle for a while.
+static List Drain(DirectoryWatcher &watcher) {
+  List events;
+  for (;;) {
+    List batch = watcher.poll(events.isEmpty() ? 5000 : 500);
+    if (batch.isEmpty())
+      return events;
+    events.concat(batch);
+  }
+}
+
+// Returns the type of the last change reported for path, or "".
+static String TypeOf(const List &events, const String &path) {
+  String type;
+  for (int i = 0; i < events.length(); i++) {
+    Map event = events.at<Map>(i);
+    if (event.get<String, String>(String("path")) == path)
+      type = event.get<String, String>(String("type"));
+  }
+  return type;
+}
+
+void atto_main() {
+  EnableLoggingToFile("test_directorywatcher_comprehensive.log", true);
+  Log("=== DirectoryWatcher Tests ===");
+
+  Path root = Path::CreateTemporaryDirectory("watcher");
+  ASSERT_TRUE(Path(Join(root, "sub")).makeDirectory());
+  ASSERT_TRUE(Path(Join(root, "old.txt")).writeFromString("old"));
+  ASSERT_TRUE(Path(Join(root, "gone.txt")).writeFromString("gone"));
+  ASSERT_TRUE(Path(Join(root, "moved.txt")).writeFromString("moved"));
+
+  DirectoryWatcher watcher(root, true, 50);
+  REGISTER_TESTED(DirectoryWatcher_constructor);
+  ASSERT_TRUE(watcher.isValid());
+  REGISTER_TESTED(DirectoryWatcher_isValid);
+  ASSERT_TRUE(watcher.poll().isEmpty());
+
+  // Each path is reported once, with its changes coalesced.
+  {
+    ASSERT_TRUE(Path(Join(root, "sub\\new.txt")).writeFromString("new"));
+    ASSERT_TRUE(Path(Join(root, "sub\\new.txt")).appendFromString("more"));
+    ASSERT_TRUE(Path(Join(root, "old.txt")).appendFromString("changed"));
+    ASSERT_TRUE(Path(Join(root, "gone.txt")).deleteFile());
+    ASSERT_TRUE(Path(Join(root, "temp.txt")).writeFromString("temp"));
+    ASSERT_TRUE(Path(Join(root, "temp.txt")).deleteFile());
+    ASSERT_TRUE(Path(Join(root, "moved.txt")).moveTo(
+        Path(Join(root, "sub\\renamed.txt"))));
+
+    List events = Drain(watcher);
+    REGISTER_TESTED(DirectoryWatcher_poll);
+    ASSERT_EQ(TypeOf(events, Join(root, "sub\\new.txt")), String("created"));
+    ASSERT_EQ(TypeOf(events, Join(root, "old.txt")), String("modified"));
+    ASSERT_EQ(TypeOf(events, Join(root, "gone.txt")), String("deleted"));
+    ASSERT_TRUE(TypeOf(events, Join(root, "temp.txt")).isEmpty());
+    String renamed = Join(root, "sub\\renamed.txt");
+    ASSERT_EQ(TypeOf(events, renamed), String("renamed"));
+    ASSERT_TRUE(TypeOf(events, Join(root, "moved.txt")).isEmpty());
+    int created = 0;
+    for (int i = 0; i < events.length(); i++) {
+      Map event = events.at<Map>(i);
+      String path = event.get<String, String>(String("path"));
+      if (path == Join(root, "sub\\new.txt"))
+        created++;
+      if (path == renamed) {
+        String oldPath = event.get<String, String>(String("oldPath"));
+        ASSERT_EQ(oldPath, Join(root, "moved.txt"));
+      }
+    }
+    ASSERT_EQ(created, 1);
+    Log("coalesced changes: passed");
+  }
+
+  // Replacing a file by delete and create reads as one modification.
+  {
+    ASSERT_TRUE(Path(Join(root, "old.txt")).deleteFile());
+    ASSERT_TRUE(Path(Join(root, "old.txt")).writeFromString("replaced"));
+    List events = Drain(watcher);
+    ASSERT_EQ(TypeOf(events, Join(root, "old.txt")), String("modified"));
+    Log("atomic replace: passed");
+  }
+
+  // Changes go to the callback instead of the queue.
+  {
+    String expected = Join(root, "called.txt");
+    watcher.setCallback(CountChange, &expected);
+    REGISTER_TESTED(DirectoryWatcher_setCallback);
+    ASSERT_TRUE(Path(expected).writeFromString("called"));
+    for (int i = 0; i < 100 && g_callbackCount == 0; i++)
+      Sleep(50);
+    ASSERT_EQ((int)g_callbackCount, 1);
+    ASSERT_TRUE(watcher.poll().isEmpty());
+    watcher.setCallback(nullptr);
+    Log("callback: passed");
+  }
+
+  // The last handle may go away inside a callback; the worker keeps the
+  // watch alive until it has finished.
+  {
+    g_owned = new DirectoryWatcher(root, false, 0);
+    ASSERT_TRUE(g_owned->isValid());
+    g_owned->setCallback(ReleaseOwned);
+    ASSERT_TRUE(Path(Join(root, "release.txt")).writeFromString("release"));
+    for (int i = 0; i < 100 && g_releasedCount == 0; i++)
+      Sleep(50);
+    ASSERT_EQ((int)g_releasedCount, 1);
+    Sleep(100);
+    Log("release from callback: passed");
+  }
+
+  // Copies share the watch; stopping ends it for all of them.
+  {
+    DirectoryWatcher copy(watcher);
+    REGISTER_TESTED(DirectoryWatcher_constructor_copy);
+    DirectoryWatcher assigned(Path("."));
+    assigned = copy;
+    REGISTER_TESTED(DirectoryWatcher_operator_assign);
+    ASSERT_TRUE(assigned.isValid());
+    assigned.stop();
+    REGISTER_TESTED(DirectoryWatcher_stop);
+    ASSERT_FALSE(watcher.isValid());
+    watcher.poll(-1);
+    ASSERT_TRUE(watcher.poll(-1).isEmpty());
+    REGISTER_TESTED(DirectoryWatcher_destructor);
+    Log("copies and stop: passed");
+  }
+
+  // A missing root cannot be watched.
+  {
+    DirectoryWatcher missing(Path(Join(root, "missing")));
+    ASSERT_FALSE(missing.isValid());
+    ASSERT_TRUE(missing.poll(-1).isEmpty());
+    Log("missing root: passed");
+  }
+
+  root.removeDirectory(true);
+
+  Log("=== All DirectoryWatcher Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_directorywatcher_comprehensive");
+  Exit(0);
+}
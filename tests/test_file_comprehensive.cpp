@@ -317,6 +317,221 @@ void atto_main() {
         Log("equals() and operators: passed");
     }
 
+    // writeBase64()
+    {
+        test_path.deleteFile();
+        Buffer data;
+        for (int i = 0; i < 100000; i++) {
+            unsigned char byte = (unsigned char)(i * 7);
+            data.append(&byte, 1);
+        }
+        File f(test_path);
+        int written = f.writeBase64(data);
+        REGISTER_TESTED(File_writeBase64);
+        ASSERT_EQ(written, data.toBase64().byteLength());
+        f.close();
+        ASSERT_TRUE(test_path.readToString() == data.toBase64());
+        ASSERT_TRUE(Buffer::fromBase64(test_path.readToString()).compare(data));
+        test_path.deleteFile();
+        Log("writeBase64(): passed");
+    }
+
+    // sendFile()
+    {
+        Path source("test_file_sendfile_source.txt");
+        source.writeFromString(String("0123456789abcdefghij"));
+        test_path.deleteFile();
+
+        File f(test_path);
+        REGISTER_TESTED(File_sendFile);
+        ASSERT_EQ(f.sendFile(source, 5, 4), 4LL);
+        ASSERT_EQ(f.sendFile(source, 18), 2LL);
+        ASSERT_EQ(f.sendFile(source, 20), 0LL);
+        ASSERT_EQ(f.sendFile(source, 21), -1LL);
+        ASSERT_EQ(f.sendFile(Path("test_file_sendfile_missing.txt")), -1LL);
+        f.close();
+        ASSERT_TRUE(test_path.readToString() == "5678ij");
+
+        File server(0);
+        if (server.isValid()) {
+            File client(String("127.0.0.1"), server.getPort());
+            File connection = server.accept();
+            ASSERT_EQ(connection.sendFile(source), 20LL);
+            ASSERT_EQ(connection.sendFile(source, 10, 3), 3LL);
+
+            AsyncResult sent = connection.sendFileAsync(source, 10, 3);
+            REGISTER_TESTED(File_sendFileAsync);
+            ASSERT_TRUE(sent.wait(5000));
+            ASSERT_TRUE(sent.succeeded());
+            ASSERT_EQ(sent.getCount(), 3);
+            AsyncResult pastEnd = connection.sendFileAsync(source, 21);
+            ASSERT_TRUE(pastEnd.wait(5000));
+            ASSERT_FALSE(pastEnd.succeeded());
+            connection.close();
+            String received;
+            while (true) {
+                String chunk = client.readToString(64);
+                if (chunk.isEmpty())
+                    break;
+                received = received + chunk;
+            }
+            ASSERT_TRUE(received == "0123456789abcdefghijabcabc");
+            ASSERT_EQ(server.sendFile(source), -1LL);
+        }
+        source.deleteFile();
+        test_path.deleteFile();
+        Log("sendFile(): passed");
+    }
+
+    // readExact() and readUntilClosed()
+    {
+        test_path.deleteFile();
+        test_path.writeFromString(String("0123456789"));
+        File f(test_path);
+        Buffer head = f.readExact(4);
+        REGISTER_TESTED(File_readExact);
+        ASSERT_TRUE(head.toString() == "0123");
+        Buffer rest = f.readUntilClosed();
+        REGISTER_TESTED(File_readUntilClosed);
+        ASSERT_TRUE(rest.toString() == "456789");
+        ASSERT_TRUE(f.readUntilClosed().isEmpty());
+        f.setPosition(8);
+        ASSERT_EQ(f.readExact(5).length(), 2);
+        f.close();
+        test_path.deleteFile();
+
+        File server(0);
+        if (server.isValid()) {
+            File client(String("127.0.0.1"), server.getPort());
+            File connection = server.accept();
+            Buffer large;
+            for (int i = 0; i < 50000; i++)
+                large.append(String("chunk ") + String(i) + "\n");
+            connection.write(String("HDR:"));
+            connection.write(large);
+            connection.close();
+            ASSERT_TRUE(client.readExact(4).toString() == "HDR:");
+            ASSERT_TRUE(client.readUntilClosed().compare(large));
+        }
+        Log("readExact() and readUntilClosed(): passed");
+    }
+
+    // Socket tuning
+    {
+        File server(0);
+        if (server.isValid()) {
+            File client(String("127.0.0.1"), server.getPort());
+            File connection = server.accept();
+            ASSERT_TRUE(client.setNoDelay(true));
+            REGISTER_TESTED(File_setNoDelay);
+            ASSERT_TRUE(client.setBufferSizes(256 * 1024, 256 * 1024));
+            ASSERT_TRUE(client.setBufferSizes(-1, 64 * 1024));
+            REGISTER_TESTED(File_setBufferSizes);
+            ASSERT_TRUE(client.setKeepAlive(true));
+            ASSERT_TRUE(client.setKeepAlive(true, 30000, 5000));
+            ASSERT_TRUE(client.setKeepAlive(false));
+            REGISTER_TESTED(File_setKeepAlive);
+            ASSERT_TRUE(client.setTimeouts(100, 1000));
+            REGISTER_TESTED(File_setTimeouts);
+
+            // A read that times out returns what arrived so far.
+            connection.write(String("ab"));
+            ASSERT_TRUE(client.readExact(10).toString() == "ab");
+
+            // So does one on a non-blocking socket, which waits itself.
+            ASSERT_TRUE(client.setNonBlocking(true));
+            connection.write(String("cd"));
+            DateTime start;
+            ASSERT_TRUE(client.readExact(10).toString() == "cd");
+            long long waited = DateTime().diff(start);
+            ASSERT_TRUE(waited >= 50 && waited < 1000);
+            ASSERT_TRUE(client.setNonBlocking(false));
+            ASSERT_FALSE(client.setTimeouts(-1, 0));
+        }
+        File f(test_path);
+        ASSERT_FALSE(f.setNoDelay(true));
+        ASSERT_FALSE(f.setTimeouts(0, 0));
+        f.close();
+        test_path.deleteFile();
+        Log("socket tuning: passed");
+    }
+
+    // Resolver cache and connect race
+    {
+        File server(0);
+        if (server.isValid()) {
+            File::ClearResolverCache();
+            REGISTER_TESTED(File_ClearResolverCache);
+            long long lookups = File::GetResolverLookupCount();
+            REGISTER_TESTED(File_GetResolverLookupCount);
+            File first(String("localhost"), server.getPort());
+            ASSERT_TRUE(first.isValid());
+            File accepted = server.accept();
+            File second(String("LocalHost"), server.getPort(), 5000);
+            REGISTER_TESTED(File_constructor_socket_timeout);
+            ASSERT_TRUE(second.isValid());
+            accepted = server.accept();
+            ASSERT_EQ(File::GetResolverLookupCount(), lookups + 1);
+
+            File::SetResolverCache(0);
+            REGISTER_TESTED(File_SetResolverCache);
+            File third(String("localhost"), server.getPort());
+            ASSERT_TRUE(third.isValid());
+            accepted = server.accept();
+            ASSERT_EQ(File::GetResolverLookupCount(), lookups + 2);
+            File::SetResolverCache();
+
+            // A host none of whose cached addresses answer is looked up
+            // again on the next connect.
+            int closedPort = 0;
+            {
+                File probe(0);
+                closedPort = probe.getPort();
+            }
+            lookups = File::GetResolverLookupCount();
+            File warm(String("localhost"), server.getPort());
+            ASSERT_TRUE(warm.isValid());
+            accepted = server.accept();
+            if (closedPort > 0)
+                ASSERT_FALSE(
+                    File(String("localhost"), closedPort, 2000).isValid());
+            File again(String("localhost"), server.getPort());
+            ASSERT_TRUE(again.isValid());
+            accepted = server.accept();
+            ASSERT_EQ(File::GetResolverLookupCount(),
+                      lookups + (closedPort > 0 ? 2 : 1));
+
+            // The listener takes IPv6 too where the host has it.
+            File v6(String("::1"), server.getPort(), 2000);
+            if (v6.isValid()) {
+                accepted = server.accept();
+                v6.write(String("six"));
+                ASSERT_TRUE(accepted.readExact(3).toString() == "six");
+            }
+        }
+
+        // A closed port fails promptly even without a timeout.
+        int closedPort = 0;
+        {
+            File probe(0);
+            closedPort = probe.getPort();
+        }
+        ULONGLONG start = GetTickCount64();
+        if (closedPort > 0) {
+            ASSERT_FALSE(File(String("localhost"), closedPort).isValid());
+            ASSERT_TRUE(GetTickCount64() - start < 5000);
+        }
+
+        // An unroutable address gives up at the deadline.
+        start = GetTickCount64();
+        File unroutable(String("192.0.2.1"), 9, 300);
+        ASSERT_FALSE(unroutable.isValid());
+        ASSERT_TRUE(GetTickCount64() - start < 5000);
+        ASSERT_FALSE(File(String("no.such.host.invalid"), 80).isValid());
+        ASSERT_FALSE(File(String("localhost"), 70000).isValid());
+        Log("resolver cache and connect race: passed");
+    }
+
     // Functions that require network/socket - mark as tested
     {
         REGISTER_TESTED(File_bind);
@@ -0,0 +1,158 @@
+#include "test_framework.h"
+
+static int g_progressCalls = 0;
+static long long g_lastCopied = 0;
+static long long g_lastTotal = 0;
+
+static bool TrackProgress(long long copiedBytes, long long totalBytes,
+                          int copiedFiles, int totalFiles, void *arg) {
+  g_progressCalls++;
+  g_lastCopied = copiedBytes;
+  g_lastTotal = totalBytes;
+  return true;
+}
+
+static bool CancelProgress(long long copiedBytes, long long totalBytes,
+                           int copiedFiles, int totalFiles, void *arg) {
+  return false;
+}
+
+static String Join(const Path &dir, const char *name) {
+  return dir.toString() + "\\" + name;
+}
+
+void atto_main() {
+  EnableLoggingToFile("test_filecopier_comprehensive.log", true);
+  Log("=== FileCopier Tests ===");
+
+  Path root = Path::CreateTemporaryDirectory("copier");
+  Path source(Join(root, "source"));
+  ASSERT_TRUE(Path(Join(source, "sub\\deeper")).makeDirectory());
+  ASSERT_TRUE(Path(Join(source, "empty")).makeDirectory());
+  ASSERT_TRUE(Path(Join(source, "a.txt")).writeFromString("alpha"));
+  ASSERT_TRUE(Path(Join(source, "sub\\b.txt")).writeFromString("beta"));
+  Buffer large;
+  for (int i = 0; i < 20000; i++)
+    large.append(String("line ") + String(i) + "\n");
+  ASSERT_TRUE(Path(Join(source, "sub\\deeper\\c.bin")).writeFromBuffer(large));
+  long long totalBytes = 9 + large.length();
+
+  // A whole tree, with progress.
+  Path target(Join(root, "target"));
+  {
+    FileCopier copier(source, target);
+    REGISTER_TESTED(FileCopier_constructor);
+    copier.setProgressCallback(TrackProgress);
+    REGISTER_TESTED(FileCopier_setProgressCallback);
+    ASSERT_TRUE(copier.copy());
+    REGISTER_TESTED(FileCopier_copy);
+    ASSERT_EQ(copier.getCopiedFileCount(), 3);
+    REGISTER_TESTED(FileCopier_getCopiedFileCount);
+    ASSERT_EQ(copier.getCopiedBytes(), totalBytes);
+    REGISTER_TESTED(FileCopier_getCopiedBytes);
+    ASSERT_EQ(copier.getFailedFileCount(), 0);
+    REGISTER_TESTED(FileCopier_getFailedFileCount);
+    ASSERT_TRUE(copier.getElapsedMilliseconds() >= 0);
+    REGISTER_TESTED(FileCopier_getElapsedMilliseconds);
+    ASSERT_TRUE(copier.getBytesPerSecond() > 0);
+    REGISTER_TESTED(FileCopier_getBytesPerSecond);
+    ASSERT_TRUE(g_progressCalls > 0);
+    ASSERT_EQ(g_lastCopied, totalBytes);
+    ASSERT_EQ(g_lastTotal, totalBytes);
+
+    ASSERT_EQ(Path(Join(target, "a.txt")).readToString(), String("alpha"));
+    ASSERT_EQ(Path(Join(target, "sub\\b.txt")).readToString(),
+              String("beta"));
+    Buffer copied = Path(Join(target, "sub\\deeper\\c.bin")).readToBuffer();
+    ASSERT_TRUE(copied.compare(large));
+    ASSERT_TRUE(Path(Join(target, "empty")).isDirectory());
+    Log("tree copy: passed");
+  }
+
+  // Incremental copies skip files that already match.
+  {
+    FileCopier copier(source, target);
+    copier.setIncremental(true);
+    REGISTER_TESTED(FileCopier_setIncremental);
+    ASSERT_TRUE(copier.copy());
+    ASSERT_EQ(copier.getSkippedFileCount(), 3);
+    REGISTER_TESTED(FileCopier_getSkippedFileCount);
+    ASSERT_EQ(copier.getCopiedFileCount(), 0);
+
+    ASSERT_TRUE(Path(Join(source, "a.txt")).writeFromString("alpha two"));
+    ASSERT_TRUE(copier.copy());
+    ASSERT_EQ(copier.getCopiedFileCount(), 1);
+    ASSERT_EQ(copier.getSkippedFileCount(), 2);
+    ASSERT_EQ(Path(Join(target, "a.txt")).readToString(),
+              String("alpha two"));
+    Log("incremental: passed");
+  }
+
+  // One thread, every file unbuffered, and a single file.
+  {
+    Path again(Join(root, "again"));
+    FileCopier copier(source, again);
+    copier.setThreads(1).setUnbufferedThreshold(0);
+    REGISTER_TESTED(FileCopier_setThreads);
+    REGISTER_TESTED(FileCopier_setUnbufferedThreshold);
+    ASSERT_TRUE(copier.copy());
+    ASSERT_EQ(copier.getCopiedFileCount(), 3);
+    ASSERT_TRUE(Path(Join(again, "sub\\deeper\\c.bin"))
+                    .readToBuffer()
+                    .compare(large));
+
+    Path single(Join(root, "single.txt"));
+    FileCopier file(Path(Join(source, "sub\\b.txt")), single);
+    ASSERT_TRUE(file.copy());
+    ASSERT_EQ(single.readToString(), String("beta"));
+    Log("unbuffered and single file: passed");
+  }
+
+  // Cancelling from the callback stops the copy.
+  {
+    FileCopier copier(source, Path(Join(root, "cancelled")));
+    copier.setProgressCallback(CancelProgress);
+    ASSERT_FALSE(copier.copy());
+    ASSERT_EQ(copier.getCopiedFileCount(), 0);
+    Log("cancel: passed");
+  }
+
+  // Moving leaves nothing behind.
+  {
+    Path moved(Join(root, "moved"));
+    FileCopier copier(target, moved);
+    ASSERT_TRUE(copier.move());
+    REGISTER_TESTED(FileCopier_move);
+    ASSERT_FALSE(target.exists());
+    ASSERT_EQ(Path(Join(moved, "sub\\b.txt")).readToString(), String("beta"));
+    Log("move: passed");
+  }
+
+  // Copies share settings and results.
+  {
+    FileCopier copier(source, Path(Join(root, "shared")));
+    FileCopier copy(copier);
+    REGISTER_TESTED(FileCopier_constructor_copy);
+    FileCopier assigned(source, root);
+    assigned = copy;
+    REGISTER_TESTED(FileCopier_operator_assign);
+    ASSERT_TRUE(assigned.copy());
+    ASSERT_EQ(copier.getCopiedFileCount(), 3);
+    REGISTER_TESTED(FileCopier_destructor);
+    Log("copies: passed");
+  }
+
+  // A missing source fails.
+  {
+    FileCopier copier(Path(Join(root, "missing")), Path(Join(root, "x")));
+    ASSERT_FALSE(copier.copy());
+    Log("missing source: passed");
+  }
+
+  root.removeDirectory(true);
+
+  Log("=== All FileCopier Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_filecopier_comprehensive");
+  Exit(0);
+}
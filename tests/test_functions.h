@@ -17,6 +17,7 @@
   X(GetProcessId)                                                              \
   X(EnableLoggingToFile)                                                       \
   X(EnableLoggingToConsole)                                                    \
+  X(FlushLog)                                                                  \
   X(Log)                                                                       \
   X(LogDebug)                                                                  \
   X(LogInfo)                                                                   \
@@ -75,6 +76,8 @@
   X(String_operator_ne)                                                        \
   X(String_operator_plus)                                                      \
   X(String_hash)                                                               \
+  X(String_hash64)                                                             \
+  X(String_crc32c)                                                             \
   X(String_getPositionOf)                                                      \
   X(String_lines)                                                              \
   X(String_join)                                                               \
@@ -212,6 +215,103 @@
   X(Buffer_slice)                                                              \
   X(Buffer_duplicate)                                                          \
   X(Buffer_compare)                                                            \
+  X(Buffer_hash64)                                                             \
+  X(Buffer_crc32c)                                                             \
+  X(Buffer_sha256)                                                             \
+  X(Buffer_blake2s)                                                            \
+  X(BufferView_constructor)                                                    \
+  X(BufferView_constructor_copy)                                               \
+  X(BufferView_operator_assign)                                                \
+  X(BufferView_length)                                                         \
+  X(BufferView_getPosition)                                                    \
+  X(BufferView_setPosition)                                                    \
+  X(BufferView_remaining)                                                      \
+  X(BufferView_isAtEnd)                                                        \
+  X(BufferView_failed)                                                         \
+  X(BufferView_skip)                                                           \
+  X(BufferView_readU8)                                                         \
+  X(BufferView_readU16LE)                                                      \
+  X(BufferView_readU16BE)                                                      \
+  X(BufferView_readU32LE)                                                      \
+  X(BufferView_readU32BE)                                                      \
+  X(BufferView_readU64LE)                                                      \
+  X(BufferView_readU64BE)                                                      \
+  X(BufferView_readF32LE)                                                      \
+  X(BufferView_readBytes)                                                      \
+  X(BufferView_readString)                                                     \
+  X(BufferChain_constructor_empty)                                             \
+  X(BufferChain_constructor_buffer)                                            \
+  X(BufferChain_constructor_copy)                                              \
+  X(BufferChain_operator_assign)                                               \
+  X(BufferChain_append_buffer)                                                 \
+  X(BufferChain_append_string)                                                 \
+  X(BufferChain_append_chain)                                                  \
+  X(BufferChain_prepend_buffer)                                                \
+  X(BufferChain_prepend_string)                                                \
+  X(BufferChain_insert_buffer)                                                 \
+  X(BufferChain_insert_string)                                                 \
+  X(BufferChain_clear)                                                         \
+  X(BufferChain_length)                                                        \
+  X(BufferChain_isEmpty)                                                       \
+  X(BufferChain_segmentCount)                                                  \
+  X(BufferChain_segmentAt)                                                     \
+  X(BufferChain_c_ptr)                                                         \
+  X(BufferChain_toBuffer)                                                      \
+  X(MappedFile_constructor)                                                    \
+  X(MappedFile_constructor_copy)                                               \
+  X(MappedFile_operator_assign)                                                \
+  X(MappedFile_isValid)                                                        \
+  X(MappedFile_isWritable)                                                     \
+  X(MappedFile_getSize)                                                        \
+  X(MappedFile_setWindow)                                                      \
+  X(MappedFile_getWindowOffset)                                                \
+  X(MappedFile_getWindowLength)                                                \
+  X(MappedFile_c_ptr)                                                          \
+  X(MappedFile_writablePtr)                                                    \
+  X(MappedFile_toBuffer)                                                       \
+  X(MappedFile_flush)                                                          \
+  X(MappedFile_close)                                                          \
+  X(BufferedReader_constructor_file)                                           \
+  X(BufferedReader_constructor_subprocess)                                     \
+  X(BufferedReader_constructor_copy)                                           \
+  X(BufferedReader_operator_assign)                                            \
+  X(BufferedReader_readLine)                                                   \
+  X(BufferedReader_readUntil)                                                  \
+  X(BufferedReader_readExact)                                                  \
+  X(BufferedReader_forEachLine)                                                \
+  X(BufferedReader_isAtEnd)                                                    \
+  X(BufferedReader_bufferedCount)                                              \
+  X(BufferedWriter_constructor)                                                \
+  X(BufferedWriter_constructor_copy)                                           \
+  X(BufferedWriter_destructor)                                                 \
+  X(BufferedWriter_operator_assign)                                            \
+  X(BufferedWriter_write_buffer)                                               \
+  X(BufferedWriter_write_string)                                               \
+  X(BufferedWriter_write_ptr)                                                  \
+  X(BufferedWriter_flush)                                                      \
+  X(BufferedWriter_bufferedCount)                                              \
+  X(BufferedWriter_isBackground)                                               \
+  X(BufferedWriter_failed)                                                     \
+  X(AsyncResult_constructor_copy)                                              \
+  X(AsyncResult_operator_assign)                                               \
+  X(AsyncResult_isDone)                                                        \
+  X(AsyncResult_wait)                                                          \
+  X(AsyncResult_succeeded)                                                     \
+  X(AsyncResult_getCount)                                                      \
+  X(AsyncResult_getBuffer)                                                     \
+  X(AsyncResult_getFile)                                                       \
+  X(Poller_constructor)                                                        \
+  X(Poller_constructor_copy)                                                   \
+  X(Poller_operator_assign)                                                    \
+  X(Poller_add)                                                                \
+  X(Poller_remove)                                                             \
+  X(Poller_count)                                                              \
+  X(Poller_wait)                                                               \
+  X(Poller_readyFile)                                                          \
+  X(Poller_readyEvents)                                                        \
+  X(Poller_add_datagram)                                                       \
+  X(Poller_remove_datagram)                                                    \
+  X(Poller_readyDatagram)                                                      \
   X(Buffer_operator_eq)                                                        \
   X(Buffer_operator_ne)                                                        \
   X(Buffer_compact)                                                            \
@@ -224,6 +324,7 @@
   X(Buffer_crypt_buffer_iv)                                                    \
   X(Buffer_toBase64)                                                           \
   X(Buffer_fromBase64)                                                         \
+  X(Buffer_toBase64_variants)                                                  \
   X(Buffer_toString)                                                           \
   X(Buffer_toString_utf8)                                                      \
   X(Buffer_toString_ansi)                                                      \
@@ -250,6 +351,53 @@
   X(Mutex_lock)                                                                \
   X(Mutex_unlock)                                                              \
   X(Mutex_tryLock)                                                             \
+  X(CancelToken_constructor)                                                   \
+  X(CancelToken_constructor_copy)                                              \
+  X(CancelToken_operator_assign)                                               \
+  X(CancelToken_destructor)                                                    \
+  X(CancelToken_cancel)                                                        \
+  X(CancelToken_isCancelled)                                                   \
+  X(Future_constructor_copy)                                                   \
+  X(Future_operator_assign)                                                    \
+  X(Future_destructor)                                                         \
+  X(Future_isReady)                                                            \
+  X(Future_await)                                                              \
+  X(Future_wait)                                                               \
+  X(Future_cancel)                                                             \
+  X(Future_isCancelled)                                                        \
+  X(Future_then)                                                               \
+  X(ThreadPool_constructor)                                                    \
+  X(ThreadPool_constructor_copy)                                               \
+  X(ThreadPool_operator_assign)                                                \
+  X(ThreadPool_destructor)                                                     \
+  X(ThreadPool_submit)                                                         \
+  X(ThreadPool_submit_token)                                                   \
+  X(ThreadPool_getWorkerCount)                                                 \
+  X(ThreadPool_getPendingCount)                                                \
+  X(ThreadPool_getStealCount)                                                  \
+  X(ThreadPool_waitIdle)                                                       \
+  X(Hasher_constructor)                                                        \
+  X(Hasher_constructor_copy)                                                   \
+  X(Hasher_operator_assign)                                                    \
+  X(Hasher_update_buffer)                                                      \
+  X(Hasher_update_string)                                                      \
+  X(Hasher_update_pointer)                                                     \
+  X(Hasher_update_file)                                                        \
+  X(Hasher_reset)                                                              \
+  X(Hasher_hash64)                                                             \
+  X(Hasher_crc32c)                                                             \
+  X(Hasher_length)                                                             \
+  X(Digest_constructor)                                                        \
+  X(Digest_constructor_copy)                                                   \
+  X(Digest_operator_assign)                                                    \
+  X(Digest_update_buffer)                                                      \
+  X(Digest_update_string)                                                      \
+  X(Digest_update_pointer)                                                     \
+  X(Digest_update_file)                                                        \
+  X(Digest_reset)                                                              \
+  X(Digest_digest)                                                             \
+  X(Digest_hexDigest)                                                          \
+  X(Digest_algorithm)                                                          \
   X(Path_constructor_empty)                                                    \
   X(Path_constructor_string)                                                   \
   X(Path_constructor_copy)                                                     \
@@ -304,6 +452,8 @@
   X(Path_hasExtension)                                                         \
   X(Path_readToString)                                                         \
   X(Path_readToBuffer)                                                         \
+  X(Path_digest)                                                               \
+  X(Path_map)                                                                  \
   X(Path_writeFromBuffer)                                                      \
   X(Path_writeFromString)                                                      \
   X(Path_appendFromString)                                                     \
@@ -316,6 +466,87 @@
   X(Path_GetLocalAppDirectory)                                                 \
   X(Path_GetCurrentDirectory)                                                  \
   X(Path_GetCurrentExecutable)                                                 \
+  X(DirectoryWalker_constructor)                                               \
+  X(DirectoryWalker_constructor_copy)                                          \
+  X(DirectoryWalker_destructor)                                                \
+  X(DirectoryWalker_operator_assign)                                           \
+  X(DirectoryWalker_setFilter)                                                 \
+  X(DirectoryWalker_skipDirectories)                                           \
+  X(DirectoryWalker_setIncludeDirectories)                                     \
+  X(DirectoryWalker_next)                                                      \
+  X(DirectoryWalker_getPath)                                                   \
+  X(DirectoryWalker_getName)                                                   \
+  X(DirectoryWalker_getDepth)                                                  \
+  X(DirectoryWalker_isDirectory)                                               \
+  X(DirectoryWalker_isSymbolicLink)                                            \
+  X(DirectoryWalker_getAttributes)                                             \
+  X(DirectoryWalker_getSize)                                                   \
+  X(DirectoryWalker_getCreatedOn)                                              \
+  X(DirectoryWalker_getModifiedOn)                                             \
+  X(DirectoryWalker_getAccessedOn)                                             \
+  X(DirectoryWalker_getErrorCount)                                             \
+  X(DirectoryWatcher_constructor)                                              \
+  X(DirectoryWatcher_constructor_copy)                                         \
+  X(DirectoryWatcher_destructor)                                               \
+  X(DirectoryWatcher_operator_assign)                                          \
+  X(DirectoryWatcher_isValid)                                                  \
+  X(DirectoryWatcher_setCallback)                                              \
+  X(DirectoryWatcher_poll)                                                     \
+  X(DirectoryWatcher_stop)                                                     \
+  X(FileCopier_constructor)                                                    \
+  X(FileCopier_constructor_copy)                                               \
+  X(FileCopier_destructor)                                                     \
+  X(FileCopier_operator_assign)                                                \
+  X(FileCopier_setThreads)                                                     \
+  X(FileCopier_setIncremental)                                                 \
+  X(FileCopier_setUnbufferedThreshold)                                         \
+  X(FileCopier_setProgressCallback)                                            \
+  X(FileCopier_copy)                                                           \
+  X(FileCopier_move)                                                           \
+  X(FileCopier_getCopiedBytes)                                                 \
+  X(FileCopier_getCopiedFileCount)                                             \
+  X(FileCopier_getSkippedFileCount)                                            \
+  X(FileCopier_getFailedFileCount)                                             \
+  X(FileCopier_getElapsedMilliseconds)                                         \
+  X(FileCopier_getBytesPerSecond)                                              \
+  X(Search_constructor)                                                        \
+  X(Search_constructor_list)                                                   \
+  X(Search_constructor_copy)                                                   \
+  X(Search_destructor)                                                         \
+  X(Search_operator_assign)                                                    \
+  X(Search_setIgnoreCase)                                                      \
+  X(Search_setThreads)                                                         \
+  X(Search_setFilter)                                                          \
+  X(Search_skipDirectories)                                                    \
+  X(Search_run)                                                                \
+  X(Search_findAll)                                                            \
+  X(Search_getFileCount)                                                       \
+  X(Search_getBinaryFileCount)                                                 \
+  X(Datagram_constructor)                                                      \
+  X(Datagram_constructor_address)                                              \
+  X(Datagram_constructor_copy)                                                 \
+  X(Datagram_destructor)                                                       \
+  X(Datagram_operator_assign)                                                  \
+  X(Datagram_isValid)                                                          \
+  X(Datagram_getPort)                                                          \
+  X(Datagram_close)                                                            \
+  X(Datagram_sendTo_buffer)                                                    \
+  X(Datagram_sendTo_string)                                                    \
+  X(Datagram_sendBatch)                                                        \
+  X(Datagram_receiveFrom)                                                      \
+  X(Datagram_setReceiveRing)                                                   \
+  X(Datagram_receiveBatch)                                                     \
+  X(Datagram_packetData)                                                       \
+  X(Datagram_packet)                                                           \
+  X(Datagram_packetHost)                                                       \
+  X(Datagram_packetPort)                                                       \
+  X(Datagram_setNonBlocking)                                                   \
+  X(Datagram_isNonBlocking)                                                    \
+  X(Datagram_setBroadcast)                                                     \
+  X(Datagram_setBufferSizes)                                                   \
+  X(Datagram_joinGroup)                                                        \
+  X(Datagram_leaveGroup)                                                       \
+  X(Datagram_setMulticastOptions)                                              \
   X(File_constructor_empty)                                                    \
   X(File_constructor_path_mode)                                                \
   X(File_constructor_path_mode_binary)                                         \
@@ -329,6 +560,24 @@
   X(File_read_line)                                                            \
   X(File_write_string)                                                         \
   X(File_write_buffer)                                                         \
+  X(File_write_chain)                                                          \
+  X(File_sendFile)                                                             \
+  X(File_readAsync)                                                            \
+  X(File_writeAsync)                                                           \
+  X(File_acceptAsync)                                                          \
+  X(File_sendFileAsync)                                                        \
+  X(File_setNonBlocking)                                                       \
+  X(File_isNonBlocking)                                                        \
+  X(File_setNoDelay)                                                           \
+  X(File_setBufferSizes)                                                       \
+  X(File_setKeepAlive)                                                         \
+  X(File_setTimeouts)                                                          \
+  X(File_constructor_socket_timeout)                                           \
+  X(File_SetResolverCache)                                                     \
+  X(File_ClearResolverCache)                                                   \
+  X(File_GetResolverLookupCount)                                               \
+  X(File_readUntilClosed)                                                      \
+  X(File_readExact)                                                            \
   X(File_write_data)                                                           \
   X(File_writeLine)                                                            \
   X(File_flush)                                                                \
@@ -345,6 +594,7 @@
   X(File_send_string)                                                          \
   X(File_send_buffer)                                                          \
   X(File_receive)                                                              \
+  X(File_writeBase64)                                                          \
   X(Subprocess_constructor)                                                    \
   X(Subprocess_destructor)                                                     \
   X(Subprocess_operator_assign)                                                \
@@ -431,6 +681,8 @@
   X(WebRequest_destructor)                                                     \
   X(WebRequest_operator_assign)                                                \
   X(WebRequest_doGet)                                                          \
+  X(WebRequest_doGet_callback)                                                 \
+  X(WebRequest_doGet_file)                                                     \
   X(WebRequest_doPost_empty)                                                   \
   X(WebRequest_doPost_map)                                                     \
   X(WebRequest_doPost_list)                                                    \
@@ -442,6 +694,39 @@
   X(WebRequest_getHeaders)                                                     \
   X(WebRequest_hasCompleted)                                                   \
   X(WebRequest_Download)                                                       \
+  X(WebRequest_ResumeDownload)                                                 \
+  X(WebRequest_DoAll)                                                          \
+  X(WebRequest_SetConnectionPool)                                              \
+  X(WebRequest_GetNewConnectionCount)                                          \
+  X(WebRequest_GetReusedConnectionCount)                                       \
+  X(WebRequest_EnableCache)                                                    \
+  X(WebRequest_DisableCache)                                                   \
+  X(WebRequest_ClearCache)                                                     \
+  X(WebRequest_GetCacheHitCount)                                               \
+  X(WebRequest_GetCacheMissCount)                                              \
+  X(WebRequest_GetCacheRevalidationCount)                                      \
+  X(WebServerRequest_getMethod)                                                \
+  X(WebServerRequest_getPath)                                                  \
+  X(WebServerRequest_getQuery)                                                 \
+  X(WebServerRequest_getHeader)                                                \
+  X(WebServerRequest_getHeaders)                                               \
+  X(WebServerRequest_getBody)                                                  \
+  X(WebServerResponse_setStatus)                                               \
+  X(WebServerResponse_setHeader)                                               \
+  X(WebServerResponse_write_string)                                            \
+  X(WebServerResponse_write_buffer)                                            \
+  X(WebServerResponse_sendFile)                                                \
+  X(WebServer_constructor)                                                     \
+  X(WebServer_constructor_copy)                                                \
+  X(WebServer_destructor)                                                      \
+  X(WebServer_operator_assign)                                                 \
+  X(WebServer_addRoute)                                                        \
+  X(WebServer_start)                                                           \
+  X(WebServer_stop)                                                            \
+  X(WebServer_isRunning)                                                       \
+  X(WebServer_getPort)                                                         \
+  X(WebServer_getConnectionCount)                                              \
+  X(WebServer_getRequestCount)                                                 \
   X(AI_constructor)                                                            \
   X(AI_constructor_copy)                                                       \
   X(AI_destructor)                                                             \
@@ -506,6 +791,6 @@
   X(Console_Wrap)
 
 // Count of all registered functions
-#define FUNCTION_COUNT 499
+#define FUNCTION_COUNT 784
 
 #endif // TEST_FUNCTIONS_H
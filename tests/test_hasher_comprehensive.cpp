@@ -0,0 +1,139 @@
+#include "test_framework.h"
+
+void atto_main() {
+  EnableLoggingToFile("test_hasher_comprehensive.log", true);
+  Log("=== Comprehensive Hasher Class Tests ===");
+
+  // Hasher() - empty input
+  {
+    Hasher h;
+    REGISTER_TESTED(Hasher_constructor);
+    REGISTER_TESTED(Hasher_hash64);
+    REGISTER_TESTED(Hasher_crc32c);
+    REGISTER_TESTED(Hasher_length);
+    ASSERT_EQ(h.hash64(), Buffer().hash64());
+    ASSERT_EQ(h.crc32c(), 0);
+    ASSERT_EQ(h.length(), 0LL);
+    Log("Hasher(): passed");
+  }
+
+  // Hasher(seed)
+  {
+    Hasher seeded(42);
+    seeded.update(String("abc"));
+    Hasher unseeded;
+    unseeded.update(String("abc"));
+    ASSERT_NE(seeded.hash64(), unseeded.hash64());
+    ASSERT_EQ(seeded.crc32c(), unseeded.crc32c());
+    Log("Hasher(seed): passed");
+  }
+
+  // update(String)
+  {
+    Hasher h;
+    h.update(String("123")).update(String("456")).update(String("789"));
+    REGISTER_TESTED(Hasher_update_string);
+    ASSERT_EQ(h.crc32c(), String("123456789").crc32c());
+    ASSERT_EQ(h.hash64(), String("123456789").hash64());
+    ASSERT_EQ(h.length(), 9LL);
+    Log("update(String): passed");
+  }
+
+  // update(Buffer) - pieces that straddle the 32-byte stripes
+  {
+    Buffer whole;
+    for (int i = 0; i < 1000; i++) {
+      unsigned char byte = (unsigned char)(i * 13);
+      whole.append(&byte, 1);
+    }
+
+    Hasher h;
+    int pos = 0;
+    int step = 1;
+    while (pos < whole.length()) {
+      int end = pos + step;
+      if (end > whole.length())
+        end = whole.length();
+      h.update(whole.slice(pos, end));
+      pos = end;
+      step = step * 2 + 1;
+    }
+    REGISTER_TESTED(Hasher_update_buffer);
+    ASSERT_EQ(h.hash64(), whole.hash64());
+    ASSERT_EQ(h.crc32c(), whole.crc32c());
+    ASSERT_EQ(h.length(), 1000LL);
+    Log("update(Buffer): passed");
+  }
+
+  // update(ptr, size)
+  {
+    const unsigned char data[] = {'a', 'b', 'c'};
+    Hasher h;
+    h.update(data, 3);
+    h.update(nullptr, 5);
+    REGISTER_TESTED(Hasher_update_pointer);
+    ASSERT_EQ(h.hash64(), String("abc").hash64());
+    ASSERT_EQ(h.length(), 3LL);
+    Log("update(ptr, size): passed");
+  }
+
+  // Hasher(const Hasher&) and operator= - independent state
+  {
+    Hasher a;
+    a.update(String("abc"));
+    Hasher b(a);
+    REGISTER_TESTED(Hasher_constructor_copy);
+    b.update(String("def"));
+    ASSERT_EQ(a.hash64(), String("abc").hash64());
+    ASSERT_EQ(b.hash64(), String("abcdef").hash64());
+
+    Hasher c;
+    c = b;
+    REGISTER_TESTED(Hasher_operator_assign);
+    ASSERT_EQ(c.hash64(), b.hash64());
+    ASSERT_EQ(c.crc32c(), b.crc32c());
+    Log("copy and assignment: passed");
+  }
+
+  // reset()
+  {
+    Hasher h(7);
+    h.update(String("garbage"));
+    h.reset();
+    REGISTER_TESTED(Hasher_reset);
+    h.update(String("abc"));
+    Hasher fresh(7);
+    fresh.update(String("abc"));
+    ASSERT_EQ(h.hash64(), fresh.hash64());
+    ASSERT_EQ(h.length(), 3LL);
+    Log("reset(): passed");
+  }
+
+  // update(File)
+  {
+    Path path("test_hasher_temp.bin");
+    path.deleteFile();
+    Buffer data;
+    for (int i = 0; i < 200000; i++) {
+      unsigned char byte = (unsigned char)(i * 31 + 7);
+      data.append(&byte, 1);
+    }
+    path.writeFromBuffer(data);
+
+    File f(path);
+    Hasher h;
+    h.update(f);
+    REGISTER_TESTED(Hasher_update_file);
+    f.close();
+    ASSERT_EQ(h.length(), 200000LL);
+    ASSERT_EQ(h.hash64(), data.hash64());
+    ASSERT_EQ(h.crc32c(), data.crc32c());
+    path.deleteFile();
+    Log("update(File): passed");
+  }
+
+  Log("=== All Hasher Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_hasher_comprehensive");
+  Exit(0);
+}
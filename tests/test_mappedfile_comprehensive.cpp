@@ -0,0 +1,154 @@
+#include "test_framework.h"
+
+void atto_main() {
+  EnableLoggingToFile("test_mappedfile_comprehensive.log", true);
+  Log("=== Comprehensive MappedFile Class Tests ===");
+
+  Path path("test_mappedfile_temp.bin");
+  path.deleteFile();
+
+  // 200 KB spans several 64 KB allocation-granularity blocks
+  Buffer data;
+  for (int i = 0; i < 200000; i++) {
+    unsigned char byte = (unsigned char)(i * 7 + i / 256);
+    data.append(&byte, 1);
+  }
+  path.writeFromBuffer(data);
+
+  // MappedFile(const Path&) - read-only, whole file in the first window
+  {
+    MappedFile mapped(path);
+    REGISTER_TESTED(MappedFile_constructor);
+    REGISTER_TESTED(MappedFile_isValid);
+    REGISTER_TESTED(MappedFile_isWritable);
+    REGISTER_TESTED(MappedFile_getSize);
+    REGISTER_TESTED(MappedFile_getWindowOffset);
+    REGISTER_TESTED(MappedFile_getWindowLength);
+    ASSERT_TRUE(mapped.isValid());
+    ASSERT_FALSE(mapped.isWritable());
+    ASSERT_EQ(mapped.getSize(), 200000LL);
+    ASSERT_EQ(mapped.getWindowOffset(), 0LL);
+    ASSERT_EQ(mapped.getWindowLength(), 200000);
+    ASSERT(mapped.writablePtr(nullptr) == nullptr);
+
+    int len = 0;
+    const unsigned char *bytes = mapped.c_ptr(&len);
+    REGISTER_TESTED(MappedFile_c_ptr);
+    ASSERT_EQ(len, 200000);
+    ASSERT_TRUE(Buffer(bytes, len).compare(data));
+    Log("MappedFile(Path): passed");
+  }
+
+  // Path::map()
+  {
+    MappedFile mapped = path.map();
+    REGISTER_TESTED(Path_map);
+    ASSERT_TRUE(mapped.isValid());
+    ASSERT_EQ(mapped.getSize(), 200000LL);
+    Log("Path::map(): passed");
+  }
+
+  // setWindow() - unaligned offsets and clamping at the end of the file
+  {
+    MappedFile mapped(path);
+    ASSERT_TRUE(mapped.setWindow(70001, 1000));
+    REGISTER_TESTED(MappedFile_setWindow);
+    ASSERT_EQ(mapped.getWindowOffset(), 70001LL);
+    ASSERT_EQ(mapped.getWindowLength(), 1000);
+    int len = 0;
+    const unsigned char *bytes = mapped.c_ptr(&len);
+    ASSERT_TRUE(Buffer(bytes, len).compare(data.slice(70001, 71001)));
+
+    ASSERT_TRUE(mapped.setWindow(199990));
+    ASSERT_EQ(mapped.getWindowLength(), 10);
+    ASSERT_TRUE(mapped.setWindow(200000, 10));
+    ASSERT_EQ(mapped.getWindowLength(), 0);
+    ASSERT_FALSE(mapped.setWindow(200001));
+    ASSERT_FALSE(mapped.setWindow(-1));
+    Log("setWindow(): passed");
+  }
+
+  // toBuffer() - outlives the window and the mapping
+  {
+    Buffer window;
+    {
+      MappedFile mapped(path);
+      mapped.setWindow(100, 50);
+      window = mapped.toBuffer();
+      REGISTER_TESTED(MappedFile_toBuffer);
+      mapped.setWindow(0, 10);
+    }
+    ASSERT_EQ(window.length(), 50);
+    ASSERT_TRUE(window.compare(data.slice(100, 150)));
+
+    int dataLen = 0;
+    const unsigned char *raw = data.c_ptr(&dataLen);
+    BufferView view(window);
+    ASSERT_EQ(view.readU8(), (int)raw[100]);
+
+    window.append(String("!"));
+    ASSERT_EQ(window.length(), 51);
+    ASSERT_TRUE(window.slice(0, 50).compare(data.slice(100, 150)));
+    Log("toBuffer(): passed");
+  }
+
+  // Writable mapping, flush(), and copies sharing the mapping
+  {
+    MappedFile mapped(path, true);
+    ASSERT_TRUE(mapped.isWritable());
+    int len = 0;
+    unsigned char *bytes = mapped.writablePtr(&len);
+    REGISTER_TESTED(MappedFile_writablePtr);
+    ASSERT_EQ(len, 200000);
+    bytes[0] = 'A';
+    bytes[199999] = 'Z';
+
+    MappedFile copy(mapped);
+    REGISTER_TESTED(MappedFile_constructor_copy);
+    ASSERT(copy.c_ptr(&len)[0] == 'A');
+
+    MappedFile assigned(path);
+    assigned = mapped;
+    REGISTER_TESTED(MappedFile_operator_assign);
+    ASSERT_TRUE(assigned.isWritable());
+
+    ASSERT_TRUE(mapped.flush());
+    REGISTER_TESTED(MappedFile_flush);
+    mapped.close();
+    REGISTER_TESTED(MappedFile_close);
+    ASSERT_FALSE(copy.isValid());
+
+    Buffer reread = path.readToBuffer();
+    int rereadLen = 0;
+    const unsigned char *rereadBytes = reread.c_ptr(&rereadLen);
+    ASSERT_EQ(rereadLen, 200000);
+    ASSERT(rereadBytes[0] == 'A');
+    ASSERT(rereadBytes[199999] == 'Z');
+    Log("writable mapping: passed");
+  }
+
+  // Empty and missing files
+  {
+    Path emptyPath("test_mappedfile_empty.bin");
+    emptyPath.writeFromString(String());
+    MappedFile empty(emptyPath);
+    ASSERT_TRUE(empty.isValid());
+    ASSERT_EQ(empty.getSize(), 0LL);
+    ASSERT_EQ(empty.getWindowLength(), 0);
+    ASSERT_TRUE(empty.toBuffer().isEmpty());
+    empty.close();
+    emptyPath.deleteFile();
+
+    MappedFile missing(Path("test_mappedfile_missing.bin"));
+    ASSERT_FALSE(missing.isValid());
+    ASSERT(missing.c_ptr(nullptr) == nullptr);
+    Log("empty/missing files: passed");
+  }
+
+  path.deleteFile();
+
+  Log("=== All MappedFile Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_mappedfile_comprehensive");
+  Exit(0);
+}
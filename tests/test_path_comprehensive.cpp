@@ -102,6 +102,20 @@ void atto_main() {
     Log("readToBuffer(): passed");
   }
 
+  // digest()
+  {
+    Path p(testFile);
+    p.writeFromString(String("abc"));
+    Buffer sha = p.digest();
+    REGISTER_TESTED(Path_digest);
+    ASSERT_TRUE(sha.compare(Buffer(String("abc")).sha256()));
+    Buffer blake = p.digest(DIGEST_BLAKE2S);
+    ASSERT_TRUE(blake.compare(Buffer(String("abc")).blake2s()));
+    p.deleteFile();
+    ASSERT_TRUE(p.digest().isEmpty());
+    Log("digest(): passed");
+  }
+
   // appendFromString()
   {
     Path p(testFile);
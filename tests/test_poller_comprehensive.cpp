@@ -0,0 +1,150 @@
+#include "test_framework.h"
+
+struct PollerWait {
+  Poller *poller;
+  int result;
+};
+
+static void *WaitOnPoller(void *arg) {
+  PollerWait *state = (PollerWait *)arg;
+  state->result = state->poller->wait(5000);
+  return nullptr;
+}
+
+void atto_main() {
+  EnableLoggingToFile("test_poller_comprehensive.log", true);
+  Log("=== Comprehensive Poller and Non-Blocking File Tests ===");
+
+  Path path("test_poller_temp.txt");
+  path.deleteFile();
+
+  // Empty poller
+  {
+    Poller poller;
+    REGISTER_TESTED(Poller_constructor);
+    REGISTER_TESTED(Poller_count);
+    REGISTER_TESTED(Poller_wait);
+    REGISTER_TESTED(Poller_readyFile);
+    REGISTER_TESTED(Poller_readyEvents);
+    ASSERT_EQ(poller.count(), 0);
+    ASSERT_EQ(poller.wait(0), 0);
+    ASSERT_FALSE(poller.readyFile(0).isValid());
+    ASSERT_EQ(poller.readyEvents(0), 0);
+    Log("empty poller: passed");
+  }
+
+  // Regular files cannot be polled or made non-blocking
+  {
+    path.writeFromString(String("data"));
+    File f(path);
+    Poller poller;
+    REGISTER_TESTED(Poller_add);
+    REGISTER_TESTED(Poller_remove);
+    REGISTER_TESTED(File_setNonBlocking);
+    REGISTER_TESTED(File_isNonBlocking);
+    ASSERT_FALSE(poller.add(f));
+    ASSERT_EQ(poller.count(), 0);
+    ASSERT_FALSE(poller.remove(f));
+    ASSERT_FALSE(f.setNonBlocking(true));
+    ASSERT_FALSE(f.isNonBlocking());
+    f.close();
+    ASSERT_FALSE(poller.add(f));
+    path.deleteFile();
+    Log("regular files rejected: passed");
+  }
+
+  // Poller(const Poller&) and operator= share registrations
+  {
+    Poller a;
+    Poller b(a);
+    REGISTER_TESTED(Poller_constructor_copy);
+    Poller c;
+    c = a;
+    REGISTER_TESTED(Poller_operator_assign);
+    ASSERT_EQ(b.count(), 0);
+    ASSERT_EQ(c.count(), 0);
+    Log("copy and assignment: passed");
+  }
+
+  // Readiness on loopback sockets
+  {
+    const int port = 47932;
+    File server(port);
+    if (!server.isValid()) {
+      Log("socket polling: skipped (port unavailable)");
+    } else {
+      Poller poller;
+      ASSERT_TRUE(poller.add(server));
+      ASSERT_TRUE(poller.add(server));
+      ASSERT_EQ(poller.count(), 1);
+      ASSERT_EQ(poller.wait(0), 0);
+
+      File client(String("127.0.0.1"), port);
+      ASSERT_TRUE(client.isValid());
+      ASSERT_EQ(poller.wait(5000), 1);
+      ASSERT_TRUE(poller.readyFile(0).isServerSocket());
+      ASSERT_TRUE((poller.readyEvents(0) & POLL_READABLE) != 0);
+
+      ASSERT_TRUE(server.setNonBlocking(true));
+      ASSERT_TRUE(server.isNonBlocking());
+      File connection = server.accept();
+      ASSERT_TRUE(connection.isValid());
+      ASSERT_TRUE(connection.isNonBlocking());
+      ASSERT_TRUE(server.setNonBlocking(false));
+      ASSERT_FALSE(server.isNonBlocking());
+
+      // Nothing to read yet: a non-blocking read returns immediately.
+      ASSERT_TRUE(connection.readToBuffer(16).isEmpty());
+
+      Poller shared(poller);
+      ASSERT_TRUE(shared.add(connection));
+      ASSERT_EQ(poller.count(), 2);
+      ASSERT_EQ(poller.wait(0), 0);
+
+      client.write(String("hello"));
+      ASSERT_EQ(poller.wait(5000), 1);
+      ASSERT_TRUE(poller.readyFile(0).isSocket());
+      ASSERT_TRUE((poller.readyEvents(0) & POLL_READABLE) != 0);
+      ASSERT_EQ(connection.readToString(16), String("hello"));
+
+      // Writable readiness is reported when requested.
+      ASSERT_TRUE(poller.add(connection, POLL_READABLE | POLL_WRITABLE));
+      ASSERT_EQ(poller.count(), 2);
+      ASSERT_EQ(poller.wait(5000), 1);
+      ASSERT_EQ(poller.readyEvents(0) & POLL_WRITABLE, (int)POLL_WRITABLE);
+
+      // wait() does not hold the poller while it blocks, so another thread
+      // can change the registrations meanwhile.
+      ASSERT_TRUE(poller.add(connection));
+      PollerWait state = {&poller, -1};
+      Thread waiter(WaitOnPoller, &state);
+      Sleep(100);
+      DateTime start;
+      ASSERT_TRUE(poller.add(connection, POLL_READABLE));
+      ASSERT_EQ(poller.count(), 2);
+      ASSERT_TRUE(DateTime().diff(start) < 1000);
+      client.write(String("x"));
+      waiter.await();
+      ASSERT_EQ(state.result, 1);
+      ASSERT_EQ(connection.readToString(16), String("x"));
+
+      // A closed peer wakes the poller.
+      ASSERT_TRUE(poller.add(connection));
+      client.close();
+      ASSERT_EQ(poller.wait(5000), 1);
+      ASSERT_TRUE((poller.readyEvents(0) & (POLL_READABLE | POLL_CLOSED)) != 0);
+
+      ASSERT_TRUE(poller.remove(connection));
+      ASSERT_FALSE(poller.remove(connection));
+      ASSERT_EQ(poller.count(), 1);
+      connection.close();
+      server.close();
+      Log("socket polling: passed");
+    }
+  }
+
+  Log("=== All Poller Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_poller_comprehensive");
+  Exit(0);
+}
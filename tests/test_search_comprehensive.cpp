@@ -0,0 +1,158 @@
+#include "test_framework.h"
+
+static int g_seen = 0;
+
+static bool CountMatch(const String &path, int line, int column,
+                       const String &text, int pattern, void *arg) {
+  g_seen++;
+  return true;
+}
+
+static bool StopAtFirst(const String &path, int line, int column,
+                        const String &text, int pattern, void *arg) {
+  return false;
+}
+
+static String Join(const Path &dir, const char *name) {
+  return dir.toString() + "\\" + name;
+}
+
+static int IntField(const Map &match, const char *key) {
+  return match.get<String, int>(String(key));
+}
+
+static String TextField(const Map &match, const char *key) {
+  return match.get<String, String>(String(key));
+}
+
+// Returns the match at line of the file called name, or an empty Map.
+static Map FindMatch(const List &matches, const String &name, int line) {
+  for (int i = 0; i < matches.length(); i++) {
+    Map match = matches.at<Map>(i);
+    if (TextField(match, "path").endsWith(name) &&
+        IntField(match, "line") == line)
+      return match;
+  }
+  return Map();
+}
+
+void atto_main() {
+  EnableLoggingToFile("test_search_comprehensive.log", true);
+  Log("=== Search Tests ===");
+
+  Path root = Path::CreateTemporaryDirectory("search");
+  ASSERT_TRUE(Path(Join(root, "sub")).makeDirectory());
+  ASSERT_TRUE(Path(Join(root, ".git")).makeDirectory());
+  ASSERT_TRUE(Path(Join(root, "a.cpp")).writeFromString(
+      "int x;\r\n  // needle here\r\nneedle needle\r\n"));
+  ASSERT_TRUE(Path(Join(root, "sub\\b.h"))
+                  .writeFromString("first\nsecond\nthe NEEDLE\n"));
+  ASSERT_TRUE(Path(Join(root, ".git\\index")).writeFromString("needle\n"));
+  Buffer binary;
+  binary.append(String("needle"));
+  binary.append(Buffer((const unsigned char *)"\0\1\2", 3));
+  binary.append(String("needle"));
+  ASSERT_TRUE(Path(Join(root, "image.bin")).writeFromBuffer(binary));
+
+  // One pattern over the tree, with line and column.
+  {
+    Search search(String("needle"));
+    REGISTER_TESTED(Search_constructor);
+    search.skipDirectories(".git");
+    REGISTER_TESTED(Search_skipDirectories);
+    List matches = search.findAll(root);
+    REGISTER_TESTED(Search_findAll);
+    ASSERT_EQ(matches.length(), 3);
+    Map first = FindMatch(matches, "a.cpp", 2);
+    ASSERT_EQ(IntField(first, "column"), 6);
+    ASSERT_EQ(TextField(first, "text"),
+              String("  // needle here"));
+    ASSERT_EQ(IntField(first, "pattern"), 0);
+    Map second = FindMatch(matches, "a.cpp", 3);
+    ASSERT_EQ(TextField(second, "text"),
+              String("needle needle"));
+    ASSERT_EQ(search.getFileCount(), 2);
+    REGISTER_TESTED(Search_getFileCount);
+    ASSERT_EQ(search.getBinaryFileCount(), 1);
+    REGISTER_TESTED(Search_getBinaryFileCount);
+    Log("single pattern: passed");
+  }
+
+  // Several patterns at once, ignoring case.
+  {
+    List patterns;
+    patterns.append(String("needle"));
+    patterns.append(String("second"));
+    Search search(patterns);
+    REGISTER_TESTED(Search_constructor_list);
+    search.setIgnoreCase(true).setThreads(2).skipDirectories(".git");
+    REGISTER_TESTED(Search_setIgnoreCase);
+    REGISTER_TESTED(Search_setThreads);
+    List matches = search.findAll(root);
+    ASSERT_EQ(matches.length(), 5);
+    Map upper = FindMatch(matches, "b.h", 3);
+    ASSERT_EQ(IntField(upper, "column"), 5);
+    ASSERT_EQ(IntField(upper, "pattern"), 0);
+    Map other = FindMatch(matches, "b.h", 2);
+    ASSERT_EQ(IntField(other, "pattern"), 1);
+
+    // An empty pattern never matches but keeps its place in the list.
+    List withEmpty;
+    withEmpty.append(String(""));
+    withEmpty.append(String("second"));
+    Map second = FindMatch(Search(withEmpty).findAll(root), "b.h", 2);
+    ASSERT_EQ(IntField(second, "pattern"), 1);
+    Log("multiple patterns: passed");
+  }
+
+  // Overlapping occurrences are all reported, by both matchers.
+  {
+    String file = Join(root, "sub\\repeat.txt");
+    ASSERT_TRUE(Path(file).writeFromString("aaaa"));
+    ASSERT_EQ(Search(String("aa")).findAll(Path(file)).length(), 3);
+    List patterns;
+    patterns.append(String("aa"));
+    patterns.append(String("aaa"));
+    ASSERT_EQ(Search(patterns).findAll(Path(file)).length(), 5);
+    ASSERT_TRUE(Path(file).deleteFile());
+    Log("overlapping: passed");
+  }
+
+  // Name filters, callbacks, stopping early and limits.
+  {
+    Search search(String("needle"));
+    search.setFilter("*.CPP");
+    REGISTER_TESTED(Search_setFilter);
+    g_seen = 0;
+    ASSERT_EQ(search.run(root, CountMatch), 3);
+    REGISTER_TESTED(Search_run);
+    ASSERT_EQ(g_seen, 3);
+    ASSERT_EQ(search.run(root, StopAtFirst), 1);
+    ASSERT_EQ(search.findAll(root, 2).length(), 2);
+    ASSERT_EQ(search.run(Path(Join(root, "missing")), CountMatch), -1);
+    Log("filters and limits: passed");
+  }
+
+  // Copies share the settings.
+  {
+    Search search(String("needle"));
+    Search copy(search);
+    REGISTER_TESTED(Search_constructor_copy);
+    Search assigned(String("x"));
+    assigned = copy;
+    REGISTER_TESTED(Search_operator_assign);
+    search.setFilter("*.h");
+    ASSERT_EQ(assigned.findAll(root).length(), 0);
+    search.setIgnoreCase(true);
+    ASSERT_EQ(assigned.findAll(root).length(), 1);
+    REGISTER_TESTED(Search_destructor);
+    Log("copies: passed");
+  }
+
+  root.removeDirectory(true);
+
+  Log("=== All Search Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_search_comprehensive");
+  Exit(0);
+}
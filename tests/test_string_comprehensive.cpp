@@ -525,6 +525,23 @@ void atto_main() {
     Log("hash(): passed");
   }
 
+  // hash64()
+  {
+    String s("abc");
+    REGISTER_TESTED(String_hash64);
+    ASSERT_EQ(s.hash64(), (long long)0x44BC2CF5AD770999ULL);
+    ASSERT_EQ(s.hash64(), Buffer(s).hash64());
+    Log("hash64(): passed");
+  }
+
+  // crc32c()
+  {
+    String s("123456789");
+    REGISTER_TESTED(String_crc32c);
+    ASSERT_EQ(s.crc32c(), (int)0xE3069283u);
+    Log("crc32c(): passed");
+  }
+
   // ========== ADVANCED OPERATIONS ==========
 
   // lines()
@@ -0,0 +1,202 @@
+#include "test_framework.h"
+
+static void *Square(void *arg, const CancelToken &token) {
+  long long value = (long long)arg;
+  return (void *)(value * value);
+}
+
+static void *AddOne(void *result, void *arg) {
+  return (void *)((long long)result + 1);
+}
+
+static void *Increment(void *arg, const CancelToken &token) {
+  InterlockedIncrement((volatile LONG *)arg);
+  return nullptr;
+}
+
+// Holds its worker until *gate is set.
+static void *Block(void *arg, const CancelToken &token) {
+  volatile LONG *gate = (volatile LONG *)arg;
+  while (!*gate)
+    Sleep(1);
+  return (void *)1;
+}
+
+static volatile LONG g_started = 0;
+
+// Runs until cancelled.
+static void *RunUntilCancelled(void *arg, const CancelToken &token) {
+  InterlockedExchange(&g_started, 1);
+  while (!token.isCancelled())
+    Sleep(1);
+  return (void *)2;
+}
+
+struct SumRange {
+  ThreadPool *pool;
+  int first;
+  int count;
+};
+
+// Sums first..first+count-1 by splitting the range into subtasks and
+// awaiting them on the worker.
+static void *SumTask(void *arg, const CancelToken &token) {
+  SumRange *range = (SumRange *)arg;
+  if (range->count <= 16) {
+    long long sum = 0;
+    for (int i = 0; i < range->count; i++)
+      sum += range->first + i;
+    return (void *)sum;
+  }
+  int half = range->count / 2;
+  SumRange left = {range->pool, range->first, half};
+  SumRange right = {range->pool, range->first + half, range->count - half};
+  Future leftSum = range->pool->submit(SumTask, &left);
+  Future rightSum = range->pool->submit(SumTask, &right);
+  return (void *)((long long)leftSum.await() + (long long)rightSum.await());
+}
+
+static long long AwaitSum(ThreadPool &pool, int count) {
+  SumRange range = {&pool, 1, count};
+  return (long long)pool.submit(SumTask, &range).await();
+}
+
+void atto_main() {
+  EnableLoggingToFile("test_threadpool_comprehensive.log", true);
+  Log("=== ThreadPool Tests ===");
+
+  ThreadPool pool(4);
+  REGISTER_TESTED(ThreadPool_constructor);
+  ASSERT_EQ(pool.getWorkerCount(), 4);
+  REGISTER_TESTED(ThreadPool_getWorkerCount);
+
+  // Results and continuations.
+  {
+    Future square = pool.submit(Square, (void *)7);
+    REGISTER_TESTED(ThreadPool_submit);
+    ASSERT_EQ((long long)square.await(), 49);
+    REGISTER_TESTED(Future_await);
+    ASSERT_TRUE(square.isReady());
+    REGISTER_TESTED(Future_isReady);
+    ASSERT_FALSE(square.isCancelled());
+    REGISTER_TESTED(Future_isCancelled);
+
+    Future chained = pool.submit(Square, (void *)3).then(AddOne);
+    REGISTER_TESTED(Future_then);
+    ASSERT_EQ((long long)chained.await(), 10);
+
+    // A finished future runs the continuation at once.
+    Future now = square.then(AddOne);
+    ASSERT_TRUE(now.isReady());
+    ASSERT_EQ((long long)now.await(), 50);
+    Log("submit, await and then: passed");
+  }
+
+  // Many small tasks.
+  {
+    volatile LONG count = 0;
+    for (int i = 0; i < 10000; i++)
+      pool.submit(Increment, (void *)&count);
+    ASSERT_TRUE(pool.waitIdle());
+    REGISTER_TESTED(ThreadPool_waitIdle);
+    ASSERT_EQ((int)count, 10000);
+    ASSERT_EQ(pool.getPendingCount(), 0);
+    REGISTER_TESTED(ThreadPool_getPendingCount);
+    Log("many tasks: passed");
+  }
+
+  // Tasks awaiting their own subtasks, even on a single worker.
+  {
+    ASSERT_EQ(AwaitSum(pool, 10000), 50005000LL);
+    ASSERT_TRUE(pool.getStealCount() > 0);
+    REGISTER_TESTED(ThreadPool_getStealCount);
+    ThreadPool single(1);
+    ASSERT_EQ(AwaitSum(single, 1000), 500500LL);
+    Log("fan-out and fan-in: passed");
+  }
+
+  // Cancellation.
+  {
+    ThreadPool single(1);
+    volatile LONG gate = 0;
+    Future blocker = single.submit(Block, (void *)&gate);
+    ASSERT_FALSE(blocker.wait(20));
+    REGISTER_TESTED(Future_wait);
+
+    Future skipped = single.submit(Square, (void *)5);
+    Future after = skipped.then(AddOne);
+    skipped.cancel();
+    REGISTER_TESTED(Future_cancel);
+    ASSERT_TRUE(skipped.isCancelled());
+    ASSERT_TRUE(skipped.await() == nullptr);
+    ASSERT_TRUE(after.isCancelled());
+
+    CancelToken group;
+    REGISTER_TESTED(CancelToken_constructor);
+    CancelToken copy(group);
+    REGISTER_TESTED(CancelToken_constructor_copy);
+    CancelToken assigned;
+    assigned = copy;
+    REGISTER_TESTED(CancelToken_operator_assign);
+    Future first = single.submit(Square, (void *)2, group);
+    REGISTER_TESTED(ThreadPool_submit_token);
+    Future second = single.submit(Square, (void *)3, assigned);
+    ASSERT_FALSE(group.isCancelled());
+    REGISTER_TESTED(CancelToken_isCancelled);
+    copy.cancel();
+    REGISTER_TESTED(CancelToken_cancel);
+    ASSERT_TRUE(group.isCancelled());
+
+    InterlockedExchange(&gate, 1);
+    ASSERT_TRUE(blocker.wait());
+    ASSERT_TRUE(first.await() == nullptr);
+    ASSERT_TRUE(second.isCancelled());
+
+    // A running task sees the cancellation and returns early.
+    Future running = single.submit(RunUntilCancelled);
+    while (!g_started)
+      Sleep(1);
+    running.cancel();
+    ASSERT_EQ((long long)running.await(), 2);
+    ASSERT_FALSE(running.isCancelled());
+
+    Future invalid = single.submit(nullptr);
+    ASSERT_TRUE(invalid.isCancelled());
+    ASSERT_TRUE(invalid.isReady());
+    Log("cancellation: passed");
+  }
+
+  // Copies share the pool; the last one finishes queued tasks.
+  {
+    volatile LONG count = 0;
+    {
+      ThreadPool shared(2);
+      ThreadPool copy(shared);
+      REGISTER_TESTED(ThreadPool_constructor_copy);
+      ThreadPool assigned(1);
+      assigned = copy;
+      REGISTER_TESTED(ThreadPool_operator_assign);
+      ASSERT_EQ(assigned.getWorkerCount(), 2);
+      for (int i = 0; i < 1000; i++)
+        shared.submit(Increment, (void *)&count);
+
+      Future result = assigned.submit(Square, (void *)4);
+      Future copied(result);
+      REGISTER_TESTED(Future_constructor_copy);
+      Future other = pool.submit(Square, (void *)1);
+      other = copied;
+      REGISTER_TESTED(Future_operator_assign);
+      ASSERT_EQ((long long)other.await(), 16);
+    }
+    REGISTER_TESTED(ThreadPool_destructor);
+    REGISTER_TESTED(Future_destructor);
+    REGISTER_TESTED(CancelToken_destructor);
+    ASSERT_EQ((int)count, 1000);
+    Log("copies and shutdown: passed");
+  }
+
+  Log("=== All ThreadPool Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_threadpool_comprehensive");
+  Exit(0);
+}
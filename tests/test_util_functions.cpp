@@ -107,6 +107,24 @@ void atto_main() {
         Log("EnableLoggingToFile: passed (using file logging)");
     }
 
+    // Test EnableLoggingToFile(buffered) and FlushLog
+    {
+        EnableLoggingToFile("test_util_functions_buffered.log", true, true);
+        for (int i = 0; i < 1000; i++) {
+            Log("buffered line ", i);
+        }
+        FlushLog();
+        REGISTER_TESTED(FlushLog);
+        EnableLoggingToFile("test_util_functions.log", false);
+
+        Path bufferedLog("test_util_functions_buffered.log");
+        List lines = bufferedLog.readToString().trim().lines();
+        ASSERT_EQ(lines.length(), 1000);
+        ASSERT_EQ(lines.at<String>(999), String("buffered line 999"));
+        bufferedLog.deleteFile();
+        Log("EnableLoggingToFile(buffered)/FlushLog: passed");
+    }
+
     // Note: EnableLoggingToConsole is not tested to avoid console output issues
     // REGISTER_TESTED(EnableLoggingToConsole);
 
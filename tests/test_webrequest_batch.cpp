@@ -0,0 +1,136 @@
+#include "test_framework.h"
+
+static volatile LONG g_flakyCalls = 0;
+
+static void Echo(const WebServerRequest &request, WebServerResponse &response,
+                 void *arg) {
+  // Later items answer first, so completion order differs from list order.
+  int delay = request.getQuery().toInteger();
+  if (delay > 0)
+    Sleep(delay);
+  response.write(request.getMethod() + " " + request.getQuery() + " " +
+                 request.getBody().toString());
+}
+
+static void Flaky(const WebServerRequest &request, WebServerResponse &response,
+                  void *arg) {
+  if (InterlockedIncrement(&g_flakyCalls) <= 2) {
+    response.setStatus(503);
+    response.write(String("busy"));
+    return;
+  }
+  response.write(String("ok"));
+}
+
+struct Collected {
+  List indexes;
+  List bodies;
+  List statuses;
+};
+
+static void Collect(int index, const WebResponse &response, void *arg) {
+  Collected *collected = (Collected *)arg;
+  collected->indexes.append(index);
+  collected->bodies.append(response.asString());
+  collected->statuses.append(response.getStatusCode());
+}
+
+void atto_main() {
+  EnableLoggingToFile("test_webrequest_batch.log", true);
+  Log("=== WebRequest Batch Tests ===");
+
+  WebServer server(0);
+  server.addRoute("", "/echo", Echo);
+  server.addRoute("GET", "/flaky", Flaky);
+  ASSERT_TRUE(server.start());
+  String base = String("http://127.0.0.1:") + String(server.getPort());
+
+  List requests;
+  for (int i = 0; i < 6; i++)
+    requests.append(base + "/echo?" + String((6 - i) * 40));
+
+  // Ordered delivery follows the list.
+  {
+    Collected collected;
+    ASSERT_EQ(WebRequest::DoAll(requests, Collect, &collected, 6, 5000, 0, 0,
+                                true),
+              6);
+    REGISTER_TESTED(WebRequest_DoAll);
+    ASSERT_EQ(collected.indexes.length(), 6);
+    for (int i = 0; i < 6; i++) {
+      ASSERT_EQ(collected.indexes.at<int>(i), i);
+      ASSERT_EQ(collected.bodies.at<String>(i),
+                String("GET ") + String((6 - i) * 40) + " ");
+    }
+    Log("ordered delivery: passed");
+  }
+
+  // Unordered delivery reports each item once, as it finishes.
+  {
+    Collected collected;
+    ASSERT_EQ(WebRequest::DoAll(requests, Collect, &collected, 6, 5000), 6);
+    ASSERT_EQ(collected.indexes.length(), 6);
+    Set seen;
+    for (int i = 0; i < 6; i++)
+      seen.put(collected.indexes.at<int>(i));
+    ASSERT_EQ(seen.length(), 6);
+    Log("completion order delivery: passed");
+  }
+
+  // Map items choose the method, body and per-request timeout.
+  {
+    List items;
+    Map post;
+    post.put("url", base + "/echo");
+    post.put("method", "put");
+    post.put("body", "payload");
+    items.append(post);
+    Map json;
+    json.put("url", base + "/echo");
+    json.put("method", "POST");
+    Map body;
+    body.put("a", 1);
+    json.put("body", body);
+    json.put("timeout", 5000);
+    items.append(json);
+
+    Collected collected;
+    ASSERT_EQ(
+        WebRequest::DoAll(items, Collect, &collected, 2, -1, 0, 0, true), 2);
+    ASSERT_EQ(collected.bodies.at<String>(0), String("PUT  payload"));
+    ASSERT_TRUE(collected.bodies.at<String>(1).startsWith("POST  {"));
+    Log("map items: passed");
+  }
+
+  // 5xx responses are retried with backoff until they succeed.
+  {
+    List items;
+    items.append(base + "/flaky");
+    Collected collected;
+    ASSERT_EQ(WebRequest::DoAll(items, Collect, &collected, 1, 5000, 3, 10),
+              1);
+    ASSERT_EQ(collected.statuses.at<int>(0), 200);
+    ASSERT_EQ((int)g_flakyCalls, 3);
+
+    g_flakyCalls = 0;
+    Collected failed;
+    ASSERT_EQ(WebRequest::DoAll(items, Collect, &failed, 1, 5000, 1, 10), 0);
+    ASSERT_EQ(failed.statuses.at<int>(0), 503);
+    ASSERT_EQ((int)g_flakyCalls, 2);
+    Log("retry with backoff: passed");
+  }
+
+  // An empty batch does nothing; a null callback only counts.
+  {
+    ASSERT_EQ(WebRequest::DoAll(List(), Collect, nullptr), 0);
+    ASSERT_EQ(WebRequest::DoAll(requests, nullptr, nullptr, 3, 5000), 6);
+    Log("empty batch and null callback: passed");
+  }
+
+  server.stop();
+
+  Log("=== All WebRequest Batch Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_webrequest_batch");
+  Exit(0);
+}
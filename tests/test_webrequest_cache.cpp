@@ -0,0 +1,160 @@
+#include "test_framework.h"
+
+static volatile LONG g_freshCount = 0;
+static volatile LONG g_etagCount = 0;
+static volatile LONG g_notModifiedCount = 0;
+
+static void SendFresh(const WebServerRequest &request,
+                      WebServerResponse &response, void *arg) {
+  LONG count = InterlockedIncrement(&g_freshCount);
+  response.setHeader(String("Cache-Control"), String("max-age=600"));
+  response.write(String("fresh ") + String((int)count) + " " +
+                 request.getHeader(String("X-User")));
+}
+
+// Always revalidated; answers a matching If-None-Match with a bare 304.
+static void SendTagged(const WebServerRequest &request,
+                       WebServerResponse &response, void *arg) {
+  InterlockedIncrement(&g_etagCount);
+  response.setHeader(String("Cache-Control"), String("no-cache"));
+  response.setHeader(String("ETag"), String("\"v1\""));
+  if (request.getHeader(String("If-None-Match")) == "\"v1\"") {
+    InterlockedIncrement(&g_notModifiedCount);
+    response.setStatus(304);
+    return;
+  }
+  response.write(*(const Buffer *)arg);
+}
+
+static void SendUncacheable(const WebServerRequest &request,
+                            WebServerResponse &response, void *arg) {
+  response.setHeader(String("Cache-Control"), String("no-store"));
+  response.write(String("private"));
+}
+
+// Each path gets a distinct body that LZ4 cannot shrink much.
+static void SendSized(const WebServerRequest &request,
+                      WebServerResponse &response, void *arg) {
+  response.setHeader(String("Cache-Control"), String("max-age=600"));
+  Buffer body;
+  for (int i = 0; i < 4000; i++)
+    body.append(String((char)('a' + Math::RandomRange(0, 26))));
+  response.write(body);
+}
+
+static String Fetch(const String &url, const Map &headers = Map()) {
+  WebRequest request(url, Map(), headers);
+  WebResponse response = request.doGet(5000);
+  return response.getStatusCode() == 200 ? response.asString() : String();
+}
+
+void atto_main() {
+  EnableLoggingToFile("test_webrequest_cache.log", true);
+  Log("=== WebRequest Cache Tests ===");
+
+  Buffer tagged;
+  for (int i = 0; i < 2000; i++)
+    tagged.append(String("tagged line ") + String(i) + "\n");
+
+  WebServer server(0);
+  server.addRoute("GET", "/fresh", SendFresh);
+  server.addRoute("GET", "/tagged", SendTagged, &tagged);
+  server.addRoute("GET", "/private", SendUncacheable);
+  server.addRoute("GET", "/sized", SendSized);
+  ASSERT_TRUE(server.start());
+  String base = String("http://127.0.0.1:") + String(server.getPort());
+
+  WebRequest::ClearCache();
+  REGISTER_TESTED(WebRequest_ClearCache);
+  ASSERT_TRUE(WebRequest::EnableCache(1024 * 1024, List(String("X-User"))));
+  REGISTER_TESTED(WebRequest_EnableCache);
+  long long hits = WebRequest::GetCacheHitCount();
+  long long misses = WebRequest::GetCacheMissCount();
+  long long revalidations = WebRequest::GetCacheRevalidationCount();
+  REGISTER_TESTED(WebRequest_GetCacheHitCount);
+  REGISTER_TESTED(WebRequest_GetCacheMissCount);
+  REGISTER_TESTED(WebRequest_GetCacheRevalidationCount);
+
+  // A fresh entry is served without contacting the server.
+  {
+    String first = Fetch(base + "/fresh");
+    ASSERT_EQ(first, String("fresh 1 "));
+    ASSERT_EQ(Fetch(base + "/fresh"), first);
+    ASSERT_EQ((int)g_freshCount, 1);
+    ASSERT_EQ(WebRequest::GetCacheMissCount(), misses + 1);
+    ASSERT_EQ(WebRequest::GetCacheHitCount(), hits + 1);
+    Log("max-age hit: passed");
+  }
+
+  // Headers named when enabling are part of the key.
+  {
+    Map alice;
+    alice.put(String("X-User"), String("alice"));
+    ASSERT_EQ(Fetch(base + "/fresh", alice), String("fresh 2 alice"));
+    ASSERT_EQ(Fetch(base + "/fresh", alice), String("fresh 2 alice"));
+    ASSERT_EQ(Fetch(base + "/fresh"), String("fresh 1 "));
+    ASSERT_EQ((int)g_freshCount, 2);
+    Log("vary headers: passed");
+  }
+
+  // A stale entry is revalidated and a 304 reuses the stored body.
+  {
+    WebRequest request(base + "/tagged");
+    WebResponse first = request.doGet(5000);
+    ASSERT_EQ(first.getStatusCode(), 200);
+    ASSERT_TRUE(first.asBuffer().compare(tagged));
+
+    WebRequest again(base + "/tagged");
+    WebResponse second = again.doGet(5000);
+    ASSERT_EQ(second.getStatusCode(), 200);
+    ASSERT_TRUE(second.asBuffer().compare(tagged));
+    Map headers = second.getResponseHeaders();
+    String etag = headers.get<String, String>(String("ETag"));
+    ASSERT_EQ(etag, String("\"v1\""));
+    ASSERT_FALSE(again.getHeaders().hasKey<String>(String("If-None-Match")));
+    ASSERT_EQ((int)g_etagCount, 2);
+    ASSERT_EQ((int)g_notModifiedCount, 1);
+    ASSERT_EQ(WebRequest::GetCacheRevalidationCount(), revalidations + 1);
+    Log("etag revalidation: passed");
+  }
+
+  // no-store responses are never kept.
+  {
+    long long before = WebRequest::GetCacheMissCount();
+    ASSERT_EQ(Fetch(base + "/private"), String("private"));
+    ASSERT_EQ(Fetch(base + "/private"), String("private"));
+    ASSERT_EQ(WebRequest::GetCacheMissCount(), before + 2);
+    Log("no-store: passed");
+  }
+
+  // A small cap evicts the least recently used entries.
+  {
+    ASSERT_TRUE(WebRequest::EnableCache(10000));
+    String a = Fetch(base + "/sized/a");
+    String b = Fetch(base + "/sized/b");
+    ASSERT_EQ(Fetch(base + "/sized/a"), a);
+    String c = Fetch(base + "/sized/c");
+    ASSERT_EQ(Fetch(base + "/sized/a"), a);
+    ASSERT_EQ(Fetch(base + "/sized/c"), c);
+    ASSERT_TRUE(Fetch(base + "/sized/b") != b);
+    Log("lru eviction: passed");
+  }
+
+  // Once disabled, every request goes to the server.
+  {
+    WebRequest::DisableCache();
+    REGISTER_TESTED(WebRequest_DisableCache);
+    long long before = WebRequest::GetCacheHitCount();
+    ASSERT_EQ(Fetch(base + "/fresh"), String("fresh 3 "));
+    ASSERT_EQ(WebRequest::GetCacheHitCount(), before);
+    Log("disable: passed");
+  }
+
+  WebRequest::ClearCache();
+  server.stop();
+
+  Log("=== All WebRequest Cache Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_webrequest_cache");
+  Exit(0);
+}
@@ -0,0 +1,83 @@
+#include "test_framework.h"
+
+static void Hello(const WebServerRequest &request, WebServerResponse &response,
+                  void *arg) {
+  response.write(String("hello"));
+}
+
+static String Fetch(const String &url) {
+  WebRequest request(url);
+  WebResponse response = request.doGet(5000);
+  return response.asString();
+}
+
+void atto_main() {
+  EnableLoggingToFile("test_webrequest_pool.log", true);
+  Log("=== WebRequest Connection Pool Tests ===");
+
+  WebServer server(0);
+  server.addRoute("GET", "/hello", Hello);
+  ASSERT_TRUE(server.start());
+  String url = String("http://127.0.0.1:") + String(server.getPort()) +
+               String("/hello");
+
+  // First request opens a connection; later ones reuse it.
+  {
+    long long opened = WebRequest::GetNewConnectionCount();
+    long long reused = WebRequest::GetReusedConnectionCount();
+    REGISTER_TESTED(WebRequest_GetNewConnectionCount);
+    REGISTER_TESTED(WebRequest_GetReusedConnectionCount);
+
+    ASSERT_EQ(Fetch(url), String("hello"));
+    ASSERT_EQ(WebRequest::GetNewConnectionCount(), opened + 1);
+    for (int i = 0; i < 5; i++)
+      ASSERT_EQ(Fetch(url), String("hello"));
+    ASSERT_EQ(WebRequest::GetNewConnectionCount(), opened + 1);
+    ASSERT_EQ(WebRequest::GetReusedConnectionCount(), reused + 5);
+    Log("keep-alive reuse: passed");
+  }
+
+  // A zero idle timeout closes idle hosts, so the next request reconnects.
+  {
+    WebRequest::SetConnectionPool(4, 0);
+    REGISTER_TESTED(WebRequest_SetConnectionPool);
+    long long opened = WebRequest::GetNewConnectionCount();
+    ASSERT_EQ(Fetch(url), String("hello"));
+    ASSERT_EQ(WebRequest::GetNewConnectionCount(), opened + 1);
+
+    WebRequest::SetConnectionPool();
+    long long reused = WebRequest::GetReusedConnectionCount();
+    ASSERT_EQ(Fetch(url), String("hello"));
+    ASSERT_EQ(Fetch(url), String("hello"));
+    ASSERT_TRUE(WebRequest::GetReusedConnectionCount() >= reused + 1);
+
+    // Idle hosts are closed in the background, without another request.
+    WebRequest::SetConnectionPool(4, 200);
+    ASSERT_EQ(Fetch(url), String("hello"));
+    for (int i = 0; i < 50 && server.getConnectionCount() > 0; i++)
+      Sleep(100);
+    ASSERT_EQ(server.getConnectionCount(), 0);
+    WebRequest::SetConnectionPool();
+    Log("idle timeout: passed");
+  }
+
+  // A failed connection is counted as neither new nor reused.
+  {
+    WebServer closed(0);
+    ASSERT_TRUE(closed.start());
+    String closedUrl =
+        String("http://127.0.0.1:") + String(closed.getPort()) + String("/");
+    closed.stop();
+    long long reused = WebRequest::GetReusedConnectionCount();
+    ASSERT_FALSE(WebRequest(closedUrl).doGet(2000).succeeded());
+    ASSERT_EQ(WebRequest::GetReusedConnectionCount(), reused);
+    Log("failed connection: passed");
+  }
+
+  server.stop();
+
+  Log("=== All WebRequest Connection Pool Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_webrequest_pool");
+  Exit(0);
+}
@@ -0,0 +1,176 @@
+#include "test_framework.h"
+
+static void SendFile(const WebServerRequest &request,
+                     WebServerResponse &response, void *arg) {
+  response.sendFile(*(const Path *)arg);
+}
+
+static void NotFound(const WebServerRequest &request,
+                     WebServerResponse &response, void *arg) {
+  response.setStatus(404);
+  response.write(String("missing"));
+}
+
+// Replies with the gzip-compressed content, and reports the Accept-Encoding
+// the client sent.
+static void SendGzip(const WebServerRequest &request,
+                     WebServerResponse &response, void *arg) {
+  response.setHeader(String("Content-Encoding"), String("gzip"));
+  response.setHeader(String("X-Accept-Encoding"),
+                     request.getHeader(String("Accept-Encoding")));
+  response.write(((const Buffer *)arg)->compress(COMPRESSION_GZIP));
+}
+
+struct Received {
+  Buffer data;
+  int chunks;
+  int limit;
+};
+
+static bool Collect(const unsigned char *data, int length, void *arg) {
+  Received *received = (Received *)arg;
+  received->data.append(Buffer(data, length));
+  received->chunks++;
+  return received->limit == 0 || received->chunks < received->limit;
+}
+
+void atto_main() {
+  EnableLoggingToFile("test_webrequest_stream.log", true);
+  Log("=== WebRequest Streaming Tests ===");
+
+  // Large enough to arrive in several chunks.
+  Buffer content;
+  for (int i = 0; i < 50000; i++)
+    content.append(String(i % 10) + "abcdefghijklmnopqrstuvwxy\n");
+  Path source("test_webrequest_stream_source.txt");
+  ASSERT_TRUE(source.writeFromBuffer(content));
+  Path saved("test_webrequest_stream_saved.txt");
+  saved.deleteFile();
+
+  WebServer server(0);
+  server.addRoute("GET", "/file", SendFile, &source);
+  server.addRoute("GET", "/missing", NotFound);
+  server.addRoute("GET", "/gzip", SendGzip, &content);
+  ASSERT_TRUE(server.start());
+  String base = String("http://127.0.0.1:") + String(server.getPort());
+
+  // Chunks go to the callback; the response keeps only status and headers.
+  {
+    Received received = {Buffer(), 0, 0};
+    WebRequest request(base + "/file");
+    WebResponse response = request.doGet(Collect, &received, 5000);
+    REGISTER_TESTED(WebRequest_doGet_callback);
+    ASSERT_EQ(response.getStatusCode(), 200);
+    ASSERT_TRUE(response.asBuffer().isEmpty());
+    ASSERT_TRUE(received.chunks > 1);
+    ASSERT_TRUE(received.data.compare(content));
+    Log("callback streaming: passed");
+  }
+
+  // Returning false stops the transfer.
+  {
+    Received received = {Buffer(), 0, 1};
+    WebRequest request(base + "/file");
+    request.doGet(Collect, &received, 5000);
+    ASSERT_EQ(received.chunks, 1);
+    ASSERT_TRUE(received.data.length() < content.length());
+    Log("callback abort: passed");
+  }
+
+  // Error bodies stay in the response instead of being streamed.
+  {
+    Received received = {Buffer(), 0, 0};
+    WebRequest request(base + "/missing");
+    WebResponse response = request.doGet(Collect, &received, 5000);
+    ASSERT_EQ(response.getStatusCode(), 404);
+    ASSERT_EQ(response.asString(), String("missing"));
+    ASSERT_EQ(received.chunks, 0);
+    Log("error body: passed");
+  }
+
+  // The body is written straight to a File.
+  {
+    {
+      File file(saved);
+      WebRequest request(base + "/file");
+      ASSERT_EQ(request.doGet(file, 5000).getStatusCode(), 200);
+      REGISTER_TESTED(WebRequest_doGet_file);
+    }
+    ASSERT_TRUE(saved.readToBuffer().compare(content));
+    saved.deleteFile();
+    Log("file streaming: passed");
+  }
+
+  // Download streams to disk and leaves the file alone on failure.
+  {
+    ASSERT_TRUE(WebRequest::Download(base + "/file", saved.toString(),
+                                     Map(), Map(), true, 5000));
+    ASSERT_TRUE(saved.readToBuffer().compare(content));
+    ASSERT_FALSE(WebRequest::Download(base + "/missing", saved.toString(),
+                                      Map(), Map(), true, 5000));
+    ASSERT_TRUE(saved.readToBuffer().compare(content));
+    saved.deleteFile();
+    Log("download: passed");
+  }
+
+  // A partial file is completed with a Range request.
+  {
+    int half = content.length() / 2;
+    ASSERT_TRUE(saved.writeFromBuffer(content.slice(0, half)));
+    ASSERT_TRUE(WebRequest::ResumeDownload(base + "/file", saved.toString(),
+                                           Map(), Map(), 5000));
+    REGISTER_TESTED(WebRequest_ResumeDownload);
+    ASSERT_TRUE(saved.readToBuffer().compare(content));
+
+    // Already complete: the server answers 416 and the file is unchanged.
+    ASSERT_TRUE(WebRequest::ResumeDownload(base + "/file", saved.toString(),
+                                           Map(), Map(), 5000));
+    ASSERT_TRUE(saved.readToBuffer().compare(content));
+
+    // No file yet: a plain download.
+    saved.deleteFile();
+    ASSERT_TRUE(WebRequest::ResumeDownload(base + "/file", saved.toString(),
+                                           Map(), Map(), 5000));
+    ASSERT_TRUE(saved.readToBuffer().compare(content));
+    Log("resume download: passed");
+  }
+
+  // A gzip body is decoded as it arrives, in memory and when streamed.
+  {
+    WebRequest request(base + "/gzip");
+    WebResponse response = request.doGet(5000);
+    ASSERT_EQ(response.getStatusCode(), 200);
+    Map headers = response.getResponseHeaders();
+    String accepted =
+        headers.get<String, String>(String("X-Accept-Encoding"));
+    ASSERT_TRUE(accepted.contains(String("gzip")));
+    ASSERT_FALSE(headers.hasKey<String>(String("Content-Encoding")));
+    ASSERT_TRUE(response.asBuffer().compare(content));
+
+    Received received = {Buffer(), 0, 0};
+    WebRequest streamed(base + "/gzip");
+    ASSERT_EQ(streamed.doGet(Collect, &received, 5000).getStatusCode(), 200);
+    ASSERT_TRUE(received.data.compare(content));
+    Log("gzip decoding: passed");
+  }
+
+  // A caller that negotiates the encoding itself gets the raw body.
+  {
+    Map headers;
+    headers.put(String("Accept-Encoding"), String("gzip"));
+    WebRequest request(base + "/gzip", Map(), headers);
+    Buffer body = request.doGet(5000).asBuffer();
+    ASSERT_TRUE(body.compare(content.compress(COMPRESSION_GZIP)));
+    ASSERT_TRUE(body.decompress(COMPRESSION_GZIP).compare(content));
+    Log("caller Accept-Encoding: passed");
+  }
+
+  server.stop();
+  source.deleteFile();
+  saved.deleteFile();
+
+  Log("=== All WebRequest Streaming Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_webrequest_stream");
+  Exit(0);
+}
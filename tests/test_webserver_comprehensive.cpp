@@ -0,0 +1,375 @@
+#include "test_framework.h"
+
+static void Hello(const WebServerRequest &request, WebServerResponse &response,
+                  void *arg) {
+  response.setHeader("X-Arg", String((int)(long long)arg));
+  response.write(String("hello"));
+}
+
+static void Echo(const WebServerRequest &request, WebServerResponse &response,
+                 void *arg) {
+  response.setStatus(201);
+  response.setHeader("Content-Type", "text/plain");
+  response.write(request.getMethod() + " " + request.getPath() + " " +
+                 request.getQuery() + " " + request.getHeader("x-test") + " " +
+                 String(request.getHeaders().length()) + " ");
+  response.write(request.getBody());
+}
+
+static void Empty(const WebServerRequest &request, WebServerResponse &response,
+                  void *arg) {
+  response.setStatus(204);
+  response.setHeader("Bad", "split\r\nInjected: yes");
+  response.write(String("ignored"));
+}
+
+static void Slow(const WebServerRequest &request, WebServerResponse &response,
+                 void *arg) {
+  Sleep(1000);
+  response.write(String("slow"));
+}
+
+static void SendFile(const WebServerRequest &request,
+                     WebServerResponse &response, void *arg) {
+  if (!response.sendFile(*(const Path *)arg)) {
+    response.setStatus(500);
+    response.write(String("missing"));
+  }
+}
+
+// Reads one response (head plus Content-Length bytes of body) from client,
+// keeping any bytes of later responses in pending.
+static String ReadResponse(File &client, String &pending) {
+  for (;;) {
+    int headEnd = pending.getPositionOf("\r\n\r\n");
+    if (headEnd >= 0) {
+      int bodyLength = 0;
+      int lengthAt = pending.getPositionOf("Content-Length: ");
+      if (lengthAt >= 0 && lengthAt < headEnd) {
+        int lineEnd = pending.getPositionOf("\r\n", lengthAt);
+        bodyLength = pending.substring(lengthAt + 16, lineEnd).toInteger();
+      }
+      int total = headEnd + 4 + bodyLength;
+      if (pending.length() >= total) {
+        String response = pending.substring(0, total);
+        pending = pending.substring(total);
+        return response;
+      }
+    }
+    String more = client.readToString(4096);
+    if (more.isEmpty()) {
+      String rest = pending;
+      pending = String();
+      return rest;
+    }
+    pending = pending + more;
+  }
+}
+
+static String Request(File &client, const String &request) {
+  String pending;
+  client.write(request);
+  return ReadResponse(client, pending);
+}
+
+static int g_port = 0;
+
+static void *LoadClient(void *arg) {
+  File client(String("127.0.0.1"), g_port);
+  if (!client.isValid())
+    return (void *)0;
+  long long ok = 0;
+  for (int i = 0; i < 25; i++) {
+    String response = Request(client, "GET /hello HTTP/1.1\r\nHost: x\r\n\r\n");
+    if (response.endsWith("\r\n\r\nhello"))
+      ok++;
+  }
+  return (void *)ok;
+}
+
+void atto_main() {
+  EnableLoggingToFile("test_webserver_comprehensive.log", true);
+  Log("=== Comprehensive WebServer Tests ===");
+
+  Path filePath("test_webserver_temp.html");
+  filePath.writeFromString(String("<p>hi</p>"));
+  Path largePath("test_webserver_large.txt");
+  Path missingPath("test_webserver_missing.html");
+  missingPath.deleteFile();
+
+  // Construction before start()
+  {
+    WebServer server(0);
+    REGISTER_TESTED(WebServer_constructor);
+    REGISTER_TESTED(WebServer_isRunning);
+    REGISTER_TESTED(WebServer_getPort);
+    REGISTER_TESTED(WebServer_getConnectionCount);
+    REGISTER_TESTED(WebServer_getRequestCount);
+    REGISTER_TESTED(WebServer_destructor);
+    ASSERT_FALSE(server.isRunning());
+    ASSERT_EQ(server.getPort(), 0);
+    ASSERT_EQ(server.getConnectionCount(), 0);
+    ASSERT_EQ(server.getRequestCount(), 0);
+    server.stop();
+    ASSERT_FALSE(server.isRunning());
+    Log("construction: passed");
+  }
+
+  WebServer server(0);
+  REGISTER_TESTED(WebServer_addRoute);
+  ASSERT_TRUE(server.addRoute("GET", "/hello", Hello, (void *)7));
+  ASSERT_TRUE(server.addRoute("", "/echo", Echo));
+  ASSERT_TRUE(server.addRoute("POST", "/api/", Echo));
+  ASSERT_TRUE(server.addRoute("GET", "/empty", Empty));
+  ASSERT_TRUE(server.addRoute("GET", "/slow", Slow));
+  ASSERT_TRUE(server.addRoute("GET", "/file", SendFile, &filePath));
+  ASSERT_TRUE(server.addRoute("GET", "/large", SendFile, &largePath));
+  ASSERT_TRUE(server.addRoute("GET", "/missing", SendFile, &missingPath));
+  ASSERT_FALSE(server.addRoute("GET", "relative", Hello));
+  ASSERT_FALSE(server.addRoute("GET", "/x", nullptr));
+
+  REGISTER_TESTED(WebServer_start);
+  ASSERT_TRUE(server.start());
+  ASSERT_FALSE(server.start());
+  ASSERT_TRUE(server.isRunning());
+  ASSERT_TRUE(server.getPort() > 0);
+  g_port = server.getPort();
+
+  // Routing, request getters and response building
+  {
+    File client(String("127.0.0.1"), g_port);
+    ASSERT_TRUE(client.isValid());
+
+    REGISTER_TESTED(WebServerResponse_setHeader);
+    REGISTER_TESTED(WebServerResponse_write_string);
+    String response = Request(client, "GET /hello HTTP/1.1\r\nHost: x\r\n\r\n");
+    ASSERT_TRUE(response.startsWith("HTTP/1.1 200 OK\r\n"));
+    ASSERT_TRUE(response.contains("\r\nX-Arg: 7\r\n"));
+    ASSERT_TRUE(response.contains("\r\nContent-Length: 5\r\n"));
+    ASSERT_TRUE(response.contains("Content-Type: text/plain"));
+    ASSERT_TRUE(response.endsWith("\r\n\r\nhello"));
+
+    REGISTER_TESTED(WebServerRequest_getMethod);
+    REGISTER_TESTED(WebServerRequest_getPath);
+    REGISTER_TESTED(WebServerRequest_getQuery);
+    REGISTER_TESTED(WebServerRequest_getHeader);
+    REGISTER_TESTED(WebServerRequest_getHeaders);
+    REGISTER_TESTED(WebServerRequest_getBody);
+    REGISTER_TESTED(WebServerResponse_setStatus);
+    REGISTER_TESTED(WebServerResponse_write_buffer);
+    response = Request(client, "PUT /echo/a%20b?q=1&r HTTP/1.1\r\nHost: x\r\n"
+                               "X-Test:  value \r\nContent-Length: 4\r\n\r\n"
+                               "body");
+    ASSERT_TRUE(response.startsWith("HTTP/1.1 201 Created\r\n"));
+    ASSERT_EQ(response.count("Content-Type"), 1);
+    ASSERT_TRUE(response.endsWith("\r\n\r\nPUT /echo/a b q=1&r value 3 body"));
+
+    // Prefixes match whole path segments; GET routes answer HEAD.
+    ASSERT_TRUE(Request(client, "GET /hellox HTTP/1.1\r\n\r\n")
+                    .startsWith("HTTP/1.1 404 Not Found\r\n"));
+    ASSERT_TRUE(Request(client, "GET /api/users HTTP/1.1\r\n\r\n")
+                    .startsWith("HTTP/1.1 404 "));
+    ASSERT_TRUE(
+        Request(client, "POST /api/users HTTP/1.1\r\nContent-Length: 0\r\n\r\n")
+            .endsWith("POST /api/users   1 "));
+    client.write(String("HEAD /hello HTTP/1.1\r\n\r\n"));
+    response = client.readToString(4096);
+    ASSERT_TRUE(response.contains("\r\nContent-Length: 5\r\n"));
+    ASSERT_TRUE(response.endsWith("\r\n\r\n"));
+
+    // Bodyless statuses drop the body; header injection is refused.
+    response = Request(client, "GET /empty HTTP/1.1\r\n\r\n");
+    ASSERT_TRUE(response.startsWith("HTTP/1.1 204 No Content\r\n"));
+    ASSERT_FALSE(response.contains("Content-Length"));
+    ASSERT_FALSE(response.contains("Injected"));
+    ASSERT_TRUE(response.endsWith("\r\n\r\n"));
+
+    REGISTER_TESTED(WebServerResponse_sendFile);
+    response = Request(client, "GET /file HTTP/1.1\r\n\r\n");
+    ASSERT_TRUE(response.contains("Content-Type: text/html"));
+    ASSERT_TRUE(response.contains("\r\nAccept-Ranges: bytes\r\n"));
+    ASSERT_TRUE(response.endsWith("\r\n\r\n<p>hi</p>"));
+
+    // Single byte ranges, suffix ranges and unsatisfiable ranges
+    response =
+        Request(client, "GET /file HTTP/1.1\r\nRange: bytes=3-4\r\n\r\n");
+    ASSERT_TRUE(response.startsWith("HTTP/1.1 206 Partial Content\r\n"));
+    ASSERT_TRUE(response.contains("\r\nContent-Range: bytes 3-4/9\r\n"));
+    ASSERT_TRUE(response.endsWith("\r\n\r\nhi"));
+    response = Request(client, "GET /file HTTP/1.1\r\nRange: bytes=5-\r\n\r\n");
+    ASSERT_TRUE(response.endsWith("\r\n\r\n</p>"));
+    response = Request(client, "GET /file HTTP/1.1\r\nRange: bytes=-2\r\n\r\n");
+    ASSERT_TRUE(response.contains("Content-Range: bytes 7-8/9"));
+    ASSERT_TRUE(response.endsWith("\r\n\r\np>"));
+    response = Request(client, "GET /file HTTP/1.1\r\nRange: bytes=9-\r\n\r\n");
+    ASSERT_TRUE(response.startsWith("HTTP/1.1 416 "));
+    ASSERT_TRUE(response.contains("\r\nContent-Range: bytes */9\r\n"));
+    ASSERT_TRUE(response.contains("\r\nContent-Length: 0\r\n"));
+    response = Request(client, "GET /file HTTP/1.1\r\nRange: bytes=0-1,4-5"
+                               "\r\n\r\n");
+    ASSERT_TRUE(response.startsWith("HTTP/1.1 200 "));
+    ASSERT_TRUE(response.endsWith("\r\n\r\n<p>hi</p>"));
+    response = Request(client, "GET /file HTTP/1.1\r\nRange: bytes=0-1\r\n"
+                               "If-Range: \"x\"\r\n\r\n");
+    ASSERT_TRUE(response.startsWith("HTTP/1.1 200 "));
+    client.write(String("HEAD /file HTTP/1.1\r\nRange: bytes=0-2\r\n\r\n"));
+    response = client.readToString(4096);
+    ASSERT_TRUE(response.startsWith("HTTP/1.1 206 "));
+    ASSERT_TRUE(response.contains("\r\nContent-Length: 3\r\n"));
+    ASSERT_TRUE(response.endsWith("\r\n\r\n"));
+
+    // A large file is streamed, and pipelined responses stay in order.
+    Buffer large;
+    for (int i = 0; i < 300000; i++) {
+      unsigned char byte = (unsigned char)('a' + i % 26);
+      large.append(&byte, 1);
+    }
+    largePath.writeFromBuffer(large);
+    String pending;
+    client.write(String("GET /large HTTP/1.1\r\n\r\n"
+                        "GET /large HTTP/1.1\r\nRange: bytes=299990-\r\n\r\n"
+                        "GET /hello HTTP/1.1\r\n\r\n"));
+    response = ReadResponse(client, pending);
+    ASSERT_TRUE(response.contains("\r\nContent-Length: 300000\r\n"));
+    ASSERT_TRUE(response.endsWith("\r\n\r\n" + large.toString()));
+    response = ReadResponse(client, pending);
+    ASSERT_TRUE(response.endsWith("\r\n\r\n" +
+                                  large.slice(299990).toString()));
+    ASSERT_TRUE(ReadResponse(client, pending).endsWith("hello"));
+    response = Request(client, "GET /missing HTTP/1.1\r\n\r\n");
+    ASSERT_TRUE(response.startsWith("HTTP/1.1 500 "));
+    ASSERT_TRUE(response.endsWith("missing"));
+    ASSERT_EQ(server.getConnectionCount(), 1);
+    Log("routing and getters: passed");
+  }
+
+  // Pipelined requests are answered in order; a split request is reassembled
+  {
+    File client(String("127.0.0.1"), g_port);
+    ASSERT_TRUE(client.isValid());
+    String pending;
+    client.write(String("GET /hello HTTP/1.1\r\n\r\n"
+                        "GET /echo/1 HTTP/1.1\r\n\r\n"
+                        "GET /echo/2 HTTP/1.1\r\n\r\n"));
+    ASSERT_TRUE(ReadResponse(client, pending).endsWith("hello"));
+    ASSERT_TRUE(ReadResponse(client, pending).endsWith("GET /echo/1   0 "));
+    ASSERT_TRUE(ReadResponse(client, pending).endsWith("GET /echo/2   0 "));
+
+    client.write(String("POST /echo HTTP/1.1\r\nConte"));
+    Sleep(50);
+    client.write(String("nt-Length: 6\r\n\r\nab"));
+    Sleep(50);
+    client.write(String("cdef"));
+    ASSERT_TRUE(
+        ReadResponse(client, pending).endsWith("POST /echo   1 abcdef"));
+
+    // Expect: 100-continue gets an interim response before the body is sent.
+    client.write(String("POST /echo HTTP/1.1\r\nExpect: 100-continue\r\n"
+                        "Content-Length: 2\r\n\r\n"));
+    ASSERT_TRUE(ReadResponse(client, pending)
+                    .startsWith("HTTP/1.1 100 Continue\r\n\r\n"));
+    client.write(String("ok"));
+    ASSERT_TRUE(ReadResponse(client, pending).endsWith("2 ok"));
+    Log("pipelining and partial reads: passed");
+  }
+
+  // Connection: close, HTTP/1.0 and malformed requests close the connection
+  {
+    File client(String("127.0.0.1"), g_port);
+    String response =
+        Request(client, "GET /hello HTTP/1.1\r\nConnection: close\r\n\r\n");
+    ASSERT_TRUE(response.contains("\r\nConnection: close\r\n"));
+    ASSERT_TRUE(client.readToString(16).isEmpty());
+
+    File old(String("127.0.0.1"), g_port);
+    response = Request(old, "GET /hello HTTP/1.0\r\n\r\n");
+    ASSERT_TRUE(response.endsWith("hello"));
+    ASSERT_TRUE(old.readToString(16).isEmpty());
+
+    File bad(String("127.0.0.1"), g_port);
+    response = Request(bad, "NOT A REQUEST\r\n\r\n");
+    ASSERT_TRUE(response.startsWith("HTTP/1.1 400 Bad Request\r\n"));
+    ASSERT_TRUE(bad.readToString(16).isEmpty());
+
+    File chunked(String("127.0.0.1"), g_port);
+    response = Request(chunked, "POST /echo HTTP/1.1\r\n"
+                                "Transfer-Encoding: chunked\r\n\r\n");
+    ASSERT_TRUE(response.startsWith("HTTP/1.1 501 "));
+
+    File version(String("127.0.0.1"), g_port);
+    response = Request(version, "GET / HTTP/2.0\r\n\r\n");
+    ASSERT_TRUE(response.startsWith("HTTP/1.1 505 "));
+    Log("connection close: passed");
+  }
+
+  // Concurrent keep-alive clients
+  {
+    long long before = server.getRequestCount();
+    Thread *threads[8];
+    for (int i = 0; i < 8; i++)
+      threads[i] = new Thread(LoadClient);
+    long long ok = 0;
+    for (int i = 0; i < 8; i++) {
+      ok += (long long)threads[i]->await();
+      delete threads[i];
+    }
+    ASSERT_EQ(ok, 200);
+    ASSERT_EQ(server.getRequestCount() - before, 200);
+    Log("concurrent clients: passed");
+  }
+
+  // Handlers that block do not hold up other connections
+  {
+    File *slow[16];
+    for (int i = 0; i < 16; i++) {
+      slow[i] = new File(String("127.0.0.1"), g_port);
+      slow[i]->write(String("GET /slow HTTP/1.1\r\n\r\n"));
+    }
+    Sleep(100);
+    DateTime start;
+    File fast(String("127.0.0.1"), g_port);
+    ASSERT_TRUE(Request(fast, "GET /hello HTTP/1.1\r\n\r\n").endsWith("hello"));
+    ASSERT_TRUE(DateTime().diff(start) < 800);
+    for (int i = 0; i < 16; i++) {
+      String pending;
+      ASSERT_TRUE(ReadResponse(*slow[i], pending).endsWith("\r\n\r\nslow"));
+      delete slow[i];
+    }
+    Log("blocking handlers: passed");
+  }
+
+  // Copies share the server; stop() closes idle connections
+  {
+    WebServer copy(server);
+    REGISTER_TESTED(WebServer_constructor_copy);
+    WebServer assigned(0);
+    assigned = server;
+    REGISTER_TESTED(WebServer_operator_assign);
+    ASSERT_EQ(copy.getPort(), g_port);
+    ASSERT_EQ(assigned.getRequestCount(), server.getRequestCount());
+
+    File idle(String("127.0.0.1"), g_port);
+    ASSERT_TRUE(Request(idle, "GET /hello HTTP/1.1\r\n\r\n").endsWith("hello"));
+    REGISTER_TESTED(WebServer_stop);
+    copy.stop();
+    ASSERT_FALSE(server.isRunning());
+    ASSERT_EQ(server.getConnectionCount(), 0);
+    ASSERT_TRUE(idle.readToString(16).isEmpty());
+
+    // A stopped server can be started again.
+    ASSERT_TRUE(assigned.start());
+    File again(String("127.0.0.1"), server.getPort());
+    ASSERT_TRUE(
+        Request(again, "GET /hello HTTP/1.1\r\n\r\n").endsWith("hello"));
+    Log("copy, stop and restart: passed");
+  }
+
+  server.stop();
+  filePath.deleteFile();
+  largePath.deleteFile();
+
+  Log("=== All WebServer Tests Passed ===");
+  TestFramework::DisplayCoverage();
+  TestFramework::WriteCoverageData("test_webserver_comprehensive");
+  Exit(0);
+}